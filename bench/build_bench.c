@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * build_bench.c - parallel bulk build benchmark
+ *
+ * Measures the throughput of building a B+-tree and a B-tree from sorted elements from 1 to 64 threads.
+ *
+ * usage: build_bench [number of elements]
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/bplustree.h>
+#include <index/btree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+const void **keys;
+size_t      nmemb;
+
+double measure(const int kind, const size_t nthreads) {
+  struct bplus_root bplus = bplus_init(64, less);
+  struct btree_root btree = btree_init(64, less);
+  struct timespec   begin;
+  struct timespec   end;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  if (kind == 0) bplus_build(&bplus, keys, (void **)keys, nmemb, nthreads);
+  else           btree_build(&btree, keys, (void **)keys, nmemb, nthreads);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  bplus_clear(&bplus);
+  btree_clear(&btree);
+
+  return (double)nmemb / ((end.tv_sec-begin.tv_sec)*1e9 + (end.tv_nsec-begin.tv_nsec)) * 1e3;
+}
+
+int main(int argc, const char **argv) {
+  nmemb = argc < 2 ? 1 << 24 : strtoull(argv[1], NULL, 10);
+  keys  = malloc(__SIZEOF_POINTER__*nmemb);
+
+  for (size_t idx = 0; idx < nmemb; ++idx)
+    keys[idx] = (void *)(uintptr_t)(idx+1);
+
+  printf("%zu elements, throughput in M elements/s\n", nmemb);
+  printf("%7s %10s %10s\n", "threads", "bplus", "btree");
+
+  for (size_t nthreads = 1; nthreads <= 64; nthreads <<= 1)
+    printf("%7zu %10.2f %10.2f\n", nthreads, measure(0, nthreads), measure(1, nthreads));
+
+  free(keys);
+
+  return 0;
+}
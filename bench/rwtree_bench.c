@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * rwtree_bench.c - reader/writer-locked tree benchmark
+ *
+ * Measures the lookup throughput of the reader/writer-locked trees from 1 to 64 threads,
+ * against an AVL tree guarded by a single mutex, a B+-tree under optimistic lock coupling,
+ * a sharded index of 16 B+-trees and a lock-free skip list.
+ *
+ * usage: rwtree_bench [write percentage]
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/rwtree.h>
+#include <index/shard.h>
+#include <index/skiplist.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NKEYS   (1 << 20)
+#define NOPS    (1 << 18)
+#define NSHARDS 16
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+struct avl_root avl;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct avl_rw_root   avl_rw;
+struct rb_rw_root    rb_rw;
+struct llrb_rw_root  llrb_rw;
+struct btree_rw_root btree_rw;
+struct bplus_rw_root bplus_rw;
+struct bplus_root    bplus_olc;
+struct shard_root    shard;
+struct epoch_root    epoch;
+struct skip_root     skip;
+
+int writes;
+
+/**
+ * struct worker - a thread performing lookups on one of the trees
+ *
+ * @kind: the kind of tree
+ * @seed: the state of the random number generator
+ * @hits: the number of the keys found
+ */
+struct worker {
+  int       kind;
+  uint64_t  seed;
+  size_t    hits;
+};
+
+static inline uintptr_t next(uint64_t *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  return 1 + (uintptr_t)(*seed % NKEYS);
+}
+
+void *work(void *arg) {
+  struct worker       *worker = arg;
+  struct epoch_thread thread;
+  void                *value;
+
+  if (worker->kind == 8)
+    epoch_register(&epoch, &thread);
+
+  for (size_t op = 0; op < NOPS; ++op) {
+    const uintptr_t key   = next(&worker->seed);
+    const bool      write = (int)(worker->seed % 100) < writes;
+
+    switch (worker->kind) {
+      case 0:
+        pthread_mutex_lock(&mutex);
+        value = write ? avl_replace(&avl, (void *)key, (void *)key).value : avl_find(avl, (void *)key).value;
+        pthread_mutex_unlock(&mutex);
+        break;
+      case 1:
+        if (write) avl_rw_replace(&avl_rw, (void *)key, (void *)key), value = (void *)key;
+        else       value = avl_rw_find(&avl_rw, (void *)key);
+        break;
+      case 2:
+        if (write) rb_rw_replace(&rb_rw, (void *)key, (void *)key), value = (void *)key;
+        else       value = rb_rw_find(&rb_rw, (void *)key);
+        break;
+      case 3:
+        if (write) llrb_rw_replace(&llrb_rw, (void *)key, (void *)key), value = (void *)key;
+        else       value = llrb_rw_find(&llrb_rw, (void *)key);
+        break;
+      case 4:
+        if (write) btree_rw_replace(&btree_rw, (void *)key, (void *)key), value = (void *)key;
+        else       value = btree_rw_find(&btree_rw, (void *)key);
+        break;
+      case 5:
+        if (write) bplus_rw_replace(&bplus_rw, (void *)key, (void *)key), value = (void *)key;
+        else       value = bplus_rw_find(&bplus_rw, (void *)key);
+        break;
+      case 6:
+        if (write) bplus_olc_erase(&bplus_olc, (void *)key), bplus_olc_insert(&bplus_olc, (void *)key, (void *)key), value = (void *)key;
+        else       value = bplus_olc_find(&bplus_olc, (void *)key);
+        break;
+      case 7:
+        if (write) shard_replace(&shard, (void *)key, (void *)key), value = (void *)key;
+        else       value = shard_find(&shard, (void *)key);
+        break;
+      default:
+        epoch_enter(&epoch, &thread);
+        value = write ? skip_replace(&skip, (void *)key, (void *)key).value : skip_find(&skip, (void *)key).value;
+        epoch_exit(&thread);
+        break;
+    }
+
+    worker->hits += value == (void *)key;
+  }
+
+  if (worker->kind == 8)
+    epoch_unregister(&epoch, &thread);
+
+  return NULL;
+}
+
+double measure(const int kind, const int nthreads) {
+  pthread_t       threads[64];
+  struct worker   workers[64];
+  struct timespec begin;
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  for (int idx = 0; idx < nthreads; ++idx) {
+    workers[idx] = (struct worker){ .kind = kind, .seed = 0x9E3779B97F4A7C15ULL * (idx+1), .hits = 0 };
+    pthread_create(&threads[idx], NULL, work, &workers[idx]);
+  }
+
+  for (int idx = 0; idx < nthreads; ++idx)
+    pthread_join(threads[idx], NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return (double)nthreads*NOPS / ((end.tv_sec-begin.tv_sec)*1e9 + (end.tv_nsec-begin.tv_nsec)) * 1e3;
+}
+
+int main(int argc, const char **argv) {
+  const void *bounds[NSHARDS-1];
+
+  writes = argc < 2 ? 0 : atoi(argv[1]);
+
+  for (uintptr_t idx = 1; idx < NSHARDS; ++idx)
+    bounds[idx-1] = (void *)(1 + idx*NKEYS/NSHARDS);
+
+  avl = avl_init(less);
+  avl_rw_init(&avl_rw, less);
+  rb_rw_init(&rb_rw, less);
+  llrb_rw_init(&llrb_rw, less);
+  btree_rw_init(&btree_rw, 64, less);
+  bplus_rw_init(&bplus_rw, 64, less);
+  memcpy(&bplus_olc, &bplus_rw.tree, sizeof(struct bplus_root));
+  shard_init(&shard, NSHARDS, bounds, 64, less);
+  epoch_init(&epoch);
+  skip_init(&skip, less, &epoch);
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key) {
+    avl_insert(&avl, (void *)key, (void *)key);
+    avl_rw_insert(&avl_rw, (void *)key, (void *)key);
+    rb_rw_insert(&rb_rw, (void *)key, (void *)key);
+    llrb_rw_insert(&llrb_rw, (void *)key, (void *)key);
+    btree_rw_insert(&btree_rw, (void *)key, (void *)key);
+    bplus_rw_insert(&bplus_rw, (void *)key, (void *)key);
+    bplus_olc_insert(&bplus_olc, (void *)key, (void *)key);
+    shard_insert(&shard, (void *)key, (void *)key);
+    skip_insert(&skip, (void *)key, (void *)key);
+  }
+
+  printf("%d%% writes, throughput in Mops/s\n", writes);
+  printf("%7s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "threads", "avl+mutex", "avl_rw", "rb_rw", "llrb_rw", "btree_rw", "bplus_rw", "bplus_olc", "shard", "skiplist");
+
+  for (int nthreads = 1; nthreads <= 64; nthreads <<= 1) {
+    printf("%7d", nthreads);
+    for (int kind = 0; kind < 9; ++kind)
+      printf(" %10.2f", measure(kind, nthreads));
+    putchar('\n');
+  }
+
+  avl_clear(&avl);
+  avl_rw_destroy(&avl_rw);
+  rb_rw_destroy(&rb_rw);
+  llrb_rw_destroy(&llrb_rw);
+  btree_rw_destroy(&btree_rw);
+  bplus_rw_destroy(&bplus_rw);
+  bplus_clear(&bplus_olc);
+  shard_destroy(&shard);
+  skip_destroy(&skip);
+  epoch_destroy(&epoch);
+
+  return 0;
+}
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * scan_bench.c - parallel range reduce benchmark
+ *
+ * Measures the throughput of summing the values of a B+-tree over its whole range and over its middle half from 1 to 64 threads.
+ *
+ * usage: scan_bench [number of elements]
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/bplustree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+void add(void *restrict acc, const void *restrict key, void *restrict value) { (void)key; *(uintptr_t *)acc += (uintptr_t)value; }
+
+void sum(void *restrict acc, const void *restrict other) { *(uintptr_t *)acc += *(const uintptr_t *)other; }
+
+struct bplus_root *tree;
+size_t            nmemb;
+
+double measure(const int kind, const size_t nthreads) {
+  uintptr_t       acc = 0;
+  struct timespec begin;
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+
+  if (kind == 0) bplus_reduce(*tree, add, sum, &acc, sizeof(acc), nthreads);
+  else           bplus_range_reduce(*tree, (void *)(uintptr_t)(nmemb/4+1), (void *)(uintptr_t)(nmemb/4*3+1), add, sum, &acc, sizeof(acc), nthreads);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return (double)(kind == 0 ? nmemb : nmemb>>1) / ((end.tv_sec-begin.tv_sec)*1e9 + (end.tv_nsec-begin.tv_nsec)) * 1e3;
+}
+
+int main(int argc, const char **argv) {
+  struct bplus_root bplus = bplus_init(64, less);
+  const void        **keys;
+
+  nmemb = argc < 2 ? 1 << 24 : strtoull(argv[1], NULL, 10);
+  keys  = malloc(__SIZEOF_POINTER__*nmemb);
+  tree  = &bplus;
+
+  for (size_t idx = 0; idx < nmemb; ++idx)
+    keys[idx] = (void *)(uintptr_t)(idx+1);
+
+  bplus_build(tree, keys, (void **)keys, nmemb, 1);
+  free(keys);
+
+  printf("%zu elements, throughput in M elements/s\n", nmemb);
+  printf("%7s %10s %10s\n", "threads", "all", "range");
+
+  for (size_t nthreads = 1; nthreads <= 64; nthreads <<= 1)
+    printf("%7zu %10.2f %10.2f\n", nthreads, measure(0, nthreads), measure(1, nthreads));
+
+  bplus_clear(tree);
+
+  return 0;
+}
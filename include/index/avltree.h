@@ -23,6 +23,10 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+struct bplus_codec;
+struct epoch_root;
+struct serial_stream;
+
 /**
  * struct avl_node - a node in AVL tree
  *
@@ -34,6 +38,9 @@
  * @tree:   the address of the tree to which the node belongs
  * @height: the height of the subtree rooted with the node
  *
+ * Since avl_join and avl_split move subtrees between trees in logarithmic time,
+ * @tree is only kept up to date for the root node.
+ *
  * In a binary tree, the balance factor of a node X is defined
  * to be the height difference
  *
@@ -74,6 +81,36 @@ struct avl_reverse_iter {
         struct avl_node *pivot;
 } __attribute__((aligned(__SIZEOF_POINTER__)));
 
+/**
+ * struct avl_cow_node - a node in persistent AVL tree
+ *
+ * @key:      the key of the node
+ * @value:    the value of the node
+ * @left:     the address of the left subtree
+ * @right:    the address of the right subtree
+ * @height:   the height of the subtree rooted with the node
+ * @refcount: the number of the links to the node, from either parent nodes or snapshots
+ *
+ * Nodes are shared between the versions of a persistent tree,
+ * so that they have neither a parent nor a tree.
+ * A node referred to by more than one link is immutable;
+ * a writer copies it before modification and leaves the original to the other versions.
+ */
+struct avl_cow_node {
+  const void                *key;
+        void                *value;
+        struct avl_cow_node *left;
+        struct avl_cow_node *right;
+        size_t              height;
+        size_t              refcount;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+struct avl_cow_root {
+  struct avl_cow_node *root;
+  bool               (*less)(const void *restrict, const void *restrict);
+  size_t              size;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
 /*
  * The below functions use the operator with 3 different
  * calling conventions. The operator denotes:
@@ -181,6 +218,150 @@ extern void *avl_erase(struct avl_root *restrict tree, const void *restrict key)
  */
 extern void avl_clear(struct avl_root *tree);
 
+/**
+ * avl_clone - copies all entries of @other into @tree
+ *
+ * @tree:  empty tree to copy the entries into
+ * @other: tree to copy the entries from
+ *
+ * The node structure of @other is copied level by level without any comparison.
+ */
+extern void avl_clone(struct avl_root *restrict tree, const struct avl_root other);
+
+/**
+ * avl_dump - writes the entries of @tree in ascending order to @stream
+ *
+ * @tree:   tree to dump
+ * @stream: the stream to write the dump to
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ *
+ * The dump is the number of the entries followed by the length-prefixed records of the key and the value of each entry,
+ * as laid out in serial.h, so that it does not depend on the machine that wrote it.
+ *
+ * Returns false if the stream fails or a record cannot be buffered.
+ */
+extern bool avl_dump(const struct avl_root tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * avl_restore - builds @tree from a dump read from @stream
+ *
+ * @tree:   empty tree to build
+ * @stream: the stream to read the dump from
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ *
+ * The entries are read in ascending order and linked into a balanced shape as they come,
+ * without any comparison or rebalancing, so that the tree is built in linear time.
+ *
+ * Returns false if @tree is not empty, leaving it as it is,
+ * or if the stream fails or a record is malformed, leaving @tree empty and releasing the keys and values read by the codecs.
+ */
+extern bool avl_restore(struct avl_root *restrict tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * avl_join - moves all entries from @other into @tree
+ *
+ * @tree:  tree to move the entries into
+ * @other: tree to move the entries from
+ *
+ * The keys of @other must be either all less or all greater than those of @tree;
+ * otherwise it returns false without moving any entry.
+ */
+extern bool avl_join(struct avl_root *restrict tree, struct avl_root *restrict other);
+
+/**
+ * avl_split - moves the entries of @tree greater than or equal to @key into @other
+ *
+ * @tree:  tree to split
+ * @key:   the key to split at
+ * @other: empty tree to move the entries into
+ *
+ * The tree is cut in logarithmic time, but as the nodes carry no subtree sizes,
+ * the sizes of the two trees are recounted in time proportional to the smaller one.
+ */
+extern void avl_split(struct avl_root *restrict tree, const void *restrict key, struct avl_root *restrict other);
+
+/**
+ * avl_union - moves the entries of @other into @tree, freeing those whose keys are already in @tree
+ *
+ * @tree:  tree to store the union into
+ * @other: tree to move the entries from
+ */
+extern void avl_union(struct avl_root *restrict tree, struct avl_root *restrict other);
+
+/**
+ * avl_intersection - keeps the entries of @tree whose keys are in @other, freeing all the others
+ *
+ * @tree:  tree to store the intersection into
+ * @other: tree whose keys to keep
+ */
+extern void avl_intersection(struct avl_root *restrict tree, struct avl_root *restrict other);
+
+/**
+ * avl_difference - keeps the entries of @tree whose keys are not in @other, freeing all the others
+ *
+ * @tree:  tree to store the difference into
+ * @other: tree whose keys to remove
+ */
+extern void avl_difference(struct avl_root *restrict tree, struct avl_root *restrict other);
+
+/*
+ * The below functions let any number of readers look up a tree without taking any lock,
+ * while a single writer modifies it concurrently.
+ * Readers must call them inside a critical section of the epoch domain passed to the writer,
+ * i.e., between epoch_enter and epoch_exit, and writers must be serialized by the caller.
+ *
+ * The writer never changes a node reachable by readers in place other than its child links:
+ * a rotation replaces the node moving down with a copy, and the removal of a node with two children
+ * replaces it with a copy holding the entry of the adjacent node, which is unlinked only after a grace period.
+ * Unlinked nodes are retired to the epoch domain rather than freed.
+ * The other functions may be used on the tree while no reader is in a critical section.
+ *
+ * See https://www.usenix.org/system/files/conference/atc14/atc14-paper-howard.pdf for more details.
+ */
+
+/**
+ * avl_rcu_find - searches @tree for an entry with @key, concurrently with a writer
+ *
+ * @tree: tree to search
+ * @key:  the key to search for
+ *
+ * Returns the value of the entry, or NULL if not found.
+ */
+extern void *avl_rcu_find(const struct avl_root *tree, const void *key);
+
+/**
+ * avl_rcu_contains - checks if @tree contains an entry with @key, concurrently with a writer
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool avl_rcu_contains(const struct avl_root *tree, const void *key);
+
+/**
+ * avl_rcu_insert - inserts an entry into @tree, concurrently with lock-free readers
+ *
+ * @tree:  tree to insert an entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ * @epoch: epoch domain of the readers
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool avl_rcu_insert(struct avl_root *restrict tree, const void *restrict key, void *restrict value, struct epoch_root *restrict epoch);
+
+/**
+ * avl_rcu_erase - removes the entry with @key from @tree, concurrently with lock-free readers
+ *
+ * @tree:  tree to remove the entry from
+ * @key:   the key of the entry to remove
+ * @epoch: epoch domain of the readers
+ *
+ * The removal of an entry with two children waits for the readers in a critical section to leave it.
+ */
+extern void *avl_rcu_erase(struct avl_root *restrict tree, const void *restrict key, struct epoch_root *restrict epoch);
+
 /**
  * avl_iter_init - initializes an iterator of @tree
  *
@@ -237,4 +418,103 @@ extern void avl_reverse_iter_next(struct avl_reverse_iter *iter);
  */
 static inline bool avl_reverse_iter_end(const struct avl_reverse_iter iter) { return iter.pivot == NULL; }
 
+/*
+ * The below functions implement a persistent AVL tree by path copying:
+ * an insertion or a removal copies only the shared nodes on the path from the root down to the modified node,
+ * so that a snapshot taken in constant time keeps seeing the tree as it was,
+ * and each write costs O(log n) memory while any snapshot is alive.
+ * Nodes are reference-counted atomically, so that a snapshot may be read and released by any thread
+ * while the writer keeps modifying the tree, as long as the snapshot is taken by the writer.
+ */
+
+/**
+ * avl_cow_init - initializes an empty persistent tree with @less
+ *
+ * @less: operator defining the (partial) node order
+ */
+static inline struct avl_cow_root avl_cow_init(bool (*less)(const void *restrict, const void *restrict)) {
+  struct avl_cow_root tree = {
+    .root = NULL,
+    .less = less,
+    .size = 0,
+  };
+  return tree;
+}
+
+/**
+ * avl_cow_size - returns the number of entries in @tree
+ *
+ * @tree: tree to get the number of entries
+ */
+static inline size_t avl_cow_size(const struct avl_cow_root tree) { return tree.size; }
+
+/**
+ * avl_cow_empty - checks whether @tree is empty
+ *
+ * @tree: tree to check
+ */
+static inline bool avl_cow_empty(const struct avl_cow_root tree) { return tree.root == NULL; }
+
+/**
+ * avl_cow_find - searches @tree for an entry with @key
+ *
+ * @tree: tree to search
+ * @key:  the key to search for
+ *
+ * Returns the value of the entry, or NULL if not found.
+ */
+extern void *avl_cow_find(const struct avl_cow_root tree, const void *key);
+
+/**
+ * avl_cow_contains - checks if @tree contains an entry with @key
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool avl_cow_contains(const struct avl_cow_root tree, const void *key);
+
+/**
+ * avl_cow_insert - inserts an entry into @tree, copying the shared nodes on the path
+ *
+ * @tree:  tree to insert an entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool avl_cow_insert(struct avl_cow_root *restrict tree, const void *restrict key, void *restrict value);
+
+/**
+ * avl_cow_erase - removes the entry with @key from @tree, copying the shared nodes on the path
+ *
+ * @tree: tree to remove the entry from
+ * @key:  the key of the entry to remove
+ */
+extern void *avl_cow_erase(struct avl_cow_root *restrict tree, const void *restrict key);
+
+/**
+ * avl_cow_snapshot - returns a snapshot of @tree in constant time
+ *
+ * @tree: tree to take a snapshot of
+ *
+ * The snapshot is a tree on its own, which may be modified independently of @tree
+ * and must be released using avl_cow_release.
+ */
+extern struct avl_cow_root avl_cow_snapshot(const struct avl_cow_root tree);
+
+/**
+ * avl_cow_release - releases @tree, freeing the nodes no other version refers to
+ *
+ * @tree: tree to release
+ */
+extern void avl_cow_release(struct avl_cow_root *tree);
+
+/**
+ * avl_cow_for_each - applies @func to each entry of @tree in ascending order
+ *
+ * @tree: tree to apply @func to each entry of
+ * @func: function to apply to each entry of @tree
+ */
+extern void avl_cow_for_each(const struct avl_cow_root tree, void (*func)(const void *restrict, void *restrict));
+
 #endif /* _INDEX_AVLTREE_H */
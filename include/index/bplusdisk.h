@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * bplusdisk.h - disk-resident B+-tree declaration
+ *
+ * A disk-resident B+-tree keeps each node in a fixed-size page of a file and reaches it through a buffer pool,
+ * so that a tree larger than memory keeps only its hot part resident within the memory budget of the pool.
+ * The nodes refer to their children and siblings by page numbers, and the keys and values are fixed-size records
+ * stored inline, so that the order of the internal and external nodes follows from the page size.
+ *
+ * The nodes are laid out as in a B+-tree image, and the first page of the file holds the metadata of the tree.
+ * Underfull nodes are not merged: a node is freed once it becomes empty and its page is reused by later splits,
+ * which keeps an erasure on a single root-to-leaf path.
+ *
+ * A scan may read the external nodes ahead of the one it is at, discovering them through their parents
+ * rather than the links of the external nodes, so that a scan over cold pages waits on a window of reads at once
+ * instead of on each read in turn.
+ *
+ * See http://carlosproal.com/ir/papers/p121-comer.pdf for more details.
+ */
+#ifndef _INDEX_BPLUSDISK_H
+#define _INDEX_BPLUSDISK_H
+
+#include <index/pool.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BPLUS_DISK_MAGIC "LIBINDXD"
+
+/**
+ * struct bplus_disk_meta - the metadata of disk-resident B+-tree, taking the first page of the file
+ *
+ * @magic:      BPLUS_DISK_MAGIC
+ * @page_size:  the size of a page
+ * @key_size:   the size of a key record
+ * @value_size: the size of a value record
+ * @root:       the page of the root node, or zero if the tree is empty
+ * @head:       the page of the leftmost leaf, or zero if the tree is empty
+ * @tail:       the page of the rightmost leaf, or zero if the tree is empty
+ * @size:       the number of elements
+ * @height:     the number of the internal levels
+ * @pages:      the number of the pages of the file
+ * @free:       the first page of the list of free pages, or zero if there is none
+ */
+struct bplus_disk_meta {
+  char     magic[8];
+  uint64_t page_size;
+  uint64_t key_size;
+  uint64_t value_size;
+  uint64_t root;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t size;
+  uint64_t height;
+  uint64_t pages;
+  uint64_t free;
+} __attribute__((aligned(8)));
+
+/**
+ * struct bplus_disk_root - a disk-resident B+-tree
+ *
+ * @pool:     the buffer pool of the pages
+ * @meta:     the metadata, written to the first page on synchronization
+ * @less:     operator defining the (partial) element order of the key records
+ * @internal: the order of the internal nodes
+ * @external: the order of the external nodes
+ * @scratch:  the buffer used to split a node, or to hold the children of a parent during a scan
+ * @window:   the number of the external nodes the scans read ahead
+ */
+struct bplus_disk_root {
+  struct pool            pool;
+  struct bplus_disk_meta meta;
+  bool                 (*less)(const void *restrict, const void *restrict);
+  size_t                 internal;
+  size_t                 external;
+  unsigned char          *scratch;
+  size_t                 window;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * NOTE:
+ *
+ * The keys and values are passed as the addresses of their records, which are copied into the pages.
+ * The records handed to @less and to the functions applied by the scans point into the buffer pool,
+ * are aligned to 8 bytes, and are only valid during the call.
+ * An insertion or a removal pins every page it changes before changing any of them, so that it leaves the tree as it was if a page cannot be pinned,
+ * which takes a buffer pool of at least 2*height+4 frames, height being the number of the internal levels.
+ * The tree is not safe for concurrent use, and a failed write of a page back to the file leaves the tree unspecified.
+ */
+
+/**
+ * bplus_disk_open - opens the tree in the file at @path, creating an empty tree if the file is empty
+ *
+ * @tree:       tree to open
+ * @path:       the path of the file
+ * @page_size:  the size of a page, which must be a power of two
+ * @budget:     the memory budget of the buffer pool
+ * @key_size:   the size of a key record
+ * @value_size: the size of a value record
+ * @less:       operator defining the (partial) element order of the key records
+ *
+ * Returns false if the file cannot be opened, holds a tree of another layout,
+ * a page cannot hold three children or two elements, or @budget holds fewer frames than an update of the tree may pin.
+ */
+extern bool bplus_disk_open(struct bplus_disk_root *restrict tree, const char *restrict path, const size_t page_size, const size_t budget,
+                            const size_t key_size, const size_t value_size, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * bplus_disk_close - synchronizes @tree and closes it
+ *
+ * @tree: tree to close
+ *
+ * Returns false if the tree cannot be written.
+ */
+extern bool bplus_disk_close(struct bplus_disk_root *tree);
+
+/**
+ * bplus_disk_sync - writes the metadata and all dirty pages of @tree and synchronizes the file
+ *
+ * @tree: tree to synchronize
+ *
+ * Returns false if the tree cannot be written.
+ */
+extern bool bplus_disk_sync(struct bplus_disk_root *tree);
+
+/**
+ * bplus_disk_readahead - makes the scans of @tree read up to @window external nodes ahead by @nthreads reader threads
+ *
+ * @tree:     tree to read ahead the scans of
+ * @window:   the number of the external nodes to read ahead, which is capped at half the frames of the buffer pool
+ * @nthreads: the number of the reader threads, or zero to leave the reads to the kernel
+ *
+ * The reader threads are started once, on the first call with nonzero @nthreads, and run until the tree is closed.
+ *
+ * Returns false if the reader threads cannot be started.
+ */
+extern bool bplus_disk_readahead(struct bplus_disk_root *tree, const size_t window, const size_t nthreads);
+
+/**
+ * bplus_disk_size - returns the number of elements in @tree
+ *
+ * @tree: tree to get the number of elements
+ */
+static inline size_t bplus_disk_size(const struct bplus_disk_root *tree) { return tree->meta.size; }
+
+/**
+ * bplus_disk_empty - checks whether @tree is empty
+ *
+ * @tree: tree to check
+ */
+static inline bool bplus_disk_empty(const struct bplus_disk_root *tree) { return bplus_disk_size(tree) == 0; }
+
+/**
+ * bplus_disk_find - finds element from @tree with @key
+ *
+ * @tree:  tree to find element from
+ * @key:   the key record to search for
+ * @value: where to copy the value record, or NULL
+ *
+ * Returns false if there is no such element.
+ */
+extern bool bplus_disk_find(struct bplus_disk_root *restrict tree, const void *restrict key, void *restrict value);
+
+/**
+ * bplus_disk_contains - checks if @tree contains element with @key
+ *
+ * @tree: tree to check
+ * @key:  the key record to search for
+ */
+static inline bool bplus_disk_contains(struct bplus_disk_root *restrict tree, const void *restrict key) { return bplus_disk_find(tree, key, NULL); }
+
+/**
+ * bplus_disk_insert - inserts an element into @tree
+ *
+ * @tree:  tree to insert element into
+ * @key:   the key record of the element to insert
+ * @value: the value record of the element to insert
+ *
+ * Returns false without insertion if @key already exists in @tree or the tree cannot be written.
+ */
+extern bool bplus_disk_insert(struct bplus_disk_root *restrict tree, const void *restrict key, const void *restrict value);
+
+/**
+ * bplus_disk_insert_or_assign - inserts an element into @tree or assigns @value if @key already exists
+ *
+ * @tree:  tree to insert element into
+ * @key:   the key record of the element to insert if not found
+ * @value: the value record of the element to insert or assign
+ *
+ * Returns false if the tree cannot be written.
+ */
+extern bool bplus_disk_insert_or_assign(struct bplus_disk_root *restrict tree, const void *restrict key, const void *restrict value);
+
+/**
+ * bplus_disk_erase - removes the element with @key from @tree
+ *
+ * @tree:  tree to remove the element from
+ * @key:   the key record of the element to remove
+ * @value: where to copy the value record of the removed element, or NULL
+ *
+ * Returns false if there is no such element.
+ */
+extern bool bplus_disk_erase(struct bplus_disk_root *restrict tree, const void *restrict key, void *restrict value);
+
+/**
+ * bplus_disk_for_each - applies @func to each element of @tree in ascending order
+ *
+ * @tree: tree to apply @func to each element of
+ * @func: function to apply to each element of @tree, which must not modify @tree
+ */
+extern void bplus_disk_for_each(struct bplus_disk_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * bplus_disk_range_each - applies @func to each element of @tree greater than or equal to @inf and less than @sup
+ *
+ * @tree: tree to apply @func to each element of
+ * @inf:  the lower bound key record to search for
+ * @sup:  the upper bound key record to search for
+ * @func: function to apply to each element of @tree, which must not modify @tree
+ */
+extern void bplus_disk_range_each(struct bplus_disk_root *tree, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict));
+
+#endif /* _INDEX_BPLUSDISK_H */
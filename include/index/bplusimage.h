@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * bplusimage.h - memory-mapped B+-tree image declaration
+ *
+ * A B+-tree image is a pointer-free copy of a B+-tree in a file,
+ * in which each node takes a fixed-size slot and refers to its children and siblings by their offsets in the file.
+ * The keys and values are stored inline, either as the bits of the pointers themselves,
+ * which suits the integers cast to pointers, or as fixed-size records written by an encoder.
+ *
+ * An image is served straight from a read-only mapping of the file, so that opening it takes no deserialization,
+ * the nodes are paged in on first access, and any number of processes share a single copy through the page cache.
+ * An image may also be written to an anonymous shared memory file, whose descriptor is handed to the worker processes,
+ * by inheritance across fork or over a UNIX domain socket, to be mapped read-only by each of them.
+ *
+ * A store keeps an image up to date by incremental checkpoints, which only write the nodes changed since the last one.
+ * The changed nodes are written to free slots rather than over their old ones, and the header is written last,
+ * so that the file holds the image of the last checkpoint until the header of the next one replaces it,
+ * and the slots left behind are only reused once that header is durable.
+ * The leaves are not linked to each other, as moving a leaf would then move both of its neighbours as well,
+ * and the scans walk the internal nodes instead.
+ *
+ * A compressed image packs each leaf into a block of its own length instead of a slot, for the cold data read by scans.
+ * The keys are delta-encoded as varints, or front-coded if written by an encoder, starting over every few keys at a restart point,
+ * so that a lookup searches the restart points and decodes the few keys following one, while a scan decodes a whole leaf at once.
+ * The values stored as pointers may further be compressed by an LZ4-style block per leaf.
+ */
+#ifndef _INDEX_BPLUSIMAGE_H
+#define _INDEX_BPLUSIMAGE_H
+
+#include <index/bplustree.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BPLUS_IMAGE_PAGE  4096
+#define BPLUS_IMAGE_MAGIC "LIBINDEX"
+#define BPLUS_IMAGE_DELTA 1
+#define BPLUS_IMAGE_LZ    2
+
+/**
+ * struct bplus_codec - a serializer of keys or values into records
+ *
+ * @size:    the size of a fixed-size record
+ * @encode:  function to write the fixed-size record of its second argument into its first argument
+ * @record:  function to write the variable-size record of its second argument into its third argument if it fits in its fourth argument bytes,
+ *           returning the length of the record either way
+ * @decode:  function to rebuild the key or value from the variable-size record at its second argument of its third argument bytes into its fourth argument,
+ *           returning false if the record is malformed
+ * @release: function to free the key or value rebuilt by @decode, or NULL if it need not be freed
+ * @ctx:     the context handed to @record, @decode and @release as their first argument
+ *
+ * The images take the fixed-size records, and the dumps of serial.h the variable-size ones,
+ * so that a codec need only fill in the functions of the files it serves.
+ */
+struct bplus_codec {
+  size_t size;
+  void   (*encode)(void *restrict, const void *restrict);
+  size_t (*record)(void *, const void *, void *restrict, const size_t);
+  bool   (*decode)(void *, const void *restrict, const size_t, void **restrict);
+  void   (*release)(void *, void *);
+  void   *ctx;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct bplus_image_header - the header of B+-tree image, taking the first page of the file
+ *
+ * @magic:      BPLUS_IMAGE_MAGIC
+ * @pointer:    the size of a pointer on the machine that wrote the image
+ * @order:      the order of the tree
+ * @size:       the number of elements
+ * @key_size:   the size of a key record, or zero if the keys are stored as pointers
+ * @value_size: the size of a value record, or zero if the values are stored as pointers
+ * @node_size:  the size of a node slot, or of an internal node slot if the leaves are compressed
+ * @root:       the offset of the root node, or zero if the tree is empty
+ * @head:       the offset of the leftmost leaf, or zero if the tree is empty
+ * @tail:       the offset of the rightmost leaf, or zero if the tree is empty
+ * @length:     the length of the image, which the file may exceed by the slots of a checkpoint cut short
+ * @flags:      zero if the leaves take node slots, or BPLUS_IMAGE_DELTA if they are compressed, along with BPLUS_IMAGE_LZ if their values are
+ */
+struct bplus_image_header {
+  char     magic[8];
+  uint64_t pointer;
+  uint64_t order;
+  uint64_t size;
+  uint64_t key_size;
+  uint64_t value_size;
+  uint64_t node_size;
+  uint64_t root;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t length;
+  uint64_t flags;
+} __attribute__((aligned(8)));
+
+/**
+ * struct bplus_image - a B+-tree image mapped into memory
+ *
+ * @base:   the address of the mapping
+ * @length: the length of the mapping
+ * @header: the header of the image
+ * @less:   operator defining the (partial) element order of the keys as presented by the image
+ */
+struct bplus_image {
+  const unsigned char             *base;
+        size_t                    length;
+  const struct bplus_image_header *header;
+  bool                          (*less)(const void *restrict, const void *restrict);
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct bplus_store - an image kept up to date by incremental checkpoints of a B+-tree
+ *
+ * @fd:       the file of the image, or -1 before the first checkpoint
+ * @path:     the path of the image
+ * @keys:     the serializer of the keys, or NULL to store the keys as pointers
+ * @values:   the serializer of the values, or NULL to store the values as pointers
+ * @header:   the header of the last checkpoint
+ * @free:     the slots released by the last checkpoint, which the next checkpoint may overwrite
+ * @nfree:    the number of the slots in @free
+ * @capacity: the capacity of @free
+ * @written:  the number of the nodes written by the last checkpoint
+ * @full:     whether the next checkpoint is to write the whole tree to a new file
+ */
+struct bplus_store {
+        int                       fd;
+        char                      *path;
+  const struct bplus_codec        *keys;
+  const struct bplus_codec        *values;
+        struct bplus_image_header header;
+        uint64_t                  *free;
+        size_t                    nfree;
+        size_t                    capacity;
+        size_t                    written;
+        bool                      full;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * NOTE:
+ *
+ * The image presents a key or a value stored as a pointer by the pointer itself,
+ * and one written by an encoder by the address of its record in the mapping,
+ * which must not be written to. The keys searched for must be given in the same form,
+ * and @less of the image must order them as the tree did.
+ * An image is only readable on machines of the same byte order and pointer size as the one that wrote it.
+ * The key records of a compressed image are decoded out of the mapping, so that the scans present them
+ * by addresses that are only valid during the call to the function applied to them.
+ *
+ * A tree is checkpointed through a single store, as its nodes remember their slots in the image of that store.
+ * A checkpoint must not race with the writers of the tree, nor with the mappings of the image of the store,
+ * whose free slots it overwrites.
+ */
+
+/**
+ * bplus_save - writes the image of @tree to @path
+ *
+ * @tree:   tree to write the image of
+ * @path:   the path of the file to write, which is replaced atomically
+ * @keys:   the serializer of the keys, or NULL to store the keys as pointers
+ * @values: the serializer of the values, or NULL to store the values as pointers
+ *
+ * Returns false if the file cannot be written.
+ */
+extern bool bplus_save(const struct bplus_root tree, const char *restrict path, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * bplus_save_compressed - writes the compressed image of @tree to @path
+ *
+ * @tree:   tree to write the image of
+ * @path:   the path of the file to write, which is replaced atomically
+ * @keys:   the serializer of the keys, or NULL to store the keys as pointers
+ * @values: the serializer of the values, or NULL to store the values as pointers
+ * @lz:     whether to compress the values, which must then be stored as pointers
+ *
+ * Returns false if the file cannot be written, or if @lz is set along with @values.
+ */
+extern bool bplus_save_compressed(const struct bplus_root tree, const char *restrict path, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values, const bool lz);
+
+/**
+ * bplus_save_shared - writes the image of @tree to an anonymous shared memory file
+ *
+ * @tree:   tree to write the image of
+ * @keys:   the serializer of the keys, or NULL to store the keys as pointers
+ * @values: the serializer of the values, or NULL to store the values as pointers
+ *
+ * The file is sealed against any further change on Linux, so that the processes mapping it need not trust each other.
+ * It lives until its last descriptor is closed and its last mapping is unmapped.
+ *
+ * Returns the descriptor of the file, to be opened by bplus_open_fd, or -1 if the file cannot be written.
+ */
+extern int bplus_save_shared(const struct bplus_root tree, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * bplus_store_init - initializes @store of the image at @path
+ *
+ * @store:  store to initialize
+ * @path:   the path of the image
+ * @keys:   the serializer of the keys, or NULL to store the keys as pointers
+ * @values: the serializer of the values, or NULL to store the values as pointers
+ *
+ * The file is not touched until the first checkpoint, which replaces it with the whole image of the tree.
+ *
+ * Returns false if @store cannot be allocated.
+ */
+extern bool bplus_store_init(struct bplus_store *restrict store, const char *restrict path, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * bplus_store_destroy - closes the image of @store and frees @store
+ *
+ * @store: store to destroy
+ */
+extern void bplus_store_destroy(struct bplus_store *store);
+
+/**
+ * bplus_checkpoint - brings the image of @store up to date with @tree
+ *
+ * @store: store of the image
+ * @tree:  tree to checkpoint
+ *
+ * The first checkpoint writes the whole tree, and each later one only the nodes changed since the last one
+ * along with their ancestors, so that its cost follows the writes rather than the size of the tree.
+ * A failed checkpoint leaves the image of the last one in place, and the next one writes the whole tree again.
+ *
+ * Returns false if the file cannot be written.
+ */
+extern bool bplus_checkpoint(struct bplus_store *restrict store, struct bplus_root *restrict tree);
+
+/**
+ * bplus_open_mmap - maps the image at @path into memory
+ *
+ * @path: the path of the image
+ * @less: operator defining the (partial) element order of the keys as presented by the image
+ *
+ * Returns NULL if the file cannot be mapped or is not an image.
+ */
+extern struct bplus_image *bplus_open_mmap(const char *restrict path, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * bplus_open_fd - maps the image of the file of @fd into memory
+ *
+ * @fd:   the descriptor of the file, which may be closed once mapped
+ * @less: operator defining the (partial) element order of the keys as presented by the image
+ *
+ * Returns NULL if the file cannot be mapped or is not an image.
+ */
+extern struct bplus_image *bplus_open_fd(const int fd, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * bplus_close_mmap - unmaps @image
+ *
+ * @image: image to unmap
+ */
+extern void bplus_close_mmap(struct bplus_image *image);
+
+/**
+ * bplus_image_size - returns the number of elements in @image
+ *
+ * @image: image to get the number of elements
+ */
+static inline size_t bplus_image_size(const struct bplus_image *image) { return image->header->size; }
+
+/**
+ * bplus_image_empty - checks whether @image is empty
+ *
+ * @image: image to check
+ */
+static inline bool bplus_image_empty(const struct bplus_image *image) { return bplus_image_size(image) == 0; }
+
+/**
+ * bplus_image_find - finds element from @image with @key
+ *
+ * @image: image to find element from
+ * @key:   the key to search for
+ *
+ * Returns NULL if there is no such element.
+ */
+extern void *bplus_image_find(const struct bplus_image *image, const void *key);
+
+/**
+ * bplus_image_contains - checks if @image contains element with @key
+ *
+ * @image: image to check
+ * @key:   the key to search for
+ */
+extern bool bplus_image_contains(const struct bplus_image *image, const void *key);
+
+/**
+ * bplus_image_for_each - applies @func to each element of @image in ascending order
+ *
+ * @image: image to apply @func to each element of
+ * @func:  function to apply to each element of @image
+ */
+extern void bplus_image_for_each(const struct bplus_image *image, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * bplus_image_range_each - applies @func to each element of @image greater than or equal to @inf and less than @sup
+ *
+ * @image: image to apply @func to each element of
+ * @inf:   the lower bound key to search for
+ * @sup:   the upper bound key to search for
+ * @func:  function to apply to each element of @image
+ */
+extern void bplus_image_range_each(const struct bplus_image *image, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict));
+
+#endif /* _INDEX_BPLUSIMAGE_H */
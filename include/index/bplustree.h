@@ -36,37 +36,52 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * struct bplus_internal_node - an internal node in B+-tree
  *
  * @keys:     the ordered set of keys of the node
  * @children: the ordered set of children of the node
+ * @high:     the upper bound of the keys of the subtree, or NULL if the node has not been split concurrently
+ * @next:     the address of the right sibling split from the node
  * @nmemb:    the number of the keys of the node
+ * @version:  the version lock of the node
+ * @slot:     the offset of the node in the image of the last checkpoint, or zero if the node has changed since
  * @type:     the type of the node
  */
 struct bplus_internal_node {
-  const void   **keys;
-        void   **children;
-        size_t nmemb;
-        bool   type;
+  const void                       **keys;
+        void                       **children;
+  const void                       *high;
+        struct bplus_internal_node *next;
+        size_t                     nmemb;
+        size_t                     version;
+        uint64_t                   slot;
+        bool                       type;
 } __attribute__((aligned(__SIZEOF_POINTER__)));
 
 /**
  * struct bplus_external_node - an external node in B+-tree
  *
- * @keys:   the ordered set of keys of the node
- * @values: the ordered set of values of the node
- * @prev:   the address of the previous node
- * @next:   the address of the next node
- * @nmemb:  the number of the keys of the node
+ * @keys:    the ordered set of keys of the node
+ * @values:  the ordered set of values of the node
+ * @high:    the upper bound of the keys of the node, or NULL if the node has not been split concurrently
+ * @prev:    the address of the previous node
+ * @next:    the address of the next node
+ * @nmemb:   the number of the keys of the node
+ * @version: the version lock of the node
+ * @slot:    the offset of the node in the image of the last checkpoint, or zero if the node has changed since
  */
 struct bplus_external_node {
   const void                       **keys;
         void                       **values;
+  const void                       *high;
         struct bplus_external_node *prev;
         struct bplus_external_node *next;
         size_t                     nmemb;
+        size_t                     version;
+        uint64_t                   slot;
 } __attribute__((aligned(__SIZEOF_POINTER__)));
 
 struct bplus_root {
@@ -75,9 +90,39 @@ struct bplus_root {
         struct bplus_external_node *tail;
         bool                      (*less)(const void *restrict, const void *restrict);
         size_t                     size;
+        size_t                     version;
   const size_t                     order;
 } __attribute__((aligned(__SIZEOF_POINTER__)));
 
+/**
+ * struct bplus_frozen - an immutable, densely packed B+-tree
+ *
+ * @keys:    the keys in ascending order, every @order of which make an external node
+ * @values:  the values in the order of @keys
+ * @index:   the separators of the internal nodes, level by level from the root, in @order-1 slots per node
+ * @offsets: the offset of each level in @index
+ * @spans:   the number of the elements under a child of a node of each level
+ * @height:  the number of the levels of the internal nodes
+ * @less:    operator defining the (partial) element order
+ * @size:    the number of elements
+ * @order:   the order of tree
+ *
+ * The external nodes are full and contiguous, so that a scan reads @keys and @values sequentially.
+ * The internal nodes are implicit: the j-th child of the i-th node of a level is the (i*@order+j)-th node of the level below,
+ * and the separator of the j-th child is the first key under it, for each child but the first.
+ */
+struct bplus_frozen {
+  const void   **keys;
+        void   **values;
+  const void   **index;
+        size_t *offsets;
+        size_t *spans;
+        size_t height;
+        bool  (*less)(const void *restrict, const void *restrict);
+        size_t size;
+        size_t order;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
 /*
  * The below functions use the operator with 3 different
  * calling conventions. The operator denotes:
@@ -101,12 +146,13 @@ struct bplus_root {
  */
 static inline struct bplus_root bplus_init(const size_t order, bool (*less)(const void *restrict, const void *restrict)) {
   struct bplus_root tree = {
-    .root  = NULL,
-    .head  = NULL,
-    .tail  = NULL,
-    .less  = less,
-    .size  = 0,
-    .order = order,
+    .root    = NULL,
+    .head    = NULL,
+    .tail    = NULL,
+    .less    = less,
+    .size    = 0,
+    .version = 0,
+    .order   = order,
   };
   return tree;
 }
@@ -159,6 +205,19 @@ extern struct bplus_external_node *bplus_insert(struct bplus_root *restrict tree
  */
 extern struct bplus_external_node *bplus_insert_or_assign(struct bplus_root *restrict tree, const void *restrict key, void *restrict value);
 
+/**
+ * bplus_insert_batch - inserts @nmemb elements into @tree at once
+ *
+ * @tree:   tree to insert elements into
+ * @keys:   the keys of the elements to insert
+ * @values: the values of the elements to insert
+ * @nmemb:  the number of the elements to insert
+ *
+ * The batch is sorted and then merged into the leaves run by run,
+ * so that each overflowing leaf is split once and its separators are pushed up together.
+ */
+extern size_t bplus_insert_batch(struct bplus_root *restrict tree, const void **restrict keys, void **restrict values, const size_t nmemb);
+
 /**
  * bplus_erase - removes the element with @key from @tree
  *
@@ -174,6 +233,31 @@ extern void *bplus_erase(struct bplus_root *restrict tree, const void *restrict
  */
 extern void bplus_clear(struct bplus_root *restrict tree);
 
+/**
+ * bplus_clone - copies all elements of @other into @tree
+ *
+ * @tree:  empty tree of the same order to copy the elements into
+ * @other: tree to copy the elements from
+ *
+ * The node structure of @other is copied level by level without any comparison,
+ * including the linked list of the leaves.
+ */
+extern void bplus_clone(struct bplus_root *restrict tree, const struct bplus_root other);
+
+/**
+ * bplus_build - builds @tree from @nmemb elements sorted in ascending order of their keys, using up to @threads threads
+ *
+ * @tree:    empty tree to build
+ * @keys:    the keys of the elements in strictly ascending order
+ * @values:  the values of the elements
+ * @nmemb:   the number of the elements
+ * @threads: the number of threads to use
+ *
+ * The tree is built top-down without any comparison: the elements are spread evenly over the nodes of each level,
+ * and independent subtrees are built on separate threads, whose runs of leaves are then linked together.
+ */
+extern void bplus_build(struct bplus_root *restrict tree, const void **restrict keys, void **restrict values, const size_t nmemb, const size_t threads);
+
 /**
  * bplus_for_each - applies @func to each element of @tree in ascending order
  *
@@ -208,4 +292,173 @@ static inline void bplus_rev_each(const struct bplus_root tree, void (*func)(con
  */
 extern void bplus_range_each(const struct bplus_root tree, const void *restrict inf, const void *restrict sup, void (*func)(const void *restrict, void *restrict));
 
+/*
+ * The below functions split the leaves into up to @threads runs at the separators of the internal nodes,
+ * and apply @map to each element of a run on its own thread, accumulating it into a partial result of the run.
+ * Each partial result starts as a copy of @acc, which must hold the identity of @reduce on entry,
+ * and the partial results are then accumulated into @acc by @reduce in ascending order of their runs,
+ * so that @reduce must be associative but need not be commutative.
+ * @map may be applied concurrently to different partial results, and @tree must not be modified meanwhile.
+ */
+
+/**
+ * bplus_reduce - accumulates each element of @tree into @acc, using up to @threads threads
+ *
+ * @tree:    tree to accumulate each element of
+ * @map:     function to accumulate an element into a partial result
+ * @reduce:  function to accumulate the partial result given as its second argument into its first argument
+ * @acc:     the accumulator of @size bytes
+ * @size:    the size of @acc
+ * @threads: the number of threads to use
+ */
+extern void bplus_reduce(const struct bplus_root tree, void (*map)(void *restrict, const void *restrict, void *restrict), void (*reduce)(void *restrict, const void *restrict), void *restrict acc, const size_t size, const size_t threads);
+
+/**
+ * bplus_range_reduce - accumulates each element of @tree greater than or equal to @inf and less than @sup into @acc, using up to @threads threads
+ *
+ * @tree:    tree to accumulate each element of
+ * @inf:     the lower bound key to search for
+ * @sup:     the upper bound key to search for
+ * @map:     function to accumulate an element into a partial result
+ * @reduce:  function to accumulate the partial result given as its second argument into its first argument
+ * @acc:     the accumulator of @size bytes
+ * @size:    the size of @acc
+ * @threads: the number of threads to use
+ */
+extern void bplus_range_reduce(const struct bplus_root tree, const void *restrict inf, const void *restrict sup, void (*map)(void *restrict, const void *restrict, void *restrict),
+                               void (*reduce)(void *restrict, const void *restrict), void *restrict acc, const size_t size, const size_t threads);
+
+/**
+ * bplus_freeze - compacts @tree into @frozen, emptying @tree
+ *
+ * @frozen: frozen tree to build
+ * @tree:   tree to compact
+ *
+ * The elements are moved into full external nodes in a single array,
+ * over which the separators of the internal nodes are laid out level by level without any child pointer.
+ *
+ * Returns false if @frozen cannot be allocated, leaving @tree as is.
+ */
+extern bool bplus_freeze(struct bplus_frozen *restrict frozen, struct bplus_root *restrict tree);
+
+/**
+ * bplus_frozen_destroy - frees @frozen
+ *
+ * @frozen: frozen tree to free
+ */
+extern void bplus_frozen_destroy(struct bplus_frozen *frozen);
+
+/**
+ * bplus_frozen_size - returns the number of elements in @frozen
+ *
+ * @frozen: frozen tree to get the number of elements
+ */
+static inline size_t bplus_frozen_size(const struct bplus_frozen *frozen) { return frozen->size; }
+
+/**
+ * bplus_frozen_empty - checks whether @frozen is empty
+ *
+ * @frozen: frozen tree to check
+ */
+static inline bool bplus_frozen_empty(const struct bplus_frozen *frozen) { return bplus_frozen_size(frozen) == 0; }
+
+/**
+ * bplus_frozen_find - finds element from @frozen with @key
+ *
+ * @frozen: frozen tree to find element from
+ * @key:    the key to search for
+ *
+ * Returns NULL if there is no such element.
+ */
+extern void *bplus_frozen_find(const struct bplus_frozen *restrict frozen, const void *restrict key);
+
+/**
+ * bplus_frozen_contains - checks if @frozen contains element with @key
+ *
+ * @frozen: frozen tree to check
+ * @key:    the key to search for
+ */
+extern bool bplus_frozen_contains(const struct bplus_frozen *restrict frozen, const void *restrict key);
+
+/**
+ * bplus_frozen_for_each - applies @func to each element of @frozen in ascending order
+ *
+ * @frozen: frozen tree to apply @func to each element of
+ * @func:   function to apply to each element of @frozen
+ */
+static inline void bplus_frozen_for_each(const struct bplus_frozen *frozen, void (*func)(const void *restrict, void *restrict)) {
+  for (register size_t idx = 0; idx < frozen->size; ++idx)
+    func(frozen->keys[idx], frozen->values[idx]);
+}
+
+/**
+ * bplus_frozen_range_each - applies @func to each element of @frozen greater than or equal to @inf and less than @sup
+ *
+ * @frozen: frozen tree to apply @func to each element of
+ * @inf:    the lower bound key to search for
+ * @sup:    the upper bound key to search for
+ * @func:   function to apply to each element of @frozen
+ */
+extern void bplus_frozen_range_each(const struct bplus_frozen *restrict frozen, const void *restrict inf, const void *restrict sup, void (*func)(const void *restrict, void *restrict));
+
+/*
+ * The below functions may be called concurrently from multiple threads on the same tree,
+ * combining the version lock of each node as in optimistic lock coupling with the right links of B-link trees:
+ *
+ *  - readers take a snapshot of the version of each node and validate it after reading the node,
+ *    retrying only that node if it changed, so that they never write shared memory
+ *  - a split moves the upper half of a node into a new right sibling, linked from the node,
+ *    and bounds the node with a high key before the separator is pushed up into the parent,
+ *    so that any thread landing on the node with a greater key just moves right
+ *  - writers lock at most one node per level at a time, propagating splits upward one level after another
+ *
+ * See https://db.in.tum.de/~leis/papers/artsync.pdf and https://www.csd.uoc.gr/~hy460/pdf/p650-lehman.pdf for more details.
+ *
+ * NOTE:
+ *
+ * bplus_olc_erase does not merge underflowing nodes, since a merged node could not be freed
+ * while readers may still be on it. Once a tree is modified by these functions,
+ * it must only be modified by these functions until it is cleared.
+ * The other functions may be used on the tree while no thread is modifying it.
+ *
+ * The readers only hand a key to @less once the node holding it is validated, so that @less never sees a torn key.
+ * The keys of erased elements may still be compared by the readers that validated them before the erase,
+ * so they must remain valid until all operations in flight at the time of the erase are complete.
+ */
+
+/**
+ * bplus_olc_find - finds element from @tree with @key, concurrently with the other bplus_olc_* calls
+ *
+ * @tree: tree to find element from
+ * @key:  the key to search for
+ */
+extern void *bplus_olc_find(struct bplus_root *restrict tree, const void *restrict key);
+
+/**
+ * bplus_olc_contains - checks if @tree contains element with @key, concurrently with the other bplus_olc_* calls
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool bplus_olc_contains(struct bplus_root *restrict tree, const void *restrict key);
+
+/**
+ * bplus_olc_insert - inserts an element into @tree, concurrently with the other bplus_olc_* calls
+ *
+ * @tree:  tree to insert element into
+ * @key:   the key of the element to insert
+ * @value: the value of the element to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool bplus_olc_insert(struct bplus_root *restrict tree, const void *restrict key, void *restrict value);
+
+/**
+ * bplus_olc_erase - removes the element with @key from @tree, concurrently with the other bplus_olc_* calls
+ *
+ * @tree: tree to remove the element from
+ * @key:  the key of the element to remove
+ */
+extern void *bplus_olc_erase(struct bplus_root *restrict tree, const void *restrict key);
+
 #endif /* _INDEX_BPLUSTREE_H */
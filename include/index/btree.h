@@ -32,7 +32,7 @@
  * @keys:     the ordered set of keys of the node
  * @values:   the ordered set of values of the node
  * @parent:   the address of the parent node
- * @children: the ordered set of children of the node
+ * @children: the ordered set of children of the node, or NULL if the node is a leaf
  * @tree:     the address of the tree to which the node belongs
  * @index:    the index to the parent node
  * @nmemb:    the number of the keys in the node
@@ -175,6 +175,31 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
  */
 extern void btree_clear(struct btree_root *tree);
 
+/**
+ * btree_clone - copies all entries of @other into @tree
+ *
+ * @tree:  empty tree of the same order to copy the entries into
+ * @other: tree to copy the entries from
+ *
+ * The node structure of @other is copied level by level without any comparison,
+ * including the parent and index links of each node.
+ */
+extern void btree_clone(struct btree_root *restrict tree, const struct btree_root other);
+
+/**
+ * btree_build - builds @tree from @nmemb entries sorted in ascending order of their keys, using up to @threads threads
+ *
+ * @tree:    empty tree to build
+ * @keys:    the keys of the entries in strictly ascending order
+ * @values:  the values of the entries
+ * @nmemb:   the number of the entries
+ * @threads: the number of threads to use
+ *
+ * The tree is built top-down without any comparison: the entries are spread evenly over the nodes of each level,
+ * and independent subtrees are built on separate threads.
+ */
+extern void btree_build(struct btree_root *restrict tree, const void **restrict keys, void **restrict values, const size_t nmemb, const size_t threads);
+
 /**
  * btree_iter_init - initializes an iterator of @tree
  *
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * epoch.h - epoch-based reclamation declaration
+ *
+ * Epoch-based reclamation lets readers traverse a structure without taking any lock,
+ * while a writer unlinks nodes from it concurrently.
+ * Instead of freeing an unlinked node right away, the writer retires it,
+ * and the node is freed only once every reader that might still hold it has left its critical section.
+ *
+ * A global epoch is advanced whenever every reader in a critical section has observed the current one.
+ * A node retired in epoch e cannot be reached by any reader entering after it was unlinked,
+ * so that it is freed once the global epoch reaches e+2.
+ * Entering and leaving a critical section cost a store and a fence,
+ * without any lock or atomic read-modify-write.
+ *
+ * See https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf for more details.
+ */
+#ifndef _INDEX_EPOCH_H
+#define _INDEX_EPOCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * struct epoch_thread - a reader thread registered to an epoch domain
+ *
+ * @state: the epoch observed on entering the critical section shifted left by one and ORed with one,
+ *         or zero outside any critical section
+ * @next:  the address of the next registered thread
+ *
+ * Each thread is padded to a cache line, so that readers do not invalidate the states of each other.
+ */
+struct epoch_thread {
+  size_t              state;
+  struct epoch_thread *next;
+} __attribute__((aligned(64)));
+
+/**
+ * struct epoch_root - an epoch domain
+ *
+ * @epoch:    the global epoch
+ * @threads:  the list of the registered threads
+ * @limbo:    the nodes retired in each of the last three epochs
+ * @nmemb:    the number of the nodes in each of @limbo
+ * @capacity: the capacity of each of @limbo
+ * @lock:     the lock serializing the writers and the registration of threads
+ */
+struct epoch_root {
+  size_t              epoch;
+  struct epoch_thread *threads;
+  void                **limbo[3];
+  size_t              nmemb[3];
+  size_t              capacity[3];
+  pthread_mutex_t     lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * epoch_init - initializes an epoch domain with no registered thread
+ *
+ * @root: epoch domain to initialize
+ */
+extern void epoch_init(struct epoch_root *restrict root);
+
+/**
+ * epoch_destroy - frees all retired nodes and destroys @root
+ *
+ * @root: epoch domain to destroy
+ *
+ * No thread may be in a critical section of @root during or after this call.
+ */
+extern void epoch_destroy(struct epoch_root *restrict root);
+
+/**
+ * epoch_register - registers @thread to @root
+ *
+ * @root:   epoch domain to register to
+ * @thread: thread to register, which must outlive its registration
+ */
+extern void epoch_register(struct epoch_root *restrict root, struct epoch_thread *restrict thread);
+
+/**
+ * epoch_unregister - unregisters @thread from @root
+ *
+ * @root:   epoch domain to unregister from
+ * @thread: thread to unregister, which must be outside any critical section
+ */
+extern void epoch_unregister(struct epoch_root *restrict root, struct epoch_thread *restrict thread);
+
+/**
+ * epoch_enter - enters a critical section of @root
+ *
+ * @root:   epoch domain to enter
+ * @thread: the calling thread
+ *
+ * Critical sections do not nest.
+ */
+static inline void epoch_enter(const struct epoch_root *restrict root, struct epoch_thread *restrict thread) {
+  __atomic_store_n(&thread->state, __atomic_load_n(&root->epoch, __ATOMIC_RELAXED)<<1 | 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * epoch_exit - leaves the critical section of @thread
+ *
+ * @thread: the calling thread
+ */
+static inline void epoch_exit(struct epoch_thread *restrict thread) { __atomic_store_n(&thread->state, 0, __ATOMIC_RELEASE); }
+
+/**
+ * epoch_retire - frees @ptr once no reader may hold it
+ *
+ * @root: epoch domain to retire @ptr to
+ * @ptr:  memory allocated by malloc that has been unlinked from any shared structure
+ */
+extern void epoch_retire(struct epoch_root *restrict root, void *restrict ptr);
+
+/**
+ * epoch_reclaim - tries to advance the global epoch, freeing the nodes no reader may hold
+ *
+ * @root: epoch domain to reclaim
+ *
+ * Returns false if a reader in a critical section has not observed the current epoch yet.
+ */
+extern bool epoch_reclaim(struct epoch_root *restrict root);
+
+/**
+ * epoch_synchronize - waits until every reader in a critical section at the time of the call leaves it
+ *
+ * @root: epoch domain to wait for
+ */
+extern void epoch_synchronize(struct epoch_root *restrict root);
+
+#endif /* _INDEX_EPOCH_H */
@@ -16,6 +16,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+struct bplus_codec;
+struct serial_stream;
+
 /**
  * struct llrb_node - a node in left-leaning red-black tree
  *
@@ -167,6 +170,47 @@ extern void *llrb_erase(struct llrb_root *restrict tree, const void *restrict ke
  */
 extern void llrb_clear(struct llrb_root *tree);
 
+/**
+ * llrb_clone - copies all entries of @other into @tree
+ *
+ * @tree:  empty tree to copy the entries into
+ * @other: tree to copy the entries from
+ *
+ * The node structure of @other is copied level by level without any comparison.
+ */
+extern void llrb_clone(struct llrb_root *restrict tree, const struct llrb_root other);
+
+/**
+ * llrb_dump - writes the entries of @tree in ascending order to @stream
+ *
+ * @tree:   tree to dump
+ * @stream: the stream to write the dump to
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ *
+ * The dump is the number of the entries followed by the length-prefixed records of the key and the value of each entry,
+ * as laid out in serial.h, so that it does not depend on the machine that wrote it.
+ *
+ * Returns false if the stream fails or a record cannot be buffered.
+ */
+extern bool llrb_dump(const struct llrb_root tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * llrb_restore - builds @tree from a dump read from @stream
+ *
+ * @tree:   empty tree to build
+ * @stream: the stream to read the dump from
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ *
+ * The entries are read in ascending order and linked into a balanced shape as they come,
+ * without any comparison or rebalancing, so that the tree is built in linear time.
+ *
+ * Returns false if @tree is not empty, leaving it as it is,
+ * or if the stream fails or a record is malformed, leaving @tree empty and releasing the keys and values read by the codecs.
+ */
+extern bool llrb_restore(struct llrb_root *restrict tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
 /**
  * llrb_iter_init - initializes an iterator of @tree
  *
@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * lsm.h - log-structured merge index declaration
+ *
+ * A log-structured merge index buffers the writes in a B+-tree, the memtable, rather than updating its data in place.
+ * Once the memtable reaches a threshold, it is frozen and a background thread flushes it to an immutable sorted run,
+ * a B+-tree image mapped into memory, while a fresh memtable takes the writes.
+ * An erasure writes a tombstone, which shadows the element in the older runs until a compaction drops both.
+ *
+ * The runs are tiered by size, tier t holding up to threshold*fanout^t elements.
+ * Once a fanout of consecutive runs share a tier, the background thread merges them into a single run of the next tier,
+ * keeping the newest version of each element and dropping the tombstones once nothing older is left for them to shadow,
+ * so that each element is merged once per tier and a lookup visits a number of runs logarithmic in the size of the index.
+ * Each run has a Bloom filter over its keys, which lets a lookup skip most of the runs not containing its key.
+ * A lookup visits the memtable, the frozen memtable and the runs from the newest to the oldest,
+ * and a scan merges all of them, taking the newest version of each element.
+ *
+ * See https://www.cs.umb.edu/~poneil/lsmtree.pdf for more details.
+ */
+#ifndef _INDEX_LSM_H
+#define _INDEX_LSM_H
+
+#include <index/bplusimage.h>
+#include <index/bplustree.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * struct lsm_run - an immutable sorted run of log-structured merge index
+ *
+ * @image: the image holding the elements and tombstones of the run
+ * @nmemb: the number of the elements and tombstones of the run
+ * @bloom: the Bloom filter over the keys of the run
+ * @nbits: the number of the bits of @bloom
+ */
+struct lsm_run {
+  struct bplus_image *image;
+  size_t             nmemb;
+  uint64_t           *bloom;
+  size_t             nbits;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct lsm_root - a log-structured merge index
+ *
+ * @memtable:    the B+-tree taking the writes
+ * @frozen:      the memtable being flushed, valid while @flushing
+ * @runs:        the runs from the oldest to the newest
+ * @nruns:       the number of @runs
+ * @dir:         the directory of the run files
+ * @threshold:   the number of the elements at which the memtable is frozen
+ * @fanout:      the number of the runs of a tier at which they are merged
+ * @seq:         the sequence number of the next run file
+ * @flushes:     the number of the memtables flushed
+ * @compactions: the number of the compactions
+ * @skips:       the number of the runs skipped by the lookups thanks to the Bloom filters
+ * @hash:        function to hash the keys, consistent with @less
+ * @flushing:    whether @frozen is being flushed
+ * @failed:      whether a run could not be written, which fails all later freezes
+ * @stop:        whether the background thread is to stop
+ * @lock:        the lock guarding @frozen, @runs and the flags
+ * @wake:        the condition signalled when there is work for the background thread
+ * @idle:        the condition signalled when the background thread finishes a flush or a compaction
+ * @worker:      the background thread flushing and compacting
+ */
+struct lsm_root {
+  struct bplus_root memtable;
+  struct bplus_root frozen;
+  struct lsm_run    *runs;
+  size_t            nruns;
+  char              *dir;
+  size_t            threshold;
+  size_t            fanout;
+  size_t            seq;
+  size_t            flushes;
+  size_t            compactions;
+  size_t            skips;
+  uint64_t        (*hash)(const void *);
+  bool              flushing;
+  bool              failed;
+  bool              stop;
+  pthread_mutex_t   lock;
+  pthread_cond_t    wake;
+  pthread_cond_t    idle;
+  pthread_t         worker;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * NOTE:
+ *
+ * The keys and values are stored in the runs as pointers, so that they must remain valid until the index is destroyed,
+ * and the values must not be NULL. The run files are unlinked once mapped, and do not outlive the index.
+ * The index is not safe for concurrent use, apart from its own background thread.
+ */
+
+/**
+ * lsm_init - initializes an empty index of @order with @less, keeping its runs in @dir
+ *
+ * @tree:      index to initialize
+ * @dir:       the directory of the run files
+ * @order:     the order of the memtable
+ * @threshold: the number of the elements at which the memtable is frozen
+ * @fanout:    the number of the runs of a tier at which they are merged, at least two
+ * @less:      operator defining the (partial) element order
+ * @hash:      function to hash the keys, which must be equal for the keys equal under @less
+ *
+ * Returns false if the background thread cannot be started or the arguments are invalid.
+ */
+extern bool lsm_init(struct lsm_root *restrict tree, const char *restrict dir, const size_t order, const size_t threshold, const size_t fanout,
+                     bool (*less)(const void *restrict, const void *restrict), uint64_t (*hash)(const void *));
+
+/**
+ * lsm_destroy - stops the background thread of @tree and frees @tree
+ *
+ * @tree: index to destroy
+ */
+extern void lsm_destroy(struct lsm_root *tree);
+
+/**
+ * lsm_find - finds element from @tree with @key
+ *
+ * @tree: index to find element from
+ * @key:  the key to search for
+ *
+ * Returns NULL if there is no such element.
+ */
+extern void *lsm_find(struct lsm_root *restrict tree, const void *restrict key);
+
+/**
+ * lsm_contains - checks if @tree contains element with @key
+ *
+ * @tree: index to check
+ * @key:  the key to search for
+ */
+static inline bool lsm_contains(struct lsm_root *restrict tree, const void *restrict key) { return lsm_find(tree, key) != NULL; }
+
+/**
+ * lsm_insert - inserts an element into @tree, or assigns @value to the element with @key if it already exists
+ *
+ * @tree:  index to insert an element into
+ * @key:   the key of the element to insert
+ * @value: the value of the element to insert
+ *
+ * The write does not look up the runs, so that it cannot tell an insertion from an assignment.
+ *
+ * Returns false if the memtable is full and cannot be frozen, as a run could not be written.
+ */
+extern bool lsm_insert(struct lsm_root *restrict tree, const void *restrict key, void *restrict value);
+
+/**
+ * lsm_erase - removes the element with @key from @tree, if any
+ *
+ * @tree: index to remove the element from
+ * @key:  the key of the element to remove
+ *
+ * Returns false if the memtable is full and cannot be frozen, as a run could not be written.
+ */
+extern bool lsm_erase(struct lsm_root *restrict tree, const void *restrict key);
+
+/**
+ * lsm_flush - freezes the memtable of @tree and waits until it is flushed along with the compaction it triggers
+ *
+ * @tree: index to flush
+ *
+ * Returns false if a run could not be written.
+ */
+extern bool lsm_flush(struct lsm_root *tree);
+
+/**
+ * lsm_for_each - applies @func to each element of @tree in ascending order
+ *
+ * @tree: index to apply @func to each element of
+ * @func: function to apply to each element of @tree, which must not modify @tree
+ */
+extern void lsm_for_each(struct lsm_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * lsm_range_each - applies @func to each element of @tree greater than or equal to @inf and less than @sup
+ *
+ * @tree: index to apply @func to each element of
+ * @inf:  the lower bound key to search for
+ * @sup:  the upper bound key to search for
+ * @func: function to apply to each element of @tree, which must not modify @tree
+ */
+extern void lsm_range_each(struct lsm_root *tree, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict));
+
+#endif /* _INDEX_LSM_H */
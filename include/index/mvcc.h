@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * mvcc.h - multi-version B+-tree declaration
+ *
+ * A multi-version B+-tree keeps a chain of versions per key, each stamped with the logical time of the write
+ * that created it, newest first. An erasure pushes a tombstone rather than removing the key.
+ * A snapshot pins the logical time at which it is taken, and sees for each key the newest version not newer than it,
+ * so that a scan under a snapshot sees a consistent view no matter what is written meanwhile.
+ *
+ * A scan holds the read lock for a batch of elements at a time rather than for the whole scan,
+ * so that writers wait for at most one batch instead of the whole scan.
+ * The versions no snapshot can see any more are freed when their key is written again,
+ * or by mvcc_gc, which sweeps the whole tree a batch at a time.
+ *
+ * See https://www.vldb.org/pvldb/vol10/p781-Wu.pdf for more details.
+ */
+#ifndef _INDEX_MVCC_H
+#define _INDEX_MVCC_H
+
+#include <index/rwtree.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MVCC_BATCH 256
+
+/**
+ * struct mvcc_version - a version of the value of a key
+ *
+ * @value:  the value, or NULL for a tombstone
+ * @stamp:  the logical time of the write that created the version
+ * @erased: whether the version is a tombstone
+ * @next:   the address of the next older version
+ */
+struct mvcc_version {
+        void                *value;
+        size_t              stamp;
+        bool                erased;
+        struct mvcc_version *next;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct mvcc_snapshot - a snapshot of multi-version B+-tree
+ *
+ * @stamp: the logical time at which the snapshot was taken
+ * @prev:  the address of the previous older snapshot
+ * @next:  the address of the next newer snapshot
+ */
+struct mvcc_snapshot {
+  size_t               stamp;
+  struct mvcc_snapshot *prev;
+  struct mvcc_snapshot *next;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct mvcc_root - a multi-version B+-tree
+ *
+ * @tree:   the B+-tree mapping each key to its version chain, along with its lock
+ * @clock:  the logical time of the last write
+ * @size:   the number of the keys whose newest version is not a tombstone
+ * @oldest: the oldest snapshot taken and not released yet
+ * @newest: the newest snapshot taken and not released yet
+ * @lock:   the lock guarding the list of snapshots
+ */
+struct mvcc_root {
+  struct bplus_rw_root tree;
+  size_t               clock;
+  size_t               size;
+  struct mvcc_snapshot *oldest;
+  struct mvcc_snapshot *newest;
+  pthread_mutex_t      lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * NOTE:
+ *
+ * A key stays in the tree until no snapshot can see its tombstone,
+ * so the keys of erased elements must remain valid until then.
+ */
+
+/**
+ * mvcc_init - initializes an empty tree of @order with @less
+ *
+ * @root:  tree to initialize
+ * @order: the order of the underlying B+-tree
+ * @less:  operator defining the (partial) element order
+ */
+extern void mvcc_init(struct mvcc_root *root, const size_t order, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * mvcc_destroy - frees all versions of @root and destroys its locks
+ *
+ * @root: tree to destroy
+ *
+ * No snapshot of @root may be in use during or after this call.
+ */
+extern void mvcc_destroy(struct mvcc_root *root);
+
+/**
+ * mvcc_size - returns the number of elements in @root
+ *
+ * @root: tree to get the number of elements
+ */
+extern size_t mvcc_size(struct mvcc_root *root);
+
+/**
+ * mvcc_contains - checks if @root contains an element with @key
+ *
+ * @root: tree to check
+ * @key:  the key to search for
+ */
+extern bool mvcc_contains(struct mvcc_root *root, const void *key);
+
+/**
+ * mvcc_find - returns the newest value of the element with @key in @root, or NULL if there is no such element
+ *
+ * @root: tree to find element from
+ * @key:  the key to search for
+ */
+extern void *mvcc_find(struct mvcc_root *root, const void *key);
+
+/**
+ * mvcc_insert - inserts an element into @root
+ *
+ * @root:  tree to insert element into
+ * @key:   the key of the element to insert
+ * @value: the value of the element to insert, which must not be NULL
+ *
+ * Returns false without insertion if @key already exists in @root.
+ */
+extern bool mvcc_insert(struct mvcc_root *root, const void *key, void *value);
+
+/**
+ * mvcc_replace - inserts an element into @root or assigns @value if @key already exists
+ *
+ * @root:  tree to insert element into
+ * @key:   the key of the element to insert if not found
+ * @value: the value of the element to insert or assign, which must not be NULL
+ *
+ * The previous value is kept as an older version as long as a snapshot can see it.
+ */
+extern void mvcc_replace(struct mvcc_root *root, const void *key, void *value);
+
+/**
+ * mvcc_erase - removes the element with @key from @root
+ *
+ * @root: tree to remove the element from
+ * @key:  the key of the element to remove
+ *
+ * Returns the newest value of the removed element, or NULL if not found.
+ */
+extern void *mvcc_erase(struct mvcc_root *root, const void *key);
+
+/**
+ * mvcc_snapshot - takes a snapshot of @root
+ *
+ * @root:     tree to take a snapshot of
+ * @snapshot: snapshot to register, which must outlive its registration
+ */
+extern void mvcc_snapshot(struct mvcc_root *restrict root, struct mvcc_snapshot *restrict snapshot);
+
+/**
+ * mvcc_release - releases @snapshot, letting the versions only it can see be freed
+ *
+ * @root:     tree to which @snapshot belongs
+ * @snapshot: snapshot to release
+ */
+extern void mvcc_release(struct mvcc_root *restrict root, struct mvcc_snapshot *restrict snapshot);
+
+/**
+ * mvcc_snapshot_find - returns the value of the element with @key in @snapshot, or NULL if there is no such element
+ *
+ * @root:     tree to find element from
+ * @snapshot: snapshot to look up
+ * @key:      the key to search for
+ */
+extern void *mvcc_snapshot_find(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, const void *key);
+
+/**
+ * mvcc_for_each - applies @func to each element of @snapshot in ascending order
+ *
+ * @root:     tree to apply @func to each element of
+ * @snapshot: snapshot to scan
+ * @func:     function to apply to each element of @snapshot
+ *
+ * @func is applied without any lock, so that it may write to @root.
+ */
+extern void mvcc_for_each(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * mvcc_range_each - applies @func to each element of @snapshot greater than or equal to @inf and less than @sup
+ *
+ * @root:     tree to apply @func to each element of
+ * @snapshot: snapshot to scan
+ * @inf:      the lower bound key to search for
+ * @sup:      the upper bound key to search for
+ * @func:     function to apply to each element of @snapshot
+ *
+ * @func is applied without any lock, so that it may write to @root.
+ */
+extern void mvcc_range_each(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * mvcc_gc - frees the versions no snapshot can see, and removes the keys whose newest version is such a tombstone
+ *
+ * @root: tree to collect garbage from
+ *
+ * The tree is swept under the write lock a batch at a time.
+ * This function is meant to be called periodically or after releasing a long-lived snapshot,
+ * concurrently with the other functions.
+ *
+ * Returns the number of the freed versions.
+ */
+extern size_t mvcc_gc(struct mvcc_root *root);
+
+#endif /* _INDEX_MVCC_H */
@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * pool.h - buffer pool declaration
+ *
+ * A buffer pool caches the fixed-size pages of a file in a bounded number of frames,
+ * so that a structure larger than memory keeps only its hot pages resident.
+ * A page is pinned while in use and cannot be evicted until unpinned.
+ * When a frame is needed for a page not in the pool, the CLOCK algorithm picks the victim:
+ * the hand sweeps the frames, giving each recently referenced frame a second chance,
+ * and takes the first unpinned frame not referenced since the last sweep.
+ * A dirty victim is written back before its frame is reused.
+ *
+ * A page may be prefetched ahead of its use, into a pinned frame that reader threads fill in the background,
+ * so that a scan overlaps its reads with one another and with its own work.
+ * The frame of a page being read is neither evicted nor handed out until the read is done, even if unpinned,
+ * and the reader threads touch nothing but the frames handed to them, so that the rest of the pool stays single-threaded.
+ * Without reader threads, a prefetch merely advises the kernel to read the page into the page cache.
+ */
+#ifndef _INDEX_POOL_H
+#define _INDEX_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POOL_NIL ((size_t)-1)
+
+/**
+ * struct pool_frame - a frame of buffer pool
+ *
+ * @page:       the number of the page in the frame
+ * @pins:       the number of the users of the page
+ * @chain:      the index of the next frame in the same bucket
+ * @valid:      whether the frame holds a page
+ * @dirty:      whether the page has been modified since it was read or written back
+ * @referenced: whether the page has been referenced since the hand last passed the frame
+ * @loading:    whether the page is being read by a reader thread
+ * @failed:     whether the read by a reader thread has failed
+ */
+struct pool_frame {
+  uint64_t page;
+  size_t   pins;
+  size_t   chain;
+  bool     valid;
+  bool     dirty;
+  bool     referenced;
+  bool     loading;
+  bool     failed;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct pool - a buffer pool
+ *
+ * @fd:        the file of the pages
+ * @page_size: the size of a page
+ * @nframes:   the number of frames
+ * @nbuckets:  the number of buckets of the page table
+ * @hand:      the index of the frame the clock hand points to
+ * @frames:    the frames
+ * @buckets:   the page table, mapping each bucket to the index of its first frame
+ * @arena:     the pages of the frames, aligned to @page_size
+ * @reads:     the number of the pages read on demand
+ * @writes:    the number of the pages written back
+ * @prefetches: the number of the pages prefetched
+ * @readers:   the reader threads
+ * @nreaders:  the number of @readers
+ * @queue:     the frames waiting for a reader thread, as a ring of @nframes entries
+ * @head:      the index of the first frame in @queue
+ * @count:     the number of the frames in @queue
+ * @stop:      whether the reader threads are to exit once @queue is empty
+ * @lock:      the lock of @queue and of the end of the reads
+ * @ready:     the condition signaled when a frame joins @queue
+ * @done:      the condition signaled when a reader thread finishes a read
+ */
+struct pool {
+  int               fd;
+  size_t            page_size;
+  size_t            nframes;
+  size_t            nbuckets;
+  size_t            hand;
+  struct pool_frame *frames;
+  size_t            *buckets;
+  unsigned char     *arena;
+  size_t            reads;
+  size_t            writes;
+  size_t            prefetches;
+  pthread_t         *readers;
+  size_t            nreaders;
+  size_t            *queue;
+  size_t            head;
+  size_t            count;
+  bool              stop;
+  pthread_mutex_t   lock;
+  pthread_cond_t    ready;
+  pthread_cond_t    done;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * pool_open - opens a buffer pool over the file at @path, creating the file if missing
+ *
+ * @pool:      pool to open
+ * @path:      the path of the file
+ * @page_size: the size of a page, which must be a power of two
+ * @budget:    the memory budget of the pool, which must hold at least two pages
+ *
+ * Returns false if the file cannot be opened or the arguments are invalid.
+ */
+extern bool pool_open(struct pool *restrict pool, const char *restrict path, const size_t page_size, const size_t budget);
+
+/**
+ * pool_async - starts @nreaders threads reading the pages prefetched from @pool
+ *
+ * @pool:     pool to start the reader threads of
+ * @nreaders: the number of the reader threads
+ *
+ * Returns false if the threads cannot be started or have already been.
+ */
+extern bool pool_async(struct pool *pool, const size_t nreaders);
+
+/**
+ * pool_close - writes back all dirty pages of @pool and closes it
+ *
+ * @pool: pool to close
+ *
+ * Returns false if a page cannot be written back.
+ */
+extern bool pool_close(struct pool *pool);
+
+/**
+ * pool_fetch - pins the page numbered @page, reading it into the pool if not resident
+ *
+ * @pool: pool to fetch the page from
+ * @page: the number of the page
+ *
+ * Returns NULL if every frame is pinned or the page cannot be read.
+ */
+extern void *pool_fetch(struct pool *pool, const uint64_t page);
+
+/**
+ * pool_create - pins the page numbered @page filled with zeros, without reading it
+ *
+ * @pool: pool to create the page in
+ * @page: the number of the page
+ *
+ * Returns NULL if every frame is pinned.
+ */
+extern void *pool_create(struct pool *pool, const uint64_t page);
+
+/**
+ * pool_prefetch - pins the page numbered @page, starting to read it in the background if not resident
+ *
+ * @pool: pool to prefetch the page into
+ * @page: the number of the page
+ *
+ * The page must not be accessed until fetched by pool_fetch, and is unpinned as usual, once for the prefetch.
+ *
+ * Returns the address of the page, or NULL if every frame is pinned, or if @pool has no reader threads,
+ * in which case the kernel is advised to read the page into the page cache instead.
+ */
+extern void *pool_prefetch(struct pool *pool, const uint64_t page);
+
+/**
+ * pool_unpin - unpins the page at @data
+ *
+ * @pool:  pool to which the page belongs
+ * @data:  the address of the page, as returned by pool_fetch or pool_create
+ * @dirty: whether the page has been modified
+ */
+extern void pool_unpin(struct pool *restrict pool, const void *restrict data, const bool dirty);
+
+/**
+ * pool_flush - writes back all dirty pages of @pool and synchronizes the file
+ *
+ * @pool: pool to flush
+ *
+ * Returns false if a page cannot be written back.
+ */
+extern bool pool_flush(struct pool *pool);
+
+#endif /* _INDEX_POOL_H */
@@ -25,6 +25,10 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+struct bplus_codec;
+struct epoch_root;
+struct serial_stream;
+
 /**
  * struct rb_node - a node in red-black tree
  *
@@ -36,6 +40,9 @@
  * @tree:   the address of the tree to which the node belongs
  * @black:  the color of the node
  *
+ * Since rb_join and rb_split move subtrees between trees in logarithmic time,
+ * @tree is only kept up to date for the root node.
+ *
  * In addition to the requirements imposed on a binary search tree,
  * the following must be satisfied by a red–black tree:
  *
@@ -181,6 +188,150 @@ extern void *rb_erase(struct rb_root *restrict tree, const void *restrict key);
  */
 extern void rb_clear(struct rb_root *tree);
 
+/**
+ * rb_clone - copies all entries of @other into @tree
+ *
+ * @tree:  empty tree to copy the entries into
+ * @other: tree to copy the entries from
+ *
+ * The node structure of @other is copied level by level without any comparison.
+ */
+extern void rb_clone(struct rb_root *restrict tree, const struct rb_root other);
+
+/**
+ * rb_dump - writes the entries of @tree in ascending order to @stream
+ *
+ * @tree:   tree to dump
+ * @stream: the stream to write the dump to
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ *
+ * The dump is the number of the entries followed by the length-prefixed records of the key and the value of each entry,
+ * as laid out in serial.h, so that it does not depend on the machine that wrote it.
+ *
+ * Returns false if the stream fails or a record cannot be buffered.
+ */
+extern bool rb_dump(const struct rb_root tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * rb_restore - builds @tree from a dump read from @stream
+ *
+ * @tree:   empty tree to build
+ * @stream: the stream to read the dump from
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ *
+ * The entries are read in ascending order and linked into a balanced shape as they come,
+ * without any comparison or rebalancing, so that the tree is built in linear time.
+ *
+ * Returns false if @tree is not empty, leaving it as it is,
+ * or if the stream fails or a record is malformed, leaving @tree empty and releasing the keys and values read by the codecs.
+ */
+extern bool rb_restore(struct rb_root *restrict tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values);
+
+/**
+ * rb_join - moves all entries from @other into @tree
+ *
+ * @tree:  tree to move the entries into
+ * @other: tree to move the entries from
+ *
+ * The keys of @other must be either all less or all greater than those of @tree;
+ * otherwise it returns false without moving any entry.
+ */
+extern bool rb_join(struct rb_root *restrict tree, struct rb_root *restrict other);
+
+/**
+ * rb_split - moves the entries of @tree greater than or equal to @key into @other
+ *
+ * @tree:  tree to split
+ * @key:   the key to split at
+ * @other: empty tree to move the entries into
+ *
+ * The tree is cut in logarithmic time, but as the nodes carry no subtree sizes,
+ * the sizes of the two trees are recounted in time proportional to the smaller one.
+ */
+extern void rb_split(struct rb_root *restrict tree, const void *restrict key, struct rb_root *restrict other);
+
+/**
+ * rb_union - moves the entries of @other into @tree, freeing those whose keys are already in @tree
+ *
+ * @tree:  tree to store the union into
+ * @other: tree to move the entries from
+ */
+extern void rb_union(struct rb_root *restrict tree, struct rb_root *restrict other);
+
+/**
+ * rb_intersection - keeps the entries of @tree whose keys are in @other, freeing all the others
+ *
+ * @tree:  tree to store the intersection into
+ * @other: tree whose keys to keep
+ */
+extern void rb_intersection(struct rb_root *restrict tree, struct rb_root *restrict other);
+
+/**
+ * rb_difference - keeps the entries of @tree whose keys are not in @other, freeing all the others
+ *
+ * @tree:  tree to store the difference into
+ * @other: tree whose keys to remove
+ */
+extern void rb_difference(struct rb_root *restrict tree, struct rb_root *restrict other);
+
+/*
+ * The below functions let any number of readers look up a tree without taking any lock,
+ * while a single writer modifies it concurrently.
+ * Readers must call them inside a critical section of the epoch domain passed to the writer,
+ * i.e., between epoch_enter and epoch_exit, and writers must be serialized by the caller.
+ *
+ * The writer never changes a node reachable by readers in place other than its child links:
+ * a rotation replaces the node moving down with a copy, and the removal of a node with two children
+ * replaces it with a copy holding the entry of the adjacent node, which is unlinked only after a grace period.
+ * Unlinked nodes are retired to the epoch domain rather than freed.
+ * The other functions may be used on the tree while no reader is in a critical section.
+ *
+ * See https://www.usenix.org/system/files/conference/atc14/atc14-paper-howard.pdf for more details.
+ */
+
+/**
+ * rb_rcu_find - searches @tree for an entry with @key, concurrently with a writer
+ *
+ * @tree: tree to search
+ * @key:  the key to search for
+ *
+ * Returns the value of the entry, or NULL if not found.
+ */
+extern void *rb_rcu_find(const struct rb_root *tree, const void *key);
+
+/**
+ * rb_rcu_contains - checks if @tree contains an entry with @key, concurrently with a writer
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool rb_rcu_contains(const struct rb_root *tree, const void *key);
+
+/**
+ * rb_rcu_insert - inserts an entry into @tree, concurrently with lock-free readers
+ *
+ * @tree:  tree to insert an entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ * @epoch: epoch domain of the readers
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool rb_rcu_insert(struct rb_root *restrict tree, const void *restrict key, void *restrict value, struct epoch_root *restrict epoch);
+
+/**
+ * rb_rcu_erase - removes the entry with @key from @tree, concurrently with lock-free readers
+ *
+ * @tree:  tree to remove the entry from
+ * @key:   the key of the entry to remove
+ * @epoch: epoch domain of the readers
+ *
+ * The removal of an entry with two children waits for the readers in a critical section to leave it.
+ */
+extern void *rb_rcu_erase(struct rb_root *restrict tree, const void *restrict key, struct epoch_root *restrict epoch);
+
 /**
  * rb_iter_init - initializes an iterator of @tree
  *
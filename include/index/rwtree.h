@@ -0,0 +1,602 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * rwtree.h - reader/writer-locked tree declaration
+ *
+ * The trees in this library are not safe to share between threads on their own.
+ * The below wrappers pair each tree with a reader/writer lock,
+ * so that any number of readers may look up and iterate over a tree in parallel
+ * while each writer takes exclusive access to it.
+ *
+ * Lookups return values rather than iterators, since an iterator is only valid while the lock is held.
+ * To iterate over a tree, either apply a function to each entry under the read lock using *_rw_for_each,
+ * or hold the read lock explicitly using *_rw_read_lock and *_rw_unlock and use the iterators of the underlying tree.
+ *
+ * See https://pubs.opengroup.org/onlinepubs/9699919799/functions/pthread_rwlock_rdlock.html for more details.
+ */
+#ifndef _INDEX_RWTREE_H
+#define _INDEX_RWTREE_H
+
+#include <index/avltree.h>
+#include <index/bplustree.h>
+#include <index/btree.h>
+#include <index/llrbtree.h>
+#include <index/rbtree.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * struct avl_rw_root - an AVL tree guarded by a reader/writer lock
+ *
+ * @tree: the underlying tree
+ * @lock: the lock guarding @tree
+ */
+struct avl_rw_root {
+  struct avl_root  tree;
+  pthread_rwlock_t lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct rb_rw_root - a red-black tree guarded by a reader/writer lock
+ *
+ * @tree: the underlying tree
+ * @lock: the lock guarding @tree
+ */
+struct rb_rw_root {
+  struct rb_root   tree;
+  pthread_rwlock_t lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct llrb_rw_root - a left-leaning red-black tree guarded by a reader/writer lock
+ *
+ * @tree: the underlying tree
+ * @lock: the lock guarding @tree
+ */
+struct llrb_rw_root {
+  struct llrb_root tree;
+  pthread_rwlock_t lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct btree_rw_root - a B-tree guarded by a reader/writer lock
+ *
+ * @tree: the underlying tree
+ * @lock: the lock guarding @tree
+ */
+struct btree_rw_root {
+  struct btree_root tree;
+  pthread_rwlock_t  lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct bplus_rw_root - a B+-tree guarded by a reader/writer lock
+ *
+ * @tree: the underlying tree
+ * @lock: the lock guarding @tree
+ */
+struct bplus_rw_root {
+  struct bplus_root tree;
+  pthread_rwlock_t  lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * avl_rw_init - initializes an empty tree with @less
+ *
+ * @tree:  tree to initialize
+ * @less:  operator defining the (partial) node order
+ */
+extern void avl_rw_init(struct avl_rw_root *tree, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * avl_rw_destroy - erases all entries from @tree and destroys its lock
+ *
+ * @tree: tree to destroy
+ */
+extern void avl_rw_destroy(struct avl_rw_root *tree);
+
+/**
+ * avl_rw_read_lock - acquires the read lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline const struct avl_root *avl_rw_read_lock(struct avl_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * avl_rw_write_lock - acquires the write lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline struct avl_root *avl_rw_write_lock(struct avl_rw_root *tree) {
+  pthread_rwlock_wrlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * avl_rw_unlock - releases the lock of @tree held by the calling thread
+ *
+ * @tree: tree to unlock
+ */
+static inline void avl_rw_unlock(struct avl_rw_root *tree) { pthread_rwlock_unlock(&tree->lock); }
+
+/**
+ * avl_rw_size - returns the number of entries in @tree
+ *
+ * @tree: tree to get the number of entries
+ */
+extern size_t avl_rw_size(struct avl_rw_root *tree);
+
+/**
+ * avl_rw_contains - checks if @tree contains an entry with @key
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool avl_rw_contains(struct avl_rw_root *tree, const void *key);
+
+/**
+ * avl_rw_find - returns the value of the entry with @key in @tree, or NULL if there is no such entry
+ *
+ * @tree: tree to find entry from
+ * @key:  the key to search for
+ */
+extern void *avl_rw_find(struct avl_rw_root *tree, const void *key);
+
+/**
+ * avl_rw_insert - inserts an entry into @tree
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool avl_rw_insert(struct avl_rw_root *tree, const void *key, void *value);
+
+/**
+ * avl_rw_replace - inserts an entry into @tree or assigns @value if @key already exists
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert if not found
+ * @value: the value of the entry to insert or assign
+ */
+extern void avl_rw_replace(struct avl_rw_root *tree, const void *key, void *value);
+
+/**
+ * avl_rw_erase - removes the entry with @key from @tree
+ *
+ * @tree: tree to remove the entry from
+ * @key:  the key of the entry to remove
+ */
+extern void *avl_rw_erase(struct avl_rw_root *tree, const void *key);
+
+/**
+ * avl_rw_for_each - applies @func to each entry of @tree in ascending order under the read lock
+ *
+ * @tree: tree to apply @func to each entry of
+ * @func: function to apply to each entry of @tree
+ */
+extern void avl_rw_for_each(struct avl_rw_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * rb_rw_init - initializes an empty tree with @less
+ *
+ * @tree:  tree to initialize
+ * @less:  operator defining the (partial) node order
+ */
+extern void rb_rw_init(struct rb_rw_root *tree, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * rb_rw_destroy - erases all entries from @tree and destroys its lock
+ *
+ * @tree: tree to destroy
+ */
+extern void rb_rw_destroy(struct rb_rw_root *tree);
+
+/**
+ * rb_rw_read_lock - acquires the read lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline const struct rb_root *rb_rw_read_lock(struct rb_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * rb_rw_write_lock - acquires the write lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline struct rb_root *rb_rw_write_lock(struct rb_rw_root *tree) {
+  pthread_rwlock_wrlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * rb_rw_unlock - releases the lock of @tree held by the calling thread
+ *
+ * @tree: tree to unlock
+ */
+static inline void rb_rw_unlock(struct rb_rw_root *tree) { pthread_rwlock_unlock(&tree->lock); }
+
+/**
+ * rb_rw_size - returns the number of entries in @tree
+ *
+ * @tree: tree to get the number of entries
+ */
+extern size_t rb_rw_size(struct rb_rw_root *tree);
+
+/**
+ * rb_rw_contains - checks if @tree contains an entry with @key
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool rb_rw_contains(struct rb_rw_root *tree, const void *key);
+
+/**
+ * rb_rw_find - returns the value of the entry with @key in @tree, or NULL if there is no such entry
+ *
+ * @tree: tree to find entry from
+ * @key:  the key to search for
+ */
+extern void *rb_rw_find(struct rb_rw_root *tree, const void *key);
+
+/**
+ * rb_rw_insert - inserts an entry into @tree
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool rb_rw_insert(struct rb_rw_root *tree, const void *key, void *value);
+
+/**
+ * rb_rw_replace - inserts an entry into @tree or assigns @value if @key already exists
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert if not found
+ * @value: the value of the entry to insert or assign
+ */
+extern void rb_rw_replace(struct rb_rw_root *tree, const void *key, void *value);
+
+/**
+ * rb_rw_erase - removes the entry with @key from @tree
+ *
+ * @tree: tree to remove the entry from
+ * @key:  the key of the entry to remove
+ */
+extern void *rb_rw_erase(struct rb_rw_root *tree, const void *key);
+
+/**
+ * rb_rw_for_each - applies @func to each entry of @tree in ascending order under the read lock
+ *
+ * @tree: tree to apply @func to each entry of
+ * @func: function to apply to each entry of @tree
+ */
+extern void rb_rw_for_each(struct rb_rw_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * llrb_rw_init - initializes an empty tree with @less
+ *
+ * @tree:  tree to initialize
+ * @less:  operator defining the (partial) node order
+ */
+extern void llrb_rw_init(struct llrb_rw_root *tree, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * llrb_rw_destroy - erases all entries from @tree and destroys its lock
+ *
+ * @tree: tree to destroy
+ */
+extern void llrb_rw_destroy(struct llrb_rw_root *tree);
+
+/**
+ * llrb_rw_read_lock - acquires the read lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline const struct llrb_root *llrb_rw_read_lock(struct llrb_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * llrb_rw_write_lock - acquires the write lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline struct llrb_root *llrb_rw_write_lock(struct llrb_rw_root *tree) {
+  pthread_rwlock_wrlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * llrb_rw_unlock - releases the lock of @tree held by the calling thread
+ *
+ * @tree: tree to unlock
+ */
+static inline void llrb_rw_unlock(struct llrb_rw_root *tree) { pthread_rwlock_unlock(&tree->lock); }
+
+/**
+ * llrb_rw_size - returns the number of entries in @tree
+ *
+ * @tree: tree to get the number of entries
+ */
+extern size_t llrb_rw_size(struct llrb_rw_root *tree);
+
+/**
+ * llrb_rw_contains - checks if @tree contains an entry with @key
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool llrb_rw_contains(struct llrb_rw_root *tree, const void *key);
+
+/**
+ * llrb_rw_find - returns the value of the entry with @key in @tree, or NULL if there is no such entry
+ *
+ * @tree: tree to find entry from
+ * @key:  the key to search for
+ */
+extern void *llrb_rw_find(struct llrb_rw_root *tree, const void *key);
+
+/**
+ * llrb_rw_insert - inserts an entry into @tree
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool llrb_rw_insert(struct llrb_rw_root *tree, const void *key, void *value);
+
+/**
+ * llrb_rw_replace - inserts an entry into @tree or assigns @value if @key already exists
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert if not found
+ * @value: the value of the entry to insert or assign
+ */
+extern void llrb_rw_replace(struct llrb_rw_root *tree, const void *key, void *value);
+
+/**
+ * llrb_rw_erase - removes the entry with @key from @tree
+ *
+ * @tree: tree to remove the entry from
+ * @key:  the key of the entry to remove
+ */
+extern void *llrb_rw_erase(struct llrb_rw_root *tree, const void *key);
+
+/**
+ * llrb_rw_for_each - applies @func to each entry of @tree in ascending order under the read lock
+ *
+ * @tree: tree to apply @func to each entry of
+ * @func: function to apply to each entry of @tree
+ */
+extern void llrb_rw_for_each(struct llrb_rw_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * btree_rw_init - initializes an empty tree of @order with @less
+ *
+ * @tree:  tree to initialize
+ * @order: the order of tree
+ * @less:  operator defining the (partial) node order
+ */
+extern void btree_rw_init(struct btree_rw_root *tree, const size_t order, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * btree_rw_destroy - erases all entries from @tree and destroys its lock
+ *
+ * @tree: tree to destroy
+ */
+extern void btree_rw_destroy(struct btree_rw_root *tree);
+
+/**
+ * btree_rw_read_lock - acquires the read lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline const struct btree_root *btree_rw_read_lock(struct btree_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * btree_rw_write_lock - acquires the write lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline struct btree_root *btree_rw_write_lock(struct btree_rw_root *tree) {
+  pthread_rwlock_wrlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * btree_rw_unlock - releases the lock of @tree held by the calling thread
+ *
+ * @tree: tree to unlock
+ */
+static inline void btree_rw_unlock(struct btree_rw_root *tree) { pthread_rwlock_unlock(&tree->lock); }
+
+/**
+ * btree_rw_size - returns the number of entries in @tree
+ *
+ * @tree: tree to get the number of entries
+ */
+extern size_t btree_rw_size(struct btree_rw_root *tree);
+
+/**
+ * btree_rw_contains - checks if @tree contains an entry with @key
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool btree_rw_contains(struct btree_rw_root *tree, const void *key);
+
+/**
+ * btree_rw_find - returns the value of the entry with @key in @tree, or NULL if there is no such entry
+ *
+ * @tree: tree to find entry from
+ * @key:  the key to search for
+ */
+extern void *btree_rw_find(struct btree_rw_root *tree, const void *key);
+
+/**
+ * btree_rw_insert - inserts an entry into @tree
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool btree_rw_insert(struct btree_rw_root *tree, const void *key, void *value);
+
+/**
+ * btree_rw_replace - inserts an entry into @tree or assigns @value if @key already exists
+ *
+ * @tree:  tree to insert entry into
+ * @key:   the key of the entry to insert if not found
+ * @value: the value of the entry to insert or assign
+ */
+extern void btree_rw_replace(struct btree_rw_root *tree, const void *key, void *value);
+
+/**
+ * btree_rw_erase - removes the entry with @key from @tree
+ *
+ * @tree: tree to remove the entry from
+ * @key:  the key of the entry to remove
+ */
+extern void *btree_rw_erase(struct btree_rw_root *tree, const void *key);
+
+/**
+ * btree_rw_for_each - applies @func to each entry of @tree in ascending order under the read lock
+ *
+ * @tree: tree to apply @func to each entry of
+ * @func: function to apply to each entry of @tree
+ */
+extern void btree_rw_for_each(struct btree_rw_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * bplus_rw_init - initializes an empty tree of @order with @less
+ *
+ * @tree:  tree to initialize
+ * @order: the order of tree
+ * @less:  operator defining the (partial) element order
+ */
+extern void bplus_rw_init(struct bplus_rw_root *tree, const size_t order, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * bplus_rw_destroy - erases all elements from @tree and destroys its lock
+ *
+ * @tree: tree to destroy
+ */
+extern void bplus_rw_destroy(struct bplus_rw_root *tree);
+
+/**
+ * bplus_rw_read_lock - acquires the read lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline const struct bplus_root *bplus_rw_read_lock(struct bplus_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * bplus_rw_write_lock - acquires the write lock of @tree and returns the underlying tree
+ *
+ * @tree: tree to lock
+ */
+static inline struct bplus_root *bplus_rw_write_lock(struct bplus_rw_root *tree) {
+  pthread_rwlock_wrlock(&tree->lock);
+  return &tree->tree;
+}
+
+/**
+ * bplus_rw_unlock - releases the lock of @tree held by the calling thread
+ *
+ * @tree: tree to unlock
+ */
+static inline void bplus_rw_unlock(struct bplus_rw_root *tree) { pthread_rwlock_unlock(&tree->lock); }
+
+/**
+ * bplus_rw_size - returns the number of elements in @tree
+ *
+ * @tree: tree to get the number of elements
+ */
+extern size_t bplus_rw_size(struct bplus_rw_root *tree);
+
+/**
+ * bplus_rw_contains - checks if @tree contains an element with @key
+ *
+ * @tree: tree to check
+ * @key:  the key to search for
+ */
+extern bool bplus_rw_contains(struct bplus_rw_root *tree, const void *key);
+
+/**
+ * bplus_rw_find - returns the value of the element with @key in @tree, or NULL if there is no such element
+ *
+ * @tree: tree to find element from
+ * @key:  the key to search for
+ */
+extern void *bplus_rw_find(struct bplus_rw_root *tree, const void *key);
+
+/**
+ * bplus_rw_insert - inserts an element into @tree
+ *
+ * @tree:  tree to insert element into
+ * @key:   the key of the element to insert
+ * @value: the value of the element to insert
+ *
+ * Returns false without insertion if @key already exists in @tree.
+ */
+extern bool bplus_rw_insert(struct bplus_rw_root *tree, const void *key, void *value);
+
+/**
+ * bplus_rw_replace - inserts an element into @tree or assigns @value if @key already exists
+ *
+ * @tree:  tree to insert element into
+ * @key:   the key of the element to insert if not found
+ * @value: the value of the element to insert or assign
+ */
+extern void bplus_rw_replace(struct bplus_rw_root *tree, const void *key, void *value);
+
+/**
+ * bplus_rw_erase - removes the element with @key from @tree
+ *
+ * @tree: tree to remove the element from
+ * @key:  the key of the element to remove
+ */
+extern void *bplus_rw_erase(struct bplus_rw_root *tree, const void *key);
+
+/**
+ * bplus_rw_for_each - applies @func to each element of @tree in ascending order under the read lock
+ *
+ * @tree: tree to apply @func to each element of
+ * @func: function to apply to each element of @tree
+ */
+extern void bplus_rw_for_each(struct bplus_rw_root *tree, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * bplus_rw_range_each - applies @func to each element of @tree greater than or equal to @inf and less than @sup under the read lock
+ *
+ * @tree: tree to apply @func to each element of
+ * @inf:  the lower bound key to search for
+ * @sup:  the upper bound key to search for
+ * @func: function to apply to each element of @tree
+ */
+extern void bplus_rw_range_each(struct bplus_rw_root *tree, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict));
+
+#endif /* _INDEX_RWTREE_H */
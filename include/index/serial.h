@@ -0,0 +1,205 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * serial.h - serialization of tree entries declaration
+ *
+ * A dump of a tree is the number of its entries followed by the key record and the value record of each entry,
+ * each record prefixed with its length, and all numbers written as 64-bit little-endian words,
+ * so that a dump is readable on any machine regardless of the size of a pointer or the byte order.
+ * The records are written and read through a stream, and the keys and values are turned into records and back
+ * by the variable-size functions of the codecs of bplusimage.h.
+ */
+#ifndef _INDEX_SERIAL_H
+#define _INDEX_SERIAL_H
+
+#include <index/bplusimage.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * struct serial_stream - a stream of bytes to write a dump to or read a dump from
+ *
+ * @write: function to write its third argument bytes from its second argument, returning false on failure
+ * @read:  function to read its third argument bytes into its second argument, returning false on failure
+ * @ctx:   the context handed to @write and @read as their first argument
+ */
+struct serial_stream {
+  bool (*write)(void *, const void *restrict, const size_t);
+  bool (*read)(void *, void *restrict, const size_t);
+  void *ctx;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct serial - the state of writing or reading a dump
+ *
+ * @stream:   the stream of the dump
+ * @keys:     the serializer of the keys
+ * @values:   the serializer of the values
+ * @buffer:   the buffer of a record
+ * @capacity: the capacity of @buffer
+ */
+struct serial {
+  const struct serial_stream *stream;
+  const struct bplus_codec   *keys;
+  const struct bplus_codec   *values;
+        unsigned char        *buffer;
+        size_t               capacity;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * serial_init - initializes the state of a dump through @stream, @keys and @values
+ *
+ * @stream: the stream of the dump
+ * @keys:   the serializer of the keys
+ * @values: the serializer of the values
+ */
+static inline struct serial serial_init(const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  return (struct serial){ .stream = stream, .keys = keys, .values = values, .buffer = NULL, .capacity = 0 };
+}
+
+/**
+ * serial_destroy - frees the buffer of @serial
+ *
+ * @serial: the state of the dump
+ */
+static inline void serial_destroy(struct serial *serial) { free(serial->buffer); }
+
+/**
+ * serial_reserve - grows the buffer of @serial to hold @length bytes
+ *
+ * @serial: the state of the dump
+ * @length: the number of the bytes to hold
+ *
+ * Returns false if the buffer cannot be grown.
+ */
+static inline bool serial_reserve(struct serial *serial, const size_t length) {
+  register unsigned char *buffer;
+
+  if (length <= serial->capacity) return true;
+  if ((buffer = realloc(serial->buffer, length)) == NULL) return false;
+
+  serial->buffer   = buffer;
+  serial->capacity = length;
+
+  return true;
+}
+
+/**
+ * serial_write_word - writes @word to the stream of @serial
+ *
+ * @serial: the state of the dump
+ * @word:   the number to write
+ */
+static inline bool serial_write_word(struct serial *serial, const uint64_t word) {
+  unsigned char bytes[sizeof(uint64_t)];
+
+  for (register size_t idx = 0; idx < sizeof(uint64_t); ++idx)
+    bytes[idx] = (unsigned char)(word >> 8*idx);
+
+  return serial->stream->write(serial->stream->ctx, bytes, sizeof(uint64_t));
+}
+
+/**
+ * serial_read_word - reads a number from the stream of @serial into @word
+ *
+ * @serial: the state of the dump
+ * @word:   where to store the number
+ */
+static inline bool serial_read_word(struct serial *restrict serial, uint64_t *restrict word) {
+  unsigned char bytes[sizeof(uint64_t)];
+
+  if (!serial->stream->read(serial->stream->ctx, bytes, sizeof(uint64_t))) return false;
+
+  *word = 0;
+  for (register size_t idx = 0; idx < sizeof(uint64_t); ++idx)
+    *word |= (uint64_t)bytes[idx] << 8*idx;
+
+  return true;
+}
+
+/**
+ * serial_write_record - writes the record of @item encoded by @codec to the stream of @serial
+ *
+ * @serial: the state of the dump
+ * @codec:  the serializer of @item
+ * @item:   the key or value to write
+ */
+static inline bool serial_write_record(struct serial *restrict serial, const struct bplus_codec *restrict codec, const void *item) {
+  register size_t length = codec->record(codec->ctx, item, serial->buffer, serial->capacity);
+
+  /* case of a record larger than the buffer: encode it again into a grown one */
+  if (serial->capacity < length && (!serial_reserve(serial, length) || codec->record(codec->ctx, item, serial->buffer, serial->capacity) != length)) return false;
+
+  return serial_write_word(serial, length) && (length == 0 || serial->stream->write(serial->stream->ctx, serial->buffer, length));
+}
+
+/**
+ * serial_read_record - reads a record from the stream of @serial and decodes it by @codec into @item
+ *
+ * @serial: the state of the dump
+ * @codec:  the serializer of @item
+ * @item:   where to store the key or value read
+ */
+static inline bool serial_read_record(struct serial *restrict serial, const struct bplus_codec *restrict codec, void **restrict item) {
+  uint64_t length;
+
+  return serial_read_word(serial, &length) && (size_t)length == length && serial_reserve(serial, (size_t)length) &&
+         (length == 0 || serial->stream->read(serial->stream->ctx, serial->buffer, (size_t)length)) &&
+         codec->decode(codec->ctx, serial->buffer, (size_t)length, item);
+}
+
+/**
+ * serial_write_entry - writes the records of the entry of @key and @value to the stream of @serial
+ *
+ * @serial: the state of the dump
+ * @key:    the key of the entry
+ * @value:  the value of the entry
+ *
+ * Returns false if the stream fails or a record cannot be buffered.
+ */
+static inline bool serial_write_entry(struct serial *restrict serial, const void *key, const void *value) {
+  return serial_write_record(serial, serial->keys, key) && serial_write_record(serial, serial->values, value);
+}
+
+/**
+ * serial_read_entry - reads the records of an entry from the stream of @serial into @key and @value
+ *
+ * @serial: the state of the dump
+ * @key:    where to store the key of the entry
+ * @value:  where to store the value of the entry
+ *
+ * Returns false if the stream fails, a record cannot be buffered or a record is malformed,
+ * in which case the key already read is released.
+ */
+static inline bool serial_read_entry(struct serial *restrict serial, const void **restrict key, void **restrict value) {
+  void *item;
+
+  if (!serial_read_record(serial, serial->keys, &item)) return false;
+
+  /* case of a malformed value: the key would be lost otherwise */
+  if (!serial_read_record(serial, serial->values, value)) {
+    if (serial->keys->release != NULL) serial->keys->release(serial->keys->ctx, item);
+    return false;
+  }
+
+  *key = item;
+
+  return true;
+}
+
+/**
+ * serial_release_entry - releases @key and @value read from the stream of @serial
+ *
+ * @serial: the state of the dump
+ * @key:    the key of the entry
+ * @value:  the value of the entry
+ */
+static inline void serial_release_entry(struct serial *restrict serial, const void *key, void *value) {
+  if (serial->keys->release != NULL)   serial->keys->release(serial->keys->ctx, (void *)key);
+  if (serial->values->release != NULL) serial->values->release(serial->values->ctx, value);
+}
+
+#endif /* _INDEX_SERIAL_H */
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * shard.h - range-partitioned sharded index declaration
+ *
+ * A sharded index splits the key space into a fixed number of contiguous ranges,
+ * each of which is held by its own B+-tree guarded by its own reader/writer lock,
+ * so that writers to different ranges never contend while callers still see a single ordered map.
+ *
+ * A point operation routes its key to the shard whose range contains it and locks only that shard.
+ * The ranges move over time: a rebalancer hands the entries at the edge of a shard receiving many writes
+ * over to its neighbour, moving their common boundary.
+ * A boundary is only moved while both of its shards are write-locked,
+ * so that an operation routed by a stale boundary notices it under the lock and routes again.
+ * Scans visit the shards in order, resuming each shard from where the previous one ended,
+ * so that each entry is visited once even if a boundary moves in between.
+ *
+ * See https://www.vldb.org/pvldb/vol13/p3072-huang.pdf for more details.
+ */
+#ifndef _INDEX_SHARD_H
+#define _INDEX_SHARD_H
+
+#include <index/rwtree.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * struct shard_node - a shard in sharded index
+ *
+ * @tree:   the B+-tree holding the entries of the shard along with its lock
+ * @inf:    the lower bound of the keys of the shard, or NULL for the first shard
+ * @sup:    the upper bound of the keys of the shard, or NULL for the last shard
+ * @writes: the number of the writes to the shard since the last rebalancing
+ *
+ * Each shard is padded to a cache line, so that writers to adjacent shards do not invalidate each other.
+ */
+struct shard_node {
+        struct bplus_rw_root tree;
+  const void                 *inf;
+  const void                 *sup;
+        size_t               writes;
+} __attribute__((aligned(64)));
+
+/**
+ * struct shard_root - a sharded index
+ *
+ * @shards: the shards in ascending order of their ranges
+ * @nmemb:  the number of @shards
+ * @less:   operator defining the (partial) element order
+ * @lock:   the lock serializing the rebalancers
+ */
+struct shard_root {
+  struct shard_node *shards;
+  size_t            nmemb;
+  bool            (*less)(const void *restrict, const void *restrict);
+  pthread_mutex_t   lock;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * NOTE:
+ *
+ * Like the separators of the B+-tree, a boundary between two shards may be the key of an erased element,
+ * so the keys of erased elements must remain valid until the index is destroyed.
+ * The keys must not be NULL, which stands for an unbounded range.
+ */
+
+/**
+ * shard_init - initializes an empty index of @nmemb shards split at @bounds
+ *
+ * @root:   index to initialize
+ * @nmemb:  the number of shards
+ * @bounds: the @nmemb-1 boundaries between the shards in ascending order
+ * @order:  the order of the B+-tree of each shard
+ * @less:   operator defining the (partial) element order
+ */
+extern void shard_init(struct shard_root *restrict root, const size_t nmemb, const void **restrict bounds, const size_t order, bool (*less)(const void *restrict, const void *restrict));
+
+/**
+ * shard_destroy - erases all elements from @root and destroys its shards
+ *
+ * @root: index to destroy
+ */
+extern void shard_destroy(struct shard_root *root);
+
+/**
+ * shard_size - returns the number of elements in @root
+ *
+ * @root: index to get the number of elements
+ *
+ * The shards are counted one after another, so that the result may be inexact under concurrent writes.
+ */
+extern size_t shard_size(struct shard_root *root);
+
+/**
+ * shard_contains - checks if @root contains an element with @key
+ *
+ * @root: index to check
+ * @key:  the key to search for
+ */
+extern bool shard_contains(struct shard_root *root, const void *key);
+
+/**
+ * shard_find - returns the value of the element with @key in @root, or NULL if there is no such element
+ *
+ * @root: index to find element from
+ * @key:  the key to search for
+ */
+extern void *shard_find(struct shard_root *root, const void *key);
+
+/**
+ * shard_insert - inserts an element into @root
+ *
+ * @root:  index to insert element into
+ * @key:   the key of the element to insert
+ * @value: the value of the element to insert
+ *
+ * Returns false without insertion if @key already exists in @root.
+ */
+extern bool shard_insert(struct shard_root *root, const void *key, void *value);
+
+/**
+ * shard_replace - inserts an element into @root or assigns @value if @key already exists
+ *
+ * @root:  index to insert element into
+ * @key:   the key of the element to insert if not found
+ * @value: the value of the element to insert or assign
+ */
+extern void shard_replace(struct shard_root *root, const void *key, void *value);
+
+/**
+ * shard_erase - removes the element with @key from @root
+ *
+ * @root: index to remove the element from
+ * @key:  the key of the element to remove
+ */
+extern void *shard_erase(struct shard_root *root, const void *key);
+
+/**
+ * shard_for_each - applies @func to each element of @root in ascending order
+ *
+ * @root: index to apply @func to each element of
+ * @func: function to apply to each element of @root
+ *
+ * Each shard is read-locked while @func is applied to its elements.
+ */
+extern void shard_for_each(struct shard_root *root, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * shard_range_each - applies @func to each element of @root greater than or equal to @inf and less than @sup
+ *
+ * @root: index to apply @func to each element of
+ * @inf:  the lower bound key to search for
+ * @sup:  the upper bound key to search for
+ * @func: function to apply to each element of @root
+ *
+ * Each shard is read-locked while @func is applied to its elements.
+ */
+extern void shard_range_each(struct shard_root *root, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict));
+
+/**
+ * shard_rebalance - moves the boundary of the shard with the most writes since the last call, if it is hot
+ *
+ * @root: index to rebalance
+ *
+ * A shard is hot if it has received more than twice the average number of writes,
+ * in which case a quarter of its elements are moved to the neighbour with fewer writes.
+ * This function is meant to be called periodically from a background thread,
+ * concurrently with the other functions.
+ *
+ * Returns the number of the moved elements, which is zero if they cannot be collected for lack of memory.
+ */
+extern size_t shard_rebalance(struct shard_root *root);
+
+#endif /* _INDEX_SHARD_H */
@@ -0,0 +1,241 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * skiplist.h - generic lock-free skip list declaration
+ *
+ * The skip list is a hierarchy of sorted linked lists, each of which skips over
+ * about three quarters of the nodes of the list below it,
+ * so that searching, insertion and deletion take logarithmic time on average
+ * without any rebalancing.
+ *
+ * Since every modification is a compare-and-swap of a single link,
+ * any number of threads may search and modify the list at the same time without any lock.
+ * A node is erased by marking the lowest bit of its links from the top level down,
+ * after which it is logically absent, and then unlinked from each level by the next thread passing by.
+ * Unlinked nodes are retired to an epoch domain rather than freed,
+ * so that threads still traversing them are never left with a dangling pointer.
+ *
+ * See https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf for more details.
+ */
+#ifndef _INDEX_SKIPLIST_H
+#define _INDEX_SKIPLIST_H
+
+#include <index/epoch.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SKIP_MAXLEVEL 32
+
+/**
+ * struct skip_node - a node in skip list
+ *
+ * @key:   the key of the node
+ * @value: the value of the node
+ * @level: the number of the levels in which the node is linked
+ * @ready: the number of the inserting and erasing threads yet to let go of the node
+ * @next:  the addresses of the next nodes in each level, with the lowest bit set once the node is erased
+ */
+struct skip_node {
+  const void             *key;
+        void             *value;
+        size_t           level;
+        size_t           ready;
+        struct skip_node *next[];
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct skip_root - a skip list
+ *
+ * @head:  the sentinel node linked in all levels
+ * @less:  operator defining the (partial) node order
+ * @size:  the number of entries
+ * @epoch: epoch domain to retire the erased nodes to
+ */
+struct skip_root {
+  struct skip_node  *head;
+  bool            (*less)(const void *restrict, const void *restrict);
+  size_t            size;
+  struct epoch_root *epoch;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+struct skip_iter {
+  const void             *key;
+        void             *value;
+        struct skip_node *pivot;
+  const struct skip_root *list;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+struct skip_reverse_iter {
+  const void             *key;
+        void             *value;
+        struct skip_node *pivot;
+  const struct skip_root *list;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * The below functions use the operator with 3 different
+ * calling conventions. The operator denotes:
+ *
+ *    a < b  := less(a, b)
+ *    a > b  := less(b, a)
+ *    a == b := !less(a, b) && !less(b, a)
+ *
+ * NOTE:
+ *
+ * less must describe a transitive ordering:
+ *  - if both less(a, b) and less(b, c) are true, then less(a, c) must be true as well
+ *  - if both less(a, b) and less(b, c) are false, then less(a, c) must be false as well
+ *
+ * Except for skip_init, skip_destroy and skip_clear, the below functions may be called
+ * concurrently from any number of threads, each of which must be inside a critical section
+ * of the epoch domain of the list, i.e., between epoch_enter and epoch_exit.
+ * An iterator is only valid within the critical section in which it is obtained.
+ */
+
+/**
+ * skip_init - initializes an empty list with @less
+ *
+ * @list:  list to initialize
+ * @less:  operator defining the (partial) node order
+ * @epoch: epoch domain to retire the erased nodes to
+ */
+extern void skip_init(struct skip_root *restrict list, bool (*less)(const void *restrict, const void *restrict), struct epoch_root *restrict epoch);
+
+/**
+ * skip_destroy - erases all entries from @list and frees its sentinel
+ *
+ * @list: list to destroy
+ */
+extern void skip_destroy(struct skip_root *list);
+
+/**
+ * skip_size - returns the number of entries in @list
+ *
+ * @list: list to get the number of entries
+ */
+static inline size_t skip_size(const struct skip_root *list) { return __atomic_load_n(&list->size, __ATOMIC_RELAXED); }
+
+/**
+ * skip_empty - checks whether @list is empty
+ *
+ * @list: list to check
+ */
+static inline bool skip_empty(const struct skip_root *list) { return skip_size(list) == 0; }
+
+/**
+ * skip_contains - checks if @list contains an entry with @key
+ *
+ * @list: list to check
+ * @key:  the key to search for
+ */
+extern bool skip_contains(const struct skip_root *list, const void *key);
+
+/**
+ * skip_find - searches @list for an entry with @key
+ *
+ * @list: list to search
+ * @key:  the key to search for
+ */
+extern struct skip_iter skip_find(const struct skip_root *list, const void *key);
+
+/**
+ * skip_insert - inserts an entry into @list
+ *
+ * @list:  list to insert an entry into
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ *
+ * Returns an iterator of the entry with @key, which is left unchanged if it already exists.
+ */
+extern struct skip_iter skip_insert(struct skip_root *restrict list, const void *restrict key, void *restrict value);
+
+/**
+ * skip_replace - inserts an entry or assigns @value if @key already exists
+ *
+ * @list:  list to insert an entry into
+ * @key:   the key of the entry to insert if not found
+ * @value: the value of the entry to insert or assign
+ */
+extern struct skip_iter skip_replace(struct skip_root *restrict list, const void *restrict key, void *restrict value);
+
+/**
+ * skip_erase - removes the entry with @key from @list
+ *
+ * @list: list to remove the entry from
+ * @key:  the key of the entry to remove
+ *
+ * Returns the value of the removed entry, or NULL if not found.
+ */
+extern void *skip_erase(struct skip_root *restrict list, const void *restrict key);
+
+/**
+ * skip_clear - erases all entries from @list
+ *
+ * @list: list to erase all entries from
+ *
+ * No other thread may access @list during this call.
+ */
+extern void skip_clear(struct skip_root *list);
+
+/**
+ * skip_iter_init - initializes an iterator of @list
+ *
+ * @list: list to initialize an iterator of
+ */
+extern struct skip_iter skip_iter_init(const struct skip_root *list);
+
+/**
+ * skip_iter_prev - finds logical previous entry of @iter
+ *
+ * @iter: iterator to find logical previous entry of
+ *
+ * The nodes are only linked forward, so that this function searches @list again.
+ */
+extern void skip_iter_prev(struct skip_iter *iter);
+
+/**
+ * skip_iter_next - finds logical next entry of @iter
+ *
+ * @iter: iterator to find logical next entry of
+ */
+extern void skip_iter_next(struct skip_iter *iter);
+
+/**
+ * skip_iter_end - checks if @iter reaches the end
+ *
+ * @iter: iterator to check
+ */
+static inline bool skip_iter_end(const struct skip_iter iter) { return iter.pivot == NULL; }
+
+/**
+ * skip_reverse_iter_init - initializes a reverse iterator of @list
+ *
+ * @list: list to initialize a reverse iterator of
+ */
+extern struct skip_reverse_iter skip_reverse_iter_init(const struct skip_root *list);
+
+/**
+ * skip_reverse_iter_prev - finds logical previous entry of @iter
+ *
+ * @iter: reverse iterator to find logical previous entry of
+ */
+extern void skip_reverse_iter_prev(struct skip_reverse_iter *iter);
+
+/**
+ * skip_reverse_iter_next - finds logical next entry of @iter
+ *
+ * @iter: reverse iterator to find logical next entry of
+ *
+ * The nodes are only linked forward, so that this function searches @list again.
+ */
+extern void skip_reverse_iter_next(struct skip_reverse_iter *iter);
+
+/**
+ * skip_reverse_iter_end - checks if @iter reaches the end
+ *
+ * @iter: reverse iterator to check
+ */
+static inline bool skip_reverse_iter_end(const struct skip_reverse_iter iter) { return iter.pivot == NULL; }
+
+#endif /* _INDEX_SKIPLIST_H */
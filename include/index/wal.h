@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * wal.h - write-ahead logged B+-tree declaration
+ *
+ * A write-ahead logged B+-tree appends a record of each insertion, assignment and erasure to a log
+ * before acknowledging it, so that a crash loses none of the acknowledged writes.
+ * A checkpoint saves the image of the tree and truncates the log,
+ * and opening the tree restores the image and replays the log on top of it.
+ *
+ * The records are appended under the write lock of the tree, in the order the writes are applied,
+ * while the log is written and synchronized outside of it by group commit:
+ * the first writer waiting for its record becomes the leader, writing and synchronizing all records appended so far,
+ * while the writers coming meanwhile wait for the next leader, which takes them all in one write.
+ * The policy chooses whether each write waits for its record to be synchronized,
+ * or the log is synchronized every given number of milliseconds or bytes, trading the latest writes for throughput.
+ *
+ * See https://people.eecs.berkeley.edu/~brewer/cs262/Aries.pdf for more details.
+ */
+#ifndef _INDEX_WAL_H
+#define _INDEX_WAL_H
+
+#include <index/bplusimage.h>
+#include <index/rwtree.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WAL_INSERT 1
+#define WAL_ASSIGN 2
+#define WAL_ERASE  3
+
+/**
+ * struct wal_policy - the policy of synchronizing the log
+ *
+ * @interval: the number of milliseconds between synchronizations by a background thread, or zero
+ * @bytes:    the number of bytes appended between synchronizations, or zero
+ *
+ * If both are zero, each write waits for its record to be synchronized.
+ */
+struct wal_policy {
+  size_t interval;
+  size_t bytes;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct wal_log - a write-ahead log
+ *
+ * @fd:       the file of the log
+ * @offset:   the length of the records written to the file
+ * @pending:  the records appended and not written yet
+ * @length:   the length of @pending
+ * @capacity: the capacity of @pending
+ * @spare:    the buffer swapped with @pending by the leader
+ * @reserve:  the capacity of @spare
+ * @appended: the number of bytes appended since the log was opened
+ * @durable:  the number of bytes synchronized since the log was opened
+ * @syncs:    the number of synchronizations
+ * @flushing: whether a leader is writing
+ * @failed:   whether a write has failed, which fails all later commits
+ * @stop:     whether the background thread is to stop
+ * @policy:   the policy of synchronizing the log
+ * @lock:     the lock guarding the log
+ * @cond:     the condition signalled when a leader finishes
+ * @flusher:  the background thread synchronizing the log periodically
+ */
+struct wal_log {
+  int               fd;
+  uint64_t          offset;
+  unsigned char     *pending;
+  size_t            length;
+  size_t            capacity;
+  unsigned char     *spare;
+  size_t            reserve;
+  uint64_t          appended;
+  uint64_t          durable;
+  size_t            syncs;
+  bool              flushing;
+  bool              failed;
+  bool              stop;
+  struct wal_policy policy;
+  pthread_mutex_t   lock;
+  pthread_cond_t    cond;
+  pthread_t         flusher;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * struct wal_root - a write-ahead logged B+-tree
+ *
+ * @tree:     the B+-tree, along with its lock
+ * @log:      the write-ahead log
+ * @base:     the image the tree was restored from, or NULL
+ * @replayed: the records replayed from the log
+ * @keys:     the serializer of the keys, or NULL to store the keys as pointers
+ * @values:   the serializer of the values, or NULL to store the values as pointers
+ * @image:    the path of the image
+ */
+struct wal_root {
+        struct bplus_rw_root tree;
+        struct wal_log       log;
+        struct bplus_image   *base;
+        unsigned char        *replayed;
+  const struct bplus_codec   *keys;
+  const struct bplus_codec   *values;
+        char                 *image;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/*
+ * NOTE:
+ *
+ * The keys and values restored from the image or replayed from the log are presented as in a B+-tree image,
+ * pointing into memory owned by the tree until wal_close when written by an encoder,
+ * so that such records must be usable as keys and values by themselves, e.g., NUL-terminated strings.
+ * A reader may see a write before it is acknowledged.
+ */
+
+/**
+ * wal_open - restores the tree from the image at @image and the log at @log, creating the files if missing
+ *
+ * @root:   tree to open
+ * @image:  the path of the image
+ * @log:    the path of the log
+ * @order:  the order of the tree
+ * @less:   operator defining the (partial) element order
+ * @keys:   the serializer of the keys, or NULL to store the keys as pointers
+ * @values: the serializer of the values, or NULL to store the values as pointers
+ * @policy: the policy of synchronizing the log
+ *
+ * A torn record at the end of the log, left by a crash during a write, is discarded along with the rest of the log.
+ *
+ * Returns false if the files cannot be opened, the image cannot be restored, or the group-commit thread cannot be started.
+ */
+extern bool wal_open(struct wal_root *restrict root, const char *restrict image, const char *restrict log, const size_t order, bool (*less)(const void *restrict, const void *restrict),
+                     const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values, const struct wal_policy policy);
+
+/**
+ * wal_close - synchronizes the log and frees @root, without a checkpoint
+ *
+ * @root: tree to close
+ *
+ * Returns false if the log cannot be synchronized.
+ */
+extern bool wal_close(struct wal_root *root);
+
+/**
+ * wal_sync - waits for all records appended so far to be synchronized
+ *
+ * @root: tree to synchronize the log of
+ *
+ * Returns false if the log cannot be synchronized.
+ */
+extern bool wal_sync(struct wal_root *root);
+
+/**
+ * wal_checkpoint - saves the image of @root and truncates the log
+ *
+ * @root: tree to checkpoint
+ *
+ * The writes wait for the checkpoint, while the reads go on.
+ * The log is truncated only once the image and the directory holding it are flushed to the disk.
+ *
+ * Returns false if the image cannot be saved or the log cannot be truncated.
+ */
+extern bool wal_checkpoint(struct wal_root *root);
+
+/**
+ * wal_size - returns the number of elements in @root
+ *
+ * @root: tree to get the number of elements
+ */
+static inline size_t wal_size(struct wal_root *root) { return bplus_rw_size(&root->tree); }
+
+/**
+ * wal_contains - checks if @root contains an element with @key
+ *
+ * @root: tree to check
+ * @key:  the key to search for
+ */
+static inline bool wal_contains(struct wal_root *root, const void *key) { return bplus_rw_contains(&root->tree, key); }
+
+/**
+ * wal_find - returns the value of the element with @key in @root, or NULL if there is no such element
+ *
+ * @root: tree to find element from
+ * @key:  the key to search for
+ */
+static inline void *wal_find(struct wal_root *root, const void *key) { return bplus_rw_find(&root->tree, key); }
+
+/**
+ * wal_insert - inserts an element into @root
+ *
+ * @root:  tree to insert element into
+ * @key:   the key of the element to insert
+ * @value: the value of the element to insert
+ *
+ * Returns false if @key already exists in @root, or if the insertion cannot be made durable.
+ */
+extern bool wal_insert(struct wal_root *root, const void *key, void *value);
+
+/**
+ * wal_insert_or_assign - inserts an element into @root or assigns @value if @key already exists
+ *
+ * @root:  tree to insert element into
+ * @key:   the key of the element to insert if not found
+ * @value: the value of the element to insert or assign
+ *
+ * Returns false if the write cannot be made durable.
+ */
+extern bool wal_insert_or_assign(struct wal_root *root, const void *key, void *value);
+
+/**
+ * wal_erase - removes the element with @key from @root
+ *
+ * @root:  tree to remove the element from
+ * @key:   the key of the element to remove
+ * @value: where to store the value of the removed element, or NULL
+ *
+ * Returns false if there is no such element, or if the erasure cannot be made durable.
+ */
+extern bool wal_erase(struct wal_root *restrict root, const void *restrict key, void **restrict value);
+
+#endif /* _INDEX_WAL_H */
@@ -4,8 +4,17 @@
  *
  * avltree.c - generic AVL tree definition
  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <index/avltree.h>
+#include <index/epoch.h>
+#include <index/serial.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 /**
  * avl_alloc - allocates a node with @key and @value
@@ -50,6 +59,7 @@ static inline void avl_rotate_left(struct avl_node *node) {
   else if (node->parent->left == node) node->parent->left  = rchild;
   else                                 node->parent->right = rchild;
 
+  rchild->tree   = node->tree;
   rchild->parent = node->parent;
   node->parent   = rchild;
 
@@ -71,6 +81,7 @@ static inline void avl_rotate_right(struct avl_node *node) {
   else if (node->parent->left == node) node->parent->left  = lchild;
   else                                 node->parent->right = lchild;
 
+  lchild->tree   = node->tree;
   lchild->parent = node->parent;
   node->parent   = lchild;
 
@@ -190,6 +201,686 @@ static inline void avl_destroy(struct avl_node *node) {
   }
 }
 
+/**
+ * avl_copy - allocates a copy of @node whose children still refer to those of @node
+ *
+ * @node:   node to copy
+ * @parent: the address of the parent node of the copy
+ * @tree:   the address of the tree to which the copy belongs
+ */
+static inline struct avl_node *avl_copy(const struct avl_node *restrict node, struct avl_node *restrict parent, struct avl_root *restrict tree) {
+  struct avl_node *copy = avl_alloc(node->key, node->value, parent, tree);
+  copy->left            = node->left;
+  copy->right           = node->right;
+  copy->height          = node->height;
+  return copy;
+}
+
+/**
+ * avl_retrace - updates the heights from @node up to the root, rebalancing every unbalanced subtree on the way
+ *
+ * @node: node to initiate retracing
+ */
+static inline void avl_retrace(struct avl_node *node) {
+  for (; node != NULL; node = node->parent) {
+    node->height = 1 + max(avl_height(node->left), avl_height(node->right));
+    if (1 + avl_height(node->right) < avl_height(node->left) || 1 + avl_height(node->left) < avl_height(node->right)) {
+      avl_rebalance(node);
+      node = node->parent;
+    }
+  }
+}
+
+/**
+ * avl_adopt - makes @node the root of @tree
+ *
+ * @tree: tree to store @node into
+ * @node: root node of subtree to store
+ */
+static inline void avl_adopt(struct avl_root *restrict tree, struct avl_node *node) {
+  if (node != NULL) node->parent = NULL, node->tree = tree;
+  tree->root = node;
+}
+
+/**
+ * avl_join3 - joins @lhs, @node and @rhs into @tree
+ *
+ * @tree: tree to store the joined subtree into
+ * @lhs:  root node of subtree whose keys are less than the key of @node
+ * @node: node to join with
+ * @rhs:  root node of subtree whose keys are greater than the key of @node
+ *
+ * @node is attached to the spine of the taller subtree at the height of the other one
+ * and the path above it is retraced, so that this takes time proportional to the height difference.
+ */
+static inline void avl_join3(struct avl_root *restrict tree, struct avl_node *lhs, struct avl_node *node, struct avl_node *rhs) {
+  register struct avl_node *parent = NULL;
+
+  if (lhs != NULL) lhs->parent = NULL, lhs->tree = tree;
+  if (rhs != NULL) rhs->parent = NULL, rhs->tree = tree;
+  node->tree = tree;
+
+  if (1 + avl_height(rhs) < avl_height(lhs)) {        /* case of taller left subtree */
+    tree->root = lhs;
+    for (; 1 + avl_height(rhs) < avl_height(lhs); lhs = lhs->right)
+      parent = lhs;
+    parent->right = node;
+  } else if (1 + avl_height(lhs) < avl_height(rhs)) { /* case of taller right subtree */
+    tree->root = rhs;
+    for (; 1 + avl_height(lhs) < avl_height(rhs); rhs = rhs->left)
+      parent = rhs;
+    parent->left = node;
+  } else {
+    tree->root = node;
+  }
+
+  node->left   = lhs;
+  node->right  = rhs;
+  node->parent = parent;
+  node->height = 1 + max(avl_height(lhs), avl_height(rhs));
+
+  if (lhs != NULL) lhs->parent = node;
+  if (rhs != NULL) rhs->parent = node;
+
+  avl_retrace(parent);
+}
+
+/**
+ * avl_join2 - joins @lhs and @rhs into @tree
+ *
+ * @tree: tree to store the joined subtree into
+ * @lhs:  root node of subtree whose keys are less than those of @rhs
+ * @rhs:  root node of subtree whose keys are greater than those of @lhs
+ *
+ * The leftmost node of @rhs is detached and used as the node to join with.
+ */
+static inline void avl_join2(struct avl_root *restrict tree, struct avl_node *lhs, struct avl_node *rhs) {
+  register struct avl_node *node;
+
+  if (rhs == NULL) {
+    avl_adopt(tree, lhs);
+    return;
+  }
+
+  avl_adopt(tree, rhs);
+
+  for (node = rhs; node->left != NULL; node = node->left);
+
+  if (node->parent == NULL) tree->root         = node->right; /* case of root */
+  else                      node->parent->left = node->right;
+  if (node->right != NULL)  node->right->parent = node->parent;
+
+  avl_retrace(node->parent);
+  avl_join3(tree, lhs, node, tree->root);
+}
+
+/**
+ * avl_split_subtree - splits subtree rooted with @node into @lhs and @rhs at @key
+ *
+ * @node: root node of subtree to split
+ * @key:  the key to split at
+ * @less: operator defining the (partial) node order
+ * @lhs:  tree to store the entries less than @key into
+ * @rhs:  tree to store the entries greater than @key into
+ *
+ * Returns the detached node with @key, or NULL if there is no such node.
+ */
+static struct avl_node *avl_split_subtree(struct avl_node *node, const void *restrict key, bool (*less)(const void *restrict, const void *restrict), struct avl_root *restrict lhs, struct avl_root *restrict rhs) {
+  register struct avl_node *found;
+
+  if (node == NULL) {
+    lhs->root = NULL;
+    rhs->root = NULL;
+    return NULL;
+  }
+
+  struct avl_node *left  = node->left;
+  struct avl_node *right = node->right;
+
+  if (less(node->key, key)) {
+    found = avl_split_subtree(right, key, less, lhs, rhs);
+    avl_join3(lhs, left, node, lhs->root);
+    return found;
+  }
+
+  if (less(key, node->key)) {
+    found = avl_split_subtree(left, key, less, lhs, rhs);
+    avl_join3(rhs, rhs->root, node, right);
+    return found;
+  }
+
+  if (left != NULL)  left->parent  = NULL;
+  if (right != NULL) right->parent = NULL;
+  lhs->root = left;
+  rhs->root = right;
+
+  return node;
+}
+
+/**
+ * avl_count - counts the entries of subtree rooted with @lhs, walking it in lockstep with @rhs
+ *
+ * @lhs:   root node of subtree to count the entries of
+ * @rhs:   root node of the other subtree
+ * @total: the number of entries in both subtrees
+ *
+ * The walk stops as soon as either subtree is exhausted,
+ * so that this takes time proportional to the smaller one.
+ */
+static inline size_t avl_count(struct avl_node *lhs, struct avl_node *rhs, const size_t total) {
+  register size_t count = 0;
+
+  if (lhs != NULL) for (; lhs->left != NULL; lhs = lhs->left);
+  if (rhs != NULL) for (; rhs->left != NULL; rhs = rhs->left);
+
+  for (; lhs != NULL && rhs != NULL; ++count) {
+    lhs = avl_upper_bound(lhs);
+    rhs = avl_upper_bound(rhs);
+  }
+
+  return lhs == NULL ? count : total-count;
+}
+
+/**
+ * struct avl_task - a subproblem of a set operation
+ *
+ * @tree:    tree to store the result into
+ * @lhs:     root node of the first operand
+ * @rhs:     root node of the second operand
+ * @func:    the set operation to apply to @lhs and @rhs
+ * @threads: the number of threads the subproblem may use
+ * @count:   the number of the common keys of @lhs and @rhs
+ */
+struct avl_task {
+  struct avl_root *tree;
+  struct avl_node *lhs;
+  struct avl_node *rhs;
+  size_t          (*func)(struct avl_root *restrict, struct avl_node *, struct avl_node *, const size_t);
+  size_t          threads;
+  size_t          count;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+static void *avl_task_run(void *arg) {
+  struct avl_task *task = arg;
+  task->count           = task->func(task->tree, task->lhs, task->rhs, task->threads);
+  return NULL;
+}
+
+/**
+ * avl_fork_join - runs @lower and @upper, in parallel if both operands of @lower are large enough
+ *
+ * @lower:   the subproblem on the lower keys
+ * @upper:   the subproblem on the upper keys
+ * @threads: the number of threads both subproblems may use
+ *
+ * Returns the number of the common keys of both subproblems.
+ */
+static inline size_t avl_fork_join(struct avl_task *restrict lower, struct avl_task *restrict upper, const size_t threads) {
+  pthread_t thread;
+
+  lower->threads = threads >> 1;
+  upper->threads = threads - lower->threads;
+
+  if (1 < threads && 10 <= avl_height(lower->lhs) && 10 <= avl_height(lower->rhs) && pthread_create(&thread, NULL, avl_task_run, lower) == 0) {
+    avl_task_run(upper);
+    pthread_join(thread, NULL);
+  } else {
+    lower->threads = upper->threads = 1;
+    avl_task_run(lower);
+    avl_task_run(upper);
+  }
+
+  return lower->count + upper->count;
+}
+
+/**
+ * avl_union_subtree - merges subtrees rooted with @lhs and @rhs into @tree
+ *
+ * @tree:    tree to store the union into
+ * @lhs:     root node of subtree whose entries take precedence
+ * @rhs:     root node of the other subtree
+ * @threads: the number of threads the operation may use
+ *
+ * Returns the number of the entries of @rhs freed for having keys in @lhs.
+ */
+static size_t avl_union_subtree(struct avl_root *restrict tree, struct avl_node *lhs, struct avl_node *rhs, const size_t threads) {
+  if (lhs == NULL || rhs == NULL) {
+    avl_adopt(tree, lhs == NULL ? rhs : lhs);
+    return 0;
+  }
+
+  struct avl_root lower  = avl_init(tree->less);
+  struct avl_root upper  = avl_init(tree->less);
+  struct avl_node *found = avl_split_subtree(rhs, lhs->key, tree->less, &lower, &upper);
+  struct avl_task ltask  = { .tree = &lower, .lhs = lhs->left,  .rhs = lower.root, .func = avl_union_subtree };
+  struct avl_task utask  = { .tree = &upper, .lhs = lhs->right, .rhs = upper.root, .func = avl_union_subtree };
+  const  size_t   count  = avl_fork_join(&ltask, &utask, threads) + (found != NULL);
+
+  free(found);
+  avl_join3(tree, lower.root, lhs, upper.root);
+
+  return count;
+}
+
+/**
+ * avl_intersection_subtree - keeps the entries of @lhs whose keys are in @rhs, freeing all the others
+ *
+ * @tree:    tree to store the intersection into
+ * @lhs:     root node of subtree whose entries are kept
+ * @rhs:     root node of subtree whose entries are freed
+ * @threads: the number of threads the operation may use
+ *
+ * Returns the number of the entries kept.
+ */
+static size_t avl_intersection_subtree(struct avl_root *restrict tree, struct avl_node *lhs, struct avl_node *rhs, const size_t threads) {
+  if (lhs == NULL || rhs == NULL) {
+    avl_destroy(lhs);
+    avl_destroy(rhs);
+    tree->root = NULL;
+    return 0;
+  }
+
+  struct avl_root lower  = avl_init(tree->less);
+  struct avl_root upper  = avl_init(tree->less);
+  struct avl_node *found = avl_split_subtree(rhs, lhs->key, tree->less, &lower, &upper);
+  struct avl_task ltask  = { .tree = &lower, .lhs = lhs->left,  .rhs = lower.root, .func = avl_intersection_subtree };
+  struct avl_task utask  = { .tree = &upper, .lhs = lhs->right, .rhs = upper.root, .func = avl_intersection_subtree };
+  const  size_t   count  = avl_fork_join(&ltask, &utask, threads);
+
+  if (found == NULL) {
+    free(lhs);
+    avl_join2(tree, lower.root, upper.root);
+    return count;
+  }
+
+  free(found);
+  avl_join3(tree, lower.root, lhs, upper.root);
+
+  return count + 1;
+}
+
+/**
+ * avl_difference_subtree - keeps the entries of @lhs whose keys are not in @rhs, freeing all the others
+ *
+ * @tree:    tree to store the difference into
+ * @lhs:     root node of subtree whose entries are kept
+ * @rhs:     root node of subtree whose entries are freed
+ * @threads: the number of threads the operation may use
+ *
+ * Returns the number of the entries of @lhs freed for having keys in @rhs.
+ */
+static size_t avl_difference_subtree(struct avl_root *restrict tree, struct avl_node *lhs, struct avl_node *rhs, const size_t threads) {
+  if (lhs == NULL || rhs == NULL) {
+    avl_destroy(rhs);
+    avl_adopt(tree, lhs);
+    return 0;
+  }
+
+  struct avl_root lower  = avl_init(tree->less);
+  struct avl_root upper  = avl_init(tree->less);
+  struct avl_node *found = avl_split_subtree(rhs, lhs->key, tree->less, &lower, &upper);
+  struct avl_task ltask  = { .tree = &lower, .lhs = lhs->left,  .rhs = lower.root, .func = avl_difference_subtree };
+  struct avl_task utask  = { .tree = &upper, .lhs = lhs->right, .rhs = upper.root, .func = avl_difference_subtree };
+  const  size_t   count  = avl_fork_join(&ltask, &utask, threads);
+
+  if (found != NULL) {
+    free(found);
+    free(lhs);
+    avl_join2(tree, lower.root, upper.root);
+    return count + 1;
+  }
+
+  avl_join3(tree, lower.root, lhs, upper.root);
+
+  return count;
+}
+
+/**
+ * avl_threads - returns the number of threads a set operation may use
+ */
+static inline size_t avl_threads(void) {
+  const long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+  return nprocs < 1 ? 1 : (size_t)nprocs;
+}
+
+/**
+ * avl_rcu_link - publishes @node in place of @old, the child of @parent or the root of @tree if @parent is NULL
+ *
+ * @tree:   tree to which @old belongs
+ * @parent: the parent node of @old
+ * @old:    node to replace
+ * @node:   node to publish
+ */
+static inline void avl_rcu_link(struct avl_root *restrict tree, struct avl_node *parent, const struct avl_node *old, struct avl_node *node) {
+  if (parent == NULL)            __atomic_store_n(&tree->root, node, __ATOMIC_RELEASE);
+  else if (parent->left == old)  __atomic_store_n(&parent->left, node, __ATOMIC_RELEASE);
+  else                           __atomic_store_n(&parent->right, node, __ATOMIC_RELEASE);
+}
+
+/**
+ * avl_rcu_rotate_left - rotates subtree rooted with @node counterclockwise without disturbing concurrent readers
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  root node of subtree
+ * @epoch: epoch domain to retire @node to
+ *
+ * A reader standing on @node may still need to go right past the right child,
+ * so that @node is replaced with a copy rather than moved down.
+ * Returns the copy of @node.
+ */
+static inline struct avl_node *avl_rcu_rotate_left(struct avl_root *restrict tree, struct avl_node *node, struct epoch_root *restrict epoch) {
+  struct avl_node *rchild = node->right;
+  struct avl_node *copy   = avl_copy(node, rchild, tree);
+  copy->right             = rchild->left;
+
+  if (copy->left != NULL)  copy->left->parent  = copy;
+  if (copy->right != NULL) copy->right->parent = copy;
+
+  __atomic_store_n(&rchild->left, copy, __ATOMIC_RELEASE);
+  rchild->tree   = tree;
+  rchild->parent = node->parent;
+  avl_rcu_link(tree, node->parent, node, rchild);
+  epoch_retire(epoch, node);
+
+  return copy;
+}
+
+/**
+ * avl_rcu_rotate_right - rotates subtree rooted with @node clockwise without disturbing concurrent readers
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  root node of subtree
+ * @epoch: epoch domain to retire @node to
+ *
+ * Returns the copy of @node.
+ */
+static inline struct avl_node *avl_rcu_rotate_right(struct avl_root *restrict tree, struct avl_node *node, struct epoch_root *restrict epoch) {
+  struct avl_node *lchild = node->left;
+  struct avl_node *copy   = avl_copy(node, lchild, tree);
+  copy->left              = lchild->right;
+
+  if (copy->left != NULL)  copy->left->parent  = copy;
+  if (copy->right != NULL) copy->right->parent = copy;
+
+  __atomic_store_n(&lchild->right, copy, __ATOMIC_RELEASE);
+  lchild->tree   = tree;
+  lchild->parent = node->parent;
+  avl_rcu_link(tree, node->parent, node, lchild);
+  epoch_retire(epoch, node);
+
+  return copy;
+}
+
+/**
+ * avl_rcu_rebalance - rebalances subtree rooted with @node without disturbing concurrent readers
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  root node of subtree
+ * @epoch: epoch domain to retire the rotated nodes to
+ *
+ * Returns the new root node of subtree.
+ */
+static inline struct avl_node *avl_rcu_rebalance(struct avl_root *restrict tree, struct avl_node *node, struct epoch_root *restrict epoch) {
+  register struct avl_node *child;
+
+  if (1 + avl_height(node->right) < avl_height(node->left)) {
+    if (avl_height(node->left->left) < avl_height(node->left->right)) {   /* case of Left Right */
+      child         = avl_rcu_rotate_left(tree, node->left, epoch);
+      child->height = 1 + max(avl_height(child->left), avl_height(child->right));
+    }
+    child = avl_rcu_rotate_right(tree, node, epoch);                      /* case of Left Left */
+  } else {
+    if (avl_height(node->right->right) < avl_height(node->right->left)) { /* case of Right Left */
+      child         = avl_rcu_rotate_right(tree, node->right, epoch);
+      child->height = 1 + max(avl_height(child->left), avl_height(child->right));
+    }
+    child = avl_rcu_rotate_left(tree, node, epoch);                       /* case of Right Right */
+  }
+
+  child->height         = 1 + max(avl_height(child->left), avl_height(child->right));
+  child->parent->height = 1 + max(avl_height(child->parent->left), avl_height(child->parent->right));
+
+  return child->parent;
+}
+
+/**
+ * avl_rcu_retrace - updates the heights from @node up to the root without disturbing concurrent readers,
+ * rebalancing every unbalanced subtree on the way
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  node to initiate retracing
+ * @epoch: epoch domain to retire the rotated nodes to
+ */
+static inline void avl_rcu_retrace(struct avl_root *restrict tree, struct avl_node *node, struct epoch_root *restrict epoch) {
+  for (; node != NULL; node = node->parent) {
+    node->height = 1 + max(avl_height(node->left), avl_height(node->right));
+    if (1 + avl_height(node->right) < avl_height(node->left) || 1 + avl_height(node->left) < avl_height(node->right))
+      node = avl_rcu_rebalance(tree, node, epoch);
+  }
+}
+
+/**
+ * avl_cow_alloc - allocates a node with @key and @value, referred to by a single link
+ *
+ * @key:   the key of the node
+ * @value: the value of the node
+ */
+static inline struct avl_cow_node *avl_cow_alloc(const void *restrict key, void *restrict value) {
+  struct avl_cow_node *node = malloc(sizeof(struct avl_cow_node));
+  node->key                 = key;
+  node->value               = value;
+  node->left                = NULL;
+  node->right               = NULL;
+  node->height              = 1;
+  node->refcount            = 1;
+  return node;
+}
+
+/**
+ * avl_cow_height - returns the height of subtree rooted with @node
+ *
+ * @node: root node of subtree to get the height
+ */
+static inline size_t avl_cow_height(const struct avl_cow_node *node) { return node == NULL ? 0 : node->height; }
+
+/**
+ * avl_cow_get - adds a link to @node
+ *
+ * @node: node to refer to
+ */
+static inline struct avl_cow_node *avl_cow_get(struct avl_cow_node *node) {
+  if (node != NULL)
+    __atomic_add_fetch(&node->refcount, 1, __ATOMIC_RELAXED);
+  return node;
+}
+
+/**
+ * avl_cow_put - removes a link to @node, freeing every node of the subtree no other link refers to
+ *
+ * @node: node to stop referring to
+ */
+static inline void avl_cow_put(struct avl_cow_node *node) {
+  register struct avl_cow_node *next;
+
+  while (node != NULL && __atomic_sub_fetch(&node->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+    avl_cow_put(node->left);
+    next = node->right;
+    free(node);
+    node = next;
+  }
+}
+
+/**
+ * avl_cow_own - returns a node the caller may modify in place of @node
+ *
+ * @node: node to modify, to whose copy the link of the caller is moved if any other link refers to @node
+ */
+static inline struct avl_cow_node *avl_cow_own(struct avl_cow_node *node) {
+  if (__atomic_load_n(&node->refcount, __ATOMIC_ACQUIRE) == 1)
+    return node;
+
+  struct avl_cow_node *copy = avl_cow_alloc(node->key, node->value);
+  copy->left                = avl_cow_get(node->left);
+  copy->right               = avl_cow_get(node->right);
+  copy->height              = node->height;
+  avl_cow_put(node);
+  return copy;
+}
+
+/**
+ * avl_cow_rotate_left - rotates subtree rooted with @node counterclockwise
+ *
+ * @node: owned root node of subtree
+ *
+ * Returns the new root node of subtree.
+ */
+static inline struct avl_cow_node *avl_cow_rotate_left(struct avl_cow_node *node) {
+  struct avl_cow_node *rchild = avl_cow_own(node->right);
+  node->right                 = rchild->left;
+  rchild->left                = node;
+  node->height                = 1 + max(avl_cow_height(node->left), avl_cow_height(node->right));
+  rchild->height              = 1 + max(avl_cow_height(rchild->left), avl_cow_height(rchild->right));
+  return rchild;
+}
+
+/**
+ * avl_cow_rotate_right - rotates subtree rooted with @node clockwise
+ *
+ * @node: owned root node of subtree
+ *
+ * Returns the new root node of subtree.
+ */
+static inline struct avl_cow_node *avl_cow_rotate_right(struct avl_cow_node *node) {
+  struct avl_cow_node *lchild = avl_cow_own(node->left);
+  node->left                  = lchild->right;
+  lchild->right               = node;
+  node->height                = 1 + max(avl_cow_height(node->left), avl_cow_height(node->right));
+  lchild->height              = 1 + max(avl_cow_height(lchild->left), avl_cow_height(lchild->right));
+  return lchild;
+}
+
+/**
+ * avl_cow_rebalance - updates the height of @node, rebalancing subtree rooted with @node if unbalanced
+ *
+ * @node: owned root node of subtree
+ *
+ * Returns the new root node of subtree.
+ */
+static inline struct avl_cow_node *avl_cow_rebalance(struct avl_cow_node *node) {
+  node->height = 1 + max(avl_cow_height(node->left), avl_cow_height(node->right));
+
+  if (1 + avl_cow_height(node->right) < avl_cow_height(node->left)) {
+    if (avl_cow_height(node->left->left) < avl_cow_height(node->left->right)) /* case of Left Right */
+      node->left = avl_cow_rotate_left(avl_cow_own(node->left));
+    return avl_cow_rotate_right(node);                                        /* case of Left Left */
+  }
+
+  if (1 + avl_cow_height(node->left) < avl_cow_height(node->right)) {
+    if (avl_cow_height(node->right->right) < avl_cow_height(node->right->left)) /* case of Right Left */
+      node->right = avl_cow_rotate_right(avl_cow_own(node->right));
+    return avl_cow_rotate_left(node);                                           /* case of Right Right */
+  }
+
+  return node;
+}
+
+/**
+ * avl_cow_insert_subtree - inserts an entry into subtree rooted with @node, copying the shared nodes on the path
+ *
+ * @node:  root node of subtree, which does not contain @key
+ * @key:   the key of the entry to insert
+ * @value: the value of the entry to insert
+ * @less:  operator defining the (partial) node order
+ *
+ * Returns the new root node of subtree.
+ */
+static struct avl_cow_node *avl_cow_insert_subtree(struct avl_cow_node *node, const void *restrict key, void *restrict value, bool (*less)(const void *restrict, const void *restrict)) {
+  if (node == NULL)
+    return avl_cow_alloc(key, value);
+
+  node = avl_cow_own(node);
+
+  if (less(key, node->key)) node->left  = avl_cow_insert_subtree(node->left, key, value, less);
+  else                      node->right = avl_cow_insert_subtree(node->right, key, value, less);
+
+  return avl_cow_rebalance(node);
+}
+
+/**
+ * avl_cow_erase_min - removes the leftmost entry from subtree rooted with @node, copying the shared nodes on the path
+ *
+ * @node:  non-empty root node of subtree
+ * @key:   the address to store the key of the removed entry
+ * @value: the address to store the value of the removed entry
+ *
+ * Returns the new root node of subtree.
+ */
+static struct avl_cow_node *avl_cow_erase_min(struct avl_cow_node *node, const void **restrict key, void **restrict value) {
+  register struct avl_cow_node *child;
+
+  node = avl_cow_own(node);
+
+  if (node->left == NULL) {
+    *key   = node->key;
+    *value = node->value;
+    child  = node->right;
+    free(node);
+    return child;
+  }
+
+  node->left = avl_cow_erase_min(node->left, key, value);
+
+  return avl_cow_rebalance(node);
+}
+
+/**
+ * avl_cow_erase_subtree - removes the entry with @key from subtree rooted with @node, copying the shared nodes on the path
+ *
+ * @node:   root node of subtree, which contains @key
+ * @key:    the key of the entry to remove
+ * @less:   operator defining the (partial) node order
+ * @erased: the address to store the value of the removed entry
+ *
+ * Returns the new root node of subtree.
+ */
+static struct avl_cow_node *avl_cow_erase_subtree(struct avl_cow_node *node, const void *restrict key, bool (*less)(const void *restrict, const void *restrict), void **restrict erased) {
+  register struct avl_cow_node *child;
+
+  node = avl_cow_own(node);
+
+  if (less(key, node->key)) {
+    node->left = avl_cow_erase_subtree(node->left, key, less, erased);
+  } else if (less(node->key, key)) {
+    node->right = avl_cow_erase_subtree(node->right, key, less, erased);
+  } else {
+    *erased = node->value;
+
+    if (node->left == NULL || node->right == NULL) { /* case of degree 0 or 1 */
+      child = node->left == NULL ? node->right : node->left;
+      free(node);
+      return child;
+    }
+
+    node->right = avl_cow_erase_min(node->right, &node->key, &node->value); /* case of degree 2 */
+  }
+
+  return avl_cow_rebalance(node);
+}
+
+/**
+ * avl_cow_traverse - applies @func to each entry of subtree rooted with @node in ascending order
+ *
+ * @node: root node of subtree
+ * @func: function to apply to each entry
+ */
+static void avl_cow_traverse(const struct avl_cow_node *node, void (*func)(const void *restrict, void *restrict)) {
+  while (node != NULL) {
+    avl_cow_traverse(node->left, func);
+    func(node->key, node->value);
+    node = node->right;
+  }
+}
+
 extern struct avl_iter avl_find(const struct avl_root tree, const void *key) {
   register struct avl_node *pivot = tree.root;
 
@@ -290,6 +981,9 @@ extern void *avl_erase(struct avl_root *restrict tree, const void *restrict key)
     }
   }
 
+  if (parent == NULL && tree->root != NULL)                         /* case of root */
+    tree->root->tree = tree;
+
   --tree->size;
 
   free(pivot);
@@ -312,6 +1006,389 @@ extern void avl_clear(struct avl_root *tree) {
   tree->size = 0;
 }
 
+extern void avl_clone(struct avl_root *restrict tree, const struct avl_root other) {
+  register size_t          head;
+  register size_t          tail;
+  register struct avl_node *node;
+
+  if (other.root == NULL)
+    return;
+
+  struct avl_node **queue = malloc(__SIZEOF_POINTER__*other.size);
+  queue[0] = tree->root = avl_copy(other.root, NULL, tree);
+
+  for (head = 0, tail = 1; head < tail; ++head) {
+    node = queue[head];
+    if (node->left != NULL)  queue[tail++] = node->left  = avl_copy(node->left, node, tree);
+    if (node->right != NULL) queue[tail++] = node->right = avl_copy(node->right, node, tree);
+  }
+
+  free(queue);
+  tree->size = other.size;
+}
+
+/**
+ * avl_discard - erases all entries in the subtree of @node read from @serial, releasing their keys and values
+ *
+ * @node:   root node of the subtree
+ * @serial: the state of the dump the entries were read from
+ */
+static void avl_discard(struct avl_node *restrict node, struct serial *restrict serial) {
+  register struct avl_node *next;
+
+  while (node != NULL) {
+    avl_discard(node->right, serial);
+    next = node->left;
+    serial_release_entry(serial, node->key, node->value);
+    free(node);
+    node = next;
+  }
+}
+
+/**
+ * avl_build - builds a subtree of @nmemb entries read from @serial, midway split at each node
+ *
+ * @tree:   the tree to which the subtree belongs
+ * @parent: the parent of the subtree
+ * @nmemb:  the number of the entries of the subtree
+ * @serial: the state of the dump to read the entries from
+ * @ok:     set to false if an entry cannot be read, in which case the subtree is freed along with its keys and values
+ *
+ * As the entries are split midway, the heights of the two subtrees of each node differ by at most one.
+ */
+static struct avl_node *avl_build(struct avl_root *restrict tree, struct avl_node *restrict parent, const size_t nmemb, struct serial *restrict serial, bool *restrict ok) {
+  register struct avl_node *node;
+  register struct avl_node *left;
+           const void      *key;
+           void            *value;
+
+  if (nmemb == 0 || !*ok) return NULL;
+
+  left = avl_build(tree, NULL, (nmemb-1)/2, serial, ok);
+  if (!*ok || !(*ok = serial_read_entry(serial, &key, &value))) {
+    avl_discard(left, serial);
+    return NULL;
+  }
+
+  node       = avl_alloc(key, value, parent, tree);
+  node->left = left;
+  if (left != NULL) left->parent = node;
+
+  node->right = avl_build(tree, node, nmemb-1 - (nmemb-1)/2, serial, ok);
+  if (!*ok) {
+    avl_discard(node, serial);
+    return NULL;
+  }
+
+  node->height = 1 + max(avl_height(node->left), avl_height(node->right));
+
+  return node;
+}
+
+extern bool avl_dump(const struct avl_root tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  struct serial serial = serial_init(stream, keys, values);
+  bool          ok     = serial_write_word(&serial, tree.size);
+
+  for (struct avl_iter iter = avl_iter_init(tree); ok && !avl_iter_end(iter); avl_iter_next(&iter))
+    ok = serial_write_entry(&serial, iter.key, iter.value);
+
+  serial_destroy(&serial);
+
+  return ok;
+}
+
+extern bool avl_restore(struct avl_root *restrict tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  struct serial serial = serial_init(stream, keys, values);
+  uint64_t      nmemb;
+  bool          ok     = true;
+
+  /* case of non-empty tree: its entries would be lost */
+  if (tree->root != NULL || !serial_read_word(&serial, &nmemb)) return false;
+
+  tree->root = avl_build(tree, NULL, nmemb, &serial, &ok);
+  tree->size = ok ? nmemb : 0;
+
+  serial_destroy(&serial);
+
+  return ok;
+}
+
+extern bool avl_join(struct avl_root *restrict tree, struct avl_root *restrict other) {
+  register struct avl_node *lhs;
+  register struct avl_node *rhs;
+
+  if (other->root == NULL)
+    return true;
+
+  if (tree->root == NULL) {
+    tree->root       = other->root;
+    tree->root->tree = tree;
+    tree->size       = other->size;
+    other->root      = NULL;
+    other->size      = 0;
+    return true;
+  }
+
+  for (lhs = tree->root; lhs->right != NULL; lhs = lhs->right);
+  for (rhs = other->root; rhs->left != NULL; rhs = rhs->left);
+
+  struct avl_root *lower = tree;
+  struct avl_root *upper = other;
+
+  if (!tree->less(lhs->key, rhs->key)) {
+    for (lhs = other->root; lhs->right != NULL; lhs = lhs->right);
+    for (rhs = tree->root; rhs->left != NULL; rhs = rhs->left);
+
+    if (!tree->less(lhs->key, rhs->key))
+      return false;
+
+    lower = other;
+    upper = tree;
+  }
+
+  const size_t size = tree->size + other->size;
+
+  avl_join2(tree, lower->root, upper->root);
+
+  tree->size  = size;
+  other->root = NULL;
+  other->size = 0;
+
+  return true;
+}
+
+extern void avl_split(struct avl_root *restrict tree, const void *restrict key, struct avl_root *restrict other) {
+  struct avl_root lhs  = avl_init(tree->less);
+  struct avl_root rhs  = avl_init(tree->less);
+  const  size_t   size = tree->size;
+
+  struct avl_node *found = avl_split_subtree(tree->root, key, tree->less, &lhs, &rhs);
+
+  if (found != NULL)
+    avl_join3(&rhs, NULL, found, rhs.root);
+
+  tree->root  = lhs.root;
+  other->root = rhs.root;
+  tree->size  = avl_count(lhs.root, rhs.root, size);
+  other->size = size - tree->size;
+
+  if (tree->root != NULL)  tree->root->tree  = tree;
+  if (other->root != NULL) other->root->tree = other;
+}
+
+extern void avl_union(struct avl_root *restrict tree, struct avl_root *restrict other) {
+  struct avl_root result = avl_init(tree->less);
+  const  size_t   size   = tree->size + other->size;
+
+  const size_t count = avl_union_subtree(&result, tree->root, other->root, avl_threads());
+
+  avl_adopt(tree, result.root);
+  tree->size  = size - count;
+  other->root = NULL;
+  other->size = 0;
+}
+
+extern void avl_intersection(struct avl_root *restrict tree, struct avl_root *restrict other) {
+  struct avl_root result = avl_init(tree->less);
+
+  const size_t count = avl_intersection_subtree(&result, tree->root, other->root, avl_threads());
+
+  avl_adopt(tree, result.root);
+  tree->size  = count;
+  other->root = NULL;
+  other->size = 0;
+}
+
+extern void avl_difference(struct avl_root *restrict tree, struct avl_root *restrict other) {
+  struct avl_root result = avl_init(tree->less);
+
+  const size_t count = avl_difference_subtree(&result, tree->root, other->root, avl_threads());
+
+  avl_adopt(tree, result.root);
+  tree->size -= count;
+  other->root = NULL;
+  other->size = 0;
+}
+
+extern void *avl_rcu_find(const struct avl_root *tree, const void *key) {
+  register struct avl_node *pivot = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key))      pivot = __atomic_load_n(&pivot->left, __ATOMIC_ACQUIRE);
+    else if (tree->less(pivot->key, key)) pivot = __atomic_load_n(&pivot->right, __ATOMIC_ACQUIRE);
+    else                                  return pivot->value;
+  }
+
+  return NULL;
+}
+
+extern bool avl_rcu_contains(const struct avl_root *tree, const void *key) {
+  register struct avl_node *pivot = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key))      pivot = __atomic_load_n(&pivot->left, __ATOMIC_ACQUIRE);
+    else if (tree->less(pivot->key, key)) pivot = __atomic_load_n(&pivot->right, __ATOMIC_ACQUIRE);
+    else                                  return true;
+  }
+
+  return false;
+}
+
+extern bool avl_rcu_insert(struct avl_root *restrict tree, const void *restrict key, void *restrict value, struct epoch_root *restrict epoch) {
+  register struct avl_node *parent = NULL;
+  register struct avl_node *pivot  = tree->root;
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key)) {
+      parent = pivot;
+      pivot  = pivot->left;
+    } else if (tree->less(pivot->key, key)) {
+      parent = pivot;
+      pivot  = pivot->right;
+    } else {
+      return false;
+    }
+  }
+
+  struct avl_node *node = avl_alloc(key, value, parent, tree);
+
+  if (parent == NULL)                    __atomic_store_n(&tree->root, node, __ATOMIC_RELEASE);
+  else if (tree->less(key, parent->key)) __atomic_store_n(&parent->left, node, __ATOMIC_RELEASE);
+  else                                   __atomic_store_n(&parent->right, node, __ATOMIC_RELEASE);
+
+  ++tree->size;
+
+  avl_rcu_retrace(tree, parent, epoch);
+
+  return true;
+}
+
+extern void *avl_rcu_erase(struct avl_root *restrict tree, const void *restrict key, struct epoch_root *restrict epoch) {
+  register struct avl_node *child;
+  register struct avl_node *parent = NULL;
+  register struct avl_node *pivot  = tree->root;
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key)) {
+      parent = pivot;
+      pivot  = pivot->left;
+    } else if (tree->less(pivot->key, key)) {
+      parent = pivot;
+      pivot  = pivot->right;
+    } else {
+      break;
+    }
+  }
+
+  if (pivot == NULL)
+    return NULL;
+
+  void *erased = pivot->value;
+
+  if (pivot->left != NULL && pivot->right != NULL) { /* case of degree 2 */
+    if (avl_height(pivot->left) < avl_height(pivot->right))
+      for (child = pivot->right; child->left != NULL; child = child->left);
+    else
+      for (child = pivot->left; child->right != NULL; child = child->right);
+
+    /*
+     * The key of @pivot cannot be overwritten in place under the readers,
+     * so that a copy of @pivot holding the entry of @child takes its place instead.
+     * A reader that passed @pivot before may still be heading for @child,
+     * which thus stays linked until such readers leave.
+     */
+    struct avl_node *copy = avl_copy(pivot, parent, tree);
+    copy->key             = child->key;
+    copy->value           = child->value;
+    copy->left->parent    = copy;
+    copy->right->parent   = copy;
+    avl_rcu_link(tree, parent, pivot, copy);
+    epoch_retire(epoch, pivot);
+
+    parent = child->parent;
+    pivot  = child;
+
+    if (parent != copy)
+      epoch_synchronize(epoch);
+  }
+
+  child = pivot->left == NULL ? pivot->right : pivot->left; /* case of degree 0 or 1 */
+  avl_rcu_link(tree, parent, pivot, child);
+
+  if (child != NULL) {
+    child->parent = parent;
+    child->tree   = tree;
+  }
+
+  --tree->size;
+
+  epoch_retire(epoch, pivot);
+  avl_rcu_retrace(tree, parent, epoch);
+
+  return erased;
+}
+
+extern void *avl_cow_find(const struct avl_cow_root tree, const void *key) {
+  register const struct avl_cow_node *pivot = tree.root;
+
+  while (pivot != NULL) {
+    if (tree.less(key, pivot->key))      pivot = pivot->left;
+    else if (tree.less(pivot->key, key)) pivot = pivot->right;
+    else                                 return pivot->value;
+  }
+
+  return NULL;
+}
+
+extern bool avl_cow_contains(const struct avl_cow_root tree, const void *key) {
+  register const struct avl_cow_node *pivot = tree.root;
+
+  while (pivot != NULL) {
+    if (tree.less(key, pivot->key))      pivot = pivot->left;
+    else if (tree.less(pivot->key, key)) pivot = pivot->right;
+    else                                 return true;
+  }
+
+  return false;
+}
+
+extern bool avl_cow_insert(struct avl_cow_root *restrict tree, const void *restrict key, void *restrict value) {
+  /* the path is copied only once the key is known to be absent */
+  if (avl_cow_contains(*tree, key))
+    return false;
+
+  tree->root = avl_cow_insert_subtree(tree->root, key, value, tree->less);
+  ++tree->size;
+
+  return true;
+}
+
+extern void *avl_cow_erase(struct avl_cow_root *restrict tree, const void *restrict key) {
+  void *erased = NULL;
+
+  if (!avl_cow_contains(*tree, key))
+    return NULL;
+
+  tree->root = avl_cow_erase_subtree(tree->root, key, tree->less, &erased);
+  --tree->size;
+
+  return erased;
+}
+
+extern struct avl_cow_root avl_cow_snapshot(const struct avl_cow_root tree) {
+  struct avl_cow_root snapshot = tree;
+  avl_cow_get(snapshot.root);
+  return snapshot;
+}
+
+extern void avl_cow_release(struct avl_cow_root *tree) {
+  avl_cow_put(tree->root);
+  tree->root = NULL;
+  tree->size = 0;
+}
+
+extern void avl_cow_for_each(const struct avl_cow_root tree, void (*func)(const void *restrict, void *restrict)) { avl_cow_traverse(tree.root, func); }
+
 extern struct avl_iter avl_iter_init(const struct avl_root tree) {
   register struct avl_node *pivot = tree.root;
 
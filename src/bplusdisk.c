@@ -0,0 +1,944 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * bplusdisk.c - disk-resident B+-tree definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/bplusdisk.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The layout of the pages, in which each field takes a 64-bit word
+ * and each key or value record is padded to a multiple of 8 bytes:
+ *
+ *    internal node: nmemb | type | children[internal] | keys[internal-1]
+ *    external node: nmemb | prev | next               | keys[external] | values[external]
+ *    free page:     next free page
+ *
+ * The type of an internal node tells whether its children are external nodes.
+ */
+
+/**
+ * bplus_disk_stride - returns the size of the slot of a record of @size
+ *
+ * @size: the size of a record
+ */
+static inline size_t bplus_disk_stride(const size_t size) { return (size+7) & ~(size_t)7; }
+
+/**
+ * bplus_disk_children - returns the children of the internal node @node
+ *
+ * @node: the internal node
+ */
+static inline uint64_t *bplus_disk_children(uint64_t *restrict node) { return node+2; }
+
+/**
+ * bplus_disk_internal_keys - returns the key records of the internal node @node of @tree
+ *
+ * @tree: the tree to which @node belongs
+ * @node: the internal node
+ */
+static inline unsigned char *bplus_disk_internal_keys(const struct bplus_disk_root *restrict tree, uint64_t *restrict node) { return (unsigned char *)(node+2+tree->internal); }
+
+/**
+ * bplus_disk_external_keys - returns the key records of the external node @node
+ *
+ * @node: the external node
+ */
+static inline unsigned char *bplus_disk_external_keys(uint64_t *restrict node) { return (unsigned char *)(node+3); }
+
+/**
+ * bplus_disk_values - returns the value records of the external node @node of @tree
+ *
+ * @tree: the tree to which @node belongs
+ * @node: the external node
+ */
+static inline unsigned char *bplus_disk_values(const struct bplus_disk_root *restrict tree, uint64_t *restrict node) {
+  return bplus_disk_external_keys(node) + bplus_disk_stride(tree->meta.key_size)*tree->external;
+}
+
+/**
+ * bplus_disk_separator - returns the buffer holding the separator passed up by a split
+ *
+ * @tree: the tree to which the buffer belongs
+ */
+static inline unsigned char *bplus_disk_separator(const struct bplus_disk_root *restrict tree) { return tree->scratch + (tree->pool.page_size<<1); }
+
+/**
+ * __bsearch - do a binary search for @key in the @nmemb records from @base, using the operator of @tree to perform the comparisons
+ *
+ * @tree:  the tree to which the records belong
+ * @key:   the key record to search for
+ * @base:  where to search @key
+ * @nmemb: number of records in @base
+ */
+static inline size_t __bsearch(const struct bplus_disk_root *restrict tree, const void *restrict key, const unsigned char *restrict base, const size_t nmemb) {
+  register const size_t stride = bplus_disk_stride(tree->meta.key_size);
+  register       size_t idx;
+  register       size_t lo     = 0;
+  register       size_t hi     = nmemb;
+
+  while (lo < hi) {
+    idx = (lo+hi)>>1;
+    if (tree->less(key, base + stride*idx))      hi = idx;
+    else if (tree->less(base + stride*idx, key)) lo = idx+1;
+    else                                         return idx;
+  }
+
+  return lo;
+}
+
+/**
+ * bplus_disk_equal - checks if the record at @idx of @base, which consists of @nmemb records, equals @key
+ *
+ * @tree:  the tree to which the records belong
+ * @key:   the key record to compare
+ * @base:  the records
+ * @nmemb: number of records in @base
+ * @idx:   the index returned by __bsearch
+ */
+static inline bool bplus_disk_equal(const struct bplus_disk_root *restrict tree, const void *restrict key, const unsigned char *restrict base, const size_t nmemb, const size_t idx) {
+  register const unsigned char *pivot = base + bplus_disk_stride(tree->meta.key_size)*idx;
+
+  return idx < nmemb && !(tree->less(key, pivot) || tree->less(pivot, key));
+}
+
+/**
+ * bplus_disk_frames - returns the number of the frames an update of a tree of @height may pin at once
+ *
+ * @height: the number of the internal levels
+ *
+ * A split pins the path from the root, the right neighbour of the external node,
+ * and a new page for each node of the path along with a new root.
+ */
+static inline size_t bplus_disk_frames(const size_t height) { return 2*height+4; }
+
+/**
+ * bplus_disk_alloc - pins a zeroed page for a new node, reusing a free page if any
+ *
+ * @tree: tree to allocate the page of
+ * @page: where to store the number of the page
+ *
+ * Returns NULL if the page cannot be pinned.
+ */
+static inline uint64_t *bplus_disk_alloc(struct bplus_disk_root *restrict tree, uint64_t *restrict page) {
+  register uint64_t *node;
+
+  if (tree->meta.free == 0) {
+    if ((node = pool_create(&tree->pool, tree->meta.pages)) != NULL) *page = tree->meta.pages++;
+    return node;
+  }
+
+  if ((node = pool_fetch(&tree->pool, tree->meta.free)) == NULL) return NULL;
+
+  *page           = tree->meta.free;
+  tree->meta.free = node[0];
+  memset(node, 0, tree->pool.page_size);
+
+  return node;
+}
+
+/**
+ * bplus_disk_release - unpins the page of @node and puts it on the list of free pages
+ *
+ * @tree: tree to which the page belongs
+ * @page: the number of the page
+ * @node: the pinned page
+ */
+static inline void bplus_disk_release(struct bplus_disk_root *restrict tree, const uint64_t page, uint64_t *restrict node) {
+  node[0]         = tree->meta.free;
+  tree->meta.free = page;
+  pool_unpin(&tree->pool, node, true);
+}
+
+/**
+ * bplus_disk_neighbour - pins the external node at @page, if any
+ *
+ * @tree: tree to which the node belongs
+ * @page: the number of the page of the node, or zero for none
+ * @node: where to store the pinned page, or NULL if @page is zero
+ *
+ * Returns false if the page cannot be pinned.
+ */
+static inline bool bplus_disk_neighbour(struct bplus_disk_root *restrict tree, const uint64_t page, uint64_t **restrict node) {
+  *node = NULL;
+  return page == 0 || (*node = pool_fetch(&tree->pool, page)) != NULL;
+}
+
+/**
+ * struct bplus_disk_split - the pages reserved for a split, from the external node up to the new root
+ *
+ * @pages: the numbers of the pages
+ * @nodes: the pinned pages
+ * @count: the number of the pages
+ * @next:  the index of the next page to take
+ */
+struct bplus_disk_split {
+  uint64_t pages[__SIZEOF_POINTER__*8+2];
+  uint64_t *nodes[__SIZEOF_POINTER__*8+2];
+  size_t   count;
+  size_t   next;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_disk_reserve - pins @count zeroed pages for a split
+ *
+ * @tree:  tree to allocate the pages of
+ * @split: where to store the pages
+ * @count: the number of the pages
+ *
+ * Returns false if the pages cannot be pinned, putting the ones pinned so far on the list of free pages.
+ */
+static inline bool bplus_disk_reserve(struct bplus_disk_root *restrict tree, struct bplus_disk_split *restrict split, const size_t count) {
+  for (split->count = 0, split->next = 0; split->count < count; ++split->count)
+    if ((split->nodes[split->count] = bplus_disk_alloc(tree, &split->pages[split->count])) == NULL) {
+      while (0 < split->count--)
+        bplus_disk_release(tree, split->pages[split->count], split->nodes[split->count]);
+      return false;
+    }
+
+  return true;
+}
+
+/**
+ * bplus_disk_take - takes the next page reserved by @split
+ *
+ * @split: the pages reserved for the split
+ * @page:  where to store the number of the page
+ */
+static inline uint64_t *bplus_disk_take(struct bplus_disk_split *restrict split, uint64_t *restrict page) {
+  *page = split->pages[split->next];
+  return split->nodes[split->next++];
+}
+
+/**
+ * bplus_disk_external_put - inserts an element into the external node at @page, splitting it if full
+ *
+ * @tree:   tree to insert element into
+ * @page:   the number of the page of the node
+ * @key:    the key record of the element
+ * @value:  the value record of the element
+ * @assign: whether to assign @value if @key already exists
+ * @above:  the number of the pages the split of the node takes above it, one per full ancestor and one for a new root
+ * @split:  where to reserve the pages of the split
+ * @right:  where to store the page of the right node split off
+ *
+ * Every page a split changes or allocates, up to the new root, is pinned before the node is changed,
+ * so that a failure leaves the tree as it was.
+ *
+ * Returns -1 on failure, 0 if @key already exists, 1 on insertion,
+ * or 2 on insertion with a split, passing the separator up in the separator buffer.
+ */
+static inline int bplus_disk_external_put(struct bplus_disk_root *restrict tree, const uint64_t page, const void *restrict key, const void *restrict value, const bool assign,
+                                          const size_t above, struct bplus_disk_split *restrict split, uint64_t *restrict right) {
+  register const size_t        key_stride   = bplus_disk_stride(tree->meta.key_size);
+  register const size_t        value_stride = bplus_disk_stride(tree->meta.value_size);
+  register       uint64_t      *node        = pool_fetch(&tree->pool, page);
+  register       uint64_t      *sibling;
+  register       unsigned char *keys;
+  register       unsigned char *values;
+  register       size_t        idx;
+  register       size_t        nmemb;
+  register       size_t        half;
+                 uint64_t      *next;
+
+  if (node == NULL) return -1;
+
+  keys   = bplus_disk_external_keys(node);
+  values = bplus_disk_values(tree, node);
+  nmemb  = node[0];
+  idx    = __bsearch(tree, key, keys, nmemb);
+
+  /* case of an existing key */
+  if (bplus_disk_equal(tree, key, keys, nmemb, idx)) {
+    if (assign) memcpy(values + value_stride*idx, value, tree->meta.value_size);
+    pool_unpin(&tree->pool, node, assign);
+    return 0;
+  }
+
+  /* case of a non-full node */
+  if (nmemb < tree->external) {
+    memmove(keys + key_stride*(idx+1), keys + key_stride*idx, key_stride*(nmemb-idx));
+    memmove(values + value_stride*(idx+1), values + value_stride*idx, value_stride*(nmemb-idx));
+    memcpy(keys + key_stride*idx, key, tree->meta.key_size);
+    memcpy(values + value_stride*idx, value, tree->meta.value_size);
+    ++node[0];
+    pool_unpin(&tree->pool, node, true);
+    return 1;
+  }
+
+  if (!bplus_disk_neighbour(tree, node[2], &next)) {
+    pool_unpin(&tree->pool, node, false);
+    return -1;
+  }
+
+  if (!bplus_disk_reserve(tree, split, 1+above)) {
+    if (next != NULL) pool_unpin(&tree->pool, next, false);
+    pool_unpin(&tree->pool, node, false);
+    return -1;
+  }
+
+  sibling = bplus_disk_take(split, right);
+
+  /* merge the element into a copy of the node, then share the copy between the node and its new right sibling */
+  {
+    unsigned char *merged_keys   = tree->scratch;
+    unsigned char *merged_values = tree->scratch + key_stride*(nmemb+1);
+
+    memcpy(merged_keys, keys, key_stride*idx);
+    memcpy(merged_keys + key_stride*idx, key, tree->meta.key_size);
+    memcpy(merged_keys + key_stride*(idx+1), keys + key_stride*idx, key_stride*(nmemb-idx));
+    memcpy(merged_values, values, value_stride*idx);
+    memcpy(merged_values + value_stride*idx, value, tree->meta.value_size);
+    memcpy(merged_values + value_stride*(idx+1), values + value_stride*idx, value_stride*(nmemb-idx));
+
+    half = (nmemb+2)>>1;
+    memcpy(keys, merged_keys, key_stride*half);
+    memcpy(values, merged_values, value_stride*half);
+    memcpy(bplus_disk_external_keys(sibling), merged_keys + key_stride*half, key_stride*(nmemb+1-half));
+    memcpy(bplus_disk_values(tree, sibling), merged_values + value_stride*half, value_stride*(nmemb+1-half));
+  }
+
+  node[0]    = half;
+  sibling[0] = nmemb+1-half;
+  sibling[1] = page;
+  sibling[2] = node[2];
+
+  if (next == NULL) {
+    tree->meta.tail = *right;
+  } else {
+    next[1] = *right;
+    pool_unpin(&tree->pool, next, true);
+  }
+  node[2] = *right;
+
+  memcpy(bplus_disk_separator(tree), keys + key_stride*(half-1), key_stride);
+  pool_unpin(&tree->pool, sibling, true);
+  pool_unpin(&tree->pool, node, true);
+
+  return 2;
+}
+
+/**
+ * bplus_disk_internal_put - inserts an element into the subtree of the internal node at @page
+ *
+ * @tree:   tree to insert element into
+ * @page:   the number of the page of the node
+ * @level:  the level of the node, where the parents of the external nodes are at level 1
+ * @key:    the key record of the element
+ * @value:  the value record of the element
+ * @assign: whether to assign @value if @key already exists
+ * @above:  the number of the pages the split of the node takes above it, one per full ancestor and one for a new root
+ * @split:  where to reserve the pages of the split
+ * @right:  where to store the page of the right node split off
+ *
+ * The node stays pinned while its subtree is changed, so that its own split takes no page but the one reserved for it.
+ *
+ * Returns the same as bplus_disk_external_put.
+ */
+static int bplus_disk_internal_put(struct bplus_disk_root *restrict tree, const uint64_t page, const size_t level, const void *restrict key, const void *restrict value, const bool assign,
+                                   const size_t above, struct bplus_disk_split *restrict split, uint64_t *restrict right) {
+  register const size_t        key_stride = bplus_disk_stride(tree->meta.key_size);
+  register       uint64_t      *node      = pool_fetch(&tree->pool, page);
+  register       uint64_t      *sibling;
+  register       uint64_t      *children;
+  register       unsigned char *keys;
+  register       size_t        idx;
+  register       size_t        nmemb;
+  register       size_t        half;
+  register       int           status;
+  register       bool          full;
+                 uint64_t      child;
+
+  if (node == NULL) return -1;
+
+  children = bplus_disk_children(node);
+  keys     = bplus_disk_internal_keys(tree, node);
+  nmemb    = node[0];
+  idx      = __bsearch(tree, key, keys, nmemb);
+  /* the node splits along with the child only if it is full */
+  full     = tree->internal <= nmemb+1;
+
+  status = level == 1 ? bplus_disk_external_put(tree, children[idx], key, value, assign, full ? above+1 : 0, split, &child)
+                      : bplus_disk_internal_put(tree, children[idx], level-1, key, value, assign, full ? above+1 : 0, split, &child);
+
+  if (status != 2) {
+    pool_unpin(&tree->pool, node, false);
+    return status;
+  }
+
+  /* case of a non-full node */
+  if (!full) {
+    memmove(keys + key_stride*(idx+1), keys + key_stride*idx, key_stride*(nmemb-idx));
+    memmove(children+idx+2, children+idx+1, sizeof(uint64_t)*(nmemb-idx));
+    memcpy(keys + key_stride*idx, bplus_disk_separator(tree), key_stride);
+    children[idx+1] = child;
+    ++node[0];
+    pool_unpin(&tree->pool, node, true);
+    return 1;
+  }
+
+  sibling = bplus_disk_take(split, right);
+
+  /* merge the separator into a copy of the node, then push the median up and share the rest with the new right sibling */
+  {
+    unsigned char *merged_keys     = tree->scratch;
+    uint64_t      *merged_children = (uint64_t *)(tree->scratch + key_stride*(nmemb+1));
+
+    memcpy(merged_keys, keys, key_stride*idx);
+    memcpy(merged_keys + key_stride*idx, bplus_disk_separator(tree), key_stride);
+    memcpy(merged_keys + key_stride*(idx+1), keys + key_stride*idx, key_stride*(nmemb-idx));
+    memcpy(merged_children, children, sizeof(uint64_t)*(idx+1));
+    merged_children[idx+1] = child;
+    memcpy(merged_children+idx+2, children+idx+1, sizeof(uint64_t)*(nmemb-idx));
+
+    half = (nmemb+1)>>1;
+    memcpy(keys, merged_keys, key_stride*half);
+    memcpy(children, merged_children, sizeof(uint64_t)*(half+1));
+    memcpy(bplus_disk_internal_keys(tree, sibling), merged_keys + key_stride*(half+1), key_stride*(nmemb-half));
+    memcpy(bplus_disk_children(sibling), merged_children+half+1, sizeof(uint64_t)*(nmemb+1-half));
+    memcpy(bplus_disk_separator(tree), merged_keys + key_stride*half, key_stride);
+  }
+
+  node[0]    = half;
+  sibling[0] = nmemb-half;
+  sibling[1] = node[1];
+
+  pool_unpin(&tree->pool, sibling, true);
+  pool_unpin(&tree->pool, node, true);
+
+  return 2;
+}
+
+/**
+ * bplus_disk_put - inserts an element into @tree
+ *
+ * @tree:   tree to insert element into
+ * @key:    the key record of the element
+ * @value:  the value record of the element
+ * @assign: whether to assign @value if @key already exists
+ *
+ * Returns -1 on failure, in which case @tree is left as it was, 0 if @key already exists, or 1 on insertion.
+ */
+static inline int bplus_disk_put(struct bplus_disk_root *restrict tree, const void *restrict key, const void *restrict value, const bool assign) {
+  register uint64_t                *node;
+  register int                     status;
+           uint64_t                page;
+           uint64_t                right;
+           struct bplus_disk_split split;
+
+  /* case of an empty tree */
+  if (tree->meta.root == 0) {
+    if ((node = bplus_disk_alloc(tree, &page)) == NULL) return -1;
+    node[0] = 1;
+    memcpy(bplus_disk_external_keys(node), key, tree->meta.key_size);
+    memcpy(bplus_disk_values(tree, node), value, tree->meta.value_size);
+    pool_unpin(&tree->pool, node, true);
+    tree->meta.root = tree->meta.head = tree->meta.tail = page;
+    tree->meta.size = 1;
+    return 1;
+  }
+
+  /* case of a budget too small to pin a split along the whole path */
+  if (tree->pool.nframes < bplus_disk_frames(tree->meta.height)) return -1;
+
+  status = tree->meta.height == 0 ? bplus_disk_external_put(tree, tree->meta.root, key, value, assign, 1, &split, &right)
+                                  : bplus_disk_internal_put(tree, tree->meta.root, tree->meta.height, key, value, assign, 1, &split, &right);
+
+  if (status <= 0) return status;
+
+  /* case of a root split: grow the new root reserved for it */
+  if (status == 2) {
+    node = bplus_disk_take(&split, &page);
+
+    node[0]                      = 1;
+    node[1]                      = tree->meta.height == 0;
+    bplus_disk_children(node)[0] = tree->meta.root;
+    bplus_disk_children(node)[1] = right;
+    memcpy(bplus_disk_internal_keys(tree, node), bplus_disk_separator(tree), bplus_disk_stride(tree->meta.key_size));
+    pool_unpin(&tree->pool, node, true);
+    tree->meta.root = page;
+    ++tree->meta.height;
+  }
+
+  ++tree->meta.size;
+
+  return 1;
+}
+
+/**
+ * bplus_disk_external_remove - removes the element with @key from the external node at @page
+ *
+ * @tree:  tree to remove the element from
+ * @page:  the number of the page of the node
+ * @key:   the key record of the element to remove
+ * @value: where to copy the value record of the removed element, or NULL
+ *
+ * Returns -1 on failure, 0 if there is no such element, 1 on removal,
+ * or 2 on removal that has emptied and freed the node.
+ */
+static inline int bplus_disk_external_remove(struct bplus_disk_root *restrict tree, const uint64_t page, const void *restrict key, void *restrict value) {
+  register const size_t        key_stride   = bplus_disk_stride(tree->meta.key_size);
+  register const size_t        value_stride = bplus_disk_stride(tree->meta.value_size);
+  register       uint64_t      *node        = pool_fetch(&tree->pool, page);
+  register       unsigned char *keys;
+  register       unsigned char *values;
+  register       size_t        idx;
+  register       size_t        nmemb;
+                 uint64_t      *prev;
+                 uint64_t      *next;
+
+  if (node == NULL) return -1;
+
+  keys   = bplus_disk_external_keys(node);
+  values = bplus_disk_values(tree, node);
+  nmemb  = node[0];
+  idx    = __bsearch(tree, key, keys, nmemb);
+
+  if (!bplus_disk_equal(tree, key, keys, nmemb, idx)) {
+    pool_unpin(&tree->pool, node, false);
+    return 0;
+  }
+
+  /* case of a node that stays non-empty */
+  if (1 < nmemb) {
+    if (value != NULL) memcpy(value, values + value_stride*idx, tree->meta.value_size);
+    memmove(keys + key_stride*idx, keys + key_stride*(idx+1), key_stride*(nmemb-idx-1));
+    memmove(values + value_stride*idx, values + value_stride*(idx+1), value_stride*(nmemb-idx-1));
+    --node[0];
+    pool_unpin(&tree->pool, node, true);
+    return 1;
+  }
+
+  /* both neighbours are pinned before the emptied node is unlinked from the leaf chain, so that a failure leaves the chain as it was */
+  if (!bplus_disk_neighbour(tree, node[1], &prev)) {
+    pool_unpin(&tree->pool, node, false);
+    return -1;
+  }
+  if (!bplus_disk_neighbour(tree, node[2], &next)) {
+    if (prev != NULL) pool_unpin(&tree->pool, prev, false);
+    pool_unpin(&tree->pool, node, false);
+    return -1;
+  }
+
+  if (value != NULL) memcpy(value, values, tree->meta.value_size);
+
+  if (prev == NULL) {
+    tree->meta.head = node[2];
+  } else {
+    prev[2] = node[2];
+    pool_unpin(&tree->pool, prev, true);
+  }
+  if (next == NULL) {
+    tree->meta.tail = node[1];
+  } else {
+    next[1] = node[1];
+    pool_unpin(&tree->pool, next, true);
+  }
+
+  bplus_disk_release(tree, page, node);
+
+  return 2;
+}
+
+/**
+ * bplus_disk_internal_remove - removes the element with @key from the subtree of the internal node at @page
+ *
+ * @tree:  tree to remove the element from
+ * @page:  the number of the page of the node
+ * @level: the level of the node, where the parents of the external nodes are at level 1
+ * @key:   the key record of the element to remove
+ * @value: where to copy the value record of the removed element, or NULL
+ *
+ * Returns the same as bplus_disk_external_remove.
+ */
+static int bplus_disk_internal_remove(struct bplus_disk_root *restrict tree, const uint64_t page, const size_t level, const void *restrict key, void *restrict value) {
+  register const size_t        key_stride = bplus_disk_stride(tree->meta.key_size);
+  register       uint64_t      *node      = pool_fetch(&tree->pool, page);
+  register       uint64_t      *children;
+  register       unsigned char *keys;
+  register       size_t        idx;
+  register       size_t        nmemb;
+  register       int           status;
+
+  if (node == NULL) return -1;
+
+  children = bplus_disk_children(node);
+  keys     = bplus_disk_internal_keys(tree, node);
+  nmemb    = node[0];
+  idx      = __bsearch(tree, key, keys, nmemb);
+
+  status = level == 1 ? bplus_disk_external_remove(tree, children[idx], key, value)
+                      : bplus_disk_internal_remove(tree, children[idx], level-1, key, value);
+
+  if (status != 2) {
+    pool_unpin(&tree->pool, node, false);
+    return status;
+  }
+
+  /* case of the last child freed */
+  if (nmemb == 0) {
+    bplus_disk_release(tree, page, node);
+    return 2;
+  }
+
+  /* drop the freed child along with the separator bounding it, merging its range into a neighbour */
+  if (idx < nmemb) memmove(keys + key_stride*idx, keys + key_stride*(idx+1), key_stride*(nmemb-idx-1));
+  memmove(children+idx, children+idx+1, sizeof(uint64_t)*(nmemb-idx));
+  --node[0];
+  pool_unpin(&tree->pool, node, true);
+
+  return 1;
+}
+
+extern bool bplus_disk_open(struct bplus_disk_root *restrict tree, const char *restrict path, const size_t page_size, const size_t budget,
+                            const size_t key_size, const size_t value_size, bool (*less)(const void *restrict, const void *restrict)) {
+  register const size_t key_stride   = bplus_disk_stride(key_size);
+  register const size_t value_stride = bplus_disk_stride(value_size);
+  register       void   *meta;
+
+  if (page_size < sizeof(struct bplus_disk_meta) || !pool_open(&tree->pool, path, page_size, budget)) return false;
+
+  tree->less     = less;
+  tree->internal = (page_size - sizeof(uint64_t)*2 + key_stride) / (sizeof(uint64_t) + key_stride);
+  tree->external = (page_size - sizeof(uint64_t)*3) / (key_stride + value_stride);
+
+  if (tree->internal < 3 || tree->external < 2 || tree->pool.nframes < bplus_disk_frames(0) || (meta = pool_fetch(&tree->pool, 0)) == NULL) {
+    pool_close(&tree->pool);
+    return false;
+  }
+
+  memcpy(&tree->meta, meta, sizeof(struct bplus_disk_meta));
+  pool_unpin(&tree->pool, meta, false);
+
+  /* case of an empty file */
+  if (tree->meta.magic[0] == '\0') {
+    memset(&tree->meta, 0, sizeof(struct bplus_disk_meta));
+    memcpy(tree->meta.magic, BPLUS_DISK_MAGIC, sizeof(tree->meta.magic));
+    tree->meta.page_size  = page_size;
+    tree->meta.key_size   = key_size;
+    tree->meta.value_size = value_size;
+    tree->meta.pages      = 1;
+  } else if (memcmp(tree->meta.magic, BPLUS_DISK_MAGIC, sizeof(tree->meta.magic)) != 0 ||
+             tree->meta.page_size != page_size || tree->meta.key_size != key_size || tree->meta.value_size != value_size ||
+             tree->pool.nframes < bplus_disk_frames(tree->meta.height)) {
+    pool_close(&tree->pool);
+    return false;
+  }
+
+  if ((tree->scratch = malloc((page_size<<1) + key_stride)) == NULL) {
+    pool_close(&tree->pool);
+    return false;
+  }
+
+  tree->window = 0;
+
+  return true;
+}
+
+extern bool bplus_disk_readahead(struct bplus_disk_root *tree, const size_t window, const size_t nthreads) {
+  if (0 < nthreads && tree->pool.nreaders == 0 && !pool_async(&tree->pool, nthreads)) return false;
+
+  tree->window = window < tree->pool.nframes>>1 ? window : tree->pool.nframes>>1;
+
+  return true;
+}
+
+extern bool bplus_disk_close(struct bplus_disk_root *tree) {
+  register bool ok = bplus_disk_sync(tree);
+
+  ok = pool_close(&tree->pool) && ok;
+  free(tree->scratch);
+
+  return ok;
+}
+
+extern bool bplus_disk_sync(struct bplus_disk_root *tree) {
+  register void *meta = pool_fetch(&tree->pool, 0);
+
+  if (meta == NULL) return false;
+
+  memcpy(meta, &tree->meta, sizeof(struct bplus_disk_meta));
+  pool_unpin(&tree->pool, meta, true);
+
+  return pool_flush(&tree->pool);
+}
+
+extern bool bplus_disk_find(struct bplus_disk_root *restrict tree, const void *restrict key, void *restrict value) {
+  register uint64_t      *node;
+  register unsigned char *keys;
+  register uint64_t      page = tree->meta.root;
+  register size_t        idx;
+  register bool          found;
+
+  if (page == 0) return false;
+
+  for (register size_t level = tree->meta.height; 0 < level; --level) {
+    if ((node = pool_fetch(&tree->pool, page)) == NULL) return false;
+    page = bplus_disk_children(node)[__bsearch(tree, key, bplus_disk_internal_keys(tree, node), node[0])];
+    pool_unpin(&tree->pool, node, false);
+  }
+
+  if ((node = pool_fetch(&tree->pool, page)) == NULL) return false;
+
+  keys = bplus_disk_external_keys(node);
+  idx  = __bsearch(tree, key, keys, node[0]);
+
+  if ((found = bplus_disk_equal(tree, key, keys, node[0], idx)) && value != NULL)
+    memcpy(value, bplus_disk_values(tree, node) + bplus_disk_stride(tree->meta.value_size)*idx, tree->meta.value_size);
+
+  pool_unpin(&tree->pool, node, false);
+
+  return found;
+}
+
+extern bool bplus_disk_insert(struct bplus_disk_root *restrict tree, const void *restrict key, const void *restrict value) { return bplus_disk_put(tree, key, value, false) == 1; }
+
+extern bool bplus_disk_insert_or_assign(struct bplus_disk_root *restrict tree, const void *restrict key, const void *restrict value) { return 0 <= bplus_disk_put(tree, key, value, true); }
+
+extern bool bplus_disk_erase(struct bplus_disk_root *restrict tree, const void *restrict key, void *restrict value) {
+  register uint64_t *node;
+  register uint64_t child;
+  register int      status;
+
+  if (tree->meta.root == 0) return false;
+
+  status = tree->meta.height == 0 ? bplus_disk_external_remove(tree, tree->meta.root, key, value)
+                                  : bplus_disk_internal_remove(tree, tree->meta.root, tree->meta.height, key, value);
+
+  if (status <= 0) return false;
+
+  --tree->meta.size;
+
+  /* case of the last element removed */
+  if (status == 2) {
+    tree->meta.root   = 0;
+    tree->meta.height = 0;
+  }
+
+  /* shrink the tree while the root has a single child, which is left as is if the root cannot be pinned */
+  while (0 < tree->meta.height) {
+    if ((node = pool_fetch(&tree->pool, tree->meta.root)) == NULL) break;
+    if (node[0] != 0) {
+      pool_unpin(&tree->pool, node, false);
+      break;
+    }
+    child = bplus_disk_children(node)[0];
+    bplus_disk_release(tree, tree->meta.root, node);
+    tree->meta.root = child;
+    --tree->meta.height;
+  }
+
+  return true;
+}
+
+/**
+ * struct bplus_disk_cursor - the read-ahead of a scan, walking the parents of the external nodes ahead of the scan
+ *
+ * @path:     the pages of the internal nodes above the parents, indexed by level
+ * @index:    the index of the child taken at each node of @path
+ * @children: the children of the current parent
+ * @idx:      the index of the next child of the current parent to read ahead
+ * @edx:      the index past the last child of the current parent within the scan
+ * @last:     whether the scan ends within the current parent
+ * @sup:      the upper bound key record, or NULL for no upper bound
+ */
+struct bplus_disk_cursor {
+        uint64_t path[__SIZEOF_POINTER__*8];
+        size_t   index[__SIZEOF_POINTER__*8];
+        uint64_t *children;
+        size_t   idx;
+        size_t   edx;
+        bool     last;
+  const void     *sup;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_disk_enter - makes the parent @node the current parent of @cursor, from the child at @idx on
+ *
+ * @tree:   the tree to which @node belongs
+ * @cursor: the read-ahead of the scan
+ * @node:   the parent of external nodes
+ * @idx:    the index of the first child to read ahead
+ *
+ * The children whose lower separator is not less than the upper bound of the scan are left out, and so are all parents after them.
+ */
+static inline void bplus_disk_enter(const struct bplus_disk_root *restrict tree, struct bplus_disk_cursor *restrict cursor, uint64_t *restrict node, const size_t idx) {
+  register const size_t edx = cursor->sup == NULL ? node[0] : __bsearch(tree, cursor->sup, bplus_disk_internal_keys(tree, node), node[0]);
+
+  memcpy(cursor->children, bplus_disk_children(node), sizeof(uint64_t)*(node[0]+1));
+  cursor->idx  = idx;
+  cursor->edx  = edx+1;
+  cursor->last = edx < node[0];
+}
+
+/**
+ * bplus_disk_descend - returns the page of the external node of @tree that may hold @key, or zero if @tree is empty
+ *
+ * @tree:   tree to search
+ * @key:    the key record to search for, or NULL for the leftmost external node
+ * @cursor: where to start the read-ahead of the scan following the external node, or NULL
+ */
+static inline uint64_t bplus_disk_descend(struct bplus_disk_root *restrict tree, const void *restrict key, struct bplus_disk_cursor *restrict cursor) {
+  register uint64_t *node;
+  register uint64_t page = tree->meta.root;
+  register size_t   idx;
+
+  if (cursor != NULL) {
+    cursor->idx  = cursor->edx = 0;
+    cursor->last = true;
+  }
+
+  for (register size_t level = tree->meta.height; page != 0 && 0 < level; --level) {
+    if ((node = pool_fetch(&tree->pool, page)) == NULL) return 0;
+    idx = key == NULL ? 0 : __bsearch(tree, key, bplus_disk_internal_keys(tree, node), node[0]);
+    if (cursor != NULL && 1 < level) {
+      cursor->path[level]  = page;
+      cursor->index[level] = idx;
+    } else if (cursor != NULL) {
+      bplus_disk_enter(tree, cursor, node, idx+1);
+    }
+    page = bplus_disk_children(node)[idx];
+    pool_unpin(&tree->pool, node, false);
+  }
+
+  return page;
+}
+
+/**
+ * bplus_disk_ahead - returns the page of the next external node to read ahead, or zero if the scan reads no more
+ *
+ * @tree:   the tree being scanned
+ * @cursor: the read-ahead of the scan
+ *
+ * Past the last child of the current parent, the cursor climbs up to the first ancestor with a child to the right
+ * and descends along the leftmost path of that child to the next parent.
+ */
+static inline uint64_t bplus_disk_ahead(struct bplus_disk_root *restrict tree, struct bplus_disk_cursor *restrict cursor) {
+  register uint64_t *node = NULL;
+  register uint64_t page;
+  register size_t   level;
+  register size_t   idx;
+
+  if (cursor->idx < cursor->edx) return cursor->children[cursor->idx++];
+
+  if (cursor->last) return 0;
+
+  cursor->last = true;
+
+  for (level = 2; level <= tree->meta.height; ++level) {
+    if ((node = pool_fetch(&tree->pool, cursor->path[level])) == NULL) return 0;
+    if (cursor->index[level] < node[0]) break;
+    pool_unpin(&tree->pool, node, false);
+  }
+
+  /* case of no ancestor with a child to the right */
+  if (tree->meta.height < level) return 0;
+
+  idx  = ++cursor->index[level];
+  page = bplus_disk_children(node)[idx];
+
+  /* case of a child beyond the upper bound */
+  if (cursor->sup != NULL && !tree->less(bplus_disk_internal_keys(tree, node) + bplus_disk_stride(tree->meta.key_size)*(idx-1), cursor->sup)) {
+    pool_unpin(&tree->pool, node, false);
+    return 0;
+  }
+  pool_unpin(&tree->pool, node, false);
+
+  for (--level; 1 < level; --level) {
+    if ((node = pool_fetch(&tree->pool, page)) == NULL) return 0;
+    cursor->path[level]  = page;
+    cursor->index[level] = 0;
+    page                 = bplus_disk_children(node)[0];
+    pool_unpin(&tree->pool, node, false);
+  }
+
+  if ((node = pool_fetch(&tree->pool, page)) == NULL) return 0;
+  bplus_disk_enter(tree, cursor, node, 0);
+  pool_unpin(&tree->pool, node, false);
+
+  return cursor->children[cursor->idx++];
+}
+
+/**
+ * bplus_disk_scan - applies @func to each element of @tree from the external node at @page on, up to @sup
+ *
+ * @tree:   tree to apply @func to each element of
+ * @page:   the number of the page of the first external node
+ * @inf:    the lower bound key record, or NULL for no lower bound
+ * @sup:    the upper bound key record, or NULL for no upper bound
+ * @func:   function to apply to each element of @tree
+ * @cursor: the read-ahead of the scan, or NULL
+ *
+ * The scan keeps the window of @tree filled, reading one more external node ahead each time it leaves one behind.
+ * The external nodes read ahead stay pinned until the scan reaches them, so that the buffer pool does not evict them before.
+ */
+static inline void bplus_disk_scan(struct bplus_disk_root *restrict tree, uint64_t page, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict), struct bplus_disk_cursor *restrict cursor) {
+  register const size_t        key_stride   = bplus_disk_stride(tree->meta.key_size);
+  register const size_t        value_stride = bplus_disk_stride(tree->meta.value_size);
+  register       uint64_t      *node;
+  register       unsigned char *keys;
+  register       unsigned char *values;
+  register       size_t        idx;
+  register       size_t        edx;
+  register       uint64_t      next;
+  register       void          *frame;
+  register       size_t        head         = 0;
+  register       size_t        ahead        = 0;
+                 uint64_t      *pages       = cursor == NULL ? NULL : malloc((sizeof(uint64_t)+sizeof(void *))*tree->window);
+                 void          **frames     = (void **)(pages+tree->window);
+
+  for (;;) {
+    /* the reads ahead are kept in a ring of the window, in the order the scan reaches them */
+    while (pages != NULL && ahead < tree->window && (next = bplus_disk_ahead(tree, cursor)) != 0) {
+      if ((frame = pool_prefetch(&tree->pool, next)) == NULL) continue;
+      pages[(head+ahead) % tree->window]  = next;
+      frames[(head+ahead) % tree->window] = frame;
+      ++ahead;
+    }
+
+    if (page == 0 || (node = pool_fetch(&tree->pool, page)) == NULL) break;
+
+    /* case of an external node read ahead: drop the pin of the read */
+    if (0 < ahead && pages[head] == page) {
+      pool_unpin(&tree->pool, frames[head], false);
+      head = (head+1) % tree->window;
+      --ahead;
+    }
+
+    keys   = bplus_disk_external_keys(node);
+    values = bplus_disk_values(tree, node);
+    idx    = inf == NULL ? 0 : __bsearch(tree, inf, keys, node[0]);
+    edx    = sup == NULL ? node[0] : __bsearch(tree, sup, keys, node[0]);
+
+    for (; idx < edx; ++idx)
+      func(keys + key_stride*idx, values + value_stride*idx);
+
+    page = edx < node[0] ? 0 : node[2];
+    inf  = NULL;
+    pool_unpin(&tree->pool, node, false);
+  }
+
+  for (; 0 < ahead; --ahead, head = (head+1) % tree->window)
+    pool_unpin(&tree->pool, frames[head], false);
+
+  free(pages);
+}
+
+extern void bplus_disk_for_each(struct bplus_disk_root *tree, void (*func)(const void *restrict, void *restrict)) {
+  struct bplus_disk_cursor cursor = {.children = (uint64_t *)tree->scratch, .sup = NULL};
+
+  if (tree->window == 0) bplus_disk_scan(tree, tree->meta.head, NULL, NULL, func, NULL);
+  else                   bplus_disk_scan(tree, bplus_disk_descend(tree, NULL, &cursor), NULL, NULL, func, &cursor);
+}
+
+extern void bplus_disk_range_each(struct bplus_disk_root *tree, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) {
+  struct bplus_disk_cursor cursor = {.children = (uint64_t *)tree->scratch, .sup = sup};
+
+  bplus_disk_scan(tree, bplus_disk_descend(tree, inf, tree->window == 0 ? NULL : &cursor), inf, sup, func, tree->window == 0 ? NULL : &cursor);
+}
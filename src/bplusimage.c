@@ -0,0 +1,1700 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * bplusimage.c - memory-mapped B+-tree image definition
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/bplusimage.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * The layout of the node slots, in which each field takes a 64-bit word
+ * and each key or value record is padded to a multiple of 8 bytes:
+ *
+ *    internal node: nmemb | type | children[order] | keys[order-1]
+ *    external node: nmemb | 0    | 0               | keys[order] | values[order]
+ *
+ * The leaves are not linked to each other, so that the two words following nmemb in an external node are reserved as zero.
+ * bplus_save lays the external nodes out first in ascending order, right after the header page,
+ * followed by the internal nodes in post-order, so that the root is the last node of the file,
+ * while a checkpoint of a store puts each node it writes into any free slot.
+ *
+ * A compressed image keeps the internal nodes in slots, while each external node takes a block of its own length,
+ * padded to a multiple of 8 bytes, in which the fields before the key stream take 32-bit words:
+ *
+ *    external node: nmemb | restarts | key_bytes | value_bytes | offsets[restarts] | key stream | values
+ *
+ * The key stream starts over every BPLUS_IMAGE_RESTART keys at a restart point, whose offset in the stream is in offsets.
+ * A key stored as a pointer is written as a varint, as is at a restart point and as the zigzag-encoded delta from the key before it otherwise,
+ * and a key record as the varint length of the prefix it shares with the key before it, zero at a restart point,
+ * followed by the varint length of the rest and the rest itself.
+ * The values, aligned to 8 bytes, are stored as in a slot, or as an LZ4-style block of the pointers under BPLUS_IMAGE_LZ,
+ * which is a run of sequences, each of a token whose nibbles hold the number of the literals and the length of the match less 4,
+ * either extended by bytes up to 255 when 15, the literals, and the 16-bit offset of the match, except for the last one of literals only.
+ * bplus_save_compressed appends the nodes in post-order, so that the root is the last node of the file.
+ */
+
+#define BPLUS_IMAGE_RESTART 16
+#define BPLUS_LZ_MATCH      4
+#define BPLUS_LZ_HASH       12
+
+/**
+ * bplus_image_stride - returns the size of the slot of a record of @size
+ *
+ * @size: the size of a record, or zero for a pointer
+ */
+static inline size_t bplus_image_stride(const size_t size) { return size == 0 ? sizeof(uint64_t) : (size+7) & ~(size_t)7; }
+
+/**
+ * bplus_image_node_size - returns the size of the node slots of an image
+ *
+ * @order:      the order of the tree
+ * @key_size:   the size of a key record, or zero for a pointer
+ * @value_size: the size of a value record, or zero for a pointer
+ *
+ * The slots are rounded up to a power of two, or to a multiple of the page size if greater,
+ * so that no node straddles more pages than it must.
+ */
+static inline size_t bplus_image_node_size(const size_t order, const size_t key_size, const size_t value_size) {
+  register const size_t internal = sizeof(uint64_t)*(order+2) + bplus_image_stride(key_size)*(order-1);
+  register const size_t external = sizeof(uint64_t)*3 + (bplus_image_stride(key_size)+bplus_image_stride(value_size))*order;
+  register const size_t size     = internal < external ? external : internal;
+  register       size_t slot     = 64;
+
+  if (BPLUS_IMAGE_PAGE < size) return (size+BPLUS_IMAGE_PAGE-1) / BPLUS_IMAGE_PAGE * BPLUS_IMAGE_PAGE;
+
+  while (slot < size) slot <<= 1;
+
+  return slot;
+}
+
+/**
+ * bplus_image_store - writes the record of @item into @slot
+ *
+ * @slot:  where to write the record
+ * @item:  the key or value to write the record of
+ * @codec: the serializer of @item, or NULL to write @item as a pointer
+ */
+static inline void bplus_image_store(unsigned char *restrict slot, const void *restrict item, const struct bplus_codec *restrict codec) {
+  if (codec == NULL) {
+    const uint64_t bits = (uintptr_t)item;
+    memcpy(slot, &bits, sizeof(uint64_t));
+  } else {
+    codec->encode(slot, item);
+  }
+}
+
+/**
+ * bplus_image_load - returns the key or value presented by the record in @slot
+ *
+ * @slot: the record to present
+ * @size: the size of the record, or zero for a pointer
+ */
+static inline void *bplus_image_load(const unsigned char *restrict slot, const uint64_t size) {
+  if (size != 0) return (void *)slot;
+
+  return (void *)(uintptr_t)*(const uint64_t *)slot;
+}
+
+/**
+ * bplus_image_pwrite - writes @size bytes of @buffer to @fd at @offset
+ *
+ * @fd:     the file to write to
+ * @buffer: the bytes to write
+ * @size:   the number of bytes to write
+ * @offset: the offset in @fd to write at
+ *
+ * Returns false if @fd cannot be written.
+ */
+static inline bool bplus_image_pwrite(const int fd, const unsigned char *restrict buffer, size_t size, off_t offset) {
+  register ssize_t count;
+
+  while (0 < size) {
+    if ((count = pwrite(fd, buffer, size, offset)) < 0) return false;
+    buffer += count;
+    offset += count;
+    size   -= (size_t)count;
+  }
+
+  return true;
+}
+
+/**
+ * struct bplus_image_writer - the state of writing an image
+ *
+ * @fd:        the file to write to
+ * @buffer:    the node slot being written
+ * @keys:      the serializer of the keys, or NULL to store the keys as pointers
+ * @values:    the serializer of the values, or NULL to store the values as pointers
+ * @order:     the order of the tree
+ * @node_size: the size of a node slot
+ * @leaves:    the number of the external nodes
+ * @external:  the number of the external nodes written
+ * @internal:  the number of the internal nodes written
+ * @scratch:   the key records and the values being compressed
+ * @length:    the length of the image appended so far, if compressed
+ * @head:      the offset of the first external node appended, if compressed
+ * @tail:      the offset of the last external node appended, if compressed
+ * @lz:        whether the values are compressed
+ * @ok:        whether all writes have succeeded
+ */
+struct bplus_image_writer {
+        int                fd;
+        unsigned char      *buffer;
+  const struct bplus_codec *keys;
+  const struct bplus_codec *values;
+        size_t             order;
+        size_t             node_size;
+        size_t             leaves;
+        size_t             external;
+        size_t             internal;
+        unsigned char      *scratch;
+        uint64_t           length;
+        uint64_t           head;
+        uint64_t           tail;
+        bool               lz;
+        bool               ok;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_image_count - returns the number of the internal nodes of @node
+ *
+ * @node: the subtree to count the internal nodes of
+ */
+static inline size_t bplus_image_count(const struct bplus_internal_node *restrict node) {
+  register size_t count = 1;
+
+  if (!node->type)
+    for (register size_t idx = 0; idx <= node->nmemb; ++idx)
+      count += bplus_image_count(node->children[idx]);
+
+  return count;
+}
+
+/**
+ * bplus_image_encode_external - fills the buffer of @writer with the slot of the external node @node
+ *
+ * @writer: the state of writing
+ * @node:   the external node to encode
+ */
+static inline void bplus_image_encode_external(const struct bplus_image_writer *restrict writer, const struct bplus_external_node *restrict node) {
+  register const size_t  key_stride   = bplus_image_stride(writer->keys == NULL ? 0 : writer->keys->size);
+  register const size_t  value_stride = bplus_image_stride(writer->values == NULL ? 0 : writer->values->size);
+           uint64_t      *words       = (uint64_t *)writer->buffer;
+           unsigned char *keys        = (unsigned char *)(words+3);
+           unsigned char *values      = keys + key_stride*writer->order;
+
+  memset(writer->buffer, 0, writer->node_size);
+  words[0] = node->nmemb;
+
+  for (register size_t idx = 0; idx < node->nmemb; ++idx) {
+    bplus_image_store(keys + key_stride*idx, node->keys[idx], writer->keys);
+    bplus_image_store(values + value_stride*idx, node->values[idx], writer->values);
+  }
+}
+
+/**
+ * bplus_image_encode_internal - fills the buffer of @writer with the slot of the internal node @node
+ *
+ * @writer:   the state of writing
+ * @node:     the internal node to encode
+ * @children: the offsets of the slots of the children of @node
+ */
+static inline void bplus_image_encode_internal(const struct bplus_image_writer *restrict writer, const struct bplus_internal_node *restrict node, const uint64_t *restrict children) {
+  register const size_t  key_stride = bplus_image_stride(writer->keys == NULL ? 0 : writer->keys->size);
+           uint64_t      *words     = (uint64_t *)writer->buffer;
+           unsigned char *keys      = (unsigned char *)(words+2+writer->order);
+
+  memset(writer->buffer, 0, writer->node_size);
+  words[0] = node->nmemb;
+  words[1] = node->type;
+  memcpy(words+2, children, sizeof(uint64_t)*(node->nmemb+1));
+  for (register size_t idx = 0; idx < node->nmemb; ++idx)
+    bplus_image_store(keys + key_stride*idx, node->keys[idx], writer->keys);
+}
+
+/**
+ * bplus_image_write_external - writes @node into the next external node slot
+ *
+ * @writer: the state of writing
+ * @node:   the external node to write
+ *
+ * Returns the offset of the slot.
+ */
+static inline uint64_t bplus_image_write_external(struct bplus_image_writer *restrict writer, const struct bplus_external_node *restrict node) {
+  register const uint64_t offset = BPLUS_IMAGE_PAGE + writer->external*writer->node_size;
+
+  bplus_image_encode_external(writer, node);
+
+  ++writer->external;
+  writer->ok = writer->ok && bplus_image_pwrite(writer->fd, writer->buffer, writer->node_size, (off_t)offset);
+
+  return offset;
+}
+
+/**
+ * bplus_image_write_internal - writes the subtree of @node, children first
+ *
+ * @writer: the state of writing
+ * @node:   the internal node to write
+ *
+ * Returns the offset of the slot of @node, or zero with @writer failed if the children cannot be allocated.
+ */
+static uint64_t bplus_image_write_internal(struct bplus_image_writer *restrict writer, const struct bplus_internal_node *restrict node) {
+  uint64_t *children = malloc(sizeof(uint64_t)*(node->nmemb+1));
+  uint64_t offset;
+
+  if (children == NULL) {
+    writer->ok = false;
+    return 0;
+  }
+
+  for (register size_t idx = 0; idx <= node->nmemb; ++idx)
+    children[idx] = node->type ? bplus_image_write_external(writer, node->children[idx])
+                               : bplus_image_write_internal(writer, node->children[idx]);
+
+  /* the buffer is only filled in once all children have been written through it */
+  offset = BPLUS_IMAGE_PAGE + (writer->leaves+writer->internal)*writer->node_size;
+  bplus_image_encode_internal(writer, node, children);
+
+  free(children);
+
+  ++writer->internal;
+  writer->ok = writer->ok && bplus_image_pwrite(writer->fd, writer->buffer, writer->node_size, (off_t)offset);
+
+  return offset;
+}
+
+/**
+ * bplus_image_create - creates the file to write an image aside of @path
+ *
+ * @path: the path of the image
+ * @temp: where to store the path of the file, to be freed by bplus_image_finish
+ *
+ * The image is written aside and renamed over @path, so that readers never see a partial image.
+ *
+ * Returns the descriptor of the file, or -1 if it cannot be created.
+ */
+static inline int bplus_image_create(const char *restrict path, char **restrict temp) {
+  register int fd;
+
+  if ((*temp = malloc(strlen(path)+5)) == NULL) return -1;
+  sprintf(*temp, "%s.tmp", path);
+
+  if ((fd = open(*temp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) free(*temp);
+
+  return fd;
+}
+
+/**
+ * bplus_image_sync_dir - flushes the directory holding @path to the disk
+ *
+ * @path: the path of the file whose entry to flush
+ *
+ * A rename is durable only once the directory it changes is, so that a crash cannot bring the former file back.
+ *
+ * Returns false if the directory cannot be flushed.
+ */
+static inline bool bplus_image_sync_dir(const char *restrict path) {
+  register const char *slash = strrchr(path, '/');
+  register       char *dir;
+  register       int  fd;
+  register       bool ok;
+
+  if (slash == NULL) {
+    fd = open(".", O_RDONLY | O_DIRECTORY);
+  } else {
+    if ((dir = strndup(path, slash == path ? 1 : (size_t)(slash - path))) == NULL) return false;
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    free(dir);
+  }
+
+  if (fd < 0) return false;
+
+  ok = fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+
+  return ok;
+}
+
+/**
+ * bplus_image_write_header - writes @header to the first page of the file written by @writer
+ *
+ * @writer: the state of writing
+ * @header: the header of the image
+ */
+static inline void bplus_image_write_header(struct bplus_image_writer *restrict writer, const struct bplus_image_header *restrict header) {
+  if (writer->ok) {
+    memset(writer->buffer, 0, BPLUS_IMAGE_PAGE);
+    memcpy(writer->buffer, header, sizeof(struct bplus_image_header));
+    writer->ok = bplus_image_pwrite(writer->fd, writer->buffer, BPLUS_IMAGE_PAGE, 0);
+  }
+}
+
+/**
+ * bplus_image_finish - writes @header and renames the file written by @writer at @temp over @path
+ *
+ * @writer: the state of writing, whose file is closed
+ * @header: the header of the image
+ * @temp:   the path of the file, which is freed
+ * @path:   the path of the image
+ *
+ * The header is written last, so that an image cut short by a crash is never taken for a complete one,
+ * and the directory is flushed after the rename, so that the image is durable once this returns true.
+ *
+ * Returns false if any write has failed, in which case the file is removed unless it is already renamed.
+ */
+static inline bool bplus_image_finish(struct bplus_image_writer *restrict writer, const struct bplus_image_header *restrict header, char *restrict temp, const char *restrict path) {
+  bplus_image_write_header(writer, header);
+  writer->ok = writer->ok && fsync(writer->fd) == 0;
+  writer->ok = close(writer->fd) == 0 && writer->ok;
+  writer->ok = writer->ok && rename(temp, path) == 0;
+
+  if (!writer->ok) unlink(temp);
+  else             writer->ok = bplus_image_sync_dir(path);
+
+  free(temp);
+
+  return writer->ok;
+}
+
+/**
+ * bplus_image_write_tree - writes the nodes of @tree to the file of @writer and fills @header, but for writing it
+ *
+ * @writer: the state of writing, whose file and codecs are set
+ * @tree:   tree to write the image of
+ * @header: the header of the image to fill
+ *
+ * The buffer of @writer is allocated here, to be freed by the caller.
+ */
+static inline void bplus_image_write_tree(struct bplus_image_writer *restrict writer, const struct bplus_root *restrict tree, struct bplus_image_header *restrict header) {
+  register size_t count;
+
+  writer->order     = tree->order;
+  writer->node_size = bplus_image_node_size(tree->order, writer->keys == NULL ? 0 : writer->keys->size, writer->values == NULL ? 0 : writer->values->size);
+  writer->leaves    = 0;
+  writer->external  = 0;
+  writer->internal  = 0;
+
+  for (register const struct bplus_external_node *node = tree->head; node != NULL; node = node->next)
+    ++writer->leaves;
+  count = writer->leaves + (tree->root == NULL ? 0 : bplus_image_count(tree->root));
+
+  writer->buffer = calloc(1, writer->node_size < BPLUS_IMAGE_PAGE ? BPLUS_IMAGE_PAGE : writer->node_size);
+  writer->ok     = writer->buffer != NULL;
+
+  memset(header, 0, sizeof(struct bplus_image_header));
+  memcpy(header->magic, BPLUS_IMAGE_MAGIC, sizeof(header->magic));
+  header->pointer    = __SIZEOF_POINTER__;
+  header->order      = tree->order;
+  header->size       = tree->size;
+  header->key_size   = writer->keys == NULL ? 0 : writer->keys->size;
+  header->value_size = writer->values == NULL ? 0 : writer->values->size;
+  header->node_size  = writer->node_size;
+  header->head       = writer->leaves == 0 ? 0 : BPLUS_IMAGE_PAGE;
+  header->tail       = writer->leaves == 0 ? 0 : BPLUS_IMAGE_PAGE + (writer->leaves-1)*writer->node_size;
+  header->length     = BPLUS_IMAGE_PAGE + count*writer->node_size;
+
+  if (!writer->ok)             header->root = 0;
+  else if (tree->root != NULL) header->root = bplus_image_write_internal(writer, tree->root);
+  else if (tree->head != NULL) header->root = bplus_image_write_external(writer, tree->head);
+  else                         header->root = 0;
+}
+
+extern bool bplus_save(const struct bplus_root tree, const char *restrict path, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  struct bplus_image_writer writer = {
+    .keys   = keys,
+    .values = values,
+  };
+  struct bplus_image_header header;
+  char                      *temp;
+
+  if ((writer.fd = bplus_image_create(path, &temp)) < 0) return false;
+
+  bplus_image_write_tree(&writer, &tree, &header);
+  bplus_image_finish(&writer, &header, temp, path);
+  free(writer.buffer);
+
+  return writer.ok;
+}
+
+/**
+ * bplus_shared_create - creates an anonymous shared memory file
+ *
+ * A memory file is sealed once written on Linux, while elsewhere a POSIX shared memory object is unlinked as soon as it is opened,
+ * so that neither has a name by which it can be reached, nor outlives its last descriptor and mapping.
+ *
+ * Returns the descriptor of the file, or -1 if it cannot be created.
+ */
+static inline int bplus_shared_create(void) {
+#ifdef __linux__
+  return memfd_create("libindex", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+  static   unsigned long seq;
+  register int           fd;
+           char          name[64];
+
+  sprintf(name, "/libindex.%ld.%lu", (long)getpid(), __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED));
+  if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) return -1;
+  shm_unlink(name);
+
+  return fd;
+#endif
+}
+
+extern int bplus_save_shared(const struct bplus_root tree, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  struct bplus_image_writer writer = {
+    .keys   = keys,
+    .values = values,
+  };
+  struct bplus_image_header header;
+
+  if ((writer.fd = bplus_shared_create()) < 0) return -1;
+
+  bplus_image_write_tree(&writer, &tree, &header);
+  bplus_image_write_header(&writer, &header);
+  free(writer.buffer);
+
+#ifdef __linux__
+  /* the seals keep the image from changing under the mappings of the readers, whoever holds the descriptor */
+  writer.ok = writer.ok && fcntl(writer.fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0;
+#endif
+
+  if (!writer.ok) {
+    close(writer.fd);
+    return -1;
+  }
+
+  return writer.fd;
+}
+
+/**
+ * bplus_varint_put - writes @value as a varint into @dst, returning the number of the bytes written
+ *
+ * @dst:   where to write the varint
+ * @value: the value to write
+ */
+static inline size_t bplus_varint_put(unsigned char *restrict dst, uint64_t value) {
+  register size_t len = 0;
+
+  for (; 0x80 <= value; value >>= 7)
+    dst[len++] = (unsigned char)(value | 0x80);
+  dst[len++] = (unsigned char)value;
+
+  return len;
+}
+
+/**
+ * bplus_varint_get - reads a varint from @src into @value, returning where the varint ends
+ *
+ * @src:   where the varint starts
+ * @value: where to store the value
+ */
+static inline const unsigned char *bplus_varint_get(const unsigned char *restrict src, uint64_t *restrict value) {
+  register uint64_t result = 0;
+  register unsigned shift  = 0;
+
+  for (; (*src & 0x80) && shift < 63; shift += 7)
+    result |= (uint64_t)(*src++ & 0x7f) << shift;
+  *value = result | (uint64_t)*src++ << shift;
+
+  return src;
+}
+
+/**
+ * bplus_zigzag - maps the two's complement @delta to an unsigned value that is small whenever |@delta| is
+ *
+ * @delta: the difference between two keys
+ */
+static inline uint64_t bplus_zigzag(const uint64_t delta) { return delta << 1 ^ (0 - (delta >> 63)); }
+
+/**
+ * bplus_unzigzag - reverts bplus_zigzag
+ *
+ * @bits: the zigzag-encoded difference
+ */
+static inline uint64_t bplus_unzigzag(const uint64_t bits) { return bits >> 1 ^ (0 - (bits & 1)); }
+
+/**
+ * bplus_lz_length - writes the part of a length beyond its nibble into @dst, returning the number of the bytes written
+ *
+ * @dst:    where to write the length
+ * @length: the length less 15
+ */
+static inline size_t bplus_lz_length(unsigned char *restrict dst, size_t length) {
+  register size_t len = 0;
+
+  for (; 255 <= length; length -= 255)
+    dst[len++] = 255;
+  dst[len++] = (unsigned char)length;
+
+  return len;
+}
+
+/**
+ * bplus_lz_sequence - writes a sequence of @nliterals literals and a match into @dst, returning the number of the bytes written
+ *
+ * @dst:       where to write the sequence
+ * @literals:  the literals
+ * @nliterals: the number of the literals
+ * @offset:    the distance back to the match
+ * @count:     the length of the match, or zero for the last sequence
+ */
+static inline size_t bplus_lz_sequence(unsigned char *restrict dst, const unsigned char *restrict literals, const size_t nliterals, const size_t offset, const size_t count) {
+  register size_t len = 1;
+
+  dst[0] = (unsigned char)((nliterals < 15 ? nliterals : 15) << 4 | (count == 0 ? 0 : count-BPLUS_LZ_MATCH < 15 ? count-BPLUS_LZ_MATCH : 15));
+  if (15 <= nliterals) len += bplus_lz_length(dst+len, nliterals-15);
+  memcpy(dst+len, literals, nliterals);
+  len += nliterals;
+
+  if (count == 0) return len;
+
+  dst[len++] = (unsigned char)(offset & 0xff);
+  dst[len++] = (unsigned char)(offset >> 8);
+  if (15 <= count-BPLUS_LZ_MATCH) len += bplus_lz_length(dst+len, count-BPLUS_LZ_MATCH-15);
+
+  return len;
+}
+
+/**
+ * bplus_lz_compress - compresses the @size bytes of @src into @dst, returning the number of the bytes written
+ *
+ * @src:  the bytes to compress
+ * @size: the number of the bytes
+ * @dst:  where to write the block, of at least @size + @size/255 + 16 bytes
+ *
+ * The matches are found through a hash table of the last position of each 4-byte sequence, as in LZ4.
+ */
+static size_t bplus_lz_compress(const unsigned char *restrict src, const size_t size, unsigned char *restrict dst) {
+           uint32_t table[1<<BPLUS_LZ_HASH];
+           uint32_t sequence;
+  register size_t   match;
+  register size_t   count;
+  register size_t   len    = 0;
+  register size_t   anchor = 0;
+  register size_t   pos    = 0;
+
+  memset(table, 0, sizeof(table));
+
+  while (pos + BPLUS_LZ_MATCH <= size) {
+    memcpy(&sequence, src+pos, sizeof(uint32_t));
+    sequence = (uint32_t)(sequence*2654435761u) >> (32-BPLUS_LZ_HASH);
+    match    = table[sequence];
+    table[sequence] = (uint32_t)pos+1;
+
+    /* case of no match within reach */
+    if (match == 0 || 0xffff < pos-match+1 || memcmp(src+match-1, src+pos, BPLUS_LZ_MATCH) != 0) {
+      ++pos;
+      continue;
+    }
+
+    for (count = BPLUS_LZ_MATCH, --match; pos+count < size && src[match+count] == src[pos+count]; ++count);
+    len    += bplus_lz_sequence(dst+len, src+anchor, pos-anchor, pos-match, count);
+    pos    += count;
+    anchor  = pos;
+  }
+
+  return len + bplus_lz_sequence(dst+len, src+anchor, size-anchor, 0, 0);
+}
+
+/**
+ * bplus_lz_decompress - decompresses the block of @size bytes at @src into @dst until at least @need bytes are out
+ *
+ * @src:      the block to decompress
+ * @size:     the number of the bytes of the block
+ * @dst:      where to write the bytes
+ * @capacity: the capacity of @dst
+ * @need:     the number of the bytes to decompress, after which the rest of the block is left alone
+ *
+ * Returns false if the block is malformed or ends before @need bytes.
+ */
+static bool bplus_lz_decompress(const unsigned char *restrict src, const size_t size, unsigned char *restrict dst, const size_t capacity, const size_t need) {
+  register size_t        nliterals;
+  register size_t        offset;
+  register size_t        count;
+  register unsigned char byte;
+  register size_t        in  = 0;
+  register size_t        out = 0;
+
+  while (out < need && in < size) {
+    byte      = src[in++];
+    nliterals = byte >> 4;
+    count     = (byte & 15) + BPLUS_LZ_MATCH;
+    for (byte = nliterals == 15 ? 255 : 0; byte == 255; nliterals += byte)
+      byte = in < size ? src[in++] : 0;
+    if (size-in < nliterals || capacity-out < nliterals) return false;
+    memcpy(dst+out, src+in, nliterals);
+    in  += nliterals;
+    out += nliterals;
+
+    /* case of the last sequence, or of enough bytes */
+    if (in == size || need <= out) break;
+
+    if (size-in < 2) return false;
+    offset  = src[in] | (size_t)src[in+1] << 8;
+    in     += 2;
+    for (byte = count == 15+BPLUS_LZ_MATCH ? 255 : 0; byte == 255; count += byte)
+      byte = in < size ? src[in++] : 0;
+    if (offset == 0 || out < offset || capacity-out < count) return false;
+    for (; 0 < count; --count, ++out)
+      dst[out] = dst[out-offset];
+  }
+
+  return need <= out;
+}
+
+/**
+ * bplus_image_pack_size - returns the maximum size of a compressed external node
+ *
+ * @order:      the order of the tree
+ * @key_size:   the size of a key record, or zero for a pointer
+ * @value_size: the size of a value record, or zero for a pointer
+ */
+static inline size_t bplus_image_pack_size(const size_t order, const size_t key_size, const size_t value_size) {
+  register const size_t keys   = key_size == 0 ? 10*order : (20+key_size)*order;
+  register const size_t values = value_size == 0 ? sizeof(uint64_t)*order + sizeof(uint64_t)*order/255 + 16 : bplus_image_stride(value_size)*order;
+
+  return sizeof(uint32_t)*(4 + (order+BPLUS_IMAGE_RESTART-1)/BPLUS_IMAGE_RESTART) + keys + 8 + values + 8;
+}
+
+/**
+ * bplus_image_pack - fills the buffer of @writer with the compressed external node @node, returning its size
+ *
+ * @writer: the state of writing
+ * @node:   the external node to compress
+ */
+static inline size_t bplus_image_pack(const struct bplus_image_writer *restrict writer, const struct bplus_external_node *restrict node) {
+  register const size_t        key_size     = writer->keys == NULL ? 0 : writer->keys->size;
+  register const size_t        value_stride = bplus_image_stride(writer->values == NULL ? 0 : writer->values->size);
+  register const size_t        restarts     = (node->nmemb+BPLUS_IMAGE_RESTART-1) / BPLUS_IMAGE_RESTART;
+           uint32_t            *words       = (uint32_t *)writer->buffer;
+           unsigned char       *stream      = (unsigned char *)(words+4+restarts);
+           unsigned char       *values;
+           unsigned char       *key;
+  register const unsigned char *prev;
+  register       size_t        shared;
+  register       size_t        len          = 0;
+           uint64_t            bits;
+           uint64_t            last         = 0;
+
+  memset(writer->buffer, 0, bplus_image_pack_size(writer->order, key_size, writer->values == NULL ? 0 : writer->values->size));
+
+  for (register size_t idx = 0; idx < node->nmemb; ++idx) {
+    if (idx % BPLUS_IMAGE_RESTART == 0) words[4 + idx/BPLUS_IMAGE_RESTART] = (uint32_t)len;
+
+    if (key_size == 0) {
+      bits  = (uintptr_t)node->keys[idx];
+      len  += bplus_varint_put(stream+len, idx % BPLUS_IMAGE_RESTART == 0 ? bits : bplus_zigzag(bits-last));
+      last  = bits;
+    } else {
+      key  = writer->scratch + key_size*(idx & 1);
+      prev = writer->scratch + key_size*(~idx & 1);
+      writer->keys->encode(key, node->keys[idx]);
+      for (shared = 0; idx % BPLUS_IMAGE_RESTART != 0 && shared < key_size && key[shared] == prev[shared]; ++shared);
+      len += bplus_varint_put(stream+len, shared);
+      len += bplus_varint_put(stream+len, key_size-shared);
+      memcpy(stream+len, key+shared, key_size-shared);
+      len += key_size-shared;
+    }
+  }
+
+  words[0] = (uint32_t)node->nmemb;
+  words[1] = (uint32_t)restarts;
+  words[2] = (uint32_t)len;
+  len      = ((size_t)(stream-writer->buffer) + len + 7) & ~(size_t)7;
+  values   = writer->buffer + len;
+
+  if (writer->values != NULL || !writer->lz) {
+    for (register size_t idx = 0; idx < node->nmemb; ++idx)
+      bplus_image_store(values + value_stride*idx, node->values[idx], writer->values);
+    words[3] = (uint32_t)(value_stride*node->nmemb);
+  } else {
+    key = writer->scratch + 2*key_size;
+    for (register size_t idx = 0; idx < node->nmemb; ++idx)
+      bplus_image_store(key + sizeof(uint64_t)*idx, node->values[idx], NULL);
+    words[3] = (uint32_t)bplus_lz_compress(key, sizeof(uint64_t)*node->nmemb, values);
+  }
+
+  return (len + words[3] + 7) & ~(size_t)7;
+}
+
+/**
+ * bplus_image_append_external - appends the compressed @node to the image
+ *
+ * @writer: the state of writing
+ * @node:   the external node to write
+ *
+ * Returns the offset of the node.
+ */
+static inline uint64_t bplus_image_append_external(struct bplus_image_writer *restrict writer, const struct bplus_external_node *restrict node) {
+  register const uint64_t offset = writer->length;
+  register const size_t   size   = bplus_image_pack(writer, node);
+
+  if (writer->head == 0) writer->head = offset;
+  writer->tail    = offset;
+  writer->length += size;
+  writer->ok      = writer->ok && bplus_image_pwrite(writer->fd, writer->buffer, size, (off_t)offset);
+
+  return offset;
+}
+
+/**
+ * bplus_image_append_internal - appends the subtree of @node to the image, children first
+ *
+ * @writer: the state of writing
+ * @node:   the internal node to write
+ *
+ * Returns the offset of the slot of @node.
+ */
+static uint64_t bplus_image_append_internal(struct bplus_image_writer *restrict writer, const struct bplus_internal_node *restrict node) {
+  uint64_t *children = malloc(sizeof(uint64_t)*(node->nmemb+1));
+  uint64_t offset;
+
+  if (children == NULL) {
+    writer->ok = false;
+    return 0;
+  }
+
+  for (register size_t idx = 0; writer->ok && idx <= node->nmemb; ++idx)
+    children[idx] = node->type ? bplus_image_append_external(writer, node->children[idx])
+                               : bplus_image_append_internal(writer, node->children[idx]);
+
+  offset = writer->length;
+  if (writer->ok) bplus_image_encode_internal(writer, node, children);
+
+  free(children);
+
+  writer->length += writer->node_size;
+  writer->ok      = writer->ok && bplus_image_pwrite(writer->fd, writer->buffer, writer->node_size, (off_t)offset);
+
+  return offset;
+}
+
+extern bool bplus_save_compressed(const struct bplus_root tree, const char *restrict path, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values, const bool lz) {
+  register const size_t     key_size  = keys == NULL ? 0 : keys->size;
+  register const size_t     pack_size = bplus_image_pack_size(tree.order, key_size, values == NULL ? 0 : values->size);
+  struct bplus_image_writer writer    = {
+    .keys      = keys,
+    .values    = values,
+    .order     = tree.order,
+    .node_size = (sizeof(uint64_t)*(tree.order+2) + bplus_image_stride(key_size)*(tree.order-1) + 63) & ~(size_t)63,
+    .length    = BPLUS_IMAGE_PAGE,
+    .head      = 0,
+    .tail      = 0,
+    .lz        = lz,
+  };
+  struct bplus_image_header header;
+  char                      *temp;
+
+  /* the value records are presented from the mapping, so that only the values stored as pointers are compressed */
+  if (lz && values != NULL) return false;
+
+  if ((writer.fd = bplus_image_create(path, &temp)) < 0) return false;
+
+  writer.buffer  = calloc(1, BPLUS_IMAGE_PAGE < pack_size ? pack_size : BPLUS_IMAGE_PAGE < writer.node_size ? writer.node_size : BPLUS_IMAGE_PAGE);
+  writer.scratch = malloc(2*key_size + sizeof(uint64_t)*tree.order);
+  writer.ok      = writer.buffer != NULL && writer.scratch != NULL;
+
+  memset(&header, 0, sizeof(struct bplus_image_header));
+  memcpy(header.magic, BPLUS_IMAGE_MAGIC, sizeof(header.magic));
+  header.pointer    = __SIZEOF_POINTER__;
+  header.order      = tree.order;
+  header.size       = tree.size;
+  header.key_size   = key_size;
+  header.value_size = values == NULL ? 0 : values->size;
+  header.node_size  = writer.node_size;
+  header.flags      = lz ? BPLUS_IMAGE_DELTA | BPLUS_IMAGE_LZ : BPLUS_IMAGE_DELTA;
+
+  if (!writer.ok)             header.root = 0;
+  else if (tree.root != NULL) header.root = bplus_image_append_internal(&writer, tree.root);
+  else if (tree.head != NULL) header.root = bplus_image_append_external(&writer, tree.head);
+  else                        header.root = 0;
+
+  header.head   = writer.head;
+  header.tail   = writer.tail;
+  header.length = writer.length;
+
+  bplus_image_finish(&writer, &header, temp, path);
+  free(writer.buffer);
+  free(writer.scratch);
+
+  return writer.ok;
+}
+
+/**
+ * bplus_image_pread - reads @size bytes from @fd at @offset into @buffer
+ *
+ * @fd:     the file to read from
+ * @buffer: where to read the bytes into
+ * @size:   the number of bytes to read
+ * @offset: the offset in @fd to read at
+ *
+ * Returns false if @fd cannot be read or ends before @size bytes.
+ */
+static inline bool bplus_image_pread(const int fd, unsigned char *restrict buffer, size_t size, off_t offset) {
+  register ssize_t count;
+
+  while (0 < size) {
+    if ((count = pread(fd, buffer, size, offset)) <= 0) return false;
+    buffer += count;
+    offset += count;
+    size   -= (size_t)count;
+  }
+
+  return true;
+}
+
+/**
+ * bplus_store_push - appends @slot to the @nmemb slots of @slots, growing @slots as needed
+ *
+ * @slots:    the array of the slots
+ * @nmemb:    the number of the slots in @slots
+ * @capacity: the capacity of @slots
+ * @slot:     the slot to append
+ *
+ * Returns false if @slots cannot grow.
+ */
+static inline bool bplus_store_push(uint64_t **restrict slots, size_t *restrict nmemb, size_t *restrict capacity, const uint64_t slot) {
+  register uint64_t *grown;
+
+  if (*nmemb == *capacity) {
+    if ((grown = realloc(*slots, sizeof(uint64_t)*(*capacity == 0 ? 64 : *capacity<<1))) == NULL) return false;
+    *slots    = grown;
+    *capacity = *capacity == 0 ? 64 : *capacity<<1;
+  }
+
+  (*slots)[(*nmemb)++] = slot;
+
+  return true;
+}
+
+/**
+ * bplus_store_compare - compares the slots at @lhs and @rhs for qsort and bsearch
+ *
+ * @lhs: the address of the first slot
+ * @rhs: the address of the second slot
+ */
+static int bplus_store_compare(const void *lhs, const void *rhs) {
+  const uint64_t left  = *(const uint64_t *)lhs;
+  const uint64_t right = *(const uint64_t *)rhs;
+  return (right < left) - (left < right);
+}
+
+/**
+ * struct bplus_store_writer - the state of a checkpoint
+ *
+ * @image:     the state of writing the nodes
+ * @store:     the store being checkpointed
+ * @length:    the length of the image being written
+ * @reused:    the slots of the unchanged nodes kept by the checkpoint
+ * @nreused:   the number of the slots in @reused
+ * @capacity:  the capacity of @reused
+ * @released:  the slots of the last image left behind by the checkpoint
+ * @nreleased: the number of the slots in @released
+ * @reserve:   the capacity of @released
+ * @full:      whether the whole tree is written to a new file
+ */
+struct bplus_store_writer {
+  struct bplus_image_writer image;
+  struct bplus_store        *store;
+  uint64_t                  length;
+  uint64_t                  *reused;
+  size_t                    nreused;
+  size_t                    capacity;
+  uint64_t                  *released;
+  size_t                    nreleased;
+  size_t                    reserve;
+  bool                      full;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_store_alloc - returns a slot for a node written by the checkpoint
+ *
+ * @writer: the state of the checkpoint
+ *
+ * The slots released by the last checkpoint are taken first, and the image grows only once they run out.
+ */
+static inline uint64_t bplus_store_alloc(struct bplus_store_writer *restrict writer) {
+  register uint64_t slot;
+
+  if (!writer->full && 0 < writer->store->nfree) return writer->store->free[--writer->store->nfree];
+
+  slot            = writer->length;
+  writer->length += writer->image.node_size;
+
+  return slot;
+}
+
+/**
+ * bplus_store_keep - keeps the slot of an unchanged node, returning it
+ *
+ * @writer: the state of the checkpoint
+ * @slot:   the slot of the node in the last image
+ */
+static inline uint64_t bplus_store_keep(struct bplus_store_writer *restrict writer, const uint64_t slot) {
+  writer->image.ok = writer->image.ok && bplus_store_push(&writer->reused, &writer->nreused, &writer->capacity, slot);
+  return slot;
+}
+
+/**
+ * bplus_store_write_external - writes @node into a free slot unless it is unchanged
+ *
+ * @writer: the state of the checkpoint
+ * @node:   the external node to write
+ *
+ * Returns the offset of the slot of @node.
+ */
+static inline uint64_t bplus_store_write_external(struct bplus_store_writer *restrict writer, struct bplus_external_node *restrict node) {
+  if (!writer->full && node->slot != 0) return bplus_store_keep(writer, node->slot);
+
+  node->slot = bplus_store_alloc(writer);
+  bplus_image_encode_external(&writer->image, node);
+
+  ++writer->store->written;
+  writer->image.ok = writer->image.ok && bplus_image_pwrite(writer->image.fd, writer->image.buffer, writer->image.node_size, (off_t)node->slot);
+
+  return node->slot;
+}
+
+/**
+ * bplus_store_write_internal - writes the changed nodes of the subtree of @node into free slots, children first
+ *
+ * @writer: the state of the checkpoint
+ * @node:   the internal node to write
+ *
+ * The subtree of an unchanged node is unchanged as a whole, as the writers mark all ancestors of the nodes they change,
+ * so that the checkpoint skips it without a visit.
+ *
+ * Returns the offset of the slot of @node, or zero with the checkpoint failed if memory runs out.
+ */
+static uint64_t bplus_store_write_internal(struct bplus_store_writer *restrict writer, struct bplus_internal_node *restrict node) {
+  uint64_t *children;
+
+  if (!writer->full && node->slot != 0) return bplus_store_keep(writer, node->slot);
+
+  if ((children = malloc(sizeof(uint64_t)*(node->nmemb+1))) == NULL) {
+    writer->image.ok = false;
+    return 0;
+  }
+
+  for (register size_t idx = 0; idx <= node->nmemb; ++idx)
+    children[idx] = node->type ? bplus_store_write_external(writer, node->children[idx])
+                               : bplus_store_write_internal(writer, node->children[idx]);
+
+  node->slot = bplus_store_alloc(writer);
+  bplus_image_encode_internal(&writer->image, node, children);
+
+  free(children);
+
+  ++writer->store->written;
+  writer->image.ok = writer->image.ok && bplus_image_pwrite(writer->image.fd, writer->image.buffer, writer->image.node_size, (off_t)node->slot);
+
+  return node->slot;
+}
+
+/**
+ * bplus_store_release - collects the slots of the subtree at @slot of the last image that the checkpoint leaves behind
+ *
+ * @writer:   the state of the checkpoint, whose kept slots are sorted
+ * @slot:     the slot of the subtree in the last image
+ * @external: whether @slot holds an external node
+ *
+ * The walk stops at the kept slots, so that it only reads the nodes replaced or freed since the last checkpoint.
+ *
+ * Returns false if the last image cannot be read.
+ */
+static bool bplus_store_release(struct bplus_store_writer *restrict writer, const uint64_t slot, const bool external) {
+  register bool     ok;
+           uint64_t *words;
+
+  if (0 < writer->nreused && bsearch(&slot, writer->reused, writer->nreused, sizeof(uint64_t), bplus_store_compare) != NULL) return true;
+
+  if (!bplus_store_push(&writer->released, &writer->nreleased, &writer->reserve, slot)) return false;
+
+  if (external) return true;
+
+  if ((words = malloc(writer->image.node_size)) == NULL) return false;
+
+  ok = bplus_image_pread(writer->image.fd, (unsigned char *)words, writer->image.node_size, (off_t)slot) && words[0] < writer->image.order;
+
+  for (register size_t idx = 0; ok && idx <= words[0]; ++idx)
+    ok = bplus_store_release(writer, words[2+idx], words[1]);
+
+  free(words);
+
+  return ok;
+}
+
+extern bool bplus_store_init(struct bplus_store *restrict store, const char *restrict path, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  if ((store->path = malloc(strlen(path)+1)) == NULL) return false;
+  strcpy(store->path, path);
+
+  memset(&store->header, 0, sizeof(struct bplus_image_header));
+  store->fd       = -1;
+  store->keys     = keys;
+  store->values   = values;
+  store->free     = NULL;
+  store->nfree    = 0;
+  store->capacity = 0;
+  store->written  = 0;
+  store->full     = true;
+
+  return true;
+}
+
+extern void bplus_store_destroy(struct bplus_store *store) {
+  if (0 <= store->fd) close(store->fd);
+
+  free(store->path);
+  free(store->free);
+  store->fd    = -1;
+  store->path  = NULL;
+  store->free  = NULL;
+  store->nfree = 0;
+}
+
+extern bool bplus_checkpoint(struct bplus_store *restrict store, struct bplus_root *restrict tree) {
+  struct bplus_store_writer writer = {
+    .image = {
+      .fd        = store->fd,
+      .keys      = store->keys,
+      .values    = store->values,
+      .order     = tree->order,
+      .node_size = bplus_image_node_size(tree->order, store->keys == NULL ? 0 : store->keys->size, store->values == NULL ? 0 : store->values->size),
+      .ok        = true,
+    },
+    .store     = store,
+    .length    = store->header.length,
+    .reused    = NULL,
+    .nreused   = 0,
+    .capacity  = 0,
+    .released  = NULL,
+    .nreleased = 0,
+    .reserve   = 0,
+    .full      = store->full || store->header.order != tree->order,
+  };
+  struct bplus_image_header header;
+  char                      *temp = NULL;
+
+  /* the whole tree goes to a new file renamed over @path, so that the slots of the nodes refer to a single image */
+  if (writer.full) {
+    if ((temp = malloc(strlen(store->path)+5)) == NULL) return false;
+    sprintf(temp, "%s.tmp", store->path);
+
+    if ((writer.image.fd = open(temp, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+      free(temp);
+      return false;
+    }
+
+    writer.length = BPLUS_IMAGE_PAGE;
+  }
+
+  if ((writer.image.buffer = calloc(1, writer.image.node_size < BPLUS_IMAGE_PAGE ? BPLUS_IMAGE_PAGE : writer.image.node_size)) == NULL) {
+    if (writer.full) {
+      close(writer.image.fd);
+      unlink(temp);
+      free(temp);
+    }
+    return false;
+  }
+
+  store->written = 0;
+
+  memset(&header, 0, sizeof(struct bplus_image_header));
+  memcpy(header.magic, BPLUS_IMAGE_MAGIC, sizeof(header.magic));
+  header.pointer    = __SIZEOF_POINTER__;
+  header.order      = tree->order;
+  header.size       = tree->size;
+  header.key_size   = store->keys == NULL ? 0 : store->keys->size;
+  header.value_size = store->values == NULL ? 0 : store->values->size;
+  header.node_size  = writer.image.node_size;
+
+  if (tree->root != NULL)      header.root = bplus_store_write_internal(&writer, tree->root);
+  else if (tree->head != NULL) header.root = bplus_store_write_external(&writer, tree->head);
+  else                         header.root = 0;
+
+  header.head   = tree->head == NULL ? 0 : tree->head->slot;
+  header.tail   = tree->tail == NULL ? 0 : tree->tail->slot;
+  header.length = writer.length;
+
+  /* the slots left behind are found in the last image before the new header replaces it */
+  if (!writer.full && store->header.root != 0) {
+    if (0 < writer.nreused) qsort(writer.reused, writer.nreused, sizeof(uint64_t), bplus_store_compare);
+    writer.image.ok = writer.image.ok && bplus_store_release(&writer, store->header.root, store->header.root == store->header.head && store->header.root == store->header.tail);
+  }
+
+  /* the nodes are made durable before the header refers to them */
+  writer.image.ok = writer.image.ok && fsync(writer.image.fd) == 0;
+  memset(writer.image.buffer, 0, BPLUS_IMAGE_PAGE);
+  memcpy(writer.image.buffer, &header, sizeof(struct bplus_image_header));
+  writer.image.ok = writer.image.ok && bplus_image_pwrite(writer.image.fd, writer.image.buffer, BPLUS_IMAGE_PAGE, 0);
+  writer.image.ok = writer.image.ok && fsync(writer.image.fd) == 0;
+
+  if (writer.full) {
+    writer.image.ok = writer.image.ok && rename(temp, store->path) == 0;
+    /* the rename is durable once the directory is, and until then a crash may bring the former image back */
+    if (writer.image.ok) {
+      if (0 <= store->fd) close(store->fd);
+      store->fd       = writer.image.fd;
+      store->nfree    = 0;
+      writer.image.ok = bplus_image_sync_dir(store->path);
+    } else {
+      close(writer.image.fd);
+      unlink(temp);
+    }
+    free(temp);
+  }
+
+  /* the slots left behind become free once the new header is durable */
+  for (register size_t idx = 0; writer.image.ok && idx < writer.nreleased; ++idx)
+    writer.image.ok = bplus_store_push(&store->free, &store->nfree, &store->capacity, writer.released[idx]);
+
+  if (writer.image.ok) store->header = header;
+  store->full = !writer.image.ok;
+
+  free(writer.image.buffer);
+  free(writer.reused);
+  free(writer.released);
+
+  return writer.image.ok;
+}
+
+extern struct bplus_image *bplus_open_mmap(const char *restrict path, bool (*less)(const void *restrict, const void *restrict)) {
+  struct bplus_image *image;
+  int                fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0) return NULL;
+
+  /* the mapping outlives the descriptor */
+  image = bplus_open_fd(fd, less);
+  close(fd);
+
+  return image;
+}
+
+extern struct bplus_image *bplus_open_fd(const int fd, bool (*less)(const void *restrict, const void *restrict)) {
+  struct stat                     status;
+  struct bplus_image              *image;
+  const struct bplus_image_header *header;
+  void                            *base;
+
+  if (fstat(fd, &status) != 0 || status.st_size < BPLUS_IMAGE_PAGE) return NULL;
+
+  base = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) return NULL;
+
+  header = base;
+  if (memcmp(header->magic, BPLUS_IMAGE_MAGIC, sizeof(header->magic)) != 0 || header->pointer != __SIZEOF_POINTER__ ||
+      (uint64_t)status.st_size < header->length || header->node_size == 0 || (header->flags & ~(uint64_t)(BPLUS_IMAGE_DELTA | BPLUS_IMAGE_LZ)) != 0 ||
+      header->root >= header->length || header->head >= header->length || header->tail >= header->length ||
+      (image = malloc(sizeof(struct bplus_image))) == NULL) {
+    munmap(base, (size_t)status.st_size);
+    return NULL;
+  }
+
+  image->base   = base;
+  image->length = (size_t)status.st_size;
+  image->header = header;
+  image->less   = less;
+
+  return image;
+}
+
+extern void bplus_close_mmap(struct bplus_image *image) {
+  munmap((void *)image->base, image->length);
+  free(image);
+}
+
+/**
+ * bplus_image_bsearch - do a binary search for @key in the @nmemb records from @base, using @less to perform the comparisons
+ *
+ * @image: the image to which the records belong
+ * @key:   the key to search for
+ * @base:  where to search @key
+ * @nmemb: number of records in @base
+ */
+static inline size_t bplus_image_bsearch(const struct bplus_image *restrict image, const void *restrict key, const unsigned char *restrict base, const size_t nmemb) {
+  register const size_t stride = bplus_image_stride(image->header->key_size);
+  register const void   *pivot;
+  register       size_t idx;
+  register       size_t lo     = 0;
+  register       size_t hi     = nmemb;
+
+  while (lo < hi) {
+    idx   = (lo+hi)>>1;
+    pivot = bplus_image_load(base + stride*idx, image->header->key_size);
+    if (image->less(key, pivot))      hi = idx;
+    else if (image->less(pivot, key)) lo = idx+1;
+    else                              return idx;
+  }
+
+  return lo;
+}
+
+/**
+ * bplus_image_leaf - returns the external node of @image that may hold @key, or NULL if @image is empty
+ *
+ * @image: image to search
+ * @key:   the key to search for
+ */
+static inline const uint64_t *bplus_image_leaf(const struct bplus_image *restrict image, const void *restrict key) {
+  register const uint64_t *node;
+  register       uint64_t offset = image->header->root;
+
+  if (offset == 0) return NULL;
+
+  /* the root is an external node if and only if it is the only node */
+  if (offset == image->header->head && offset == image->header->tail) return (const uint64_t *)(image->base + offset);
+
+  for (;;) {
+    node   = (const uint64_t *)(image->base + offset);
+    offset = node[2 + bplus_image_bsearch(image, key, (const unsigned char *)(node+2+image->header->order), node[0])];
+    if (node[1]) return (const uint64_t *)(image->base + offset);
+  }
+}
+
+/**
+ * struct bplus_image_cursor - the path from the root of an image down to an external node
+ *
+ * @path:  the internal nodes on the path, from the top down
+ * @index: the index of the child taken at each node of @path
+ * @depth: the number of the nodes in @path
+ */
+struct bplus_image_cursor {
+  const uint64_t *path[__SIZEOF_POINTER__*8];
+        size_t   index[__SIZEOF_POINTER__*8];
+        size_t   depth;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_image_seek - returns the external node of @image that may hold @key, or NULL if @image is empty
+ *
+ * @image:  image to search
+ * @key:    the key to search for, or NULL for the leftmost external node
+ * @cursor: where to store the path to the external node
+ */
+static inline const uint64_t *bplus_image_seek(const struct bplus_image *restrict image, const void *restrict key, struct bplus_image_cursor *restrict cursor) {
+  register const uint64_t *node;
+  register       size_t   idx;
+  register       uint64_t offset = image->header->root;
+
+  cursor->depth = 0;
+
+  if (offset == 0) return NULL;
+
+  if (offset == image->header->head && offset == image->header->tail) return (const uint64_t *)(image->base + offset);
+
+  for (;;) {
+    node                           = (const uint64_t *)(image->base + offset);
+    idx                            = key == NULL ? 0 : bplus_image_bsearch(image, key, (const unsigned char *)(node+2+image->header->order), node[0]);
+    cursor->path[cursor->depth]    = node;
+    cursor->index[cursor->depth++] = idx;
+    offset                         = node[2+idx];
+    if (node[1]) return (const uint64_t *)(image->base + offset);
+  }
+}
+
+/**
+ * bplus_image_advance - moves @cursor to the next external node of @image, returning it, or NULL if there is none
+ *
+ * @image:  image to walk
+ * @cursor: the path to the current external node
+ *
+ * The leaves are not linked to each other, so that the cursor climbs up to the first ancestor with a child to the right
+ * and descends along the leftmost path of that child.
+ */
+static inline const uint64_t *bplus_image_advance(const struct bplus_image *restrict image, struct bplus_image_cursor *restrict cursor) {
+  register const uint64_t *node;
+  register       uint64_t offset;
+
+  while (0 < cursor->depth && cursor->path[cursor->depth-1][0] <= cursor->index[cursor->depth-1])
+    --cursor->depth;
+
+  if (cursor->depth == 0) return NULL;
+
+  node   = cursor->path[cursor->depth-1];
+  offset = node[2 + ++cursor->index[cursor->depth-1]];
+
+  while (!node[1]) {
+    node                           = (const uint64_t *)(image->base + offset);
+    cursor->path[cursor->depth]    = node;
+    cursor->index[cursor->depth++] = 0;
+    offset                         = node[2];
+  }
+
+  return (const uint64_t *)(image->base + offset);
+}
+
+/**
+ * bplus_image_keys - returns the key records of the external node @node
+ *
+ * @node: the external node
+ */
+static inline const unsigned char *bplus_image_keys(const uint64_t *restrict node) { return (const unsigned char *)(node+3); }
+
+/**
+ * bplus_image_values - returns the value records of the external node @node of @image
+ *
+ * @image: the image to which @node belongs
+ * @node:  the external node
+ */
+static inline const unsigned char *bplus_image_values(const struct bplus_image *restrict image, const uint64_t *restrict node) {
+  return bplus_image_keys(node) + bplus_image_stride(image->header->key_size)*image->header->order;
+}
+
+/**
+ * bplus_image_unpack_key - decodes the key at @src of the key stream of a compressed external node, returning where the next key starts
+ *
+ * @image:   the image to which the key stream belongs
+ * @src:     where the key starts
+ * @restart: whether the key is at a restart point
+ * @bits:    the key before it if stored as a pointer, overwritten by the key
+ * @record:  the key record before it if written by an encoder, overwritten by the key
+ */
+static inline const unsigned char *bplus_image_unpack_key(const struct bplus_image *restrict image, const unsigned char *restrict src, const bool restart, uint64_t *restrict bits, unsigned char *restrict record) {
+  uint64_t value;
+  uint64_t shared;
+
+  if (image->header->key_size == 0) {
+    src   = bplus_varint_get(src, &value);
+    *bits = restart ? value : *bits + bplus_unzigzag(value);
+    return src;
+  }
+
+  src = bplus_varint_get(bplus_varint_get(src, &shared), &value);
+  memcpy(record+shared, src, value);
+
+  return src + value;
+}
+
+/**
+ * bplus_image_unpack_values - returns the values of the compressed external node @node
+ *
+ * @node: the compressed external node
+ */
+static inline const unsigned char *bplus_image_unpack_values(const unsigned char *restrict node) {
+  register const uint32_t *words = (const uint32_t *)node;
+  return node + ((sizeof(uint32_t)*(4+words[1]) + words[2] + 7) & ~(size_t)7);
+}
+
+/**
+ * bplus_image_unpack_find - searches the compressed external node @node of @image for @key
+ *
+ * @image: the image to which @node belongs
+ * @node:  the compressed external node
+ * @key:   the key to search for
+ * @value: where to store the value of @key, or NULL
+ *
+ * The restart points are searched first, so that only the keys following the last one not greater than @key are decoded,
+ * and the values are decompressed only as far as the value of @key.
+ *
+ * Returns false if there is no such element.
+ */
+static bool bplus_image_unpack_find(const struct bplus_image *restrict image, const unsigned char *restrict node, const void *restrict key, void **restrict value) {
+  register const uint32_t      *words    = (const uint32_t *)node;
+  register const unsigned char *stream   = (const unsigned char *)(words+4+words[1]);
+  register const unsigned char *values   = bplus_image_unpack_values(node);
+  register const unsigned char *src;
+  register const void          *pivot;
+  register       size_t        mid;
+  register       size_t        idx;
+  register       size_t        edx;
+  register       size_t        lo        = 0;
+  register       size_t        hi        = words[1];
+  register       bool          found     = false;
+           uint64_t            bits      = 0;
+           unsigned char       *record   = NULL;
+           unsigned char       *buffer;
+
+  if (image->header->key_size != 0 && (record = malloc(image->header->key_size)) == NULL) return false;
+
+  while (lo < hi) {
+    mid = (lo+hi)>>1;
+    bplus_image_unpack_key(image, stream + words[4+mid], true, &bits, record);
+    pivot = record == NULL ? (const void *)(uintptr_t)bits : record;
+    if (image->less(key, pivot)) hi = mid;
+    else                         lo = mid+1;
+  }
+
+  /* case of @key less than the first key */
+  if (lo == 0) {
+    free(record);
+    return false;
+  }
+
+  src = stream + words[4+lo-1];
+  edx = words[0] < lo*BPLUS_IMAGE_RESTART ? words[0] : lo*BPLUS_IMAGE_RESTART;
+  for (idx = (lo-1)*BPLUS_IMAGE_RESTART; idx < edx; ++idx) {
+    src   = bplus_image_unpack_key(image, src, idx % BPLUS_IMAGE_RESTART == 0, &bits, record);
+    pivot = record == NULL ? (const void *)(uintptr_t)bits : record;
+    if (image->less(key, pivot)) break;
+    if (!image->less(pivot, key)) {
+      found = true;
+      break;
+    }
+  }
+
+  free(record);
+
+  if (!found || value == NULL) return found;
+
+  if (image->header->value_size != 0 || !(image->header->flags & BPLUS_IMAGE_LZ)) {
+    *value = bplus_image_load(values + bplus_image_stride(image->header->value_size)*idx, image->header->value_size);
+    return true;
+  }
+
+  if ((buffer = malloc(sizeof(uint64_t)*words[0])) == NULL) return false;
+
+  if ((found = bplus_lz_decompress(values, words[3], buffer, sizeof(uint64_t)*words[0], sizeof(uint64_t)*(idx+1))))
+    *value = bplus_image_load(buffer + sizeof(uint64_t)*idx, 0);
+
+  free(buffer);
+
+  return found;
+}
+
+extern void *bplus_image_find(const struct bplus_image *image, const void *key) {
+  register const uint64_t *node = bplus_image_leaf(image, key);
+  register       size_t   idx;
+           void           *value;
+
+  if (node == NULL) return NULL;
+
+  if (image->header->flags & BPLUS_IMAGE_DELTA)
+    return bplus_image_unpack_find(image, (const unsigned char *)node, key, &value) ? value : NULL;
+
+  if ((idx = bplus_image_bsearch(image, key, bplus_image_keys(node), node[0])) < node[0]) {
+    const void *pivot = bplus_image_load(bplus_image_keys(node) + bplus_image_stride(image->header->key_size)*idx, image->header->key_size);
+    if (!(image->less(key, pivot) || image->less(pivot, key)))
+      return bplus_image_load(bplus_image_values(image, node) + bplus_image_stride(image->header->value_size)*idx, image->header->value_size);
+  }
+
+  return NULL;
+}
+
+extern bool bplus_image_contains(const struct bplus_image *image, const void *key) {
+  register const uint64_t *node = bplus_image_leaf(image, key);
+  register       size_t   idx;
+
+  if (node == NULL) return false;
+
+  if (image->header->flags & BPLUS_IMAGE_DELTA) return bplus_image_unpack_find(image, (const unsigned char *)node, key, NULL);
+
+  if ((idx = bplus_image_bsearch(image, key, bplus_image_keys(node), node[0])) < node[0]) {
+    const void *pivot = bplus_image_load(bplus_image_keys(node) + bplus_image_stride(image->header->key_size)*idx, image->header->key_size);
+    return !(image->less(key, pivot) || image->less(pivot, key));
+  }
+
+  return false;
+}
+
+/**
+ * bplus_image_apply - applies @func to the elements of the external node @node from @idx to @edx
+ *
+ * @image: the image to which @node belongs
+ * @node:  the external node
+ * @idx:   the index of the first element
+ * @edx:   the index past the last element
+ * @func:  function to apply to each element
+ */
+static inline void bplus_image_apply(const struct bplus_image *restrict image, const uint64_t *restrict node, size_t idx, const size_t edx, void (*func)(const void *restrict, void *restrict)) {
+  register const size_t        key_stride   = bplus_image_stride(image->header->key_size);
+  register const size_t        value_stride = bplus_image_stride(image->header->value_size);
+  register const unsigned char *keys        = bplus_image_keys(node);
+  register const unsigned char *values      = bplus_image_values(image, node);
+
+  for (; idx < edx; ++idx)
+    func(bplus_image_load(keys + key_stride*idx, image->header->key_size), bplus_image_load(values + value_stride*idx, image->header->value_size));
+}
+
+/**
+ * struct bplus_image_scan - the elements of a compressed external node, decoded at once by a scan
+ *
+ * @keys:    the keys as presented by the image
+ * @values:  the values as presented by the image
+ * @records: the key records written by an encoder
+ * @words:   the decompressed values
+ * @nmemb:   the number of the elements
+ */
+struct bplus_image_scan {
+  const void          **keys;
+        void          **values;
+        unsigned char *records;
+        unsigned char *words;
+        size_t        nmemb;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_scan_destroy - frees @scan
+ *
+ * @scan: scan to destroy
+ */
+static inline void bplus_scan_destroy(struct bplus_image_scan *restrict scan) {
+  free(scan->keys);
+  free(scan->values);
+  free(scan->records);
+  free(scan->words);
+}
+
+/**
+ * bplus_scan_init - initializes @scan of the compressed external nodes of @image
+ *
+ * @image: the image to scan
+ * @scan:  scan to initialize
+ *
+ * Returns false if @scan cannot be allocated.
+ */
+static inline bool bplus_scan_init(const struct bplus_image *restrict image, struct bplus_image_scan *restrict scan) {
+  register const size_t order = image->header->order;
+
+  scan->keys    = malloc(sizeof(void *)*order);
+  scan->values  = malloc(sizeof(void *)*order);
+  scan->records = image->header->key_size == 0 ? NULL : malloc(image->header->key_size*order);
+  scan->words   = image->header->flags & BPLUS_IMAGE_LZ ? malloc(sizeof(uint64_t)*order) : NULL;
+  scan->nmemb   = 0;
+
+  if (scan->keys == NULL || scan->values == NULL || (image->header->key_size != 0 && scan->records == NULL) ||
+      ((image->header->flags & BPLUS_IMAGE_LZ) && scan->words == NULL)) {
+    bplus_scan_destroy(scan);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * bplus_scan_unpack - decodes the whole compressed external node @node of @image into @scan
+ *
+ * @image: the image to which @node belongs
+ * @node:  the compressed external node
+ * @scan:  where to decode @node
+ */
+static inline void bplus_scan_unpack(const struct bplus_image *restrict image, const unsigned char *restrict node, struct bplus_image_scan *restrict scan) {
+  register const size_t        key_size     = image->header->key_size;
+  register const size_t        value_stride = bplus_image_stride(image->header->value_size);
+  register const uint32_t      *words       = (const uint32_t *)node;
+  register const unsigned char *src         = (const unsigned char *)(words+4+words[1]);
+  register const unsigned char *values      = bplus_image_unpack_values(node);
+  register       unsigned char *record;
+           uint64_t            bits         = 0;
+
+  scan->nmemb = words[0];
+
+  for (register size_t idx = 0; idx < scan->nmemb; ++idx) {
+    record = scan->records == NULL ? NULL : scan->records + key_size*idx;
+    if (record != NULL && idx % BPLUS_IMAGE_RESTART != 0) memcpy(record, record-key_size, key_size);
+    src             = bplus_image_unpack_key(image, src, idx % BPLUS_IMAGE_RESTART == 0, &bits, record);
+    scan->keys[idx] = record == NULL ? (const void *)(uintptr_t)bits : record;
+  }
+
+  /* case of the values compressed by LZ, decompressed into the scan as a whole */
+  if (scan->words != NULL) {
+    if (!bplus_lz_decompress(values, words[3], scan->words, sizeof(uint64_t)*image->header->order, sizeof(uint64_t)*scan->nmemb)) scan->nmemb = 0;
+    values = scan->words;
+  }
+
+  for (register size_t idx = 0; idx < scan->nmemb; ++idx)
+    scan->values[idx] = bplus_image_load(values + value_stride*idx, image->header->value_size);
+}
+
+/**
+ * bplus_scan_bsearch - do a binary search for @key in the keys of @scan
+ *
+ * @image: the image to which the keys belong
+ * @key:   the key to search for
+ * @scan:  the decoded external node
+ */
+static inline size_t bplus_scan_bsearch(const struct bplus_image *restrict image, const void *restrict key, const struct bplus_image_scan *restrict scan) {
+  register size_t idx;
+  register size_t lo = 0;
+  register size_t hi = scan->nmemb;
+
+  while (lo < hi) {
+    idx = (lo+hi)>>1;
+    if (image->less(key, scan->keys[idx]))      hi = idx;
+    else if (image->less(scan->keys[idx], key)) lo = idx+1;
+    else                                        return idx;
+  }
+
+  return lo;
+}
+
+/**
+ * bplus_scan_apply - applies @func to the elements of @scan from @idx to @edx
+ *
+ * @scan: the decoded external node
+ * @idx:  the index of the first element
+ * @edx:  the index past the last element
+ * @func: function to apply to each element
+ */
+static inline void bplus_scan_apply(const struct bplus_image_scan *restrict scan, size_t idx, const size_t edx, void (*func)(const void *restrict, void *restrict)) {
+  for (; idx < edx; ++idx)
+    func(scan->keys[idx], scan->values[idx]);
+}
+
+extern void bplus_image_for_each(const struct bplus_image *image, void (*func)(const void *restrict, void *restrict)) {
+  struct bplus_image_cursor cursor;
+  struct bplus_image_scan   scan;
+
+  /* case of compressed external nodes, each decoded as a whole */
+  if (image->header->flags & BPLUS_IMAGE_DELTA) {
+    if (!bplus_scan_init(image, &scan)) return;
+    for (register const uint64_t *node = bplus_image_seek(image, NULL, &cursor); node != NULL; node = bplus_image_advance(image, &cursor)) {
+      bplus_scan_unpack(image, (const unsigned char *)node, &scan);
+      bplus_scan_apply(&scan, 0, scan.nmemb, func);
+    }
+    bplus_scan_destroy(&scan);
+    return;
+  }
+
+  for (register const uint64_t *node = bplus_image_seek(image, NULL, &cursor); node != NULL; node = bplus_image_advance(image, &cursor))
+    bplus_image_apply(image, node, 0, node[0], func);
+}
+
+extern void bplus_image_range_each(const struct bplus_image *image, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) {
+           struct bplus_image_cursor cursor;
+  register const uint64_t            *node = bplus_image_seek(image, inf, &cursor);
+  register       size_t              edx;
+           struct bplus_image_scan   scan;
+
+  if (node == NULL) return;
+
+  /* case of compressed external nodes, each decoded as a whole */
+  if (image->header->flags & BPLUS_IMAGE_DELTA) {
+    if (!bplus_scan_init(image, &scan)) return;
+    bplus_scan_unpack(image, (const unsigned char *)node, &scan);
+    edx = bplus_scan_bsearch(image, sup, &scan);
+    bplus_scan_apply(&scan, bplus_scan_bsearch(image, inf, &scan), edx, func);
+    while (edx == scan.nmemb && (node = bplus_image_advance(image, &cursor)) != NULL) {
+      bplus_scan_unpack(image, (const unsigned char *)node, &scan);
+      edx = bplus_scan_bsearch(image, sup, &scan);
+      bplus_scan_apply(&scan, 0, edx, func);
+    }
+    bplus_scan_destroy(&scan);
+    return;
+  }
+
+  edx = bplus_image_bsearch(image, sup, bplus_image_keys(node), node[0]);
+  bplus_image_apply(image, node, bplus_image_bsearch(image, inf, bplus_image_keys(node), node[0]), edx, func);
+  if (edx < node[0]) return;
+
+  while ((node = bplus_image_advance(image, &cursor)) != NULL) {
+    edx = bplus_image_bsearch(image, sup, bplus_image_keys(node), node[0]);
+    bplus_image_apply(image, node, 0, edx, func);
+    if (edx < node[0]) return;
+  }
+}
@@ -4,8 +4,13 @@
  *
  * bplustree.c - generic B+-tree definition
  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <index/bplustree.h>
 #include <index/stack.h>
+#include <pthread.h>
 #include <string.h>
 
 /**
@@ -17,7 +22,11 @@ static inline struct bplus_internal_node *bplus_internal_alloc(const size_t orde
   struct bplus_internal_node *node = malloc(sizeof(struct bplus_internal_node));
   node->keys                       = malloc(__SIZEOF_POINTER__*(order-1));
   node->children                   = malloc(__SIZEOF_POINTER__*order);
+  node->high                       = NULL;
+  node->next                       = NULL;
   node->nmemb                      = 0;
+  node->version                    = 0;
+  node->slot                       = 0;
   node->type                       = false;
   return node;
 }
@@ -56,9 +65,12 @@ static inline struct bplus_external_node *bplus_external_alloc(const size_t orde
   struct bplus_external_node *node = malloc(sizeof(struct bplus_external_node));
   node->keys                       = malloc(__SIZEOF_POINTER__*order);
   node->values                     = malloc(__SIZEOF_POINTER__*order);
+  node->high                       = NULL;
   node->prev                       = NULL;
   node->next                       = NULL;
   node->nmemb                      = 0;
+  node->version                    = 0;
+  node->slot                       = 0;
   return node;
 }
 
@@ -88,6 +100,35 @@ static inline void bplus_external_clear(struct bplus_external_node *restrict lis
   }
 }
 
+/**
+ * bplus_internal_copy - allocates a copy of @node whose children still refer to those of @node
+ *
+ * @node:  node to copy
+ * @order: the order of tree
+ */
+static inline struct bplus_internal_node *bplus_internal_copy(const struct bplus_internal_node *restrict node, const size_t order) {
+  struct bplus_internal_node *copy = bplus_internal_alloc(order);
+  memcpy(copy->keys, node->keys, __SIZEOF_POINTER__*node->nmemb);
+  memcpy(copy->children, node->children, __SIZEOF_POINTER__*(node->nmemb+1));
+  copy->nmemb = node->nmemb;
+  copy->type  = node->type;
+  return copy;
+}
+
+/**
+ * bplus_external_copy - allocates a copy of @node
+ *
+ * @node:  node to copy
+ * @order: the order of tree
+ */
+static inline struct bplus_external_node *bplus_external_copy(const struct bplus_external_node *restrict node, const size_t order) {
+  struct bplus_external_node *copy = bplus_external_alloc(order);
+  memcpy(copy->keys, node->keys, __SIZEOF_POINTER__*node->nmemb);
+  memcpy(copy->values, node->values, __SIZEOF_POINTER__*node->nmemb);
+  copy->nmemb = node->nmemb;
+  return copy;
+}
+
 /**
  * __bsearch - do a binary search for @key in @base, which consists of @nmemb elements, using @less to perform the comparisons
  *
@@ -111,6 +152,327 @@ static inline size_t __bsearch(const void *restrict key, const void **restrict b
   return lo;
 }
 
+/**
+ * bplus_mark - marks @node and its ancestors on @stack as changed since the last checkpoint
+ *
+ * @stack: the path to @node, as pairs of an internal node and the index of the child taken
+ * @node:  the external node that has changed
+ *
+ * A checkpoint only visits the changed nodes, so that the ancestors of a changed node must be marked as well.
+ */
+static inline void bplus_mark(const struct stack *restrict stack, struct bplus_external_node *restrict node) {
+  for (node->slot = 0; !stack_empty(stack); stack = stack->next->next)
+    ((struct bplus_internal_node *)stack->next->value)->slot = 0;
+}
+
+/**
+ * bplus_read_lock - takes a snapshot of @version
+ *
+ * @version:  the version lock to take a snapshot of
+ * @snapshot: where to store the snapshot
+ *
+ * Returns false if @version is write-locked.
+ */
+static inline bool bplus_read_lock(const size_t *restrict version, size_t *restrict snapshot) {
+  *snapshot = __atomic_load_n(version, __ATOMIC_ACQUIRE);
+  return (*snapshot & 1) == 0;
+}
+
+/**
+ * bplus_validate - checks if @version has not changed since @snapshot was taken
+ *
+ * @version:  the version lock to validate
+ * @snapshot: the snapshot of @version
+ */
+static inline bool bplus_validate(const size_t *restrict version, const size_t snapshot) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(version, __ATOMIC_RELAXED) == snapshot;
+}
+
+/**
+ * bplus_upgrade - write-locks @version if it has not changed since @snapshot was taken
+ *
+ * @version:  the version lock to write-lock
+ * @snapshot: the snapshot of @version
+ */
+static inline bool bplus_upgrade(size_t *restrict version, size_t snapshot) {
+  if (!__atomic_compare_exchange_n(version, &snapshot, snapshot+1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return false;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * bplus_write_lock - write-locks @version, waiting for the current writer if any
+ *
+ * @version: the version lock to write-lock
+ */
+static inline void bplus_write_lock(size_t *restrict version) {
+  size_t snapshot;
+
+  while (!bplus_read_lock(version, &snapshot) || !bplus_upgrade(version, snapshot));
+}
+
+/**
+ * bplus_write_unlock - releases the write lock of @version, bumping it to a new version
+ *
+ * @version: the version lock to release
+ */
+static inline void bplus_write_unlock(size_t *restrict version) { __atomic_add_fetch(version, 1, __ATOMIC_RELEASE); }
+
+/**
+ * bplus_nmemb - reads @nmemb racing with writers, bounded by @capacity
+ *
+ * @nmemb:    the number of the keys to read
+ * @capacity: the maximum number of the keys
+ *
+ * A reader may see the node in the middle of a modification,
+ * so that the number of the keys must not lead it out of the arrays before the validation.
+ */
+static inline size_t bplus_nmemb(const size_t *restrict nmemb, const size_t capacity) {
+  const size_t count = __atomic_load_n(nmemb, __ATOMIC_ACQUIRE);
+  return count < capacity ? count : capacity;
+}
+
+/**
+ * __msort - sorts @keys and @values, which consist of @nmemb elements, in a stable manner using @less to perform the comparisons
+ *
+ * @keys:   the keys to sort
+ * @values: the values to sort along with @keys
+ * @nmemb:  number of elements in @keys
+ * @less:   operator defining the (partial) element order
+ */
+static inline void __msort(const void **restrict keys, void **restrict values, const size_t nmemb, bool (*less)(const void *restrict, const void *restrict)) {
+  register size_t lo;
+  register size_t mid;
+  register size_t hi;
+  register size_t idx;
+  register size_t jdx;
+  register size_t kdx;
+           size_t width;
+  const    void   **ktmp = malloc(__SIZEOF_POINTER__*nmemb);
+           void   **vtmp = malloc(__SIZEOF_POINTER__*nmemb);
+
+  for (width = 1; width < nmemb; width <<= 1) {
+    for (lo = 0; lo < nmemb-width; lo += width<<1) {
+      mid = lo+width;
+      hi  = nmemb-mid < width ? nmemb : mid+width;
+      if (!less(keys[mid], keys[mid-1])) continue;
+      memcpy(&ktmp[lo], &keys[lo], __SIZEOF_POINTER__*(hi-lo));
+      memcpy(&vtmp[lo], &values[lo], __SIZEOF_POINTER__*(hi-lo));
+      for (idx = lo, jdx = mid, kdx = lo; idx < mid && jdx < hi; ++kdx)
+        if (less(ktmp[jdx], ktmp[idx])) keys[kdx] = ktmp[jdx], values[kdx] = vtmp[jdx++];
+        else                            keys[kdx] = ktmp[idx], values[kdx] = vtmp[idx++];
+      memcpy(&keys[kdx], &ktmp[idx], __SIZEOF_POINTER__*(mid-idx));
+      memcpy(&values[kdx], &vtmp[idx], __SIZEOF_POINTER__*(mid-idx));
+    }
+  }
+
+  free(ktmp);
+  free(vtmp);
+}
+
+/**
+ * bplus_internal_splice - inserts @nmemb separators and children into @node right after @index child
+ *
+ * @tree:     tree to which @node belongs
+ * @node:     node to insert separators and children into
+ * @index:    index of the child that has been split
+ * @keys:     the separators to insert, to be overwritten with those to push up
+ * @children: the children to insert, to be overwritten with those to push up
+ * @nmemb:    number of separators to insert
+ * @buffer:   scratch space of at least @tree->order+@nmemb pointers per half
+ *
+ * Returns the number of separators to push up into the parent of @node,
+ * which is zero unless @node overflows.
+ */
+static inline size_t bplus_internal_splice(const struct bplus_root *restrict tree, struct bplus_internal_node *restrict node, const size_t index, const void **restrict keys, void **restrict children, const size_t nmemb, void **restrict buffer) {
+  register       size_t                     idx;
+  register       size_t                     cnt;
+  register       size_t                     off;
+  register struct bplus_internal_node *sibling;
+  const    void                       **kbuf  = (const void **)buffer;
+           void                       **cbuf  = &buffer[tree->order+nmemb];
+  const          size_t                     total = node->nmemb+nmemb+1;
+
+  if (total <= tree->order) {
+    memmove(&node->keys[index+nmemb], &node->keys[index], __SIZEOF_POINTER__*(node->nmemb-index));
+    memmove(&node->children[index+nmemb+1], &node->children[index+1], __SIZEOF_POINTER__*(node->nmemb-index));
+    memcpy(&node->keys[index], keys, __SIZEOF_POINTER__*nmemb);
+    memcpy(&node->children[index+1], children, __SIZEOF_POINTER__*nmemb);
+    node->nmemb += nmemb;
+    return 0;
+  }
+
+  memcpy(kbuf, node->keys, __SIZEOF_POINTER__*index);
+  memcpy(&kbuf[index], keys, __SIZEOF_POINTER__*nmemb);
+  memcpy(&kbuf[index+nmemb], &node->keys[index], __SIZEOF_POINTER__*(node->nmemb-index));
+  memcpy(cbuf, node->children, __SIZEOF_POINTER__*(index+1));
+  memcpy(&cbuf[index+1], children, __SIZEOF_POINTER__*nmemb);
+  memcpy(&cbuf[index+nmemb+1], &node->children[index+1], __SIZEOF_POINTER__*(node->nmemb-index));
+
+  cnt         = (total+tree->order-1)/tree->order;
+  node->nmemb = total/cnt-1;
+  memcpy(node->keys, kbuf, __SIZEOF_POINTER__*node->nmemb);
+  memcpy(node->children, cbuf, __SIZEOF_POINTER__*(node->nmemb+1));
+
+  for (idx = 1, off = node->nmemb+1; idx < cnt; ++idx) {
+    sibling        = bplus_internal_alloc(tree->order);
+    sibling->type  = node->type;
+    sibling->nmemb = total/cnt+(cnt-idx <= total%cnt)-1;
+    memcpy(sibling->keys, &kbuf[off], __SIZEOF_POINTER__*sibling->nmemb);
+    memcpy(sibling->children, &cbuf[off], __SIZEOF_POINTER__*(sibling->nmemb+1));
+    keys[idx-1]     = kbuf[off-1];
+    children[idx-1] = sibling;
+    off            += sibling->nmemb+1;
+  }
+
+  return cnt-1;
+}
+
+/**
+ * bplus_leftmost - returns the leftmost leaf of subtree rooted with @node
+ *
+ * @node:  root node of subtree
+ * @span:  the capacity of each child of @node, or 1 if @node is a leaf
+ * @order: the order of tree
+ */
+static inline struct bplus_external_node *bplus_leftmost(void *node, size_t span, const size_t order) {
+  for (; 1 < span; span /= order)
+    node = ((struct bplus_internal_node *)node)->children[0];
+  return node;
+}
+
+/**
+ * bplus_rightmost - returns the rightmost leaf of subtree rooted with @node
+ *
+ * @node:  root node of subtree
+ * @span:  the capacity of each child of @node, or 1 if @node is a leaf
+ * @order: the order of tree
+ */
+static inline struct bplus_external_node *bplus_rightmost(void *node, size_t span, const size_t order) {
+  for (; 1 < span; span /= order)
+    node = ((struct bplus_internal_node *)node)->children[((struct bplus_internal_node *)node)->nmemb];
+  return node;
+}
+
+/**
+ * struct bplus_task - a run of the children of an internal node to build
+ *
+ * @tree:    tree to build
+ * @node:    internal node whose children to build
+ * @keys:    the sorted keys of the tree
+ * @values:  the values of the tree
+ * @lo:      the index to the first element of @node
+ * @nmemb:   the number of the elements of @node
+ * @span:    the capacity of each child of @node
+ * @first:   the index to the first child to build
+ * @last:    the index past the last child to build
+ * @threads: the number of threads the run may use
+ */
+struct bplus_task {
+  const struct bplus_root          *tree;
+        struct bplus_internal_node *node;
+  const void                       **keys;
+        void                       **values;
+        size_t                     lo;
+        size_t                     nmemb;
+        size_t                     span;
+        size_t                     first;
+        size_t                     last;
+        size_t                     threads;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * bplus_bound - returns the index to the first element of @index-th child of a node
+ *
+ * @lo:    the index to the first element of the node
+ * @nmemb: the number of the elements of the node
+ * @count: the number of the children of the node
+ * @index: the index to the child
+ *
+ * The elements are spread evenly over the children, so that every child is more than half full.
+ */
+static inline size_t bplus_bound(const size_t lo, const size_t nmemb, const size_t count, const size_t index) { return lo + index*nmemb/count; }
+
+static void *bplus_build_subtree(const struct bplus_root *restrict tree, const void **restrict keys, void **restrict values, const size_t lo, const size_t nmemb, const size_t span, const size_t threads);
+
+static void *bplus_task_run(void *arg) {
+  struct bplus_task *task  = arg;
+  const size_t      count  = task->node->nmemb+1;
+  pthread_t         thread;
+
+  if (1 < task->threads && 1 < task->last-task->first && 1<<12 <= bplus_bound(0, task->nmemb, count, (task->last-task->first)>>1)) {
+    struct bplus_task lower = *task;
+    lower.last              = task->first + ((task->last-task->first)>>1);
+    lower.threads           = task->threads>>1;
+
+    if (pthread_create(&thread, NULL, bplus_task_run, &lower) == 0) {
+      struct bplus_task upper = *task;
+      upper.first             = lower.last;
+      upper.threads           = task->threads-lower.threads;
+      bplus_task_run(&upper);
+      pthread_join(thread, NULL);
+      return NULL;
+    }
+  }
+
+  for (register size_t idx = task->first; idx < task->last; ++idx)
+    task->node->children[idx] = bplus_build_subtree(task->tree, task->keys, task->values, bplus_bound(task->lo, task->nmemb, count, idx),
+                                                    bplus_bound(task->lo, task->nmemb, count, idx+1) - bplus_bound(task->lo, task->nmemb, count, idx),
+                                                    task->span/task->tree->order, task->last-task->first == 1 ? task->threads : 1);
+
+  return NULL;
+}
+
+/**
+ * bplus_build_subtree - builds a subtree of @nmemb elements from @lo-th element of @keys and @values
+ *
+ * @tree:    tree to build
+ * @keys:    the sorted keys of the tree
+ * @values:  the values of the tree
+ * @lo:      the index to the first element of the subtree
+ * @nmemb:   the number of the elements of the subtree, no more than @span times the order of @tree
+ * @span:    the capacity of each child of the root node of the subtree, or 1 to build a leaf
+ * @threads: the number of threads the subtree may use
+ *
+ * The leaves of the subtree are linked to each other, but not to the other leaves.
+ */
+static void *bplus_build_subtree(const struct bplus_root *restrict tree, const void **restrict keys, void **restrict values, const size_t lo, const size_t nmemb, const size_t span, const size_t threads) {
+  register size_t                     idx;
+  register struct bplus_external_node *left;
+  register struct bplus_external_node *right;
+
+  if (span == 1) {
+    struct bplus_external_node *leaf = bplus_external_alloc(tree->order);
+    memcpy(leaf->keys, &keys[lo], __SIZEOF_POINTER__*nmemb);
+    memcpy(leaf->values, &values[lo], __SIZEOF_POINTER__*nmemb);
+    leaf->nmemb = nmemb;
+    return leaf;
+  }
+
+  struct bplus_internal_node *node = bplus_internal_alloc(tree->order);
+  node->nmemb                      = (nmemb+span-1)/span - 1;
+  node->type                       = span == tree->order;
+
+  /* the separator is the greatest key of the left child, as bplus_insert pushes up */
+  for (idx = 0; idx < node->nmemb; ++idx)
+    node->keys[idx] = keys[bplus_bound(lo, nmemb, node->nmemb+1, idx+1)-1];
+
+  struct bplus_task task = { .tree = tree, .node = node, .keys = keys, .values = values, .lo = lo, .nmemb = nmemb, .span = span, .first = 0, .last = node->nmemb+1, .threads = threads };
+  bplus_task_run(&task);
+
+  /* the runs of leaves built by different threads are stitched together */
+  for (idx = 0; idx < node->nmemb; ++idx) {
+    left        = bplus_rightmost(node->children[idx], span/tree->order, tree->order);
+    right       = bplus_leftmost(node->children[idx+1], span/tree->order, tree->order);
+    left->next  = right;
+    right->prev = left;
+  }
+
+  return node;
+}
+
 extern void *bplus_find(const struct bplus_root tree, const void *restrict key) {
   register       size_t                     idx;
   register const struct bplus_internal_node *walk = tree.root;
@@ -180,6 +542,7 @@ extern struct bplus_external_node *bplus_insert(struct bplus_root *restrict tree
   if ((idx = __bsearch(key, node->keys, node->nmemb, tree->less)) < node->nmemb &&
       !(tree->less(key, node->keys[idx]) || tree->less(node->keys[idx], key))) { stack_clear(&stack); return NULL; }
 
+  bplus_mark(stack, node);
   ++tree->size;
 
   if (node->nmemb < tree->order) {
@@ -328,6 +691,8 @@ extern struct bplus_external_node *bplus_insert_or_assign(struct bplus_root *res
     return node;
   }
 
+  bplus_mark(stack, node);
+
   if ((idx = __bsearch(key, node->keys, node->nmemb, tree->less)) < node->nmemb &&
       !(tree->less(key, node->keys[idx]) || tree->less(node->keys[idx], key))) { stack_clear(&stack); node->values[idx] = value; return node; }
 
@@ -451,6 +816,148 @@ extern struct bplus_external_node *bplus_insert_or_assign(struct bplus_root *res
   return node;
 }
 
+extern size_t bplus_insert_batch(struct bplus_root *restrict tree, const void **restrict keys, void **restrict values, const size_t nmemb) {
+  register       size_t                     idx;
+  register       size_t                     jdx;
+  register       size_t                     kdx;
+  register       size_t                     lo;
+  register       size_t                     hi;
+  register struct bplus_internal_node *walk;
+  register struct bplus_internal_node *root;
+  register struct bplus_external_node *sib;
+                 size_t                     cnt;
+                 size_t                     total;
+                 size_t                     pos;
+                 size_t                     end;
+                 size_t                     inserted = 0;
+  const    void                       *sup;
+           struct bplus_external_node *node;
+           struct stack               *stack = NULL;
+
+  if (nmemb == 0) return 0;
+
+  const void **batch  = malloc(__SIZEOF_POINTER__*nmemb);
+        void **vbatch = malloc(__SIZEOF_POINTER__*nmemb);
+  const void **seps   = malloc(__SIZEOF_POINTER__*(nmemb+1));
+        void **kids   = malloc(__SIZEOF_POINTER__*(nmemb+1));
+  const void **kbuf   = malloc(__SIZEOF_POINTER__*(nmemb+tree->order+1));
+        void **vbuf   = malloc(__SIZEOF_POINTER__*(nmemb+tree->order+1));
+        void **buf    = malloc(__SIZEOF_POINTER__*(nmemb+tree->order+1)*2);
+
+  memcpy(batch, keys, __SIZEOF_POINTER__*nmemb);
+  memcpy(vbatch, values, __SIZEOF_POINTER__*nmemb);
+  __msort(batch, vbatch, nmemb, tree->less);
+
+  for (idx = 1, end = 1; idx < nmemb; ++idx)   /* the first occurrence of each key wins */
+    if (tree->less(batch[end-1], batch[idx])) batch[end] = batch[idx], vbatch[end++] = vbatch[idx];
+
+  if (tree->head == NULL) {
+    tree->head = bplus_external_alloc(tree->order);
+    tree->tail = tree->head;
+  }
+
+  for (pos = 0; pos < end; pos = hi) {
+    sup  = NULL;
+    walk = tree->root;
+    node = tree->head;
+
+    while (walk != NULL) {                     /* the path is marked on the way, as the run is merged into @node */
+      idx        = __bsearch(batch[pos], walk->keys, walk->nmemb, tree->less);
+      walk->slot = 0;
+      if (idx < walk->nmemb) sup = walk->keys[idx];
+      if (walk->type) node = walk->children[idx], walk = NULL;
+      else            walk = walk->children[idx];
+    }
+    node->slot = 0;
+
+    lo = pos+1;                                /* the run of the batch that falls into @node */
+    hi = end;
+    if (sup != NULL)
+      while (lo < hi) {
+        idx = (lo+hi)>>1;
+        if (tree->less(sup, batch[idx])) hi = idx;
+        else                             lo = idx+1;
+      }
+
+    for (idx = 0, jdx = pos, total = 0; idx < node->nmemb || jdx < hi; ++total)
+      if (jdx == hi || (idx < node->nmemb && tree->less(node->keys[idx], batch[jdx]))) {
+        kbuf[total] = node->keys[idx];
+        vbuf[total] = node->values[idx++];
+      } else if (idx == node->nmemb || tree->less(batch[jdx], node->keys[idx])) {
+        kbuf[total] = batch[jdx];
+        vbuf[total] = vbatch[jdx++];
+      } else {
+        kbuf[total] = node->keys[idx];
+        vbuf[total] = node->values[idx++];
+        ++jdx;
+      }
+
+    inserted += total-node->nmemb;
+
+    if (total <= tree->order) {
+      memcpy(node->keys, kbuf, __SIZEOF_POINTER__*total);
+      memcpy(node->values, vbuf, __SIZEOF_POINTER__*total);
+      node->nmemb = total;
+      continue;
+    }
+
+    for (walk = tree->root; walk != NULL;) {   /* the path is only needed when @node overflows */
+      idx = __bsearch(batch[pos], walk->keys, walk->nmemb, tree->less);
+      stack_push(&stack, walk);
+      stack_push(&stack, (void *)idx);
+      walk = walk->type ? NULL : walk->children[idx];
+    }
+
+    cnt         = (total+tree->order-1)/tree->order;
+    node->nmemb = total/cnt;
+    memcpy(node->keys, kbuf, __SIZEOF_POINTER__*node->nmemb);
+    memcpy(node->values, vbuf, __SIZEOF_POINTER__*node->nmemb);
+
+    for (idx = 1, kdx = node->nmemb; idx < cnt; ++idx) {
+      sib        = bplus_external_alloc(tree->order);
+      sib->nmemb = total/cnt+(cnt-idx <= total%cnt);
+      memcpy(sib->keys, &kbuf[kdx], __SIZEOF_POINTER__*sib->nmemb);
+      memcpy(sib->values, &vbuf[kdx], __SIZEOF_POINTER__*sib->nmemb);
+      sib->prev  = node;
+      sib->next  = node->next;
+      node->next = sib;
+      if (sib->next == NULL) tree->tail      = sib;
+      else                   sib->next->prev = sib;
+      seps[idx-1] = kbuf[kdx-1];
+      kids[idx-1] = sib;
+      kdx        += sib->nmemb;
+      node        = sib;
+    }
+
+    for (cnt -= 1; 0 < cnt && !stack_empty(stack);) {
+      idx  = (size_t)stack_pop(&stack);
+      walk = stack_pop(&stack);
+      cnt  = bplus_internal_splice(tree, walk, idx, seps, kids, cnt, buf);
+    }
+
+    for (; 0 < cnt; cnt = bplus_internal_splice(tree, root, 0, seps, kids, cnt, buf)) {
+      root              = bplus_internal_alloc(tree->order);
+      root->children[0] = tree->root == NULL ? (void *)tree->head : tree->root;
+      root->type        = tree->root == NULL;
+      tree->root        = root;
+    }
+
+    stack_clear(&stack);
+  }
+
+  tree->size += inserted;
+
+  free(batch);
+  free(vbatch);
+  free(seps);
+  free(kids);
+  free(kbuf);
+  free(vbuf);
+  free(buf);
+
+  return inserted;
+}
+
 extern void *bplus_erase(struct bplus_root *restrict tree, const void *restrict key) {
   register size_t                     idx;
   register struct bplus_internal_node *parent;
@@ -474,6 +981,7 @@ extern void *bplus_erase(struct bplus_root *restrict tree, const void *restrict
 
   void *erased = node->values[idx];
 
+  bplus_mark(stack, node);
   memmove(&node->keys[idx], &node->keys[idx+1], __SIZEOF_POINTER__*(--node->nmemb-idx));
   memmove(&node->values[idx], &node->values[idx+1], __SIZEOF_POINTER__*(node->nmemb-idx));
   --tree->size;
@@ -495,6 +1003,7 @@ extern void *bplus_erase(struct bplus_root *restrict tree, const void *restrict
                                   : idx == walk->nmemb                                                                                                          ? walk->children[idx-1]
                                   : ((struct bplus_external_node *)walk->children[idx-1])->nmemb < ((struct bplus_external_node *)walk->children[idx+1])->nmemb ? walk->children[idx+1]
                                                                                                                                                                 : walk->children[idx-1];
+  sib->slot                       = 0;
   if ((tree->order+1)>>1 < sib->nmemb) {                 /* case of key redistribution */
     if (0 < idx && sib == walk->children[idx-1]) {
       memmove(&node->keys[1], node->keys, __SIZEOF_POINTER__*node->nmemb);
@@ -544,6 +1053,7 @@ extern void *bplus_erase(struct bplus_root *restrict tree, const void *restrict
             : idx == parent->nmemb                                                                                                            ? parent->children[idx-1]
             : ((struct bplus_internal_node *)parent->children[idx-1])->nmemb < ((struct bplus_internal_node *)parent->children[idx+1])->nmemb ? parent->children[idx+1]
                                                                                                                                               : parent->children[idx-1];
+    sibling->slot = 0;
     if ((tree->order-1)>>1 < sibling->nmemb) {           /* case of key redistribution */
       if (0 < idx && sibling == parent->children[idx-1]) {
         memmove(&walk->keys[1], walk->keys, __SIZEOF_POINTER__*walk->nmemb);
@@ -596,6 +1106,61 @@ extern void bplus_clear(struct bplus_root *restrict tree) {
   tree->size = 0;
 }
 
+extern void bplus_clone(struct bplus_root *restrict tree, const struct bplus_root other) {
+  register size_t                     idx;
+  register size_t                     head;
+  register size_t                     tail;
+  register struct bplus_internal_node *node;
+  register struct bplus_external_node *leaf;
+
+  if (other.head == NULL)
+    return;
+
+  tree->size = other.size;
+
+  if (other.root == NULL) {
+    tree->head = bplus_external_copy(other.head, tree->order);
+    tree->tail = tree->head;
+    return;
+  }
+
+  struct bplus_internal_node **queue = malloc(__SIZEOF_POINTER__*(other.size+1));
+  queue[0] = tree->root = bplus_internal_copy(other.root, tree->order);
+
+  for (head = 0, tail = 1; head < tail; ++head)
+    for (node = queue[head], idx = 0; idx <= node->nmemb; ++idx) {
+      if (!node->type) {
+        queue[tail++] = node->children[idx] = bplus_internal_copy(node->children[idx], tree->order);
+        continue;
+      }
+      /* the leaves are reached from left to right, since they all appear in the same level */
+      node->children[idx] = leaf = bplus_external_copy(node->children[idx], tree->order);
+      leaf->prev              = tree->tail;
+      if (tree->tail == NULL) tree->head       = leaf;
+      else                    tree->tail->next = leaf;
+      tree->tail              = leaf;
+    }
+
+  free(queue);
+}
+
+extern void bplus_build(struct bplus_root *restrict tree, const void **restrict keys, void **restrict values, const size_t nmemb, const size_t threads) {
+  register size_t span = 1;
+           void   *root;
+
+  if (nmemb == 0)
+    return;
+
+  while (span*tree->order < nmemb)
+    span *= tree->order;
+
+  root       = bplus_build_subtree(tree, keys, values, 0, nmemb, span, threads);
+  tree->root = span == 1 ? NULL : root;
+  tree->head = bplus_leftmost(root, span, tree->order);
+  tree->tail = bplus_rightmost(root, span, tree->order);
+  tree->size = nmemb;
+}
+
 extern void bplus_range_each(const struct bplus_root tree, const void *restrict inf, const void *restrict sup, void (*func)(const void *restrict, void *restrict)) {
   register       size_t                     idx;
   register       size_t                     edx;
@@ -622,3 +1187,851 @@ extern void bplus_range_each(const struct bplus_root tree, const void *restrict
     if (idx < node->nmemb) return;
   }
 }
+
+/**
+ * bplus_range_map - applies @map to @acc and each element of @tree greater than or equal to @inf and less than @sup
+ *
+ * @tree: tree to apply @map to each element of
+ * @inf:  the lower bound key to search for, or NULL for no lower bound
+ * @sup:  the upper bound key to search for, or NULL for no upper bound
+ * @map:  function to accumulate each element of @tree into @acc
+ * @acc:  the accumulator
+ */
+static inline void bplus_range_map(const struct bplus_root *restrict tree, const void *inf, const void *sup, void (*map)(void *restrict, const void *restrict, void *restrict), void *restrict acc) {
+  register       size_t                     idx  = 0;
+  register       size_t                     edx;
+  register const struct bplus_internal_node *walk = inf == NULL ? NULL : tree->root;
+  register const struct bplus_external_node *node = tree->head;
+
+  while (walk != NULL) {
+    idx = __bsearch(inf, walk->keys, walk->nmemb, tree->less);
+    if (walk->type) node = walk->children[idx], walk = NULL;
+    else            walk = walk->children[idx];
+  }
+
+  if (node != NULL && inf != NULL)
+    idx = __bsearch(inf, node->keys, node->nmemb, tree->less);
+
+  for (; node != NULL; node = node->next, idx = 0) {
+    edx = sup == NULL ? node->nmemb : __bsearch(sup, node->keys, node->nmemb, tree->less);
+    for (; idx < edx; ++idx)
+      map(acc, node->keys[idx], node->values[idx]);
+    if (edx < node->nmemb) return;
+  }
+}
+
+/**
+ * bplus_partition - finds up to @nmemb-1 separators splitting the leaves between @inf and @sup into @nmemb runs of about the same length
+ *
+ * @tree:   tree to split
+ * @inf:    the lower bound key of the range, or NULL for no lower bound
+ * @sup:    the upper bound key of the range, or NULL for no upper bound
+ * @bounds: where to store the separators in ascending order
+ * @nmemb:  the number of runs
+ *
+ * The separators are taken from the highest level of the internal nodes that has enough of them within the range.
+ *
+ * Returns the number of the separators found, which is zero if the levels cannot be allocated.
+ */
+static inline size_t bplus_partition(const struct bplus_root *restrict tree, const void *inf, const void *sup, const void **restrict bounds, const size_t nmemb) {
+  register size_t                     idx;
+  register size_t                     pos;
+  register size_t                     count;
+  register size_t                     width = 1;
+  register size_t                     total;
+  register struct bplus_internal_node *node;
+           struct bplus_internal_node **level = malloc(__SIZEOF_POINTER__);
+           struct bplus_internal_node **next;
+           const void                 **keys;
+
+  if (level == NULL) return 0;
+
+  level[0] = tree->root;
+
+  for (;;) {
+    for (total = 0, pos = 0; pos < width; ++pos)
+      total += level[pos]->nmemb;
+
+    if ((keys = malloc(__SIZEOF_POINTER__*total)) == NULL) {
+      free(level);
+      return 0;
+    }
+
+    for (count = 0, pos = 0; pos < width; ++pos)
+      for (node = level[pos], idx = 0; idx < node->nmemb; ++idx)
+        if ((inf == NULL || !tree->less(node->keys[idx], inf)) && (sup == NULL || tree->less(node->keys[idx], sup)))
+          keys[count++] = node->keys[idx];
+
+    if (nmemb <= count+1 || level[0]->type)
+      break;
+
+    /* case of too few separators in the range, which are then looked for one level down */
+    next = malloc(__SIZEOF_POINTER__*(total+width));
+    if (next == NULL) {
+      free(keys);
+      free(level);
+      return 0;
+    }
+    for (total = 0, pos = 0; pos < width; ++pos)
+      for (node = level[pos], idx = 0; idx <= node->nmemb; ++idx)
+        if ((idx == node->nmemb || inf == NULL || !tree->less(node->keys[idx], inf)) && (idx == 0 || sup == NULL || tree->less(node->keys[idx-1], sup)))
+          next[total++] = node->children[idx];
+
+    free(keys);
+    free(level);
+    level = next;
+    width = total;
+  }
+
+  if (count+1 <= nmemb) {
+    memcpy(bounds, keys, __SIZEOF_POINTER__*count);
+  } else {
+    for (idx = 1; idx < nmemb; ++idx)
+      bounds[idx-1] = keys[idx*(count+1)/nmemb-1];
+    count = nmemb-1;
+  }
+
+  free(keys);
+  free(level);
+
+  return count;
+}
+
+/**
+ * struct bplus_scan - a run of leaves to scan on a thread
+ *
+ * @tree: tree to scan
+ * @inf:  the lower bound key of the run, or NULL for no lower bound
+ * @sup:  the upper bound key of the run, or NULL for no upper bound
+ * @map:  function to accumulate each element of the run into @acc
+ * @acc:  the partial result of the run
+ */
+struct bplus_scan {
+  const struct bplus_root *tree;
+  const void              *inf;
+  const void              *sup;
+        void              (*map)(void *restrict, const void *restrict, void *restrict);
+        void              *acc;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+static void *bplus_scan_run(void *arg) {
+  struct bplus_scan *scan = arg;
+  bplus_range_map(scan->tree, scan->inf, scan->sup, scan->map, scan->acc);
+  return NULL;
+}
+
+/**
+ * bplus_scan_reduce - applies @map to each element of @tree between @inf and @sup on up to @threads threads, and @reduce to their partial results
+ *
+ * @tree:    tree to scan
+ * @inf:     the lower bound key to search for, or NULL for no lower bound
+ * @sup:     the upper bound key to search for, or NULL for no upper bound
+ * @map:     function to accumulate each element into a partial result
+ * @reduce:  function to accumulate a partial result into another
+ * @acc:     the accumulator of @size bytes, holding the identity of @reduce
+ * @size:    the size of @acc
+ * @threads: the number of threads to use
+ */
+static inline void bplus_scan_reduce(const struct bplus_root *restrict tree, const void *inf, const void *sup, void (*map)(void *restrict, const void *restrict, void *restrict),
+                                     void (*reduce)(void *restrict, const void *restrict), void *restrict acc, const size_t size, const size_t threads) {
+  register size_t idx;
+
+  if (threads <= 1 || tree->root == NULL) {
+    bplus_range_map(tree, inf, sup, map, acc);
+    return;
+  }
+
+  const void        **bounds  = malloc(__SIZEOF_POINTER__*(threads-1));
+  const size_t      nmemb     = bounds == NULL ? 1 : bplus_partition(tree, inf, sup, bounds, threads)+1;
+  /* each partial result takes whole cache lines, so that the threads do not invalidate each other */
+  const size_t      stride    = (size+63) & ~(size_t)63;
+  char              *partials = aligned_alloc(64, stride*nmemb);
+  struct bplus_scan *scans    = malloc(sizeof(struct bplus_scan)*nmemb);
+  pthread_t         *workers  = malloc(sizeof(pthread_t)*nmemb);
+  bool              *spawned  = malloc(sizeof(bool)*nmemb);
+
+  /* case of allocation failure, falling back to a scan on the calling thread */
+  if (bounds == NULL || partials == NULL || scans == NULL || workers == NULL || spawned == NULL) {
+    free(bounds);
+    free(partials);
+    free(scans);
+    free(workers);
+    free(spawned);
+    bplus_range_map(tree, inf, sup, map, acc);
+    return;
+  }
+
+  for (idx = 0; idx < nmemb; ++idx) {
+    memcpy(&partials[stride*idx], acc, size);
+    scans[idx].tree = tree;
+    scans[idx].inf  = idx == 0       ? inf : bounds[idx-1];
+    scans[idx].sup  = idx == nmemb-1 ? sup : bounds[idx];
+    scans[idx].map  = map;
+    scans[idx].acc  = &partials[stride*idx];
+    spawned[idx]    = idx < nmemb-1 && pthread_create(&workers[idx], NULL, bplus_scan_run, &scans[idx]) == 0;
+  }
+
+  for (idx = 0; idx < nmemb; ++idx) {
+    if (spawned[idx]) pthread_join(workers[idx], NULL);
+    else              bplus_scan_run(&scans[idx]);
+  }
+
+  /* the partial results are reduced in ascending order of their runs, so that @reduce need not be commutative */
+  for (idx = 0; idx < nmemb; ++idx)
+    reduce(acc, &partials[stride*idx]);
+
+  free(bounds);
+  free(partials);
+  free(scans);
+  free(workers);
+  free(spawned);
+}
+
+extern void bplus_reduce(const struct bplus_root tree, void (*map)(void *restrict, const void *restrict, void *restrict), void (*reduce)(void *restrict, const void *restrict), void *restrict acc, const size_t size, const size_t threads) {
+  bplus_scan_reduce(&tree, NULL, NULL, map, reduce, acc, size, threads);
+}
+
+extern void bplus_range_reduce(const struct bplus_root tree, const void *restrict inf, const void *restrict sup, void (*map)(void *restrict, const void *restrict, void *restrict),
+                               void (*reduce)(void *restrict, const void *restrict), void *restrict acc, const size_t size, const size_t threads) {
+  bplus_scan_reduce(&tree, inf, sup, map, reduce, acc, size, threads);
+}
+
+extern bool bplus_freeze(struct bplus_frozen *restrict frozen, struct bplus_root *restrict tree) {
+  register       size_t                     idx;
+  register       size_t                     level;
+  register       size_t                     nodes;
+  register       size_t                     slots = 0;
+  register       size_t                     pos   = 0;
+  register const struct bplus_external_node *node;
+  const          size_t                     order = tree->order;
+  const          size_t                     size  = tree->size;
+
+  memset(frozen, 0, sizeof(struct bplus_frozen));
+  frozen->less  = tree->less;
+  frozen->order = order;
+
+  if (size == 0)
+    return true;
+
+  /* the internal levels are counted bottom-up, until a single node covers all the external nodes */
+  for (nodes = (size+order-1)/order; 1 < nodes; nodes = (nodes+order-1)/order)
+    ++frozen->height;
+
+  frozen->keys    = malloc(__SIZEOF_POINTER__*size);
+  frozen->values  = malloc(__SIZEOF_POINTER__*size);
+  frozen->offsets = malloc(sizeof(size_t)*(frozen->height+1));
+  frozen->spans   = malloc(sizeof(size_t)*(frozen->height+1));
+
+  if (frozen->keys == NULL || frozen->values == NULL || frozen->offsets == NULL || frozen->spans == NULL) {
+    bplus_frozen_destroy(frozen);
+    return false;
+  }
+
+  for (level = frozen->height, frozen->spans[level] = 1; 0 < level; --level)
+    frozen->spans[level-1] = frozen->spans[level]*order;
+
+  for (level = 0; level < frozen->height; ++level) {
+    frozen->offsets[level] = slots;
+    slots                 += (size+frozen->spans[level]*order-1)/(frozen->spans[level]*order)*(order-1);
+  }
+
+  if (0 < slots && (frozen->index = malloc(__SIZEOF_POINTER__*slots)) == NULL) {
+    bplus_frozen_destroy(frozen);
+    return false;
+  }
+
+  for (node = tree->head; node != NULL; pos += node->nmemb, node = node->next) {
+    memcpy(frozen->keys+pos, node->keys, __SIZEOF_POINTER__*node->nmemb);
+    memcpy(frozen->values+pos, node->values, __SIZEOF_POINTER__*node->nmemb);
+  }
+
+  /* the separator of the j-th child of the i-th node is the first key under the (i*order+j)-th node below */
+  for (level = 0; level < frozen->height; ++level)
+    for (nodes = (size+frozen->spans[level]-1)/frozen->spans[level], idx = 0; idx < nodes; ++idx)
+      if (idx % order != 0)
+        frozen->index[frozen->offsets[level] + idx/order*(order-1) + idx%order-1] = frozen->keys[idx*frozen->spans[level]];
+
+  frozen->size = size;
+  bplus_clear(tree);
+
+  return true;
+}
+
+extern void bplus_frozen_destroy(struct bplus_frozen *frozen) {
+  free(frozen->keys);
+  free(frozen->values);
+  free(frozen->index);
+  free(frozen->offsets);
+  free(frozen->spans);
+  frozen->keys    = NULL;
+  frozen->values  = NULL;
+  frozen->index   = NULL;
+  frozen->offsets = NULL;
+  frozen->spans   = NULL;
+  frozen->height  = 0;
+  frozen->size    = 0;
+}
+
+/**
+ * bplus_frozen_descend - returns the offset in @frozen of the external node which may contain @key
+ *
+ * @frozen: frozen tree to search
+ * @key:    the key to search for
+ */
+static inline size_t bplus_frozen_descend(const struct bplus_frozen *restrict frozen, const void *restrict key) {
+  register       size_t lo;
+  register       size_t hi;
+  register       size_t mid;
+  register       size_t nmemb;
+  register       size_t idx = 0;
+  register const void   **base;
+
+  for (register size_t level = 0; level < frozen->height; ++level) {
+    /* the last node of a level may have fewer children than the order */
+    nmemb = (frozen->size+frozen->spans[level]-1)/frozen->spans[level] - idx*frozen->order;
+    nmemb = nmemb < frozen->order ? nmemb : frozen->order;
+    base  = frozen->index + frozen->offsets[level] + idx*(frozen->order-1);
+    /* take the last child whose separator is less than or equal to @key */
+    for (lo = 0, hi = nmemb-1; lo < hi;) {
+      mid = (lo+hi)>>1;
+      if (frozen->less(key, base[mid])) hi = mid;
+      else                              lo = mid+1;
+    }
+    idx = idx*frozen->order + lo;
+  }
+
+  return idx*frozen->order;
+}
+
+extern void *bplus_frozen_find(const struct bplus_frozen *restrict frozen, const void *restrict key) {
+  register size_t lo;
+  register size_t nmemb;
+  register size_t idx;
+
+  if (frozen->size == 0)
+    return NULL;
+
+  lo    = bplus_frozen_descend(frozen, key);
+  nmemb = frozen->size-lo < frozen->order ? frozen->size-lo : frozen->order;
+  idx   = lo + __bsearch(key, frozen->keys+lo, nmemb, frozen->less);
+
+  return idx < lo+nmemb && !frozen->less(key, frozen->keys[idx]) && !frozen->less(frozen->keys[idx], key) ? frozen->values[idx] : NULL;
+}
+
+extern bool bplus_frozen_contains(const struct bplus_frozen *restrict frozen, const void *restrict key) {
+  register size_t lo;
+  register size_t nmemb;
+  register size_t idx;
+
+  if (frozen->size == 0)
+    return false;
+
+  lo    = bplus_frozen_descend(frozen, key);
+  nmemb = frozen->size-lo < frozen->order ? frozen->size-lo : frozen->order;
+  idx   = lo + __bsearch(key, frozen->keys+lo, nmemb, frozen->less);
+
+  return idx < lo+nmemb && !frozen->less(key, frozen->keys[idx]) && !frozen->less(frozen->keys[idx], key);
+}
+
+extern void bplus_frozen_range_each(const struct bplus_frozen *restrict frozen, const void *restrict inf, const void *restrict sup, void (*func)(const void *restrict, void *restrict)) {
+  register size_t lo;
+  register size_t nmemb;
+  register size_t idx;
+
+  if (frozen->size == 0)
+    return;
+
+  lo    = bplus_frozen_descend(frozen, inf);
+  nmemb = frozen->size-lo < frozen->order ? frozen->size-lo : frozen->order;
+
+  /* the external nodes are contiguous, so that the scan runs across them without following any link */
+  for (idx = lo + __bsearch(inf, frozen->keys+lo, nmemb, frozen->less); idx < frozen->size && frozen->less(frozen->keys[idx], sup); ++idx)
+    func(frozen->keys[idx], frozen->values[idx]);
+}
+
+/**
+ * bplus_olc_level - returns the level of @node, counting the leaves as level 0
+ *
+ * @node: internal node to get the level of, or NULL for the leaves
+ *
+ * The leftmost child of a node never changes, so that the leftmost path is walked without validation.
+ */
+static inline size_t bplus_olc_level(const struct bplus_internal_node *restrict node) {
+  register size_t level = 0;
+
+  for (; node != NULL; node = node->type ? NULL : node->children[0])
+    ++level;
+
+  return level;
+}
+
+/**
+ * bplus_olc_mark - marks @node and the nodes on @path as changed since the last checkpoint
+ *
+ * @path:  the internal nodes visited above @node, from the top down
+ * @depth: the number of the nodes in @path
+ * @node:  the external node that has changed
+ *
+ * The nodes are marked racing with the other writers, all of which only ever clear the slots.
+ */
+static inline void bplus_olc_mark(struct bplus_internal_node **restrict path, const size_t depth, struct bplus_external_node *restrict node) {
+  __atomic_store_n(&node->slot, 0, __ATOMIC_RELAXED);
+
+  for (register size_t idx = 0; idx < depth; ++idx)
+    __atomic_store_n(&path[idx]->slot, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * bplus_olc_key - reads the key at @slot of a node racing with writers, validating the node against @snapshot
+ *
+ * @version:  the version lock of the node
+ * @snapshot: the snapshot of @version taken before reading the node
+ * @slot:     where to read the key from
+ * @key:      where to store the key
+ *
+ * A key read from a node in the middle of a modification may be torn or already released by its owner,
+ * so that it must only be handed to the operator once the node is validated.
+ *
+ * Returns false if the node has changed since @snapshot, in which case @key must not be used.
+ */
+static inline bool bplus_olc_key(const size_t *restrict version, const size_t snapshot, const void *const *restrict slot, const void **restrict key) {
+  *key = __atomic_load_n(slot, __ATOMIC_RELAXED);
+  return bplus_validate(version, snapshot);
+}
+
+/**
+ * bplus_olc_bsearch - do a binary search for @key in @base racing with writers, validating each key before comparing it
+ *
+ * @tree:     tree to which the node belongs
+ * @version:  the version lock of the node
+ * @snapshot: the snapshot of @version taken before reading the node
+ * @key:      the key to search for
+ * @base:     where to search @key
+ * @nmemb:    number of elements in @base
+ * @idx:      where to store the index of @key, or of the first key greater than @key if there is none
+ * @found:    where to store whether @key is found
+ *
+ * Returns false if the node has changed since @snapshot, in which case @idx and @found must not be used.
+ */
+static inline bool bplus_olc_bsearch(const struct bplus_root *restrict tree, const size_t *restrict version, const size_t snapshot, const void *restrict key, const void **base, const size_t nmemb,
+                                     size_t *restrict idx, bool *restrict found) {
+  register size_t     lo = 0;
+  register size_t     hi = nmemb;
+           const void *pivot;
+
+  *found = false;
+
+  while (lo < hi) {
+    *idx = (lo+hi)>>1;
+    if (!bplus_olc_key(version, snapshot, base + *idx, &pivot)) return false;
+    if (tree->less(key, pivot))      hi = *idx;
+    else if (tree->less(pivot, key)) lo = *idx+1;
+    else                             return *found = true;
+  }
+
+  *idx = lo;
+
+  return true;
+}
+
+/**
+ * bplus_olc_descend - finds the node of @tree at @level that may contain @key without taking any lock
+ *
+ * @tree:  tree to search
+ * @key:   the key to search for
+ * @level: the level of the node to find, counting the leaves as level 0
+ * @path:  where to store the internal nodes visited above @level, from the top down
+ * @depth: where to store the number of the nodes in @path
+ *
+ * Returns NULL if @tree has no node at @level yet.
+ */
+static inline void *bplus_olc_descend(struct bplus_root *restrict tree, const void *restrict key, const size_t level, struct bplus_internal_node **restrict path, size_t *restrict depth) {
+  register size_t                     height = 0;
+  register struct bplus_internal_node *walk;
+  register struct bplus_internal_node *next;
+  register void                       *child;
+           size_t                     idx;
+           size_t                     version;
+           const  void                *high;
+           bool                       found;
+
+  *depth = 0;
+  walk   = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+
+  if (walk == NULL)
+    return level == 0 ? __atomic_load_n(&tree->head, __ATOMIC_ACQUIRE) : NULL;
+
+  if (0 < level && (height = bplus_olc_level(walk)) < level)
+    return NULL;
+
+  for (;;) {
+    if (!bplus_read_lock(&walk->version, &version))
+      continue;
+    next = __atomic_load_n(&walk->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+      if (!bplus_olc_key(&walk->version, version, &walk->high, &high))
+        continue;
+      if (tree->less(high, key)) { /* case of concurrent split */
+        walk = next;
+        continue;
+      }
+    }
+    if (0 < level && height == level) {
+      if (bplus_validate(&walk->version, version))
+        return walk;
+      continue;
+    }
+    if (!bplus_olc_bsearch(tree, &walk->version, version, key, walk->keys, bplus_nmemb(&walk->nmemb, tree->order-1), &idx, &found))
+      continue;
+    child = walk->children[idx];
+    if (!bplus_validate(&walk->version, version))
+      continue;
+    path[(*depth)++] = walk;
+    if (walk->type)
+      return child;
+    walk = child;
+    --height;
+  }
+}
+
+/**
+ * bplus_internal_lock - write-locks the internal node covering @key, moving right from @node as needed
+ *
+ * @tree: tree to which @node belongs
+ * @node: the node to start from
+ * @key:  the key to be covered
+ */
+static inline struct bplus_internal_node *bplus_internal_lock(const struct bplus_root *restrict tree, struct bplus_internal_node *restrict node, const void *restrict key) {
+  bplus_write_lock(&node->version);
+
+  while (node->next != NULL && tree->less(node->high, key)) {
+    bplus_write_lock(&node->next->version);
+    bplus_write_unlock(&node->version);
+    node = node->next;
+  }
+
+  return node;
+}
+
+/**
+ * bplus_external_lock - write-locks the external node covering @key, moving right from @node as needed
+ *
+ * @tree: tree to which @node belongs
+ * @node: the node to start from
+ * @key:  the key to be covered
+ */
+static inline struct bplus_external_node *bplus_external_lock(const struct bplus_root *restrict tree, struct bplus_external_node *restrict node, const void *restrict key) {
+  bplus_write_lock(&node->version);
+
+  while (node->next != NULL && node->high != NULL && tree->less(node->high, key)) {
+    bplus_write_lock(&node->next->version);
+    bplus_write_unlock(&node->version);
+    node = node->next;
+  }
+
+  return node;
+}
+
+/**
+ * bplus_olc_push - inserts @key and @child into non-full internal @node
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  write-locked node to insert into
+ * @key:   the key to insert
+ * @child: the child to insert right after @key
+ */
+static inline void bplus_olc_push(const struct bplus_root *restrict tree, struct bplus_internal_node *restrict node, const void *restrict key, void *restrict child) {
+  const size_t idx = __bsearch(key, node->keys, node->nmemb, tree->less);
+
+  memmove(&node->keys[idx+1], &node->keys[idx], __SIZEOF_POINTER__*(node->nmemb-idx));
+  memmove(&node->children[idx+2], &node->children[idx+1], __SIZEOF_POINTER__*(node->nmemb-idx));
+  node->keys[idx]       = key;
+  node->children[idx+1] = child;
+  __atomic_store_n(&node->nmemb, node->nmemb+1, __ATOMIC_RELEASE);
+}
+
+/**
+ * bplus_olc_split - splits full internal @node along with the insertion of @key and @child
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  write-locked node to split
+ * @key:   the key to insert, replaced with the key to push up
+ * @child: the child to insert right after @key
+ *
+ * Returns the new right sibling of @node, which is linked from @node before @node is unlocked.
+ */
+static inline struct bplus_internal_node *bplus_olc_split(const struct bplus_root *restrict tree, struct bplus_internal_node *restrict node, const void **restrict key, void *restrict child) {
+  struct bplus_internal_node *sibling = bplus_internal_alloc(tree->order);
+  const  size_t              idx      = __bsearch(*key, node->keys, node->nmemb, tree->less);
+  const  size_t              mid      = (node->nmemb+1)>>1;
+  const  void                *sep;
+
+  /* the keys of @node with @key inserted at @idx are split into [0, mid), mid and (mid, nmemb] */
+  for (register size_t pos = mid+1; pos <= node->nmemb; ++pos)
+    sibling->keys[pos-mid-1] = pos < idx ? node->keys[pos] : pos == idx ? *key : node->keys[pos-1];
+  for (register size_t pos = mid+1; pos <= node->nmemb+1; ++pos)
+    sibling->children[pos-mid-1] = pos <= idx ? node->children[pos] : pos == idx+1 ? child : node->children[pos-1];
+  sep = mid < idx ? node->keys[mid] : mid == idx ? *key : node->keys[mid-1];
+
+  sibling->nmemb = node->nmemb-mid;
+  sibling->type  = node->type;
+  sibling->high  = node->high;
+  sibling->next  = node->next;
+
+  if (idx < mid) {
+    memmove(&node->keys[idx+1], &node->keys[idx], __SIZEOF_POINTER__*(mid-idx-1));
+    memmove(&node->children[idx+2], &node->children[idx+1], __SIZEOF_POINTER__*(mid-idx-1));
+    node->keys[idx]       = *key;
+    node->children[idx+1] = child;
+  }
+
+  node->high = sep;
+  __atomic_store_n(&node->next, sibling, __ATOMIC_RELEASE);
+  __atomic_store_n(&node->nmemb, mid, __ATOMIC_RELEASE);
+  *key = sep;
+
+  return sibling;
+}
+
+/**
+ * bplus_olc_ascend - inserts @key and @right into the parent of @left, propagating splits upward
+ *
+ * @tree:  tree to insert into
+ * @path:  the internal nodes visited above @left, from the top down
+ * @depth: the number of the nodes in @path
+ * @left:  the node that has been split
+ * @key:   the key separating @left and @right
+ * @right: the new right sibling of @left
+ *
+ * No lock is held on entry, so that at most one node per level is locked at a time.
+ */
+static inline void bplus_olc_ascend(struct bplus_root *restrict tree, struct bplus_internal_node **restrict path, size_t depth, void *restrict left, const void *key, void *restrict right) {
+  register size_t                     level = 0;
+  register struct bplus_internal_node *node;
+  register struct bplus_internal_node *root;
+
+  for (;;) {
+    if (depth == 0) {                                    /* case of split of the top level */
+      bplus_write_lock(&tree->version);
+      if (bplus_olc_level(tree->root) == level) {
+        if (left == (level == 0 ? (void *)tree->head : (void *)tree->root)) {
+          root              = bplus_internal_alloc(tree->order);
+          root->keys[0]     = key;
+          root->children[0] = left;
+          root->children[1] = right;
+          root->nmemb       = 1;
+          root->type        = level == 0;
+          __atomic_store_n(&tree->root, root, __ATOMIC_RELEASE);
+          bplus_write_unlock(&tree->version);
+          return;
+        }
+        bplus_write_unlock(&tree->version);              /* the split of the leftmost node of the level is yet to grow the tree */
+        continue;
+      }
+      bplus_write_unlock(&tree->version);
+      if ((node = bplus_olc_descend(tree, key, level+1, path, &depth)) == NULL)
+        continue;
+      path[depth++] = node;
+    }
+
+    node = bplus_internal_lock(tree, path[--depth], key);
+    __atomic_store_n(&node->slot, 0, __ATOMIC_RELAXED);
+
+    if (node->nmemb < tree->order-1) {
+      bplus_olc_push(tree, node, key, right);
+      bplus_write_unlock(&node->version);
+      return;
+    }
+
+    right = bplus_olc_split(tree, node, &key, right);
+    bplus_write_unlock(&node->version);
+    left  = node;
+    ++level;
+  }
+}
+
+extern void *bplus_olc_find(struct bplus_root *restrict tree, const void *restrict key) {
+  register size_t                     nmemb;
+           struct bplus_internal_node *path[__SIZEOF_POINTER__*8];
+           struct bplus_external_node *node;
+           struct bplus_external_node *next;
+           size_t                     depth;
+           size_t                     idx;
+           size_t                     version;
+           const  void                *high;
+           void                       *value;
+           bool                       found;
+
+  while ((node = bplus_olc_descend(tree, key, 0, path, &depth)) != NULL)
+    for (;;) {
+      if (!bplus_read_lock(&node->version, &version))
+        continue;
+      next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+      if (next != NULL) {
+        if (!bplus_olc_key(&node->version, version, &node->high, &high))
+          continue;
+        if (high != NULL && tree->less(high, key)) { /* case of concurrent split */
+          node = next;
+          continue;
+        }
+      }
+      nmemb = bplus_nmemb(&node->nmemb, tree->order);
+      if (!bplus_olc_bsearch(tree, &node->version, version, key, node->keys, nmemb, &idx, &found))
+        continue;
+      value = found ? node->values[idx] : NULL;
+      if (bplus_validate(&node->version, version))
+        return value;
+    }
+
+  return NULL;
+}
+
+extern bool bplus_olc_contains(struct bplus_root *restrict tree, const void *restrict key) {
+  register size_t                     nmemb;
+           struct bplus_internal_node *path[__SIZEOF_POINTER__*8];
+           struct bplus_external_node *node;
+           struct bplus_external_node *next;
+           size_t                     depth;
+           size_t                     idx;
+           size_t                     version;
+           const  void                *high;
+           bool                       found;
+
+  while ((node = bplus_olc_descend(tree, key, 0, path, &depth)) != NULL)
+    for (;;) {
+      if (!bplus_read_lock(&node->version, &version))
+        continue;
+      next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+      if (next != NULL) {
+        if (!bplus_olc_key(&node->version, version, &node->high, &high))
+          continue;
+        if (high != NULL && tree->less(high, key)) { /* case of concurrent split */
+          node = next;
+          continue;
+        }
+      }
+      nmemb = bplus_nmemb(&node->nmemb, tree->order);
+      if (bplus_olc_bsearch(tree, &node->version, version, key, node->keys, nmemb, &idx, &found))
+        return found;
+    }
+
+  return false;
+}
+
+extern bool bplus_olc_insert(struct bplus_root *restrict tree, const void *restrict key, void *restrict value) {
+  register size_t                     idx;
+           struct bplus_internal_node *path[__SIZEOF_POINTER__*8];
+           struct bplus_external_node *node;
+           struct bplus_external_node *sib;
+           size_t                     depth;
+  const    void                       *sep;
+
+  while ((node = bplus_olc_descend(tree, key, 0, path, &depth)) == NULL) { /* case of empty tree */
+    bplus_write_lock(&tree->version);
+    if (tree->head == NULL) {
+      node            = bplus_external_alloc(tree->order);
+      node->keys[0]   = key;
+      node->values[0] = value;
+      node->nmemb     = 1;
+      __atomic_store_n(&tree->tail, node, __ATOMIC_RELEASE);
+      __atomic_store_n(&tree->head, node, __ATOMIC_RELEASE);
+      __atomic_add_fetch(&tree->size, 1, __ATOMIC_RELAXED);
+      bplus_write_unlock(&tree->version);
+      return true;
+    }
+    bplus_write_unlock(&tree->version);
+  }
+
+  node = bplus_external_lock(tree, node, key);
+  idx  = __bsearch(key, node->keys, node->nmemb, tree->less);
+
+  if (idx < node->nmemb && !(tree->less(key, node->keys[idx]) || tree->less(node->keys[idx], key))) {
+    bplus_write_unlock(&node->version);
+    return false;
+  }
+
+  bplus_olc_mark(path, depth, node);
+  __atomic_add_fetch(&tree->size, 1, __ATOMIC_RELAXED);
+
+  if (node->nmemb < tree->order) {
+    memmove(&node->keys[idx+1], &node->keys[idx], __SIZEOF_POINTER__*(node->nmemb-idx));
+    memmove(&node->values[idx+1], &node->values[idx], __SIZEOF_POINTER__*(node->nmemb-idx));
+    node->keys[idx]   = key;
+    node->values[idx] = value;
+    __atomic_store_n(&node->nmemb, node->nmemb+1, __ATOMIC_RELEASE);
+    bplus_write_unlock(&node->version);
+    return true;
+  }
+
+  /* case of full leaf: the upper half moves into a new right sibling, which is then pushed up into the parent */
+  sib        = bplus_external_alloc(tree->order);
+  sib->nmemb = (tree->order+1)>>1;
+
+  if (idx < (tree->order>>1)+1) {
+    memcpy(sib->keys, &node->keys[tree->order-sib->nmemb], __SIZEOF_POINTER__*sib->nmemb);
+    memcpy(sib->values, &node->values[tree->order-sib->nmemb], __SIZEOF_POINTER__*sib->nmemb);
+    memmove(&node->keys[idx+1], &node->keys[idx], __SIZEOF_POINTER__*(tree->order-sib->nmemb-idx));
+    memmove(&node->values[idx+1], &node->values[idx], __SIZEOF_POINTER__*(tree->order-sib->nmemb-idx));
+    node->keys[idx]   = key;
+    node->values[idx] = value;
+  } else {
+    idx -= (tree->order>>1)+1;
+    memcpy(sib->keys, &node->keys[(tree->order>>1)+1], __SIZEOF_POINTER__*idx);
+    memcpy(sib->values, &node->values[(tree->order>>1)+1], __SIZEOF_POINTER__*idx);
+    memcpy(&sib->keys[idx+1], &node->keys[(tree->order>>1)+1+idx], __SIZEOF_POINTER__*(sib->nmemb-idx-1));
+    memcpy(&sib->values[idx+1], &node->values[(tree->order>>1)+1+idx], __SIZEOF_POINTER__*(sib->nmemb-idx-1));
+    sib->keys[idx]   = key;
+    sib->values[idx] = value;
+  }
+
+  sib->high = node->high;
+  sib->prev = node;
+  sib->next = node->next;
+  if (sib->next == NULL) {
+    /* only the split of the rightmost leaf moves the tail, and it holds the lock of that leaf until @sib is linked */
+    __atomic_store_n(&tree->tail, sib, __ATOMIC_RELEASE);
+  } else {
+    bplus_write_lock(&sib->next->version);
+    sib->next->prev = sib;
+    bplus_write_unlock(&sib->next->version);
+  }
+
+  sep        = node->keys[tree->order>>1];
+  node->high = sep;
+  __atomic_store_n(&node->next, sib, __ATOMIC_RELEASE);
+  __atomic_store_n(&node->nmemb, (tree->order>>1)+1, __ATOMIC_RELEASE);
+  bplus_write_unlock(&node->version);
+
+  bplus_olc_ascend(tree, path, depth, node, sep, sib);
+
+  return true;
+}
+
+extern void *bplus_olc_erase(struct bplus_root *restrict tree, const void *restrict key) {
+  register size_t                     idx;
+           struct bplus_internal_node *path[__SIZEOF_POINTER__*8];
+           struct bplus_external_node *node;
+           size_t                     depth;
+           void                       *erased;
+
+  if ((node = bplus_olc_descend(tree, key, 0, path, &depth)) == NULL)
+    return NULL;
+
+  node = bplus_external_lock(tree, node, key);
+  idx  = __bsearch(key, node->keys, node->nmemb, tree->less);
+
+  if (idx == node->nmemb || tree->less(key, node->keys[idx]) || tree->less(node->keys[idx], key)) {
+    bplus_write_unlock(&node->version);
+    return NULL;
+  }
+
+  erased = node->values[idx];
+  bplus_olc_mark(path, depth, node);
+  memmove(&node->keys[idx], &node->keys[idx+1], __SIZEOF_POINTER__*(node->nmemb-idx-1));
+  memmove(&node->values[idx], &node->values[idx+1], __SIZEOF_POINTER__*(node->nmemb-idx-1));
+  __atomic_store_n(&node->nmemb, node->nmemb-1, __ATOMIC_RELEASE);
+  __atomic_sub_fetch(&tree->size, 1, __ATOMIC_RELAXED);
+  bplus_write_unlock(&node->version);
+
+  return erased;
+}
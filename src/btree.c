@@ -4,7 +4,12 @@
  *
  * btree.c - generic B-tree definition
  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <index/btree.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -15,13 +20,14 @@
  * @parent: the address of the parent node
  * @tree:   the address of the tree to which the node belongs
  * @index:  the index to the parent node
+ * @leaf:   whether the node is a leaf, which has no children
  */
-static inline struct btree_node *btree_alloc(const size_t order, struct btree_node *restrict parent, struct btree_root *restrict tree, size_t index) {
+static inline struct btree_node *btree_alloc(const size_t order, struct btree_node *restrict parent, struct btree_root *restrict tree, size_t index, const bool leaf) {
   struct btree_node *node = malloc(sizeof(struct btree_node));
   node->keys              = malloc(__SIZEOF_POINTER__*(order-1));
   node->values            = malloc(__SIZEOF_POINTER__*(order-1));
   node->parent            = parent;
-  node->children          = malloc(__SIZEOF_POINTER__*order);
+  node->children          = leaf ? NULL : malloc(__SIZEOF_POINTER__*order);
   node->tree              = tree;
   node->index             = index;
   node->nmemb             = 0;
@@ -73,8 +79,8 @@ static inline struct btree_node *btree_lower_bound(struct btree_node *restrict n
   if (node == NULL)
     return NULL;
 
-  if (node->children[*index] != NULL) {
-    for (node = node->children[*index]; node->children[node->nmemb] != NULL; node = node->children[node->nmemb]);
+  if (node->children != NULL) {
+    for (node = node->children[*index]; node->children != NULL; node = node->children[node->nmemb]);
     *index = node->nmemb-1;
     return node;
   }
@@ -101,8 +107,8 @@ static inline struct btree_node *btree_upper_bound(struct btree_node *restrict n
   if (node == NULL)
     return NULL;
 
-  if (node->children[*index+1] != NULL) {
-    for (node = node->children[*index+1]; node->children[0] != NULL; node = node->children[0]);
+  if (node->children != NULL) {
+    for (node = node->children[*index+1]; node->children != NULL; node = node->children[0]);
     *index = 0;
     return node;
   }
@@ -161,14 +167,139 @@ static inline void btree_destroy(struct btree_node *node) {
   register struct btree_node *next;
 
   while (node != NULL) {
-    for (idx = node->nmemb; 0 < idx; --idx)
-      btree_destroy(node->children[idx]);
-    next = node->children[0];
+    if (node->children != NULL)
+      for (idx = node->nmemb; 0 < idx; --idx)
+        btree_destroy(node->children[idx]);
+    next = node->children == NULL ? NULL : node->children[0];
     btree_free(node);
     node = next;
   }
 }
 
+/**
+ * btree_copy - allocates a copy of @node whose children still refer to those of @node
+ *
+ * @node:   node to copy
+ * @parent: the address of the parent node of the copy
+ * @tree:   the address of the tree to which the copy belongs
+ */
+static inline struct btree_node *btree_copy(const struct btree_node *restrict node, struct btree_node *restrict parent, struct btree_root *restrict tree) {
+  struct btree_node *copy = btree_alloc(tree->order, parent, tree, node->index, node->children == NULL);
+  memcpy(copy->keys, node->keys, __SIZEOF_POINTER__*node->nmemb);
+  memcpy(copy->values, node->values, __SIZEOF_POINTER__*node->nmemb);
+  if (node->children != NULL)
+    memcpy(copy->children, node->children, __SIZEOF_POINTER__*(node->nmemb+1));
+  copy->nmemb = node->nmemb;
+  return copy;
+}
+
+/**
+ * struct btree_task - a run of the children of a node to build
+ *
+ * @tree:    tree to build
+ * @node:    node whose children to build
+ * @keys:    the sorted keys of the tree
+ * @values:  the values of the tree
+ * @lo:      the index to the first entry of @node
+ * @nmemb:   the number of the entries of @node
+ * @span:    the capacity of each child of @node, counting its entries plus one
+ * @first:   the index to the first child to build
+ * @last:    the index past the last child to build
+ * @threads: the number of threads the run may use
+ */
+struct btree_task {
+        struct btree_root *tree;
+        struct btree_node *node;
+  const void              **keys;
+        void              **values;
+        size_t            lo;
+        size_t            nmemb;
+        size_t            span;
+        size_t            first;
+        size_t            last;
+        size_t            threads;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+/**
+ * btree_bound - returns the index to the entry past @index-th child of a node, which is the separator of the child
+ *
+ * @lo:    the index to the first entry of the node
+ * @nmemb: the number of the entries of the node
+ * @count: the number of the children of the node
+ * @index: the index to the child
+ *
+ * Each child is given its entries plus one of the slots of the node evenly, so that every child is more than half full.
+ */
+static inline size_t btree_bound(const size_t lo, const size_t nmemb, const size_t count, const size_t index) { return lo + (index+1)*(nmemb+1)/count - 1; }
+
+static struct btree_node *btree_build_subtree(struct btree_root *restrict tree, struct btree_node *restrict parent, const size_t index, const void **restrict keys, void **restrict values, const size_t lo, const size_t nmemb, const size_t span, const size_t threads);
+
+static void *btree_task_run(void *arg) {
+  struct btree_task *task  = arg;
+  const size_t      count  = task->node->nmemb+1;
+  pthread_t         thread;
+
+  if (1 < task->threads && 1 < task->last-task->first && 1<<12 <= btree_bound(0, task->nmemb, count, (task->last-task->first)>>1)) {
+    struct btree_task lower = *task;
+    lower.last              = task->first + ((task->last-task->first)>>1);
+    lower.threads           = task->threads>>1;
+
+    if (pthread_create(&thread, NULL, btree_task_run, &lower) == 0) {
+      struct btree_task upper = *task;
+      upper.first             = lower.last;
+      upper.threads           = task->threads-lower.threads;
+      btree_task_run(&upper);
+      pthread_join(thread, NULL);
+      return NULL;
+    }
+  }
+
+  for (register size_t idx = task->first; idx < task->last; ++idx) {
+    const size_t lo = idx == 0 ? task->lo : btree_bound(task->lo, task->nmemb, count, idx-1)+1;
+    task->node->children[idx] = btree_build_subtree(task->tree, task->node, idx, task->keys, task->values, lo,
+                                                    btree_bound(task->lo, task->nmemb, count, idx) - lo, task->span/task->tree->order,
+                                                    task->last-task->first == 1 ? task->threads : 1);
+  }
+
+  return NULL;
+}
+
+/**
+ * btree_build_subtree - builds a subtree of @nmemb entries from @lo-th entry of @keys and @values
+ *
+ * @tree:    tree to build
+ * @parent:  the address of the parent node of the subtree
+ * @index:   the index to @parent
+ * @keys:    the sorted keys of the tree
+ * @values:  the values of the tree
+ * @lo:      the index to the first entry of the subtree
+ * @nmemb:   the number of the entries of the subtree, plus one no more than @span times the order of @tree
+ * @span:    the capacity of each child of the root node of the subtree, or 1 to build a leaf
+ * @threads: the number of threads the subtree may use
+ */
+static struct btree_node *btree_build_subtree(struct btree_root *restrict tree, struct btree_node *restrict parent, const size_t index, const void **restrict keys, void **restrict values, const size_t lo, const size_t nmemb, const size_t span, const size_t threads) {
+  struct btree_node *node = btree_alloc(tree->order, parent, tree, index, span == 1);
+
+  if (span == 1) {
+    memcpy(node->keys, &keys[lo], __SIZEOF_POINTER__*nmemb);
+    memcpy(node->values, &values[lo], __SIZEOF_POINTER__*nmemb);
+    node->nmemb = nmemb;
+    return node;
+  }
+
+  node->nmemb = (nmemb+span)/span - 1;
+
+  for (register size_t idx = 0; idx < node->nmemb; ++idx) {
+    node->keys[idx]   = keys[btree_bound(lo, nmemb, node->nmemb+1, idx)];
+    node->values[idx] = values[btree_bound(lo, nmemb, node->nmemb+1, idx)];
+  }
+
+  struct btree_task task = { .tree = tree, .node = node, .keys = keys, .values = values, .lo = lo, .nmemb = nmemb, .span = span, .first = 0, .last = node->nmemb+1, .threads = threads };
+  btree_task_run(&task);
+
+  return node;
+}
+
 extern bool btree_contains(const struct btree_root tree, const void *key) {
   register size_t            idx;
   register struct btree_node *pivot = tree.root;
@@ -176,7 +307,7 @@ extern bool btree_contains(const struct btree_root tree, const void *key) {
   while (pivot != NULL) {
     if ((idx = __bsearch(key, pivot->keys, pivot->nmemb, tree.less)) < pivot->nmemb && !(tree.less(key, pivot->keys[idx]) || tree.less(pivot->keys[idx], key)))
       return true;
-    pivot = pivot->children[idx];
+    pivot = pivot->children == NULL ? NULL : pivot->children[idx];
   }
 
   return false;
@@ -189,7 +320,7 @@ extern struct btree_iter btree_find(const struct btree_root tree, const void *ke
   while (pivot != NULL) {
     if ((idx = __bsearch(key, pivot->keys, pivot->nmemb, tree.less)) < pivot->nmemb && !(tree.less(key, pivot->keys[idx]) || tree.less(pivot->keys[idx], key)))
       break;
-    pivot = pivot->children[idx];
+    pivot = pivot->children == NULL ? NULL : pivot->children[idx];
   }
 
   return btree_mk_iter(pivot, idx);
@@ -205,7 +336,7 @@ extern struct btree_iter btree_insert(struct btree_root *restrict tree, const vo
     if ((idx = __bsearch(key, pivot->keys, pivot->nmemb, tree->less)) < pivot->nmemb && !(tree->less(key, pivot->keys[idx]) || tree->less(pivot->keys[idx], key)))
       return btree_mk_iter(pivot, idx);
     parent = pivot;
-    pivot  = pivot->children[idx];
+    pivot  = pivot->children == NULL ? NULL : pivot->children[idx];
   }
 
   register struct btree_iter iter = btree_mk_iter(NULL, 0);
@@ -217,68 +348,71 @@ extern struct btree_iter btree_insert(struct btree_root *restrict tree, const vo
 
     if (pivot->nmemb < tree->order-1) {
       memmove(pivot->keys+idx+1, pivot->keys+idx, __SIZEOF_POINTER__*(pivot->nmemb-idx));
-      memmove(pivot->values+idx+1, pivot->values+idx, __SIZEOF_POINTER__*(pivot->nmemb-idx));
-      memmove(pivot->children+idx+2, pivot->children+idx+1, __SIZEOF_POINTER__*(pivot->nmemb++-idx));
-      pivot->keys[idx]       = key;
-      pivot->values[idx]     = value;
-      pivot->children[idx+1] = sibling;
-      iter                   = iter.pivot == NULL ? btree_mk_iter(pivot, idx) : iter;
-      for (idx += 2; idx <= pivot->nmemb; ++idx)
-        if (pivot->children[idx] != NULL)
+      memmove(pivot->values+idx+1, pivot->values+idx, __SIZEOF_POINTER__*(pivot->nmemb++-idx));
+      pivot->keys[idx]   = key;
+      pivot->values[idx] = value;
+      iter               = iter.pivot == NULL ? btree_mk_iter(pivot, idx) : iter;
+      if (pivot->children != NULL) {
+        memmove(pivot->children+idx+2, pivot->children+idx+1, __SIZEOF_POINTER__*(pivot->nmemb-idx-1));
+        pivot->children[idx+1] = sibling;
+        for (idx += 2; idx <= pivot->nmemb; ++idx)
           pivot->children[idx]->index = idx;
+      }
       return iter;
     }
 
-    parent = btree_alloc(tree->order+1, NULL, NULL, 0);
+    parent = btree_alloc(tree->order+1, NULL, NULL, 0, pivot->children == NULL);
     memcpy(parent->keys, pivot->keys, __SIZEOF_POINTER__*idx);
     memcpy(parent->keys+idx+1, pivot->keys+idx, __SIZEOF_POINTER__*(pivot->nmemb-idx));
     memcpy(parent->values, pivot->values, __SIZEOF_POINTER__*idx);
     memcpy(parent->values+idx+1, pivot->values+idx, __SIZEOF_POINTER__*(pivot->nmemb-idx));
-    memcpy(parent->children, pivot->children, __SIZEOF_POINTER__*(idx+1));
-    memcpy(parent->children+idx+2, pivot->children+idx+1, __SIZEOF_POINTER__*(pivot->nmemb-idx));
-    parent->keys[idx]       = key;
-    parent->values[idx]     = value;
-    parent->children[idx+1] = sibling;
+    parent->keys[idx]   = key;
+    parent->values[idx] = value;
+    if (pivot->children != NULL) {
+      memcpy(parent->children, pivot->children, __SIZEOF_POINTER__*(idx+1));
+      memcpy(parent->children+idx+2, pivot->children+idx+1, __SIZEOF_POINTER__*(pivot->nmemb-idx));
+      parent->children[idx+1] = sibling;
+    }
 
-    sibling        = btree_alloc(tree->order, pivot->parent, tree, pivot->index+1);
+    sibling        = btree_alloc(tree->order, pivot->parent, tree, pivot->index+1, pivot->children == NULL);
     sibling->nmemb = (tree->order-1)>>1;
     pivot->nmemb   = tree->order>>1;
     memcpy(pivot->keys, parent->keys, __SIZEOF_POINTER__*pivot->nmemb);
     memcpy(sibling->keys, parent->keys+pivot->nmemb+1, __SIZEOF_POINTER__*sibling->nmemb);
     memcpy(pivot->values, parent->values, __SIZEOF_POINTER__*pivot->nmemb);
     memcpy(sibling->values, parent->values+pivot->nmemb+1, __SIZEOF_POINTER__*sibling->nmemb);
-    memcpy(pivot->children, parent->children, __SIZEOF_POINTER__*(pivot->nmemb+1));
-    memcpy(sibling->children, parent->children+pivot->nmemb+1, __SIZEOF_POINTER__*(sibling->nmemb+1));
     key   = parent->keys[pivot->nmemb];
     value = parent->values[pivot->nmemb];
     iter  = iter.pivot != NULL  ? iter
           : idx == pivot->nmemb ? iter
           : idx < pivot->nmemb  ? btree_mk_iter(pivot, idx)
                                 : btree_mk_iter(sibling, idx-pivot->nmemb-1);
-    for (idx += 2; idx <= pivot->nmemb; ++idx)
-      if (pivot->children[idx] != NULL)
+    if (pivot->children != NULL) {             /* case of internal node */
+      memcpy(pivot->children, parent->children, __SIZEOF_POINTER__*(pivot->nmemb+1));
+      memcpy(sibling->children, parent->children+pivot->nmemb+1, __SIZEOF_POINTER__*(sibling->nmemb+1));
+      for (idx += 2; idx <= pivot->nmemb; ++idx)
         pivot->children[idx]->index = idx;
-    for (idx = 0; idx <= sibling->nmemb; ++idx)
-      if (sibling->children[idx] != NULL) {
+      for (idx = 0; idx <= sibling->nmemb; ++idx) {
         sibling->children[idx]->parent = sibling;
         sibling->children[idx]->index  = idx;
       }
+    }
     btree_free(parent);
 
     idx    = pivot->index;
     parent = pivot->parent;
   }
 
-  tree->root              = btree_alloc(tree->order, NULL, tree, 0);
-  tree->root->keys[0]     = key;
-  tree->root->values[0]   = value;
-  tree->root->children[0] = pivot;
-  tree->root->children[1] = sibling;
-  tree->root->nmemb       = 1;
+  tree->root            = btree_alloc(tree->order, NULL, tree, 0, pivot == NULL);
+  tree->root->keys[0]   = key;
+  tree->root->values[0] = value;
+  tree->root->nmemb     = 1;
 
   if (pivot != NULL) {
-    pivot->parent   = tree->root;
-    sibling->parent = tree->root;
+    tree->root->children[0] = pivot;
+    tree->root->children[1] = sibling;
+    pivot->parent           = tree->root;
+    sibling->parent         = tree->root;
   }
 
   return iter.pivot == NULL ? btree_mk_iter(tree->root, 0) : iter;
@@ -293,7 +427,7 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
   while (pivot != NULL) {
     if ((idx = __bsearch(key, pivot->keys, pivot->nmemb, tree->less)) < pivot->nmemb && !(tree->less(key, pivot->keys[idx]) || tree->less(pivot->keys[idx], key)))
       break;
-    pivot = pivot->children[idx];
+    pivot = pivot->children == NULL ? NULL : pivot->children[idx];
   }
 
   if (pivot == NULL)
@@ -301,9 +435,9 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
 
   void *erased = pivot->values[idx];
 
-  if (pivot->children[idx] != NULL) {
+  if (pivot->children != NULL) {
     parent = pivot;
-    for (pivot = pivot->children[idx]; pivot->children[pivot->nmemb] != NULL; pivot = pivot->children[pivot->nmemb]);
+    for (pivot = pivot->children[idx]; pivot->children != NULL; pivot = pivot->children[pivot->nmemb]);
     parent->keys[idx]   = pivot->keys[pivot->nmemb-1];
     parent->values[idx] = pivot->values[pivot->nmemb-1];
     idx                 = pivot->nmemb-1;
@@ -328,33 +462,32 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
     if ((tree->order-1)>>1 < sibling->nmemb) { /* case of key redistribution */
       if (sibling->index < idx) {
         memmove(pivot->keys+1, pivot->keys, __SIZEOF_POINTER__*pivot->nmemb);
-        memmove(pivot->values+1, pivot->values, __SIZEOF_POINTER__*pivot->nmemb);
-        memmove(pivot->children+1, pivot->children, __SIZEOF_POINTER__*++pivot->nmemb);
+        memmove(pivot->values+1, pivot->values, __SIZEOF_POINTER__*pivot->nmemb++);
         pivot->keys[0]        = parent->keys[idx-1];
         pivot->values[0]      = parent->values[idx-1];
-        pivot->children[0]    = sibling->children[sibling->nmemb];
         parent->keys[idx-1]   = sibling->keys[--sibling->nmemb];
         parent->values[idx-1] = sibling->values[sibling->nmemb];
-        if (pivot->children[0] != NULL)
+        if (pivot->children != NULL) {
+          memmove(pivot->children+1, pivot->children, __SIZEOF_POINTER__*pivot->nmemb);
+          pivot->children[0]         = sibling->children[sibling->nmemb+1];
           pivot->children[0]->parent = pivot;
-        for (idx = 0; idx <= pivot->nmemb; ++idx)
-          if (pivot->children[idx] != NULL)
+          for (idx = 0; idx <= pivot->nmemb; ++idx)
             pivot->children[idx]->index = idx;
+        }
       } else {
-        pivot->keys[pivot->nmemb]       = parent->keys[idx];
-        pivot->values[pivot->nmemb]     = parent->values[idx];
-        pivot->children[++pivot->nmemb] = sibling->children[0];
-        parent->keys[idx]               = sibling->keys[0];
-        parent->values[idx]             = sibling->values[0];
-        memmove(sibling->children, sibling->children+1, __SIZEOF_POINTER__*sibling->nmemb);
+        pivot->keys[pivot->nmemb]     = parent->keys[idx];
+        pivot->values[pivot->nmemb++] = parent->values[idx];
+        parent->keys[idx]             = sibling->keys[0];
+        parent->values[idx]           = sibling->values[0];
         memmove(sibling->keys, sibling->keys+1, __SIZEOF_POINTER__*--sibling->nmemb);
         memmove(sibling->values, sibling->values+1, __SIZEOF_POINTER__*sibling->nmemb);
-        for (idx = 0; idx <= sibling->nmemb; ++idx)
-          if (sibling->children[idx] != NULL)
-            sibling->children[idx]->index = idx;
-        if (pivot->children[pivot->nmemb] != NULL) {
+        if (pivot->children != NULL) {
+          pivot->children[pivot->nmemb]         = sibling->children[0];
           pivot->children[pivot->nmemb]->parent = pivot;
           pivot->children[pivot->nmemb]->index  = pivot->nmemb;
+          memmove(sibling->children, sibling->children+1, __SIZEOF_POINTER__*(sibling->nmemb+1));
+          for (idx = 0; idx <= sibling->nmemb; ++idx)
+            sibling->children[idx]->index = idx;
         }
       }
       return erased;
@@ -365,13 +498,14 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
       sibling->values[sibling->nmemb] = parent->values[idx-1];
       memcpy(sibling->keys+(++sibling->nmemb), pivot->keys, __SIZEOF_POINTER__*pivot->nmemb);
       memcpy(sibling->values+sibling->nmemb, pivot->values, __SIZEOF_POINTER__*pivot->nmemb);
-      memcpy(sibling->children+sibling->nmemb, pivot->children, __SIZEOF_POINTER__*(pivot->nmemb+1));
+      if (pivot->children != NULL)
+        memcpy(sibling->children+sibling->nmemb, pivot->children, __SIZEOF_POINTER__*(pivot->nmemb+1));
       memmove(parent->keys+idx-1, parent->keys+idx, __SIZEOF_POINTER__*(parent->nmemb-idx));
       memmove(parent->values+idx-1, parent->values+idx, __SIZEOF_POINTER__*(parent->nmemb-idx));
       memmove(parent->children+idx, parent->children+idx+1, __SIZEOF_POINTER__*(parent->nmemb---idx));
       sibling->nmemb += pivot->nmemb;
-      for (idx = sibling->nmemb-pivot->nmemb; idx <= sibling->nmemb; ++idx)
-        if (sibling->children[idx] != NULL) {
+      if (sibling->children != NULL)
+        for (idx = sibling->nmemb-pivot->nmemb; idx <= sibling->nmemb; ++idx) {
           sibling->children[idx]->parent = sibling;
           sibling->children[idx]->index  = idx;
         }
@@ -383,13 +517,14 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
       pivot->values[pivot->nmemb] = parent->values[idx];
       memcpy(pivot->keys+(++pivot->nmemb), sibling->keys, __SIZEOF_POINTER__*sibling->nmemb);
       memcpy(pivot->values+pivot->nmemb, sibling->values, __SIZEOF_POINTER__*sibling->nmemb);
-      memcpy(pivot->children+pivot->nmemb, sibling->children, __SIZEOF_POINTER__*(sibling->nmemb+1));
+      if (pivot->children != NULL)
+        memcpy(pivot->children+pivot->nmemb, sibling->children, __SIZEOF_POINTER__*(sibling->nmemb+1));
       memmove(parent->keys+idx, parent->keys+idx+1, __SIZEOF_POINTER__*(--parent->nmemb-idx));
       memmove(parent->values+idx, parent->values+idx+1, __SIZEOF_POINTER__*(parent->nmemb-idx));
       memmove(parent->children+idx+1, parent->children+idx+2, __SIZEOF_POINTER__*(parent->nmemb-idx));
       pivot->nmemb += sibling->nmemb;
-      for (idx = pivot->nmemb-sibling->nmemb; idx <= pivot->nmemb; ++idx)
-        if (pivot->children[idx] != NULL) {
+      if (pivot->children != NULL)
+        for (idx = pivot->nmemb-sibling->nmemb; idx <= pivot->nmemb; ++idx) {
           pivot->children[idx]->parent = pivot;
           pivot->children[idx]->index  = idx;
         }
@@ -403,7 +538,7 @@ extern void *btree_erase(struct btree_root *restrict tree, const void *restrict
   }
 
   if (pivot->nmemb == 0) {
-    tree->root = pivot->children[0];
+    tree->root = pivot->children == NULL ? NULL : pivot->children[0];
     if (tree->root != NULL)
       tree->root->parent = NULL;
     btree_free(pivot);
@@ -418,11 +553,45 @@ extern void btree_clear(struct btree_root *tree) {
   tree->size = 0;
 }
 
+extern void btree_clone(struct btree_root *restrict tree, const struct btree_root other) {
+  register size_t            idx;
+  register size_t            head;
+  register size_t            tail;
+  register struct btree_node *node;
+
+  if (other.root == NULL)
+    return;
+
+  struct btree_node **queue = malloc(__SIZEOF_POINTER__*(other.size+1));
+  queue[0] = tree->root = btree_copy(other.root, NULL, tree);
+
+  for (head = 0, tail = 1; head < tail; ++head)
+    if ((node = queue[head])->children != NULL)
+      for (idx = 0; idx <= node->nmemb; ++idx)
+        queue[tail++] = node->children[idx] = btree_copy(node->children[idx], node, tree);
+
+  free(queue);
+  tree->size = other.size;
+}
+
+extern void btree_build(struct btree_root *restrict tree, const void **restrict keys, void **restrict values, const size_t nmemb, const size_t threads) {
+  register size_t span = 1;
+
+  if (nmemb == 0)
+    return;
+
+  while (span*tree->order < nmemb+1)
+    span *= tree->order;
+
+  tree->root = btree_build_subtree(tree, NULL, 0, keys, values, 0, nmemb, span, threads);
+  tree->size = nmemb;
+}
+
 extern struct btree_iter btree_iter_init(const struct btree_root tree) {
   register struct btree_node *pivot = tree.root;
 
   if (pivot != NULL)
-    while (pivot->children[0] != NULL)
+    while (pivot->children != NULL)
       pivot = pivot->children[0];
 
   return btree_mk_iter(pivot, 0);
@@ -444,7 +613,7 @@ extern struct btree_reverse_iter btree_reverse_iter_init(const struct btree_root
   register struct btree_node *pivot = tree.root;
 
   if (pivot != NULL)
-    while (pivot->children[pivot->nmemb] != NULL)
+    while (pivot->children != NULL)
       pivot = pivot->children[pivot->nmemb];
 
   return btree_mk_reverse_iter(pivot, pivot->nmemb-1);
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * epoch.c - epoch-based reclamation definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/epoch.h>
+#include <sched.h>
+#include <stdlib.h>
+
+/**
+ * epoch_free - frees all nodes in @idx-th limbo of @root
+ *
+ * @root: epoch domain whose lock is held
+ * @idx:  the index of the limbo to free
+ */
+static inline void epoch_free(struct epoch_root *restrict root, const size_t idx) {
+  for (register size_t pos = 0; pos < root->nmemb[idx]; ++pos)
+    free(root->limbo[idx][pos]);
+  root->nmemb[idx] = 0;
+}
+
+/**
+ * epoch_advance - advances the global epoch of @root if every reader in a critical section has observed it
+ *
+ * @root: epoch domain whose lock is held
+ */
+static inline bool epoch_advance(struct epoch_root *restrict root) {
+  register const struct epoch_thread *thread;
+  register size_t                    state;
+  const    size_t                    epoch = root->epoch;
+
+  /* the retired nodes must be unlinked before the states are read */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  for (thread = root->threads; thread != NULL; thread = thread->next)
+    if ((state = __atomic_load_n(&thread->state, __ATOMIC_ACQUIRE)) != 0 && state != (epoch<<1 | 1))
+      return false;
+
+  __atomic_store_n(&root->epoch, epoch+1, __ATOMIC_RELEASE);
+  epoch_free(root, (epoch+2)%3);
+
+  return true;
+}
+
+extern void epoch_init(struct epoch_root *restrict root) {
+  root->epoch   = 0;
+  root->threads = NULL;
+
+  for (register size_t idx = 0; idx < 3; ++idx) {
+    root->limbo[idx]    = NULL;
+    root->nmemb[idx]    = 0;
+    root->capacity[idx] = 0;
+  }
+
+  pthread_mutex_init(&root->lock, NULL);
+}
+
+extern void epoch_destroy(struct epoch_root *restrict root) {
+  for (register size_t idx = 0; idx < 3; ++idx) {
+    epoch_free(root, idx);
+    free(root->limbo[idx]);
+  }
+
+  pthread_mutex_destroy(&root->lock);
+}
+
+extern void epoch_register(struct epoch_root *restrict root, struct epoch_thread *restrict thread) {
+  thread->state = 0;
+
+  pthread_mutex_lock(&root->lock);
+  thread->next  = root->threads;
+  root->threads = thread;
+  pthread_mutex_unlock(&root->lock);
+}
+
+extern void epoch_unregister(struct epoch_root *restrict root, struct epoch_thread *restrict thread) {
+  register struct epoch_thread **link;
+
+  pthread_mutex_lock(&root->lock);
+  for (link = &root->threads; *link != thread; link = &(*link)->next);
+  *link = thread->next;
+  pthread_mutex_unlock(&root->lock);
+}
+
+extern void epoch_retire(struct epoch_root *restrict root, void *restrict ptr) {
+  register size_t idx;
+
+  pthread_mutex_lock(&root->lock);
+
+  idx = root->epoch%3;
+
+  if (root->nmemb[idx] == root->capacity[idx]) {
+    root->capacity[idx] = root->capacity[idx] == 0 ? 64 : root->capacity[idx]<<1;
+    root->limbo[idx]    = realloc(root->limbo[idx], __SIZEOF_POINTER__*root->capacity[idx]);
+  }
+
+  root->limbo[idx][root->nmemb[idx]++] = ptr;
+
+  /* amortize the scan of the readers over the retirements */
+  if (root->nmemb[idx]%64 == 0)
+    epoch_advance(root);
+
+  pthread_mutex_unlock(&root->lock);
+}
+
+extern bool epoch_reclaim(struct epoch_root *restrict root) {
+  register bool advanced;
+
+  pthread_mutex_lock(&root->lock);
+  advanced = epoch_advance(root);
+  pthread_mutex_unlock(&root->lock);
+
+  return advanced;
+}
+
+extern void epoch_synchronize(struct epoch_root *restrict root) {
+  register size_t target;
+
+  pthread_mutex_lock(&root->lock);
+  target = root->epoch+2;
+
+  while (root->epoch < target)
+    if (!epoch_advance(root)) {
+      pthread_mutex_unlock(&root->lock);
+      sched_yield();
+      pthread_mutex_lock(&root->lock);
+    }
+
+  pthread_mutex_unlock(&root->lock);
+}
@@ -5,6 +5,8 @@
  * llrbtree.c - generic left-leaning red-black tree definition
  */
 #include <index/llrbtree.h>
+#include <index/serial.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 /**
@@ -220,6 +222,21 @@ static inline void llrb_destroy(struct llrb_node *node) {
   }
 }
 
+/**
+ * llrb_copy - allocates a copy of @node whose children still refer to those of @node
+ *
+ * @node:   node to copy
+ * @parent: the address of the parent node of the copy
+ * @tree:   the address of the tree to which the copy belongs
+ */
+static inline struct llrb_node *llrb_copy(const struct llrb_node *restrict node, struct llrb_node *restrict parent, struct llrb_root *restrict tree) {
+  struct llrb_node *copy = llrb_alloc(node->key, node->value, parent, tree);
+  copy->left             = node->left;
+  copy->right            = node->right;
+  copy->black            = node->black;
+  return copy;
+}
+
 extern struct llrb_iter llrb_find(const struct llrb_root tree, const void *key) {
   register struct llrb_node *pivot = tree.root;
 
@@ -335,6 +352,148 @@ extern void llrb_clear(struct llrb_root *tree) {
   tree->size = 0;
 }
 
+extern void llrb_clone(struct llrb_root *restrict tree, const struct llrb_root other) {
+  register size_t           head;
+  register size_t           tail;
+  register struct llrb_node *node;
+
+  if (other.root == NULL)
+    return;
+
+  struct llrb_node **queue = malloc(__SIZEOF_POINTER__*other.size);
+  queue[0] = tree->root = llrb_copy(other.root, NULL, tree);
+
+  for (head = 0, tail = 1; head < tail; ++head) {
+    node = queue[head];
+    if (node->left != NULL)  queue[tail++] = node->left  = llrb_copy(node->left, node, tree);
+    if (node->right != NULL) queue[tail++] = node->right = llrb_copy(node->right, node, tree);
+  }
+
+  free(queue);
+  tree->size = other.size;
+}
+
+/**
+ * llrb_discard - erases all entries in the subtree of @node read from @serial, releasing their keys and values
+ *
+ * @node:   root node of the subtree
+ * @serial: the state of the dump the entries were read from
+ */
+static void llrb_discard(struct llrb_node *restrict node, struct serial *restrict serial) {
+  register struct llrb_node *next;
+
+  while (node != NULL) {
+    llrb_discard(node->right, serial);
+    next = node->left;
+    serial_release_entry(serial, node->key, node->value);
+    free(node);
+    node = next;
+  }
+}
+
+/**
+ * llrb_build - builds a subtree of @nmemb entries read from @serial, as a 2-3 tree of @height
+ *
+ * @tree:   the tree to which the subtree belongs
+ * @parent: the parent of the subtree
+ * @nmemb:  the number of the entries of the subtree, between 2^@height-1 and 3^@height-1
+ * @height: the black height of the subtree
+ * @caps:   the largest number of the entries of a 2-3 tree of each height
+ * @serial: the state of the dump to read the entries from
+ * @ok:     set to false if an entry cannot be read, in which case the subtree is freed along with its keys and values
+ *
+ * Each node of the 2-3 tree is a 2-node if its children can hold the entries, or a 3-node otherwise,
+ * whose smaller entry is the red left child of the larger one, and the entries are spread evenly over the children.
+ */
+static struct llrb_node *llrb_build(struct llrb_root *restrict tree, struct llrb_node *restrict parent, const size_t nmemb, const size_t height, const size_t *restrict caps,
+                                    struct serial *restrict serial, bool *restrict ok) {
+  register struct llrb_node *node;
+  register struct llrb_node *left;
+  register struct llrb_node *red = NULL;
+  register size_t           rest = nmemb-1;
+           const void       *key;
+           void             *value;
+
+  if (height == 0 || !*ok) return NULL;
+
+  /* case of 3-node: the red node takes the smallest third of the entries and the middle one */
+  if (2*caps[height-1] < nmemb-1) {
+    left = llrb_build(tree, NULL, (nmemb-2)/3, height-1, caps, serial, ok);
+    if (!*ok || !(*ok = serial_read_entry(serial, &key, &value))) {
+      llrb_discard(left, serial);
+      return NULL;
+    }
+
+    red       = llrb_alloc(key, value, NULL, tree);
+    red->left = left;
+    if (left != NULL) left->parent = red;
+
+    rest       = nmemb-2 - (nmemb-2)/3;
+    red->right = llrb_build(tree, red, rest/2, height-1, caps, serial, ok);
+    if (!*ok) {
+      llrb_discard(red, serial);
+      return NULL;
+    }
+    rest -= rest/2;
+  }
+
+  left = red == NULL ? llrb_build(tree, NULL, rest/2, height-1, caps, serial, ok) : red;
+  if (!*ok || !(*ok = serial_read_entry(serial, &key, &value))) {
+    llrb_discard(left, serial);
+    return NULL;
+  }
+
+  node        = llrb_alloc(key, value, parent, tree);
+  node->black = true;
+  node->left  = left;
+  if (left != NULL) left->parent = node;
+
+  node->right = llrb_build(tree, node, red == NULL ? rest - rest/2 : rest, height-1, caps, serial, ok);
+  if (!*ok) {
+    llrb_discard(node, serial);
+    return NULL;
+  }
+
+  return node;
+}
+
+extern bool llrb_dump(const struct llrb_root tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  struct serial serial = serial_init(stream, keys, values);
+  bool          ok     = serial_write_word(&serial, tree.size);
+
+  for (struct llrb_iter iter = llrb_iter_init(tree); ok && !llrb_iter_end(iter); llrb_iter_next(&iter))
+    ok = serial_write_entry(&serial, iter.key, iter.value);
+
+  serial_destroy(&serial);
+
+  return ok;
+}
+
+extern bool llrb_restore(struct llrb_root *restrict tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  register size_t        height;
+           size_t        caps[8*sizeof(size_t)+1];
+           struct serial serial = serial_init(stream, keys, values);
+           uint64_t      nmemb;
+           bool          ok     = true;
+
+  /* case of non-empty tree: its entries would be lost */
+  if (tree->root != NULL || !serial_read_word(&serial, &nmemb)) return false;
+
+  /* the black height is the largest one whose 2-3 trees of the fewest entries can hold them all */
+  for (height = 0; ((size_t)1 << (height+1)) - 1 <= nmemb && height+1 < 8*sizeof(size_t); ++height);
+
+  caps[0] = 0;
+  for (register size_t idx = 1; idx <= height; ++idx)
+    caps[idx] = caps[idx-1] < SIZE_MAX/4 ? caps[idx-1]*3 + 2 : SIZE_MAX/2;
+
+  tree->root = llrb_build(tree, NULL, nmemb, height, caps, &serial, &ok);
+  tree->size = ok ? nmemb : 0;
+
+  serial_destroy(&serial);
+
+  return ok;
+}
+
 extern struct llrb_iter llrb_iter_init(const struct llrb_root tree) {
   register struct llrb_node *pivot = tree.root;
 
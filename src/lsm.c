@@ -0,0 +1,522 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * lsm.c - log-structured merge index definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/lsm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LSM_BLOOM_BITS   10
+#define LSM_BLOOM_PROBES 7
+
+/*
+ * The value of a tombstone, whose address is written to the runs as a pointer.
+ * The runs do not outlive the index, so that the address stays the same for as long as they are read.
+ */
+static char lsm_tombstone;
+
+#define LSM_TOMBSTONE ((void *)&lsm_tombstone)
+
+/**
+ * struct lsm_source - the elements of a memtable or a run collected for a merge
+ *
+ * @keys:     the keys in ascending order
+ * @values:   the values
+ * @nmemb:    the number of the elements collected
+ * @capacity: the capacity of @keys and @values
+ */
+struct lsm_source {
+  const void **keys;
+        void **values;
+        size_t nmemb;
+        size_t capacity;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+static _Thread_local struct lsm_source lsm_source;
+
+/**
+ * lsm_collect - collects an element into lsm_source
+ *
+ * @key:   the key of the element
+ * @value: the value of the element
+ */
+static void lsm_collect(const void *restrict key, void *restrict value) {
+  if (lsm_source.nmemb == lsm_source.capacity) {
+    lsm_source.capacity = lsm_source.capacity == 0 ? 64 : lsm_source.capacity*2;
+    lsm_source.keys     = realloc(lsm_source.keys, __SIZEOF_POINTER__*lsm_source.capacity);
+    lsm_source.values   = realloc(lsm_source.values, __SIZEOF_POINTER__*lsm_source.capacity);
+  }
+  lsm_source.keys[lsm_source.nmemb]   = key;
+  lsm_source.values[lsm_source.nmemb] = value;
+  ++lsm_source.nmemb;
+}
+
+/**
+ * lsm_merge - merges @nmemb sources into @dest, taking the newest version of each element
+ *
+ * @dest:    the source to collect the merged elements into, through lsm_source
+ * @sources: the sources from the newest to the oldest, which are freed
+ * @nmemb:   the number of @sources
+ * @drop:    whether to drop the tombstones, which is only safe if there is nothing older than @sources for them to shadow
+ * @less:    operator defining the (partial) element order
+ */
+static inline void lsm_merge(struct lsm_source *restrict dest, struct lsm_source *restrict sources, const size_t nmemb, const bool drop, bool (*less)(const void *restrict, const void *restrict)) {
+  register size_t idx;
+  register size_t best;
+           size_t *pos = calloc(nmemb, sizeof(size_t));
+
+  memset(&lsm_source, 0, sizeof(struct lsm_source));
+
+  for (;;) {
+    /* the smallest key among the sources, where a tie goes to the newest */
+    for (best = nmemb, idx = 0; idx < nmemb; ++idx)
+      if (pos[idx] < sources[idx].nmemb && (best == nmemb || less(sources[idx].keys[pos[idx]], sources[best].keys[pos[best]]))) best = idx;
+    if (best == nmemb) break;
+
+    if (!drop || sources[best].values[pos[best]] != LSM_TOMBSTONE) lsm_collect(sources[best].keys[pos[best]], sources[best].values[pos[best]]);
+
+    /* the older versions of the element are shadowed */
+    for (idx = nmemb; 0 < idx--;)
+      if (idx != best && pos[idx] < sources[idx].nmemb && !less(sources[best].keys[pos[best]], sources[idx].keys[pos[idx]])) ++pos[idx];
+    ++pos[best];
+  }
+
+  for (idx = 0; idx < nmemb; ++idx) {
+    free(sources[idx].keys);
+    free(sources[idx].values);
+  }
+  free(pos);
+
+  *dest = lsm_source;
+}
+
+/**
+ * lsm_mix - scrambles the bits of @hash
+ *
+ * @hash: the hash of a key
+ */
+static inline uint64_t lsm_mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  return hash ^ (hash >> 33);
+}
+
+/**
+ * lsm_bloom_add - adds the key of @hash to the Bloom filter of @run
+ *
+ * @run:  run to add the key to
+ * @hash: the hash of the key
+ */
+static inline void lsm_bloom_add(struct lsm_run *run, const uint64_t hash) {
+  register const uint64_t h1 = lsm_mix(hash);
+  register const uint64_t h2 = (h1 >> 32) | 1;
+
+  for (register uint64_t idx = 0, bit; idx < LSM_BLOOM_PROBES; ++idx) {
+    bit                 = (h1 + idx*h2) % run->nbits;
+    run->bloom[bit/64] |= UINT64_C(1) << bit%64;
+  }
+}
+
+/**
+ * lsm_bloom_test - checks if the Bloom filter of @run may contain the key of @hash
+ *
+ * @run:  run to check
+ * @hash: the hash of the key
+ */
+static inline bool lsm_bloom_test(const struct lsm_run *run, const uint64_t hash) {
+  register const uint64_t h1 = lsm_mix(hash);
+  register const uint64_t h2 = (h1 >> 32) | 1;
+
+  for (register uint64_t idx = 0, bit; idx < LSM_BLOOM_PROBES; ++idx) {
+    bit = (h1 + idx*h2) % run->nbits;
+    if ((run->bloom[bit/64] & UINT64_C(1) << bit%64) == 0) return false;
+  }
+  return true;
+}
+
+/**
+ * lsm_run_create - writes @source to a new run of @tree
+ *
+ * @tree:   index to write the run of
+ * @run:    run to create
+ * @source: the tree holding the elements and tombstones of the run
+ *
+ * Returns false if the run cannot be written or mapped.
+ */
+static inline bool lsm_run_create(struct lsm_root *restrict tree, struct lsm_run *restrict run, const struct bplus_root source) {
+  register char *path = malloc(strlen(tree->dir)+32);
+
+  if (path == NULL) return false;
+  sprintf(path, "%s/%zu.run", tree->dir, tree->seq++);
+
+  /* the mapping keeps the file alive after it is unlinked */
+  run->image = bplus_save(source, path, NULL, NULL) ? bplus_open_mmap(path, source.less) : NULL;
+  unlink(path);
+  free(path);
+  if (run->image == NULL) return false;
+
+  run->nmemb = bplus_size(source);
+  run->nbits = (run->nmemb*LSM_BLOOM_BITS + 63)/64*64;
+  if ((run->bloom = calloc(run->nbits/64, sizeof(uint64_t))) == NULL) {
+    bplus_close_mmap(run->image);
+    return false;
+  }
+
+  for (register const struct bplus_external_node *node = source.head; node != NULL; node = node->next)
+    for (register size_t idx = 0; idx < node->nmemb; ++idx)
+      lsm_bloom_add(run, tree->hash(node->keys[idx]));
+
+  return true;
+}
+
+/**
+ * lsm_run_destroy - unmaps @run and frees its Bloom filter
+ *
+ * @run: run to destroy
+ */
+static inline void lsm_run_destroy(struct lsm_run *run) {
+  bplus_close_mmap(run->image);
+  free(run->bloom);
+}
+
+/**
+ * lsm_tier - returns the tier of a run of @nmemb elements and tombstones in @tree
+ *
+ * @tree:  index to which the run belongs
+ * @nmemb: the number of the elements and tombstones of the run
+ *
+ * The runs of tier t hold up to @threshold*@fanout^t elements, so that a flushed memtable starts at tier zero
+ * and a merge of @fanout runs of the same tier moves up a tier.
+ */
+static inline size_t lsm_tier(const struct lsm_root *tree, const size_t nmemb) {
+  register size_t tier;
+  register size_t capacity;
+
+  for (tier = 0, capacity = tree->threshold; capacity < nmemb && capacity <= SIZE_MAX/tree->fanout; ++tier, capacity *= tree->fanout);
+
+  return tier;
+}
+
+/**
+ * lsm_pick - picks the runs of @tree to merge, if any
+ *
+ * @tree:  index to compact
+ * @start: where to store the index of the oldest run to merge
+ *
+ * The runs merged are the oldest @fanout of the newest stretch of at least @fanout consecutive runs of the same tier,
+ * so that each element is merged once per tier rather than once per compaction,
+ * and the merged run takes their place among the runs older and newer than them.
+ *
+ * Returns the number of the runs to merge, or zero if no tier is full.
+ */
+static inline size_t lsm_pick(const struct lsm_root *restrict tree, size_t *restrict start) {
+  register size_t end;
+  register size_t tier;
+
+  for (end = tree->nruns; 0 < end; end = *start) {
+    tier = lsm_tier(tree, tree->runs[end-1].nmemb);
+    for (*start = end-1; 0 < *start && lsm_tier(tree, tree->runs[*start-1].nmemb) == tier; --*start);
+    if (tree->fanout <= end - *start) return tree->fanout;
+  }
+
+  return 0;
+}
+
+/**
+ * lsm_compact - merges the @nmemb runs of @tree from @start into @run
+ *
+ * @tree:  index to compact
+ * @start: the index of the oldest run to merge
+ * @nmemb: the number of the runs to merge
+ * @run:   run to create, whose image is NULL if no element survives
+ * @init:  an empty tree of the order and operator of the memtable
+ *
+ * If the oldest run of @tree is merged, there is nothing left for the tombstones to shadow, so that they are dropped.
+ *
+ * Returns false if the run cannot be written.
+ */
+static inline bool lsm_compact(struct lsm_root *restrict tree, const size_t start, const size_t nmemb, struct lsm_run *restrict run, const struct bplus_root init) {
+  struct lsm_source *sources = malloc(sizeof(struct lsm_source)*nmemb);
+  struct lsm_source merged;
+  struct bplus_root source   = init;
+  bool              ok       = true;
+
+  for (register size_t idx = 0; idx < nmemb; ++idx) {
+    memset(&lsm_source, 0, sizeof(struct lsm_source));
+    bplus_image_for_each(tree->runs[start+nmemb-1-idx].image, lsm_collect);
+    sources[idx] = lsm_source;
+  }
+  lsm_merge(&merged, sources, nmemb, start == 0, init.less);
+  free(sources);
+
+  run->image = NULL;
+  if (0 < merged.nmemb) {
+    bplus_build(&source, merged.keys, merged.values, merged.nmemb, 1);
+    ok = lsm_run_create(tree, run, source);
+    bplus_clear(&source);
+  }
+
+  free(merged.keys);
+  free(merged.values);
+
+  return ok;
+}
+
+/**
+ * lsm_work - flushes the frozen memtables of @arg and compacts its runs until stopped
+ *
+ * @arg: the index to flush and compact
+ */
+static void *lsm_work(void *arg) {
+  struct lsm_root   *tree = arg;
+  struct lsm_run    run;
+  struct lsm_run    *runs;
+  struct bplus_root init;
+  size_t            start;
+  size_t            nmemb = 0;
+  bool              ok;
+
+  pthread_mutex_lock(&tree->lock);
+
+  while (!tree->stop) {
+    if (tree->failed || (!tree->flushing && (nmemb = lsm_pick(tree, &start)) == 0)) {
+      pthread_cond_wait(&tree->wake, &tree->lock);
+      continue;
+    }
+
+    /* case of a frozen memtable: it is read by the lookups meanwhile, and released once its run is in place */
+    if (tree->flushing) {
+      pthread_mutex_unlock(&tree->lock);
+      ok = lsm_run_create(tree, &run, tree->frozen);
+      pthread_mutex_lock(&tree->lock);
+
+      if (ok && (runs = realloc(tree->runs, sizeof(struct lsm_run)*(tree->nruns+1))) != NULL) {
+        tree->runs                = runs;
+        tree->runs[tree->nruns++] = run;
+        bplus_clear(&tree->frozen);
+        tree->flushing = false;
+        ++tree->flushes;
+      } else {
+        if (ok) lsm_run_destroy(&run);
+        tree->failed = true;
+      }
+      pthread_cond_broadcast(&tree->idle);
+      continue;
+    }
+
+    /* case of a full tier: the runs flushed meanwhile are newer than the ones merged, and stay after them */
+    memcpy(&init, &tree->memtable, sizeof(struct bplus_root));
+    pthread_mutex_unlock(&tree->lock);
+    ok = lsm_compact(tree, start, nmemb, &run, bplus_init(init.order, init.less));
+    pthread_mutex_lock(&tree->lock);
+
+    if (ok) {
+      for (register size_t idx = start; idx < start+nmemb; ++idx)
+        lsm_run_destroy(&tree->runs[idx]);
+      if (run.image != NULL) tree->runs[start] = run;
+      memmove(tree->runs + start + (run.image != NULL), tree->runs + start + nmemb, sizeof(struct lsm_run)*(tree->nruns - start - nmemb));
+      tree->nruns -= nmemb - (run.image != NULL);
+      ++tree->compactions;
+    } else {
+      tree->failed = true;
+    }
+    pthread_cond_broadcast(&tree->idle);
+  }
+
+  pthread_mutex_unlock(&tree->lock);
+
+  return NULL;
+}
+
+extern bool lsm_init(struct lsm_root *restrict tree, const char *restrict dir, const size_t order, const size_t threshold, const size_t fanout,
+                     bool (*less)(const void *restrict, const void *restrict), uint64_t (*hash)(const void *)) {
+  const struct bplus_root init = bplus_init(order, less);
+
+  if (threshold == 0 || fanout < 2 || (tree->dir = strdup(dir)) == NULL) return false;
+
+  memcpy(&tree->memtable, &init, sizeof(struct bplus_root));
+  memcpy(&tree->frozen, &init, sizeof(struct bplus_root));
+  tree->runs        = NULL;
+  tree->nruns       = 0;
+  tree->threshold   = threshold;
+  tree->fanout      = fanout;
+  tree->seq         = 0;
+  tree->flushes     = 0;
+  tree->compactions = 0;
+  tree->skips       = 0;
+  tree->hash        = hash;
+  tree->flushing    = false;
+  tree->failed      = false;
+  tree->stop        = false;
+  pthread_mutex_init(&tree->lock, NULL);
+  pthread_cond_init(&tree->wake, NULL);
+  pthread_cond_init(&tree->idle, NULL);
+
+  if (pthread_create(&tree->worker, NULL, lsm_work, tree) != 0) {
+    pthread_cond_destroy(&tree->idle);
+    pthread_cond_destroy(&tree->wake);
+    pthread_mutex_destroy(&tree->lock);
+    free(tree->dir);
+    return false;
+  }
+
+  return true;
+}
+
+extern void lsm_destroy(struct lsm_root *tree) {
+  pthread_mutex_lock(&tree->lock);
+  tree->stop = true;
+  pthread_cond_signal(&tree->wake);
+  pthread_mutex_unlock(&tree->lock);
+  pthread_join(tree->worker, NULL);
+
+  bplus_clear(&tree->memtable);
+  bplus_clear(&tree->frozen);
+  for (register size_t idx = 0; idx < tree->nruns; ++idx)
+    lsm_run_destroy(&tree->runs[idx]);
+
+  pthread_cond_destroy(&tree->idle);
+  pthread_cond_destroy(&tree->wake);
+  pthread_mutex_destroy(&tree->lock);
+  free(tree->runs);
+  free(tree->dir);
+}
+
+extern void *lsm_find(struct lsm_root *restrict tree, const void *restrict key) {
+  register       void     *value = bplus_find(tree->memtable, key);
+  register const uint64_t hash   = value == NULL ? tree->hash(key) : 0;
+
+  if (value != NULL) return value == LSM_TOMBSTONE ? NULL : value;
+
+  pthread_mutex_lock(&tree->lock);
+
+  if (tree->flushing) value = bplus_find(tree->frozen, key);
+
+  for (register size_t idx = tree->nruns; value == NULL && 0 < idx--;) {
+    if (!lsm_bloom_test(&tree->runs[idx], hash)) {
+      ++tree->skips;
+      continue;
+    }
+    value = bplus_image_find(tree->runs[idx].image, key);
+  }
+
+  pthread_mutex_unlock(&tree->lock);
+
+  return value == LSM_TOMBSTONE ? NULL : value;
+}
+
+/**
+ * lsm_freeze - freezes the memtable of @tree, waiting for the last frozen one to be flushed
+ *
+ * @tree: index to freeze the memtable of
+ *
+ * Returns false if a run could not be written.
+ */
+static inline bool lsm_freeze(struct lsm_root *tree) {
+  const struct bplus_root init = bplus_init(tree->memtable.order, tree->memtable.less);
+        bool              ok;
+
+  pthread_mutex_lock(&tree->lock);
+
+  while (tree->flushing && !tree->failed) pthread_cond_wait(&tree->idle, &tree->lock);
+
+  if ((ok = !tree->failed)) {
+    memcpy(&tree->frozen, &tree->memtable, sizeof(struct bplus_root));
+    memcpy(&tree->memtable, &init, sizeof(struct bplus_root));
+    tree->flushing = true;
+    pthread_cond_signal(&tree->wake);
+  }
+
+  pthread_mutex_unlock(&tree->lock);
+
+  return ok;
+}
+
+extern bool lsm_insert(struct lsm_root *restrict tree, const void *restrict key, void *restrict value) {
+  if (tree->threshold <= bplus_size(tree->memtable) && !lsm_freeze(tree)) return false;
+  return bplus_insert_or_assign(&tree->memtable, key, value) != NULL;
+}
+
+extern bool lsm_erase(struct lsm_root *restrict tree, const void *restrict key) {
+  if (tree->threshold <= bplus_size(tree->memtable) && !lsm_freeze(tree)) return false;
+  return bplus_insert_or_assign(&tree->memtable, key, LSM_TOMBSTONE) != NULL;
+}
+
+extern bool lsm_flush(struct lsm_root *tree) {
+  register bool   ok;
+           size_t start;
+
+  if (!bplus_empty(tree->memtable) && !lsm_freeze(tree)) return false;
+
+  pthread_mutex_lock(&tree->lock);
+  while (!tree->failed && (tree->flushing || lsm_pick(tree, &start) != 0)) pthread_cond_wait(&tree->idle, &tree->lock);
+  ok = !tree->failed;
+  pthread_mutex_unlock(&tree->lock);
+
+  return ok;
+}
+
+/**
+ * lsm_scan - applies @func to each element of @tree greater than or equal to @inf and less than @sup
+ *
+ * @tree:    index to apply @func to each element of
+ * @inf:     the lower bound key to search for
+ * @sup:     the upper bound key to search for
+ * @bounded: whether to bound the scan, or apply @func to each element
+ * @func:    function to apply to each element of @tree
+ *
+ * The elements are collected from the memtables and the runs under the lock, while @func is applied after it is released.
+ */
+static inline void lsm_scan(struct lsm_root *restrict tree, const void *inf, const void *sup, const bool bounded, void (*func)(const void *restrict, void *restrict)) {
+  struct lsm_source *sources;
+  struct lsm_source merged;
+  size_t            nmemb = 0;
+
+  pthread_mutex_lock(&tree->lock);
+
+  sources = malloc(sizeof(struct lsm_source)*(tree->nruns+2));
+
+  memset(&lsm_source, 0, sizeof(struct lsm_source));
+  if (bounded) bplus_range_each(tree->memtable, inf, sup, lsm_collect);
+  else         bplus_for_each(tree->memtable, lsm_collect);
+  sources[nmemb++] = lsm_source;
+
+  if (tree->flushing) {
+    memset(&lsm_source, 0, sizeof(struct lsm_source));
+    if (bounded) bplus_range_each(tree->frozen, inf, sup, lsm_collect);
+    else         bplus_for_each(tree->frozen, lsm_collect);
+    sources[nmemb++] = lsm_source;
+  }
+
+  for (register size_t idx = tree->nruns; 0 < idx--;) {
+    memset(&lsm_source, 0, sizeof(struct lsm_source));
+    if (bounded) bplus_image_range_each(tree->runs[idx].image, inf, sup, lsm_collect);
+    else         bplus_image_for_each(tree->runs[idx].image, lsm_collect);
+    sources[nmemb++] = lsm_source;
+  }
+
+  pthread_mutex_unlock(&tree->lock);
+
+  lsm_merge(&merged, sources, nmemb, true, tree->memtable.less);
+  free(sources);
+
+  for (register size_t idx = 0; idx < merged.nmemb; ++idx)
+    func(merged.keys[idx], merged.values[idx]);
+
+  free(merged.keys);
+  free(merged.values);
+}
+
+extern void lsm_for_each(struct lsm_root *tree, void (*func)(const void *restrict, void *restrict)) { lsm_scan(tree, NULL, NULL, false, func); }
+
+extern void lsm_range_each(struct lsm_root *tree, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) { lsm_scan(tree, inf, sup, true, func); }
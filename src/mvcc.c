@@ -0,0 +1,407 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * mvcc.c - multi-version B+-tree definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/mvcc.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * mvcc_bsearch - returns the index of the first key in @keys not less than @key
+ *
+ * @key:   the key to search for
+ * @keys:  the ordered set of keys
+ * @nmemb: the number of @keys
+ * @less:  operator defining the (partial) element order
+ */
+static inline size_t mvcc_bsearch(const void *restrict key, const void **restrict keys, const size_t nmemb, bool (*less)(const void *restrict, const void *restrict)) {
+  register size_t mid;
+  register size_t lo = 0;
+  register size_t hi = nmemb;
+
+  while (lo < hi) {
+    mid = (lo+hi)>>1;
+    if (less(keys[mid], key)) lo = mid+1;
+    else                      hi = mid;
+  }
+
+  return lo;
+}
+
+/**
+ * mvcc_seek - returns the leaf holding the first key of @tree greater than (or equal to, unless @after is set) @cursor
+ *
+ * @tree:   tree to search
+ * @cursor: the key to search for, or NULL for the first key
+ * @after:  whether to skip @cursor itself
+ * @index:  where to store the index of the key in the leaf
+ *
+ * Returns NULL if there is no such key.
+ */
+static inline struct bplus_external_node *mvcc_seek(const struct bplus_root *restrict tree, const void *restrict cursor, const bool after, size_t *restrict index) {
+  register       size_t                     idx  = 0;
+  register const struct bplus_internal_node *walk = cursor == NULL ? NULL : tree->root;
+  register       struct bplus_external_node *node = tree->head;
+
+  while (walk != NULL) {
+    idx = mvcc_bsearch(cursor, walk->keys, walk->nmemb, tree->less);
+    if (walk->type) node = walk->children[idx], walk = NULL;
+    else            walk = walk->children[idx];
+  }
+
+  if (node != NULL && cursor != NULL) {
+    idx = mvcc_bsearch(cursor, node->keys, node->nmemb, tree->less);
+    if (after && idx < node->nmemb && !tree->less(cursor, node->keys[idx])) ++idx;
+  }
+
+  for (; node != NULL && idx == node->nmemb; node = node->next, idx = 0);
+
+  *index = idx;
+  return node;
+}
+
+/**
+ * mvcc_resolve - returns the version of @chain visible at @stamp, or NULL if the key is absent at @stamp
+ *
+ * @chain: the version chain of a key
+ * @stamp: the logical time to look up
+ */
+static inline const struct mvcc_version *mvcc_resolve(const struct mvcc_version *chain, const size_t stamp) {
+  for (; chain != NULL && stamp < chain->stamp; chain = chain->next);
+  return chain == NULL || chain->erased ? NULL : chain;
+}
+
+/**
+ * mvcc_horizon - returns the logical time of the oldest snapshot of @root, or that of the last write if there is none
+ *
+ * @root: tree whose write lock is held
+ */
+static inline size_t mvcc_horizon(struct mvcc_root *root) {
+  pthread_mutex_lock(&root->lock);
+  const size_t horizon = root->oldest == NULL ? root->clock : root->oldest->stamp;
+  pthread_mutex_unlock(&root->lock);
+  return horizon;
+}
+
+/**
+ * mvcc_free - frees @version and all the older versions following it
+ *
+ * @version: the newest version to free
+ *
+ * Returns the number of the freed versions.
+ */
+static inline size_t mvcc_free(struct mvcc_version *version) {
+  register struct mvcc_version *next;
+  register size_t              freed = 0;
+
+  for (; version != NULL; version = next, ++freed) {
+    next = version->next;
+    free(version);
+  }
+
+  return freed;
+}
+
+/**
+ * mvcc_trim - frees the versions of @chain older than the newest one visible at @horizon
+ *
+ * @chain:   the version chain to trim, which is set to NULL if no version is left
+ * @horizon: the logical time of the oldest snapshot
+ *
+ * The newest version visible at @horizon is freed as well if it is a tombstone,
+ * since a missing version and a tombstone look the same to a snapshot.
+ *
+ * Returns the number of the freed versions.
+ */
+static inline size_t mvcc_trim(struct mvcc_version **chain, const size_t horizon) {
+  register struct mvcc_version **link = chain;
+  register struct mvcc_version *version;
+
+  for (; *link != NULL && horizon < (*link)->stamp; link = &(*link)->next);
+
+  if (*link != NULL && !(*link)->erased)
+    link = &(*link)->next;
+
+  version = *link;
+  *link   = NULL;
+
+  return mvcc_free(version);
+}
+
+/**
+ * mvcc_push - pushes a new version of @key onto @chain and trims it
+ *
+ * @root:   tree whose write lock is held
+ * @key:    the key to write
+ * @chain:  the version chain of @key, or NULL if @key is not in the tree
+ * @value:  the value of the new version
+ * @erased: whether the new version is a tombstone
+ */
+static inline void mvcc_push(struct mvcc_root *restrict root, const void *restrict key, struct mvcc_version *restrict chain, void *restrict value, const bool erased) {
+  struct mvcc_version *version = malloc(sizeof(struct mvcc_version));
+  version->value               = value;
+  version->stamp               = ++root->clock;
+  version->erased              = erased;
+  version->next                = chain;
+
+  mvcc_trim(&version, mvcc_horizon(root));
+
+  if (version != NULL)    bplus_insert_or_assign(&root->tree.tree, key, version);
+  else if (chain != NULL) bplus_erase(&root->tree.tree, key);
+}
+
+/**
+ * mvcc_collect - collects up to MVCC_BATCH elements of @tree visible at @stamp after @cursor and less than @sup
+ *
+ * @tree:   tree whose read lock is held
+ * @stamp:  the logical time to look up
+ * @cursor: the key to resume from, or NULL to start from the first key
+ * @after:  whether to skip @cursor itself
+ * @sup:    the upper bound key, or NULL for no upper bound
+ * @keys:   where to store the keys of the collected elements
+ * @values: where to store the values of the collected elements
+ * @done:   set if there is no more element to collect
+ *
+ * Returns the number of the collected elements.
+ */
+static inline size_t mvcc_collect(const struct bplus_root *restrict tree, const size_t stamp, const void *cursor, const bool after, const void *sup,
+                                  const void **restrict keys, void **restrict values, bool *restrict done) {
+           size_t                     idx;
+  register size_t                     nmemb = 0;
+  register struct bplus_external_node *node = mvcc_seek(tree, cursor, after, &idx);
+  register const struct mvcc_version  *version;
+
+  for (; node != NULL; node = node->next, idx = 0) {
+    for (; idx < node->nmemb; ++idx) {
+      if (sup != NULL && !tree->less(node->keys[idx], sup)) {
+        *done = true;
+        return nmemb;
+      }
+      if ((version = mvcc_resolve(node->values[idx], stamp)) != NULL) {
+        keys[nmemb]     = node->keys[idx];
+        values[nmemb++] = version->value;
+        if (nmemb == MVCC_BATCH) {
+          *done = false;
+          return nmemb;
+        }
+      }
+    }
+  }
+
+  *done = true;
+  return nmemb;
+}
+
+/**
+ * mvcc_scan - applies @func to each element of @snapshot greater than or equal to @inf and less than @sup, a batch at a time
+ *
+ * @root:     tree to scan
+ * @snapshot: snapshot to scan
+ * @inf:      the lower bound key, or NULL for no lower bound
+ * @sup:      the upper bound key, or NULL for no upper bound
+ * @func:     function to apply to each element
+ */
+static inline void mvcc_scan(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) {
+  register size_t idx;
+  register size_t nmemb;
+           bool   done   = false;
+           bool   after  = false;
+  const    void   *cursor = inf;
+  const    void   *keys[MVCC_BATCH];
+           void   *values[MVCC_BATCH];
+
+  while (!done) {
+    pthread_rwlock_rdlock(&root->tree.lock);
+    nmemb = mvcc_collect(&root->tree.tree, snapshot->stamp, cursor, after, sup, keys, values, &done);
+    pthread_rwlock_unlock(&root->tree.lock);
+
+    /* the batch is visited without the lock, so that writers wait for no more than a batch */
+    for (idx = 0; idx < nmemb; ++idx)
+      func(keys[idx], values[idx]);
+
+    if (0 < nmemb) cursor = keys[nmemb-1], after = true;
+  }
+}
+
+extern void mvcc_init(struct mvcc_root *root, const size_t order, bool (*less)(const void *restrict, const void *restrict)) {
+  bplus_rw_init(&root->tree, order, less);
+  root->clock  = 0;
+  root->size   = 0;
+  root->oldest = NULL;
+  root->newest = NULL;
+  pthread_mutex_init(&root->lock, NULL);
+}
+
+extern void mvcc_destroy(struct mvcc_root *root) {
+  for (register struct bplus_external_node *node = root->tree.tree.head; node != NULL; node = node->next)
+    for (register size_t idx = 0; idx < node->nmemb; ++idx)
+      mvcc_free(node->values[idx]);
+
+  bplus_rw_destroy(&root->tree);
+  pthread_mutex_destroy(&root->lock);
+  root->size = 0;
+}
+
+extern size_t mvcc_size(struct mvcc_root *root) {
+  pthread_rwlock_rdlock(&root->tree.lock);
+  const size_t size = root->size;
+  pthread_rwlock_unlock(&root->tree.lock);
+  return size;
+}
+
+extern bool mvcc_contains(struct mvcc_root *root, const void *key) {
+  pthread_rwlock_rdlock(&root->tree.lock);
+  const bool found = mvcc_resolve(bplus_find(root->tree.tree, key), SIZE_MAX) != NULL;
+  pthread_rwlock_unlock(&root->tree.lock);
+  return found;
+}
+
+extern void *mvcc_find(struct mvcc_root *root, const void *key) {
+  pthread_rwlock_rdlock(&root->tree.lock);
+  const struct mvcc_version *version = mvcc_resolve(bplus_find(root->tree.tree, key), SIZE_MAX);
+  void                      *value   = version == NULL ? NULL : version->value;
+  pthread_rwlock_unlock(&root->tree.lock);
+  return value;
+}
+
+extern bool mvcc_insert(struct mvcc_root *root, const void *key, void *value) {
+  pthread_rwlock_wrlock(&root->tree.lock);
+
+  struct mvcc_version *chain    = bplus_find(root->tree.tree, key);
+  const bool          inserted = mvcc_resolve(chain, SIZE_MAX) == NULL;
+
+  if (inserted) {
+    mvcc_push(root, key, chain, value, false);
+    ++root->size;
+  }
+
+  pthread_rwlock_unlock(&root->tree.lock);
+
+  return inserted;
+}
+
+extern void mvcc_replace(struct mvcc_root *root, const void *key, void *value) {
+  pthread_rwlock_wrlock(&root->tree.lock);
+
+  struct mvcc_version *chain = bplus_find(root->tree.tree, key);
+
+  if (mvcc_resolve(chain, SIZE_MAX) == NULL)
+    ++root->size;
+  mvcc_push(root, key, chain, value, false);
+
+  pthread_rwlock_unlock(&root->tree.lock);
+}
+
+extern void *mvcc_erase(struct mvcc_root *root, const void *key) {
+  void *erased = NULL;
+
+  pthread_rwlock_wrlock(&root->tree.lock);
+
+  struct mvcc_version       *chain   = bplus_find(root->tree.tree, key);
+  const struct mvcc_version *version = mvcc_resolve(chain, SIZE_MAX);
+
+  if (version != NULL) {
+    erased = version->value;
+    mvcc_push(root, key, chain, NULL, true);
+    --root->size;
+  }
+
+  pthread_rwlock_unlock(&root->tree.lock);
+
+  return erased;
+}
+
+extern void mvcc_snapshot(struct mvcc_root *restrict root, struct mvcc_snapshot *restrict snapshot) {
+  /* the read lock keeps the clock from moving while the snapshot is registered */
+  pthread_rwlock_rdlock(&root->tree.lock);
+  pthread_mutex_lock(&root->lock);
+
+  snapshot->stamp = root->clock;
+  snapshot->prev  = root->newest;
+  snapshot->next  = NULL;
+
+  if (root->newest == NULL) root->oldest       = snapshot;
+  else                      root->newest->next = snapshot;
+  root->newest = snapshot;
+
+  pthread_mutex_unlock(&root->lock);
+  pthread_rwlock_unlock(&root->tree.lock);
+}
+
+extern void mvcc_release(struct mvcc_root *restrict root, struct mvcc_snapshot *restrict snapshot) {
+  pthread_mutex_lock(&root->lock);
+
+  if (snapshot->prev == NULL) root->oldest         = snapshot->next;
+  else                        snapshot->prev->next = snapshot->next;
+  if (snapshot->next == NULL) root->newest         = snapshot->prev;
+  else                        snapshot->next->prev = snapshot->prev;
+
+  pthread_mutex_unlock(&root->lock);
+}
+
+extern void *mvcc_snapshot_find(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, const void *key) {
+  pthread_rwlock_rdlock(&root->tree.lock);
+  const struct mvcc_version *version = mvcc_resolve(bplus_find(root->tree.tree, key), snapshot->stamp);
+  void                      *value   = version == NULL ? NULL : version->value;
+  pthread_rwlock_unlock(&root->tree.lock);
+  return value;
+}
+
+extern void mvcc_for_each(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, void (*func)(const void *restrict, void *restrict)) {
+  mvcc_scan(root, snapshot, NULL, NULL, func);
+}
+
+extern void mvcc_range_each(struct mvcc_root *restrict root, const struct mvcc_snapshot *restrict snapshot, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) {
+  mvcc_scan(root, snapshot, inf, sup, func);
+}
+
+extern size_t mvcc_gc(struct mvcc_root *root) {
+  register size_t                     idx;
+  register size_t                     pos;
+  register size_t                     count;
+  register size_t                     nmemb;
+  register size_t                     horizon;
+  register size_t                     freed  = 0;
+  register struct bplus_external_node *node;
+           size_t                     start;
+           bool                       after  = false;
+           bool                       done   = false;
+  const    void                       *cursor = NULL;
+  const    void                       *erased[MVCC_BATCH];
+
+  while (!done) {
+    pthread_rwlock_wrlock(&root->tree.lock);
+
+    horizon = mvcc_horizon(root);
+    node    = mvcc_seek(&root->tree.tree, cursor, after, &start);
+    done    = true;
+
+    for (idx = start, count = 0, nmemb = 0; node != NULL; node = node->next, idx = 0) {
+      for (; idx < node->nmemb && count < MVCC_BATCH; ++idx, ++count) {
+        freed += mvcc_trim((struct mvcc_version **)&node->values[idx], horizon);
+        if (node->values[idx] == NULL) erased[nmemb++] = node->keys[idx];
+        cursor = node->keys[idx];
+      }
+      if (count == MVCC_BATCH) {
+        done = false;
+        break;
+      }
+    }
+
+    /* the keys are erased after the sweep of the batch, which would otherwise lose its place in the leaf */
+    for (pos = 0; pos < nmemb; ++pos)
+      bplus_erase(&root->tree.tree, erased[pos]);
+
+    pthread_rwlock_unlock(&root->tree.lock);
+
+    after = true;
+  }
+
+  return freed;
+}
@@ -0,0 +1,442 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * pool.c - buffer pool definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/pool.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * pool_bucket - returns the bucket of @page
+ *
+ * @pool: pool to which the page table belongs
+ * @page: the number of the page
+ */
+static inline size_t pool_bucket(const struct pool *restrict pool, const uint64_t page) { return (size_t)(page*0x9E3779B97F4A7C15ULL >> 32) & (pool->nbuckets-1); }
+
+/**
+ * pool_data - returns the address of the page in the frame at @idx
+ *
+ * @pool: pool to which the frame belongs
+ * @idx:  the index of the frame
+ */
+static inline unsigned char *pool_data(const struct pool *restrict pool, const size_t idx) { return pool->arena + idx*pool->page_size; }
+
+/**
+ * pool_lookup - returns the index of the frame holding @page, or POOL_NIL if not resident
+ *
+ * @pool: pool to search
+ * @page: the number of the page
+ */
+static inline size_t pool_lookup(const struct pool *restrict pool, const uint64_t page) {
+  register size_t idx = pool->buckets[pool_bucket(pool, page)];
+
+  while (idx != POOL_NIL && pool->frames[idx].page != page)
+    idx = pool->frames[idx].chain;
+
+  return idx;
+}
+
+/**
+ * pool_unlink - removes the frame at @idx from the page table
+ *
+ * @pool: pool to which the frame belongs
+ * @idx:  the index of the frame
+ */
+static inline void pool_unlink(struct pool *restrict pool, const size_t idx) {
+  register size_t *link = &pool->buckets[pool_bucket(pool, pool->frames[idx].page)];
+
+  while (*link != idx)
+    link = &pool->frames[*link].chain;
+  *link = pool->frames[idx].chain;
+}
+
+/**
+ * pool_write - writes the page in the frame at @idx back to the file
+ *
+ * @pool: pool to which the frame belongs
+ * @idx:  the index of the frame
+ *
+ * Returns false if the page cannot be written.
+ */
+static inline bool pool_write(struct pool *restrict pool, const size_t idx) {
+  register const unsigned char *data  = pool_data(pool, idx);
+  register       size_t        size   = pool->page_size;
+  register       off_t         offset = (off_t)(pool->frames[idx].page*pool->page_size);
+  register       ssize_t       count;
+
+  while (0 < size) {
+    if ((count = pwrite(pool->fd, data, size, offset)) < 0) return false;
+    data   += count;
+    offset += count;
+    size   -= (size_t)count;
+  }
+
+  pool->frames[idx].dirty = false;
+  ++pool->writes;
+
+  return true;
+}
+
+/**
+ * pool_read - reads the page in the frame at @idx from the file, filling the part past the end of the file with zeros
+ *
+ * @pool: pool to which the frame belongs
+ * @idx:  the index of the frame
+ *
+ * Returns false if the page cannot be read.
+ */
+static inline bool pool_read(struct pool *restrict pool, const size_t idx) {
+  register unsigned char *data  = pool_data(pool, idx);
+  register size_t        size   = pool->page_size;
+  register off_t         offset = (off_t)(pool->frames[idx].page*pool->page_size);
+  register ssize_t       count;
+
+  while (0 < size) {
+    if ((count = pread(pool->fd, data, size, offset)) < 0) return false;
+    if (count == 0) {
+      memset(data, 0, size);
+      break;
+    }
+    data   += count;
+    offset += count;
+    size   -= (size_t)count;
+  }
+
+  return true;
+}
+
+/**
+ * pool_wait - waits for the reader thread reading the page in the frame at @idx, if any
+ *
+ * @pool: pool to which the frame belongs
+ * @idx:  the index of the frame
+ *
+ * Returns false if the read has failed.
+ */
+static inline bool pool_wait(struct pool *restrict pool, const size_t idx) {
+  if (__atomic_load_n(&pool->frames[idx].loading, __ATOMIC_ACQUIRE)) {
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&pool->frames[idx].loading, __ATOMIC_ACQUIRE))
+      pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return !pool->frames[idx].failed;
+}
+
+/**
+ * pool_reader - reads the pages of the frames in the queue of @arg until stopped
+ *
+ * @arg: the pool to read the pages of
+ */
+static void *pool_reader(void *arg) {
+  struct pool *pool = arg;
+  size_t      idx;
+  bool        ok;
+
+  pthread_mutex_lock(&pool->lock);
+
+  for (;;) {
+    while (pool->count == 0 && !pool->stop)
+      pthread_cond_wait(&pool->ready, &pool->lock);
+    if (pool->count == 0) break;
+
+    idx        = pool->queue[pool->head];
+    pool->head = (pool->head+1) % pool->nframes;
+    --pool->count;
+
+    /* the frame is neither evicted nor handed out while loading, so that it is read without the lock */
+    pthread_mutex_unlock(&pool->lock);
+    ok = pool_read(pool, idx);
+    pthread_mutex_lock(&pool->lock);
+
+    pool->frames[idx].failed = !ok;
+    __atomic_store_n(&pool->frames[idx].loading, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->done);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+/**
+ * pool_stop - stops the reader threads of @pool once they have read all pages in the queue
+ *
+ * @pool: pool to stop the reader threads of
+ */
+static inline void pool_stop(struct pool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (register size_t idx = 0; idx < pool->nreaders; ++idx)
+    pthread_join(pool->readers[idx], NULL);
+
+  free(pool->readers);
+  free(pool->queue);
+  pool->readers  = NULL;
+  pool->queue    = NULL;
+  pool->nreaders = 0;
+  pool->stop     = false;
+}
+
+/**
+ * pool_evict - returns the index of a free frame, evicting its page by the CLOCK algorithm if needed
+ *
+ * @pool: pool to take a frame from
+ *
+ * Returns POOL_NIL if every frame is pinned or the victim cannot be written back.
+ */
+static inline size_t pool_evict(struct pool *pool) {
+  register size_t idx;
+  register size_t loading;
+
+  for (;;) {
+    loading = POOL_NIL;
+
+    /* two sweeps are enough, as the first clears the reference bit of every unpinned frame */
+    for (register size_t count = 0; count < pool->nframes<<1; ++count) {
+      idx        = pool->hand;
+      pool->hand = (pool->hand+1) % pool->nframes;
+
+      /* case of an empty frame */
+      if (!pool->frames[idx].valid) return idx;
+
+      if (0 < pool->frames[idx].pins) continue;
+
+      /* case of a page being read by a reader thread */
+      if (__atomic_load_n(&pool->frames[idx].loading, __ATOMIC_ACQUIRE)) {
+        loading = idx;
+        continue;
+      }
+
+      /* case of a recently referenced frame: give it a second chance */
+      if (pool->frames[idx].referenced) {
+        pool->frames[idx].referenced = false;
+        continue;
+      }
+
+      if (pool->frames[idx].dirty && !pool_write(pool, idx)) return POOL_NIL;
+      pool_unlink(pool, idx);
+      pool->frames[idx].valid = false;
+      return idx;
+    }
+
+    /* case of no victim but the frames being read, one of which is to become a victim once read */
+    if (loading == POOL_NIL) return POOL_NIL;
+    pool_wait(pool, loading);
+  }
+}
+
+/**
+ * pool_pin - pins @page into a free frame
+ *
+ * @pool: pool to pin the page into
+ * @page: the number of the page
+ *
+ * Returns the index of the frame, or POOL_NIL if every frame is pinned.
+ */
+static inline size_t pool_pin(struct pool *pool, const uint64_t page) {
+  register const size_t idx = pool_evict(pool);
+  register       size_t bucket;
+
+  if (idx == POOL_NIL) return POOL_NIL;
+
+  bucket                       = pool_bucket(pool, page);
+  pool->frames[idx].page       = page;
+  pool->frames[idx].pins       = 1;
+  pool->frames[idx].chain      = pool->buckets[bucket];
+  pool->frames[idx].valid      = true;
+  pool->frames[idx].dirty      = false;
+  pool->frames[idx].referenced = true;
+  pool->frames[idx].failed     = false;
+  pool->buckets[bucket]        = idx;
+
+  return idx;
+}
+
+extern bool pool_open(struct pool *restrict pool, const char *restrict path, const size_t page_size, const size_t budget) {
+  if (page_size < sizeof(uint64_t) || (page_size & (page_size-1)) != 0 || budget/page_size < 2) return false;
+
+  if ((pool->fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) return false;
+
+  pool->page_size = page_size;
+  pool->nframes   = budget/page_size;
+  pool->hand      = 0;
+  pool->reads     = 0;
+  pool->writes    = 0;
+  pool->prefetches = 0;
+  pool->readers   = NULL;
+  pool->nreaders  = 0;
+  pool->queue     = NULL;
+  pool->head      = 0;
+  pool->count     = 0;
+  pool->stop      = false;
+
+  for (pool->nbuckets = 1; pool->nbuckets < pool->nframes; pool->nbuckets <<= 1);
+
+  pool->frames  = calloc(pool->nframes, sizeof(struct pool_frame));
+  pool->buckets = malloc(sizeof(size_t)*pool->nbuckets);
+  if (pool->frames == NULL || pool->buckets == NULL || posix_memalign((void **)&pool->arena, page_size, pool->nframes*page_size) != 0) {
+    free(pool->frames);
+    free(pool->buckets);
+    close(pool->fd);
+    return false;
+  }
+
+  for (register size_t idx = 0; idx < pool->nbuckets; ++idx)
+    pool->buckets[idx] = POOL_NIL;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->ready, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  return true;
+}
+
+extern bool pool_async(struct pool *pool, const size_t nreaders) {
+  if (nreaders == 0 || pool->nreaders != 0) return false;
+
+  pool->queue   = malloc(sizeof(size_t)*pool->nframes);
+  pool->readers = malloc(sizeof(pthread_t)*nreaders);
+  if (pool->queue == NULL || pool->readers == NULL) {
+    free(pool->queue);
+    free(pool->readers);
+    pool->queue   = NULL;
+    pool->readers = NULL;
+    return false;
+  }
+
+  for (; pool->nreaders < nreaders; ++pool->nreaders) {
+    if (pthread_create(&pool->readers[pool->nreaders], NULL, pool_reader, pool) != 0) {
+      pool_stop(pool);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+extern bool pool_close(struct pool *pool) {
+  register bool ok;
+
+  if (0 < pool->nreaders) pool_stop(pool);
+
+  ok = pool_flush(pool);
+  ok = close(pool->fd) == 0 && ok;
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->ready);
+  pthread_cond_destroy(&pool->done);
+  free(pool->frames);
+  free(pool->buckets);
+  free(pool->arena);
+
+  return ok;
+}
+
+extern void *pool_fetch(struct pool *pool, const uint64_t page) {
+  register size_t idx = pool_lookup(pool, page);
+
+  if (idx != POOL_NIL) {
+    ++pool->frames[idx].pins;
+    pool->frames[idx].referenced = true;
+    if (pool_wait(pool, idx)) return pool_data(pool, idx);
+
+    /* case of a failed prefetch: read the page on demand */
+    if (pool_read(pool, idx)) {
+      pool->frames[idx].failed = false;
+      ++pool->reads;
+      return pool_data(pool, idx);
+    }
+    if (--pool->frames[idx].pins == 0) {
+      pool_unlink(pool, idx);
+      pool->frames[idx].valid = false;
+    }
+    return NULL;
+  }
+
+  if ((idx = pool_pin(pool, page)) == POOL_NIL) return NULL;
+
+  if (!pool_read(pool, idx)) {
+    pool_unlink(pool, idx);
+    pool->frames[idx].valid = false;
+    return NULL;
+  }
+
+  ++pool->reads;
+
+  return pool_data(pool, idx);
+}
+
+extern void *pool_prefetch(struct pool *pool, const uint64_t page) {
+  register size_t idx = pool_lookup(pool, page);
+
+  if (idx != POOL_NIL) {
+    ++pool->frames[idx].pins;
+    pool->frames[idx].referenced = true;
+    return pool_data(pool, idx);
+  }
+
+  /* case of no reader threads: leave the read to the kernel */
+  if (pool->nreaders == 0) {
+    posix_fadvise(pool->fd, (off_t)(page*pool->page_size), (off_t)pool->page_size, POSIX_FADV_WILLNEED);
+    return NULL;
+  }
+
+  if ((idx = pool_pin(pool, page)) == POOL_NIL) return NULL;
+
+  __atomic_store_n(&pool->frames[idx].loading, true, __ATOMIC_RELAXED);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->queue[(pool->head+pool->count) % pool->nframes] = idx;
+  ++pool->count;
+  pthread_cond_signal(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  ++pool->prefetches;
+
+  return pool_data(pool, idx);
+}
+
+extern void *pool_create(struct pool *pool, const uint64_t page) {
+  register size_t idx = pool_lookup(pool, page);
+
+  if (idx != POOL_NIL) {
+    ++pool->frames[idx].pins;
+    pool->frames[idx].referenced = true;
+    pool_wait(pool, idx);
+    pool->frames[idx].failed     = false;
+  } else if ((idx = pool_pin(pool, page)) == POOL_NIL) {
+    return NULL;
+  }
+
+  pool->frames[idx].dirty = true;
+  memset(pool_data(pool, idx), 0, pool->page_size);
+
+  return pool_data(pool, idx);
+}
+
+extern void pool_unpin(struct pool *restrict pool, const void *restrict data, const bool dirty) {
+  register const size_t idx = (size_t)((const unsigned char *)data - pool->arena) / pool->page_size;
+
+  --pool->frames[idx].pins;
+  pool->frames[idx].dirty |= dirty;
+}
+
+extern bool pool_flush(struct pool *pool) {
+  for (register size_t idx = 0; idx < pool->nframes; ++idx)
+    if (pool->frames[idx].valid && pool->frames[idx].dirty && !pool_write(pool, idx)) return false;
+
+  return fsync(pool->fd) == 0;
+}
@@ -4,8 +4,17 @@
  *
  * rbtree.c - generic red-black tree definition
  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/epoch.h>
 #include <index/rbtree.h>
+#include <index/serial.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 /**
  * rb_alloc - allocates a node with @key and @value
@@ -41,6 +50,7 @@ static inline void rb_rotate_left(struct rb_node *node) {
   else if (node->parent->left == node) node->parent->left  = rchild;
   else                                 node->parent->right = rchild;
 
+  rchild->tree   = node->tree;
   rchild->parent = node->parent;
   node->parent   = rchild;
 
@@ -62,6 +72,7 @@ static inline void rb_rotate_right(struct rb_node *node) {
   else if (node->parent->left == node) node->parent->left  = lchild;
   else                                 node->parent->right = lchild;
 
+  lchild->tree   = node->tree;
   lchild->parent = node->parent;
   node->parent   = lchild;
 
@@ -69,6 +80,59 @@ static inline void rb_rotate_right(struct rb_node *node) {
     node->left->parent = node;
 }
 
+/**
+ * rb_rebalance - resolves the double reds from @node up to the root
+ *
+ * @node: red node to initiate rebalancing
+ */
+static inline void rb_rebalance(struct rb_node *node) {
+  register struct rb_node *gparent;
+  register struct rb_node *uncle;
+  register struct rb_node *parent;
+
+  for (; (parent = node->parent) != NULL; node = gparent) {
+    if (parent->black)
+      return;
+
+    gparent = parent->parent;
+    uncle   = gparent->right == parent ? gparent->left : gparent->right;
+
+    if (uncle == NULL || uncle->black) { /* case of rearranging */
+      if (gparent->left == parent) {
+        if (parent->left == node) {      /* case of Left Left */
+          parent->black  = true;
+          gparent->black = false;
+          rb_rotate_right(gparent);
+        } else {                         /* case of Left Right */
+          node->black    = true;
+          gparent->black = false;
+          rb_rotate_left(parent);
+          rb_rotate_right(gparent);
+        }
+      } else {
+        if (parent->right == node) {     /* case of Right Right */
+          parent->black  = true;
+          gparent->black = false;
+          rb_rotate_left(gparent);
+        } else {                         /* case of Right Left */
+          node->black    = true;
+          gparent->black = false;
+          rb_rotate_right(parent);
+          rb_rotate_left(gparent);
+        }
+      }
+
+      return;
+    }
+
+    parent->black  = true;               /* case of recoloring */
+    uncle->black   = true;
+    gparent->black = false;
+  }
+
+  node->black = true;
+}
+
 /**
  * rb_lower_bound - finds logical lower bound of @node
  *
@@ -151,86 +215,514 @@ static inline void rb_destroy(struct rb_node *node) {
   }
 }
 
-extern struct rb_iter rb_find(const struct rb_root tree, const void *key) {
-  register struct rb_node *pivot = tree.root;
+/**
+ * rb_copy - allocates a copy of @node whose children still refer to those of @node
+ *
+ * @node:   node to copy
+ * @parent: the address of the parent node of the copy
+ * @tree:   the address of the tree to which the copy belongs
+ */
+static inline struct rb_node *rb_copy(const struct rb_node *restrict node, struct rb_node *restrict parent, struct rb_root *restrict tree) {
+  struct rb_node *copy = rb_alloc(node->key, node->value, parent, tree);
+  copy->left           = node->left;
+  copy->right          = node->right;
+  copy->black          = node->black;
+  return copy;
+}
 
-  while (pivot != NULL) {
-    if (tree.less(key, pivot->key))      pivot = pivot->left;
-    else if (tree.less(pivot->key, key)) pivot = pivot->right;
-    else                                 break;
-  }
+/**
+ * rb_black_height - returns the number of black nodes on the path from @node down to a leaf
+ *
+ * @node: root node of subtree to get the black height
+ */
+static inline size_t rb_black_height(const struct rb_node *node) {
+  register size_t height = 0;
 
-  return rb_mk_iter(pivot);
+  for (; node != NULL; node = node->left)
+    height += node->black;
+
+  return height;
 }
 
-extern struct rb_iter rb_insert(struct rb_root *restrict tree, const void *restrict key, void *restrict value) {
-  register struct rb_node *gparent;
-  register struct rb_node *uncle;
-  register struct rb_node *parent = NULL;
-  register struct rb_node *pivot  = tree->root;
+/**
+ * rb_adopt - makes @node the root of @tree
+ *
+ * @tree: tree to store @node into
+ * @node: root node of subtree to store
+ */
+static inline void rb_adopt(struct rb_root *restrict tree, struct rb_node *node) {
+  if (node != NULL) node->parent = NULL, node->tree = tree, node->black = true;
+  tree->root = node;
+}
 
-  while (pivot != NULL) {
-    if (tree->less(key, pivot->key)) {
-      parent = pivot;
-      pivot  = pivot->left;
-    } else if (tree->less(pivot->key, key)) {
-      parent = pivot;
-      pivot  = pivot->right;
-    } else {
-      return rb_mk_iter(pivot);
+/**
+ * rb_join3 - joins @lhs, @node and @rhs into @tree
+ *
+ * @tree: tree to store the joined subtree into
+ * @lhs:  root node of subtree whose keys are less than the key of @node
+ * @node: node to join with
+ * @rhs:  root node of subtree whose keys are greater than the key of @node
+ *
+ * @node is attached in red to the spine of the subtree with greater black height
+ * at the black height of the other one and the double reds above it are resolved,
+ * so that this takes time proportional to the black height difference.
+ */
+static inline void rb_join3(struct rb_root *restrict tree, struct rb_node *lhs, struct rb_node *node, struct rb_node *rhs) {
+  register struct rb_node *parent = NULL;
+  register size_t         lheight;
+  register size_t         rheight;
+
+  if (lhs != NULL) lhs->parent = NULL, lhs->tree = tree, lhs->black = true;
+  if (rhs != NULL) rhs->parent = NULL, rhs->tree = tree, rhs->black = true;
+  node->tree  = tree;
+  node->black = false;
+  lheight     = rb_black_height(lhs);
+  rheight     = rb_black_height(rhs);
+
+  if (rheight < lheight) {        /* case of taller left subtree */
+    tree->root = lhs;
+    for (; lhs != NULL && (!lhs->black || rheight < lheight); lhs = lhs->right) {
+      lheight -= lhs->black;
+      parent   = lhs;
     }
+    parent->right = node;
+  } else if (lheight < rheight) { /* case of taller right subtree */
+    tree->root = rhs;
+    for (; rhs != NULL && (!rhs->black || lheight < rheight); rhs = rhs->left) {
+      rheight -= rhs->black;
+      parent   = rhs;
+    }
+    parent->left = node;
+  } else {
+    tree->root = node;
   }
 
-  struct rb_node *node = rb_alloc(key, value, parent, tree);
+  node->left   = lhs;
+  node->right  = rhs;
+  node->parent = parent;
 
-  if (parent == NULL)                    tree->root    = node;
-  else if (tree->less(key, parent->key)) parent->left  = node;
-  else                                   parent->right = node;
+  if (lhs != NULL) lhs->parent = node;
+  if (rhs != NULL) rhs->parent = node;
 
-  ++tree->size;
+  rb_rebalance(node);
+}
+
+/**
+ * rb_join2 - joins @lhs and @rhs into @tree
+ *
+ * @tree: tree to store the joined subtree into
+ * @lhs:  root node of subtree whose keys are less than those of @rhs
+ * @rhs:  root node of subtree whose keys are greater than those of @lhs
+ *
+ * The leftmost entry of @rhs is erased and reinserted as the node to join with.
+ */
+static inline void rb_join2(struct rb_root *restrict tree, struct rb_node *lhs, struct rb_node *rhs) {
+  register struct rb_node *node;
+  struct   rb_root        upper = rb_init(tree->less);
+
+  if (rhs == NULL) {
+    rb_adopt(tree, lhs);
+    return;
+  }
+
+  rb_adopt(&upper, rhs);
+
+  for (node = rhs; node->left != NULL; node = node->left);
+
+  const void *key   = node->key;
+        void *value = rb_erase(&upper, key);
+
+  rb_join3(tree, lhs, rb_alloc(key, value, NULL, tree), upper.root);
+}
+
+/**
+ * rb_split_subtree - splits subtree rooted with @node into @lhs and @rhs at @key
+ *
+ * @node: root node of subtree to split
+ * @key:  the key to split at
+ * @less: operator defining the (partial) node order
+ * @lhs:  tree to store the entries less than @key into
+ * @rhs:  tree to store the entries greater than @key into
+ *
+ * Returns the detached node with @key, or NULL if there is no such node.
+ */
+static struct rb_node *rb_split_subtree(struct rb_node *node, const void *restrict key, bool (*less)(const void *restrict, const void *restrict), struct rb_root *restrict lhs, struct rb_root *restrict rhs) {
+  register struct rb_node *found;
+
+  if (node == NULL) {
+    lhs->root = NULL;
+    rhs->root = NULL;
+    return NULL;
+  }
+
+  struct rb_node *left  = node->left;
+  struct rb_node *right = node->right;
+
+  if (less(node->key, key)) {
+    found = rb_split_subtree(right, key, less, lhs, rhs);
+    rb_join3(lhs, left, node, lhs->root);
+    return found;
+  }
 
-  for (pivot = node; pivot->parent != NULL; parent = pivot->parent) {
+  if (less(key, node->key)) {
+    found = rb_split_subtree(left, key, less, lhs, rhs);
+    rb_join3(rhs, rhs->root, node, right);
+    return found;
+  }
+
+  /* the children may be red, and are blackened as they become roots */
+  rb_adopt(lhs, left);
+  rb_adopt(rhs, right);
+
+  return node;
+}
+
+/**
+ * rb_count - counts the entries of subtree rooted with @lhs, walking it in lockstep with @rhs
+ *
+ * @lhs:   root node of subtree to count the entries of
+ * @rhs:   root node of the other subtree
+ * @total: the number of entries in both subtrees
+ *
+ * The walk stops as soon as either subtree is exhausted,
+ * so that this takes time proportional to the smaller one.
+ */
+static inline size_t rb_count(struct rb_node *lhs, struct rb_node *rhs, const size_t total) {
+  register size_t count = 0;
+
+  if (lhs != NULL) for (; lhs->left != NULL; lhs = lhs->left);
+  if (rhs != NULL) for (; rhs->left != NULL; rhs = rhs->left);
+
+  for (; lhs != NULL && rhs != NULL; ++count) {
+    lhs = rb_upper_bound(lhs);
+    rhs = rb_upper_bound(rhs);
+  }
+
+  return lhs == NULL ? count : total-count;
+}
+
+/**
+ * struct rb_task - a subproblem of a set operation
+ *
+ * @tree:    tree to store the result into
+ * @lhs:     root node of the first operand
+ * @rhs:     root node of the second operand
+ * @func:    the set operation to apply to @lhs and @rhs
+ * @threads: the number of threads the subproblem may use
+ * @count:   the number of the common keys of @lhs and @rhs
+ */
+struct rb_task {
+  struct rb_root *tree;
+  struct rb_node *lhs;
+  struct rb_node *rhs;
+  size_t         (*func)(struct rb_root *restrict, struct rb_node *, struct rb_node *, const size_t);
+  size_t         threads;
+  size_t         count;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+static void *rb_task_run(void *arg) {
+  struct rb_task *task = arg;
+  task->count           = task->func(task->tree, task->lhs, task->rhs, task->threads);
+  return NULL;
+}
+
+/**
+ * rb_fork_join - runs @lower and @upper, in parallel if both operands of @lower are large enough
+ *
+ * @lower:   the subproblem on the lower keys
+ * @upper:   the subproblem on the upper keys
+ * @threads: the number of threads both subproblems may use
+ *
+ * Returns the number of the common keys of both subproblems.
+ */
+static inline size_t rb_fork_join(struct rb_task *restrict lower, struct rb_task *restrict upper, const size_t threads) {
+  pthread_t thread;
+
+  lower->threads = threads >> 1;
+  upper->threads = threads - lower->threads;
+
+  if (1 < threads && 8 <= rb_black_height(lower->lhs) && 8 <= rb_black_height(lower->rhs) && pthread_create(&thread, NULL, rb_task_run, lower) == 0) {
+    rb_task_run(upper);
+    pthread_join(thread, NULL);
+  } else {
+    lower->threads = upper->threads = 1;
+    rb_task_run(lower);
+    rb_task_run(upper);
+  }
+
+  return lower->count + upper->count;
+}
+
+/**
+ * rb_union_subtree - merges subtrees rooted with @lhs and @rhs into @tree
+ *
+ * @tree:    tree to store the union into
+ * @lhs:     root node of subtree whose entries take precedence
+ * @rhs:     root node of the other subtree
+ * @threads: the number of threads the operation may use
+ *
+ * Returns the number of the entries of @rhs freed for having keys in @lhs.
+ */
+static size_t rb_union_subtree(struct rb_root *restrict tree, struct rb_node *lhs, struct rb_node *rhs, const size_t threads) {
+  if (lhs == NULL || rhs == NULL) {
+    rb_adopt(tree, lhs == NULL ? rhs : lhs);
+    return 0;
+  }
+
+  struct rb_root lower  = rb_init(tree->less);
+  struct rb_root upper  = rb_init(tree->less);
+  struct rb_node *found = rb_split_subtree(rhs, lhs->key, tree->less, &lower, &upper);
+  struct rb_task ltask  = { .tree = &lower, .lhs = lhs->left,  .rhs = lower.root, .func = rb_union_subtree };
+  struct rb_task utask  = { .tree = &upper, .lhs = lhs->right, .rhs = upper.root, .func = rb_union_subtree };
+  const  size_t  count  = rb_fork_join(&ltask, &utask, threads) + (found != NULL);
+
+  free(found);
+  rb_join3(tree, lower.root, lhs, upper.root);
+
+  return count;
+}
+
+/**
+ * rb_intersection_subtree - keeps the entries of @lhs whose keys are in @rhs, freeing all the others
+ *
+ * @tree:    tree to store the intersection into
+ * @lhs:     root node of subtree whose entries are kept
+ * @rhs:     root node of subtree whose entries are freed
+ * @threads: the number of threads the operation may use
+ *
+ * Returns the number of the entries kept.
+ */
+static size_t rb_intersection_subtree(struct rb_root *restrict tree, struct rb_node *lhs, struct rb_node *rhs, const size_t threads) {
+  if (lhs == NULL || rhs == NULL) {
+    rb_destroy(lhs);
+    rb_destroy(rhs);
+    tree->root = NULL;
+    return 0;
+  }
+
+  struct rb_root lower  = rb_init(tree->less);
+  struct rb_root upper  = rb_init(tree->less);
+  struct rb_node *found = rb_split_subtree(rhs, lhs->key, tree->less, &lower, &upper);
+  struct rb_task ltask  = { .tree = &lower, .lhs = lhs->left,  .rhs = lower.root, .func = rb_intersection_subtree };
+  struct rb_task utask  = { .tree = &upper, .lhs = lhs->right, .rhs = upper.root, .func = rb_intersection_subtree };
+  const  size_t  count  = rb_fork_join(&ltask, &utask, threads);
+
+  if (found == NULL) {
+    free(lhs);
+    rb_join2(tree, lower.root, upper.root);
+    return count;
+  }
+
+  free(found);
+  rb_join3(tree, lower.root, lhs, upper.root);
+
+  return count + 1;
+}
+
+/**
+ * rb_difference_subtree - keeps the entries of @lhs whose keys are not in @rhs, freeing all the others
+ *
+ * @tree:    tree to store the difference into
+ * @lhs:     root node of subtree whose entries are kept
+ * @rhs:     root node of subtree whose entries are freed
+ * @threads: the number of threads the operation may use
+ *
+ * Returns the number of the entries of @lhs freed for having keys in @rhs.
+ */
+static size_t rb_difference_subtree(struct rb_root *restrict tree, struct rb_node *lhs, struct rb_node *rhs, const size_t threads) {
+  if (lhs == NULL || rhs == NULL) {
+    rb_destroy(rhs);
+    rb_adopt(tree, lhs);
+    return 0;
+  }
+
+  struct rb_root lower  = rb_init(tree->less);
+  struct rb_root upper  = rb_init(tree->less);
+  struct rb_node *found = rb_split_subtree(rhs, lhs->key, tree->less, &lower, &upper);
+  struct rb_task ltask  = { .tree = &lower, .lhs = lhs->left,  .rhs = lower.root, .func = rb_difference_subtree };
+  struct rb_task utask  = { .tree = &upper, .lhs = lhs->right, .rhs = upper.root, .func = rb_difference_subtree };
+  const  size_t  count  = rb_fork_join(&ltask, &utask, threads);
+
+  if (found != NULL) {
+    free(found);
+    free(lhs);
+    rb_join2(tree, lower.root, upper.root);
+    return count + 1;
+  }
+
+  rb_join3(tree, lower.root, lhs, upper.root);
+
+  return count;
+}
+
+/**
+ * rb_threads - returns the number of threads a set operation may use
+ */
+static inline size_t rb_threads(void) {
+  const long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+  return nprocs < 1 ? 1 : (size_t)nprocs;
+}
+
+/**
+ * rb_rcu_link - publishes @node in place of @old, the child of @parent or the root of @tree if @parent is NULL
+ *
+ * @tree:   tree to which @old belongs
+ * @parent: the parent node of @old
+ * @old:    node to replace
+ * @node:   node to publish
+ */
+static inline void rb_rcu_link(struct rb_root *restrict tree, struct rb_node *parent, const struct rb_node *old, struct rb_node *node) {
+  if (parent == NULL)            __atomic_store_n(&tree->root, node, __ATOMIC_RELEASE);
+  else if (parent->left == old)  __atomic_store_n(&parent->left, node, __ATOMIC_RELEASE);
+  else                           __atomic_store_n(&parent->right, node, __ATOMIC_RELEASE);
+}
+
+/**
+ * rb_rcu_rotate_left - rotates subtree rooted with @node counterclockwise without disturbing concurrent readers
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  root node of subtree
+ * @epoch: epoch domain to retire @node to
+ *
+ * A reader standing on @node may still need to go right past the right child,
+ * so that @node is replaced with a copy rather than moved down.
+ * Returns the copy of @node.
+ */
+static inline struct rb_node *rb_rcu_rotate_left(struct rb_root *restrict tree, struct rb_node *node, struct epoch_root *restrict epoch) {
+  struct rb_node *rchild = node->right;
+  struct rb_node *copy   = rb_copy(node, rchild, tree);
+  copy->right            = rchild->left;
+
+  if (copy->left != NULL)  copy->left->parent  = copy;
+  if (copy->right != NULL) copy->right->parent = copy;
+
+  __atomic_store_n(&rchild->left, copy, __ATOMIC_RELEASE);
+  rchild->tree   = tree;
+  rchild->parent = node->parent;
+  rb_rcu_link(tree, node->parent, node, rchild);
+  epoch_retire(epoch, node);
+
+  return copy;
+}
+
+/**
+ * rb_rcu_rotate_right - rotates subtree rooted with @node clockwise without disturbing concurrent readers
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  root node of subtree
+ * @epoch: epoch domain to retire @node to
+ *
+ * Returns the copy of @node.
+ */
+static inline struct rb_node *rb_rcu_rotate_right(struct rb_root *restrict tree, struct rb_node *node, struct epoch_root *restrict epoch) {
+  struct rb_node *lchild = node->left;
+  struct rb_node *copy   = rb_copy(node, lchild, tree);
+  copy->left             = lchild->right;
+
+  if (copy->left != NULL)  copy->left->parent  = copy;
+  if (copy->right != NULL) copy->right->parent = copy;
+
+  __atomic_store_n(&lchild->right, copy, __ATOMIC_RELEASE);
+  lchild->tree   = tree;
+  lchild->parent = node->parent;
+  rb_rcu_link(tree, node->parent, node, lchild);
+  epoch_retire(epoch, node);
+
+  return copy;
+}
+
+/**
+ * rb_rcu_rebalance - resolves the double reds from @node up to the root without disturbing concurrent readers
+ *
+ * @tree:  tree to which @node belongs
+ * @node:  red node to initiate rebalancing
+ * @epoch: epoch domain to retire the rotated nodes to
+ */
+static inline void rb_rcu_rebalance(struct rb_root *restrict tree, struct rb_node *node, struct epoch_root *restrict epoch) {
+  register struct rb_node *gparent;
+  register struct rb_node *uncle;
+  register struct rb_node *parent;
+
+  for (; (parent = node->parent) != NULL; node = gparent) {
     if (parent->black)
-      return rb_mk_iter(node);
+      return;
 
     gparent = parent->parent;
     uncle   = gparent->right == parent ? gparent->left : gparent->right;
 
     if (uncle == NULL || uncle->black) { /* case of rearranging */
       if (gparent->left == parent) {
-        if (parent->left == pivot) {     /* case of Left Left */
+        if (parent->left == node) {      /* case of Left Left */
           parent->black  = true;
           gparent->black = false;
-          rb_rotate_right(gparent);
+          rb_rcu_rotate_right(tree, gparent, epoch);
         } else {                         /* case of Left Right */
-          pivot->black   = true;
+          node->black    = true;
           gparent->black = false;
-          rb_rotate_left(parent);
-          rb_rotate_right(gparent);
+          rb_rcu_rotate_left(tree, parent, epoch);
+          rb_rcu_rotate_right(tree, gparent, epoch);
         }
       } else {
-        if (parent->right == pivot) {    /* case of Right Right */
+        if (parent->right == node) {     /* case of Right Right */
           parent->black  = true;
           gparent->black = false;
-          rb_rotate_left(gparent);
+          rb_rcu_rotate_left(tree, gparent, epoch);
         } else {                         /* case of Right Left */
-          pivot->black   = true;
+          node->black    = true;
           gparent->black = false;
-          rb_rotate_right(parent);
-          rb_rotate_left(gparent);
+          rb_rcu_rotate_right(tree, parent, epoch);
+          rb_rcu_rotate_left(tree, gparent, epoch);
         }
       }
 
-      return rb_mk_iter(node);
+      return;
     }
 
     parent->black  = true;               /* case of recoloring */
     uncle->black   = true;
     gparent->black = false;
-    pivot          = gparent;
   }
 
-  tree->root->black = true;
+  node->black = true;
+}
+
+extern struct rb_iter rb_find(const struct rb_root tree, const void *key) {
+  register struct rb_node *pivot = tree.root;
+
+  while (pivot != NULL) {
+    if (tree.less(key, pivot->key))      pivot = pivot->left;
+    else if (tree.less(pivot->key, key)) pivot = pivot->right;
+    else                                 break;
+  }
+
+  return rb_mk_iter(pivot);
+}
+
+extern struct rb_iter rb_insert(struct rb_root *restrict tree, const void *restrict key, void *restrict value) {
+  register struct rb_node *parent = NULL;
+  register struct rb_node *pivot  = tree->root;
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key)) {
+      parent = pivot;
+      pivot  = pivot->left;
+    } else if (tree->less(pivot->key, key)) {
+      parent = pivot;
+      pivot  = pivot->right;
+    } else {
+      return rb_mk_iter(pivot);
+    }
+  }
+
+  struct rb_node *node = rb_alloc(key, value, parent, tree);
+
+  if (parent == NULL)                    tree->root    = node;
+  else if (tree->less(key, parent->key)) parent->left  = node;
+  else                                   parent->right = node;
+
+  ++tree->size;
+
+  rb_rebalance(node);
 
   return rb_mk_iter(node);
 }
@@ -285,6 +777,9 @@ extern void *rb_erase(struct rb_root *restrict tree, const void *restrict key) {
     }
   }
 
+  if (parent == NULL && tree->root != NULL)                         /* case of root */
+    tree->root->tree = tree;
+
   --tree->size;
 
   if (!pivot->black) {
@@ -359,6 +854,388 @@ extern void rb_clear(struct rb_root *tree) {
   tree->size = 0;
 }
 
+extern void rb_clone(struct rb_root *restrict tree, const struct rb_root other) {
+  register size_t         head;
+  register size_t         tail;
+  register struct rb_node *node;
+
+  if (other.root == NULL)
+    return;
+
+  struct rb_node **queue = malloc(__SIZEOF_POINTER__*other.size);
+  queue[0] = tree->root = rb_copy(other.root, NULL, tree);
+
+  for (head = 0, tail = 1; head < tail; ++head) {
+    node = queue[head];
+    if (node->left != NULL)  queue[tail++] = node->left  = rb_copy(node->left, node, tree);
+    if (node->right != NULL) queue[tail++] = node->right = rb_copy(node->right, node, tree);
+  }
+
+  free(queue);
+  tree->size = other.size;
+}
+
+/**
+ * rb_discard - erases all entries in the subtree of @node read from @serial, releasing their keys and values
+ *
+ * @node:   root node of the subtree
+ * @serial: the state of the dump the entries were read from
+ */
+static void rb_discard(struct rb_node *restrict node, struct serial *restrict serial) {
+  register struct rb_node *next;
+
+  while (node != NULL) {
+    rb_discard(node->right, serial);
+    next = node->left;
+    serial_release_entry(serial, node->key, node->value);
+    free(node);
+    node = next;
+  }
+}
+
+/**
+ * rb_build - builds a subtree of @nmemb entries read from @serial, midway split at each node
+ *
+ * @tree:   the tree to which the subtree belongs
+ * @parent: the parent of the subtree
+ * @nmemb:  the number of the entries of the subtree
+ * @depth:  the depth of the subtree
+ * @red:    the depth of the bottom level
+ * @serial: the state of the dump to read the entries from
+ * @ok:     set to false if an entry cannot be read, in which case the subtree is freed along with its keys and values
+ *
+ * As the entries are split midway, every level but the bottom one is full,
+ * so that the nodes of the bottom level are colored red and all the others black.
+ */
+static struct rb_node *rb_build(struct rb_root *restrict tree, struct rb_node *restrict parent, const size_t nmemb, const size_t depth, const size_t red,
+                                struct serial *restrict serial, bool *restrict ok) {
+  register struct rb_node *node;
+  register struct rb_node *left;
+           const void     *key;
+           void           *value;
+
+  if (nmemb == 0 || !*ok) return NULL;
+
+  left = rb_build(tree, NULL, (nmemb-1)/2, depth+1, red, serial, ok);
+  if (!*ok || !(*ok = serial_read_entry(serial, &key, &value))) {
+    rb_discard(left, serial);
+    return NULL;
+  }
+
+  node        = rb_alloc(key, value, parent, tree);
+  node->black = depth == 0 || depth != red;
+  node->left  = left;
+  if (left != NULL) left->parent = node;
+
+  node->right = rb_build(tree, node, nmemb-1 - (nmemb-1)/2, depth+1, red, serial, ok);
+  if (!*ok) {
+    rb_discard(node, serial);
+    return NULL;
+  }
+
+  return node;
+}
+
+extern bool rb_dump(const struct rb_root tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  struct serial serial = serial_init(stream, keys, values);
+  bool          ok     = serial_write_word(&serial, tree.size);
+
+  for (struct rb_iter iter = rb_iter_init(tree); ok && !rb_iter_end(iter); rb_iter_next(&iter))
+    ok = serial_write_entry(&serial, iter.key, iter.value);
+
+  serial_destroy(&serial);
+
+  return ok;
+}
+
+extern bool rb_restore(struct rb_root *restrict tree, const struct serial_stream *restrict stream, const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values) {
+  register size_t        red;
+           struct serial serial = serial_init(stream, keys, values);
+           uint64_t      nmemb;
+           bool          ok;
+
+  /* case of non-empty tree: its entries would be lost */
+  if (tree->root != NULL || !serial_read_word(&serial, &nmemb)) return false;
+
+  for (red = 0; (size_t)2 << red <= nmemb; ++red);
+
+  ok         = true;
+  tree->root = rb_build(tree, NULL, nmemb, 0, red, &serial, &ok);
+  tree->size = ok ? nmemb : 0;
+
+  serial_destroy(&serial);
+
+  return ok;
+}
+
+extern bool rb_join(struct rb_root *restrict tree, struct rb_root *restrict other) {
+  register struct rb_node *lhs;
+  register struct rb_node *rhs;
+
+  if (other->root == NULL)
+    return true;
+
+  if (tree->root == NULL) {
+    tree->root       = other->root;
+    tree->root->tree = tree;
+    tree->size       = other->size;
+    other->root      = NULL;
+    other->size      = 0;
+    return true;
+  }
+
+  for (lhs = tree->root; lhs->right != NULL; lhs = lhs->right);
+  for (rhs = other->root; rhs->left != NULL; rhs = rhs->left);
+
+  struct rb_root *lower = tree;
+  struct rb_root *upper = other;
+
+  if (!tree->less(lhs->key, rhs->key)) {
+    for (lhs = other->root; lhs->right != NULL; lhs = lhs->right);
+    for (rhs = tree->root; rhs->left != NULL; rhs = rhs->left);
+
+    if (!tree->less(lhs->key, rhs->key))
+      return false;
+
+    lower = other;
+    upper = tree;
+  }
+
+  const size_t size = tree->size + other->size;
+
+  rb_join2(tree, lower->root, upper->root);
+
+  tree->size  = size;
+  other->root = NULL;
+  other->size = 0;
+
+  return true;
+}
+
+extern void rb_split(struct rb_root *restrict tree, const void *restrict key, struct rb_root *restrict other) {
+  struct rb_root lhs  = rb_init(tree->less);
+  struct rb_root rhs  = rb_init(tree->less);
+  const  size_t  size = tree->size;
+
+  struct rb_node *found = rb_split_subtree(tree->root, key, tree->less, &lhs, &rhs);
+
+  if (found != NULL)
+    rb_join3(&rhs, NULL, found, rhs.root);
+
+  rb_adopt(tree, lhs.root);
+  rb_adopt(other, rhs.root);
+  tree->size  = rb_count(lhs.root, rhs.root, size);
+  other->size = size - tree->size;
+}
+
+extern void rb_union(struct rb_root *restrict tree, struct rb_root *restrict other) {
+  struct rb_root result = rb_init(tree->less);
+  const  size_t  size   = tree->size + other->size;
+
+  const size_t count = rb_union_subtree(&result, tree->root, other->root, rb_threads());
+
+  rb_adopt(tree, result.root);
+  tree->size  = size - count;
+  other->root = NULL;
+  other->size = 0;
+}
+
+extern void rb_intersection(struct rb_root *restrict tree, struct rb_root *restrict other) {
+  struct rb_root result = rb_init(tree->less);
+
+  const size_t count = rb_intersection_subtree(&result, tree->root, other->root, rb_threads());
+
+  rb_adopt(tree, result.root);
+  tree->size  = count;
+  other->root = NULL;
+  other->size = 0;
+}
+
+extern void rb_difference(struct rb_root *restrict tree, struct rb_root *restrict other) {
+  struct rb_root result = rb_init(tree->less);
+
+  const size_t count = rb_difference_subtree(&result, tree->root, other->root, rb_threads());
+
+  rb_adopt(tree, result.root);
+  tree->size -= count;
+  other->root = NULL;
+  other->size = 0;
+}
+
+extern void *rb_rcu_find(const struct rb_root *tree, const void *key) {
+  register struct rb_node *pivot = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key))      pivot = __atomic_load_n(&pivot->left, __ATOMIC_ACQUIRE);
+    else if (tree->less(pivot->key, key)) pivot = __atomic_load_n(&pivot->right, __ATOMIC_ACQUIRE);
+    else                                  return pivot->value;
+  }
+
+  return NULL;
+}
+
+extern bool rb_rcu_contains(const struct rb_root *tree, const void *key) {
+  register struct rb_node *pivot = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key))      pivot = __atomic_load_n(&pivot->left, __ATOMIC_ACQUIRE);
+    else if (tree->less(pivot->key, key)) pivot = __atomic_load_n(&pivot->right, __ATOMIC_ACQUIRE);
+    else                                  return true;
+  }
+
+  return false;
+}
+
+extern bool rb_rcu_insert(struct rb_root *restrict tree, const void *restrict key, void *restrict value, struct epoch_root *restrict epoch) {
+  register struct rb_node *parent = NULL;
+  register struct rb_node *pivot  = tree->root;
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key)) {
+      parent = pivot;
+      pivot  = pivot->left;
+    } else if (tree->less(pivot->key, key)) {
+      parent = pivot;
+      pivot  = pivot->right;
+    } else {
+      return false;
+    }
+  }
+
+  struct rb_node *node = rb_alloc(key, value, parent, tree);
+
+  if (parent == NULL)                    __atomic_store_n(&tree->root, node, __ATOMIC_RELEASE);
+  else if (tree->less(key, parent->key)) __atomic_store_n(&parent->left, node, __ATOMIC_RELEASE);
+  else                                   __atomic_store_n(&parent->right, node, __ATOMIC_RELEASE);
+
+  ++tree->size;
+
+  rb_rcu_rebalance(tree, node, epoch);
+
+  return true;
+}
+
+extern void *rb_rcu_erase(struct rb_root *restrict tree, const void *restrict key, struct epoch_root *restrict epoch) {
+  register struct rb_node *sibling;
+  register struct rb_node *parent = NULL;
+  register struct rb_node *pivot  = tree->root;
+
+  while (pivot != NULL) {
+    if (tree->less(key, pivot->key)) {
+      parent = pivot;
+      pivot  = pivot->left;
+    } else if (tree->less(pivot->key, key)) {
+      parent = pivot;
+      pivot  = pivot->right;
+    } else {
+      break;
+    }
+  }
+
+  if (pivot == NULL)
+    return NULL;
+
+  void *erased = pivot->value;
+
+  if (pivot->left != NULL && pivot->right != NULL) {                 /* case of degree 2 */
+    for (sibling = pivot->left; sibling->right != NULL; sibling = sibling->right);
+
+    /*
+     * The key of @pivot cannot be overwritten in place under the readers,
+     * so that a copy of @pivot holding the entry of its predecessor takes its place instead.
+     * A reader that passed @pivot before may still be heading for the predecessor,
+     * which thus stays linked until such readers leave.
+     */
+    struct rb_node *copy = rb_copy(pivot, parent, tree);
+    copy->key            = sibling->key;
+    copy->value          = sibling->value;
+    copy->left->parent   = copy;
+    copy->right->parent  = copy;
+    rb_rcu_link(tree, parent, pivot, copy);
+    epoch_retire(epoch, pivot);
+
+    parent = sibling->parent;
+    pivot  = sibling;
+
+    if (parent != copy)
+      epoch_synchronize(epoch);
+  }
+
+  sibling = pivot;                                                   /* case of degree 0 or 1 */
+  pivot   = sibling->left == NULL ? sibling->right : sibling->left;
+  rb_rcu_link(tree, parent, sibling, pivot);
+
+  if (pivot != NULL) {
+    pivot->parent = parent;
+    pivot->tree   = tree;
+  }
+
+  --tree->size;
+
+  if (!sibling->black) {
+    epoch_retire(epoch, sibling);
+    return erased;
+  }
+
+  epoch_retire(epoch, sibling);
+
+  if (pivot != NULL && !pivot->black) {
+    pivot->black = true;
+    return erased;
+  }
+
+  while (parent != NULL) {
+    sibling = parent->right == pivot ? parent->left : parent->right;
+
+    if (!sibling->black) {                                           /* case of rearranging */
+      sibling->black = true;
+      parent->black  = false;
+      parent         = parent->left == pivot ? rb_rcu_rotate_left(tree, parent, epoch) : rb_rcu_rotate_right(tree, parent, epoch);
+      sibling        = parent->right == pivot ? parent->left : parent->right;
+    }
+
+    if ((sibling->left != NULL && !sibling->left->black) || (sibling->right != NULL && !sibling->right->black)) {
+      if (parent->left == sibling) {
+        if (sibling->right != NULL && !sibling->right->black) {      /* case of Left Right */
+          sibling->right->black = true;
+          sibling->black        = false;
+          rb_rcu_rotate_left(tree, sibling, epoch);
+          sibling = parent->left;
+        }
+        sibling->left->black = true;                                 /* case of Left Left */
+        sibling->black       = parent->black;
+        parent->black        = true;
+        rb_rcu_rotate_right(tree, parent, epoch);
+      } else {
+        if (sibling->left != NULL && !sibling->left->black) {        /* case of Right Left */
+          sibling->left->black = true;
+          sibling->black       = false;
+          rb_rcu_rotate_right(tree, sibling, epoch);
+          sibling = parent->right;
+        }
+        sibling->right->black = true;                                /* case of Right Right */
+        sibling->black        = parent->black;
+        parent->black         = true;
+        rb_rcu_rotate_left(tree, parent, epoch);
+      }
+
+      return erased;
+    }
+
+    sibling->black = false;                                          /* case of recoloring */
+
+    if (!parent->black) {
+      parent->black = true;
+      return erased;
+    }
+
+    pivot  = parent;
+    parent = pivot->parent;
+  }
+
+  return erased;
+}
+
 extern struct rb_iter rb_iter_init(const struct rb_root tree) {
   register struct rb_node *pivot = tree.root;
 
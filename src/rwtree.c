@@ -0,0 +1,317 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * rwtree.c - reader/writer-locked tree definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/rwtree.h>
+#include <string.h>
+
+extern void avl_rw_init(struct avl_rw_root *tree, bool (*less)(const void *restrict, const void *restrict)) {
+  tree->tree = avl_init(less);
+  pthread_rwlock_init(&tree->lock, NULL);
+}
+
+extern void avl_rw_destroy(struct avl_rw_root *tree) {
+  avl_clear(&tree->tree);
+  pthread_rwlock_destroy(&tree->lock);
+}
+
+extern size_t avl_rw_size(struct avl_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const size_t size = tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return size;
+}
+
+extern bool avl_rw_contains(struct avl_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const bool found = avl_contains(tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return found;
+}
+
+extern void *avl_rw_find(struct avl_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  void *value = avl_find(tree->tree, key).value;
+  pthread_rwlock_unlock(&tree->lock);
+  return value;
+}
+
+extern bool avl_rw_insert(struct avl_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  const size_t size     = tree->tree.size;
+  avl_insert(&tree->tree, key, value);
+  const bool   inserted = size < tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return inserted;
+}
+
+extern void avl_rw_replace(struct avl_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  avl_replace(&tree->tree, key, value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void *avl_rw_erase(struct avl_rw_root *tree, const void *key) {
+  pthread_rwlock_wrlock(&tree->lock);
+  void *erased = avl_erase(&tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return erased;
+}
+
+extern void avl_rw_for_each(struct avl_rw_root *tree, void (*func)(const void *restrict, void *restrict)) {
+  pthread_rwlock_rdlock(&tree->lock);
+  for (struct avl_iter iter = avl_iter_init(tree->tree); !avl_iter_end(iter); avl_iter_next(&iter))
+    func(iter.key, iter.value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void rb_rw_init(struct rb_rw_root *tree, bool (*less)(const void *restrict, const void *restrict)) {
+  tree->tree = rb_init(less);
+  pthread_rwlock_init(&tree->lock, NULL);
+}
+
+extern void rb_rw_destroy(struct rb_rw_root *tree) {
+  rb_clear(&tree->tree);
+  pthread_rwlock_destroy(&tree->lock);
+}
+
+extern size_t rb_rw_size(struct rb_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const size_t size = tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return size;
+}
+
+extern bool rb_rw_contains(struct rb_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const bool found = rb_contains(tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return found;
+}
+
+extern void *rb_rw_find(struct rb_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  void *value = rb_find(tree->tree, key).value;
+  pthread_rwlock_unlock(&tree->lock);
+  return value;
+}
+
+extern bool rb_rw_insert(struct rb_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  const size_t size     = tree->tree.size;
+  rb_insert(&tree->tree, key, value);
+  const bool   inserted = size < tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return inserted;
+}
+
+extern void rb_rw_replace(struct rb_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  rb_replace(&tree->tree, key, value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void *rb_rw_erase(struct rb_rw_root *tree, const void *key) {
+  pthread_rwlock_wrlock(&tree->lock);
+  void *erased = rb_erase(&tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return erased;
+}
+
+extern void rb_rw_for_each(struct rb_rw_root *tree, void (*func)(const void *restrict, void *restrict)) {
+  pthread_rwlock_rdlock(&tree->lock);
+  for (struct rb_iter iter = rb_iter_init(tree->tree); !rb_iter_end(iter); rb_iter_next(&iter))
+    func(iter.key, iter.value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void llrb_rw_init(struct llrb_rw_root *tree, bool (*less)(const void *restrict, const void *restrict)) {
+  tree->tree = llrb_init(less);
+  pthread_rwlock_init(&tree->lock, NULL);
+}
+
+extern void llrb_rw_destroy(struct llrb_rw_root *tree) {
+  llrb_clear(&tree->tree);
+  pthread_rwlock_destroy(&tree->lock);
+}
+
+extern size_t llrb_rw_size(struct llrb_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const size_t size = tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return size;
+}
+
+extern bool llrb_rw_contains(struct llrb_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const bool found = llrb_contains(tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return found;
+}
+
+extern void *llrb_rw_find(struct llrb_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  void *value = llrb_find(tree->tree, key).value;
+  pthread_rwlock_unlock(&tree->lock);
+  return value;
+}
+
+extern bool llrb_rw_insert(struct llrb_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  const size_t size     = tree->tree.size;
+  llrb_insert(&tree->tree, key, value);
+  const bool   inserted = size < tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return inserted;
+}
+
+extern void llrb_rw_replace(struct llrb_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  llrb_replace(&tree->tree, key, value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void *llrb_rw_erase(struct llrb_rw_root *tree, const void *key) {
+  pthread_rwlock_wrlock(&tree->lock);
+  void *erased = llrb_erase(&tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return erased;
+}
+
+extern void llrb_rw_for_each(struct llrb_rw_root *tree, void (*func)(const void *restrict, void *restrict)) {
+  pthread_rwlock_rdlock(&tree->lock);
+  for (struct llrb_iter iter = llrb_iter_init(tree->tree); !llrb_iter_end(iter); llrb_iter_next(&iter))
+    func(iter.key, iter.value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void btree_rw_init(struct btree_rw_root *tree, const size_t order, bool (*less)(const void *restrict, const void *restrict)) {
+  const struct btree_root init = btree_init(order, less);
+  memcpy(&tree->tree, &init, sizeof(struct btree_root));
+  pthread_rwlock_init(&tree->lock, NULL);
+}
+
+extern void btree_rw_destroy(struct btree_rw_root *tree) {
+  btree_clear(&tree->tree);
+  pthread_rwlock_destroy(&tree->lock);
+}
+
+extern size_t btree_rw_size(struct btree_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const size_t size = tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return size;
+}
+
+extern bool btree_rw_contains(struct btree_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const bool found = btree_contains(tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return found;
+}
+
+extern void *btree_rw_find(struct btree_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  void *value = btree_find(tree->tree, key).value;
+  pthread_rwlock_unlock(&tree->lock);
+  return value;
+}
+
+extern bool btree_rw_insert(struct btree_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  const size_t size     = tree->tree.size;
+  btree_insert(&tree->tree, key, value);
+  const bool   inserted = size < tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return inserted;
+}
+
+extern void btree_rw_replace(struct btree_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  btree_replace(&tree->tree, key, value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void *btree_rw_erase(struct btree_rw_root *tree, const void *key) {
+  pthread_rwlock_wrlock(&tree->lock);
+  void *erased = btree_erase(&tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return erased;
+}
+
+extern void btree_rw_for_each(struct btree_rw_root *tree, void (*func)(const void *restrict, void *restrict)) {
+  pthread_rwlock_rdlock(&tree->lock);
+  for (struct btree_iter iter = btree_iter_init(tree->tree); !btree_iter_end(iter); btree_iter_next(&iter))
+    func(iter.key, iter.value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void bplus_rw_init(struct bplus_rw_root *tree, const size_t order, bool (*less)(const void *restrict, const void *restrict)) {
+  const struct bplus_root init = bplus_init(order, less);
+  memcpy(&tree->tree, &init, sizeof(struct bplus_root));
+  pthread_rwlock_init(&tree->lock, NULL);
+}
+
+extern void bplus_rw_destroy(struct bplus_rw_root *tree) {
+  bplus_clear(&tree->tree);
+  pthread_rwlock_destroy(&tree->lock);
+}
+
+extern size_t bplus_rw_size(struct bplus_rw_root *tree) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const size_t size = tree->tree.size;
+  pthread_rwlock_unlock(&tree->lock);
+  return size;
+}
+
+extern bool bplus_rw_contains(struct bplus_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  const bool found = bplus_contains(tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return found;
+}
+
+extern void *bplus_rw_find(struct bplus_rw_root *tree, const void *key) {
+  pthread_rwlock_rdlock(&tree->lock);
+  void *value = bplus_find(tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return value;
+}
+
+extern bool bplus_rw_insert(struct bplus_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  const bool inserted = bplus_insert(&tree->tree, key, value) != NULL;
+  pthread_rwlock_unlock(&tree->lock);
+  return inserted;
+}
+
+extern void bplus_rw_replace(struct bplus_rw_root *tree, const void *key, void *value) {
+  pthread_rwlock_wrlock(&tree->lock);
+  bplus_insert_or_assign(&tree->tree, key, value);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void *bplus_rw_erase(struct bplus_rw_root *tree, const void *key) {
+  pthread_rwlock_wrlock(&tree->lock);
+  void *erased = bplus_erase(&tree->tree, key);
+  pthread_rwlock_unlock(&tree->lock);
+  return erased;
+}
+
+extern void bplus_rw_for_each(struct bplus_rw_root *tree, void (*func)(const void *restrict, void *restrict)) {
+  pthread_rwlock_rdlock(&tree->lock);
+  bplus_for_each(tree->tree, func);
+  pthread_rwlock_unlock(&tree->lock);
+}
+
+extern void bplus_rw_range_each(struct bplus_rw_root *tree, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) {
+  pthread_rwlock_rdlock(&tree->lock);
+  bplus_range_each(tree->tree, inf, sup, func);
+  pthread_rwlock_unlock(&tree->lock);
+}
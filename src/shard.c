@@ -0,0 +1,291 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * shard.c - range-partitioned sharded index definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/shard.h>
+#include <stdlib.h>
+
+/**
+ * shard_route - returns the shard whose range contained @key when its boundary was read
+ *
+ * @root: index to route @key in
+ * @key:  the key to route
+ *
+ * The boundaries are read without any lock, so that the caller must check the range of the shard after locking it.
+ */
+static inline struct shard_node *shard_route(const struct shard_root *restrict root, const void *restrict key) {
+  register size_t mid;
+  register size_t lo = 0;
+  register size_t hi = root->nmemb;
+
+  while (lo+1 < hi) {
+    mid = (lo+hi)>>1;
+    if (root->less(key, __atomic_load_n(&root->shards[mid].inf, __ATOMIC_ACQUIRE))) hi = mid;
+    else                                                                             lo = mid;
+  }
+
+  return &root->shards[lo];
+}
+
+/**
+ * shard_covers - checks if the range of @node contains @key
+ *
+ * @root: index to which @node belongs
+ * @node: locked shard to check
+ * @key:  the key to check
+ */
+static inline bool shard_covers(const struct shard_root *restrict root, const struct shard_node *restrict node, const void *restrict key) {
+  return (node->inf == NULL || !root->less(key, node->inf)) && (node->sup == NULL || root->less(key, node->sup));
+}
+
+/**
+ * shard_read_lock - read-locks the shard whose range contains @key and returns it
+ *
+ * @root: index to lock the shard of
+ * @key:  the key to route
+ */
+static inline struct shard_node *shard_read_lock(struct shard_root *restrict root, const void *restrict key) {
+  register struct shard_node *node;
+
+  for (;;) {
+    node = shard_route(root, key);
+    pthread_rwlock_rdlock(&node->tree.lock);
+    if (shard_covers(root, node, key)) return node;
+    pthread_rwlock_unlock(&node->tree.lock); /* case of a boundary moved after routing */
+  }
+}
+
+/**
+ * shard_write_lock - write-locks the shard whose range contains @key and returns it
+ *
+ * @root: index to lock the shard of
+ * @key:  the key to route
+ */
+static inline struct shard_node *shard_write_lock(struct shard_root *restrict root, const void *restrict key) {
+  register struct shard_node *node;
+
+  for (;;) {
+    node = shard_route(root, key);
+    pthread_rwlock_wrlock(&node->tree.lock);
+    if (shard_covers(root, node, key)) return node;
+    pthread_rwlock_unlock(&node->tree.lock); /* case of a boundary moved after routing */
+  }
+}
+
+/**
+ * shard_tail_each - applies @func to each element of @tree greater than or equal to @inf
+ *
+ * @tree: tree to apply @func to each element of
+ * @inf:  the lower bound key to search for
+ * @func: function to apply to each element of @tree
+ */
+static inline void shard_tail_each(const struct bplus_root tree, const void *restrict inf, void (*func)(const void *restrict, void *restrict)) {
+  for (register const struct bplus_external_node *node = tree.head; node != NULL; node = node->next)
+    for (register size_t idx = 0; idx < node->nmemb; ++idx)
+      if (!tree.less(node->keys[idx], inf))
+        func(node->keys[idx], node->values[idx]);
+}
+
+/**
+ * shard_move - moves @nmemb elements at the edge of @src facing @dst into @dst
+ *
+ * @src:   write-locked shard to move the elements from
+ * @dst:   write-locked neighbour of @src to move the elements into
+ * @nmemb: the number of the elements to move, less than the size of @src
+ * @bound: where to store the new boundary between @src and @dst
+ *
+ * Returns false without moving any element if the elements cannot be collected.
+ */
+static inline bool shard_move(struct shard_node *restrict src, struct shard_node *restrict dst, const size_t nmemb, const void **restrict bound) {
+  register       size_t                     idx;
+  register       size_t                     pos;
+  register const struct bplus_external_node *node;
+           const void                       **keys   = malloc(__SIZEOF_POINTER__*nmemb);
+                 void                       **values = malloc(__SIZEOF_POINTER__*nmemb);
+
+  if (keys == NULL || values == NULL) {
+    free(keys);
+    free(values);
+    return false;
+  }
+
+  if (src < dst) { /* case of the greatest elements moving right */
+    for (node = src->tree.tree.tail, idx = node->nmemb, pos = nmemb; 0 < pos; --pos) {
+      if (idx == 0) node = node->prev, idx = node->nmemb;
+      keys[pos-1]   = node->keys[--idx];
+      values[pos-1] = node->values[idx];
+    }
+  } else {         /* case of the least elements moving left */
+    for (node = src->tree.tree.head, idx = 0, pos = 0; pos < nmemb; ++pos) {
+      if (idx == node->nmemb) node = node->next, idx = 0;
+      keys[pos]   = node->keys[idx];
+      values[pos] = node->values[idx++];
+    }
+  }
+
+  for (pos = 0; pos < nmemb; ++pos)
+    bplus_erase(&src->tree.tree, keys[pos]);
+
+  *bound = src < dst ? keys[0] : src->tree.tree.head->keys[0];
+
+  bplus_insert_batch(&dst->tree.tree, keys, values, nmemb);
+
+  free(keys);
+  free(values);
+
+  return true;
+}
+
+extern void shard_init(struct shard_root *restrict root, const size_t nmemb, const void **restrict bounds, const size_t order, bool (*less)(const void *restrict, const void *restrict)) {
+  root->shards = aligned_alloc(64, sizeof(struct shard_node)*nmemb);
+  root->nmemb  = nmemb;
+  root->less   = less;
+
+  for (register size_t idx = 0; idx < nmemb; ++idx) {
+    bplus_rw_init(&root->shards[idx].tree, order, less);
+    root->shards[idx].inf    = idx == 0       ? NULL : bounds[idx-1];
+    root->shards[idx].sup    = idx == nmemb-1 ? NULL : bounds[idx];
+    root->shards[idx].writes = 0;
+  }
+
+  pthread_mutex_init(&root->lock, NULL);
+}
+
+extern void shard_destroy(struct shard_root *root) {
+  for (register size_t idx = 0; idx < root->nmemb; ++idx)
+    bplus_rw_destroy(&root->shards[idx].tree);
+
+  free(root->shards);
+  root->shards = NULL;
+  root->nmemb  = 0;
+
+  pthread_mutex_destroy(&root->lock);
+}
+
+extern size_t shard_size(struct shard_root *root) {
+  register size_t size = 0;
+
+  for (register size_t idx = 0; idx < root->nmemb; ++idx)
+    size += bplus_rw_size(&root->shards[idx].tree);
+
+  return size;
+}
+
+extern bool shard_contains(struct shard_root *root, const void *key) {
+  struct shard_node *node  = shard_read_lock(root, key);
+  const bool        found = bplus_contains(node->tree.tree, key);
+  pthread_rwlock_unlock(&node->tree.lock);
+  return found;
+}
+
+extern void *shard_find(struct shard_root *root, const void *key) {
+  struct shard_node *node  = shard_read_lock(root, key);
+  void              *value = bplus_find(node->tree.tree, key);
+  pthread_rwlock_unlock(&node->tree.lock);
+  return value;
+}
+
+extern bool shard_insert(struct shard_root *root, const void *key, void *value) {
+  struct shard_node *node     = shard_write_lock(root, key);
+  const bool        inserted = bplus_insert(&node->tree.tree, key, value) != NULL;
+  __atomic_add_fetch(&node->writes, 1, __ATOMIC_RELAXED);
+  pthread_rwlock_unlock(&node->tree.lock);
+  return inserted;
+}
+
+extern void shard_replace(struct shard_root *root, const void *key, void *value) {
+  struct shard_node *node = shard_write_lock(root, key);
+  bplus_insert_or_assign(&node->tree.tree, key, value);
+  __atomic_add_fetch(&node->writes, 1, __ATOMIC_RELAXED);
+  pthread_rwlock_unlock(&node->tree.lock);
+}
+
+extern void *shard_erase(struct shard_root *root, const void *key) {
+  struct shard_node *node   = shard_write_lock(root, key);
+  void              *erased = bplus_erase(&node->tree.tree, key);
+  __atomic_add_fetch(&node->writes, 1, __ATOMIC_RELAXED);
+  pthread_rwlock_unlock(&node->tree.lock);
+  return erased;
+}
+
+extern void shard_for_each(struct shard_root *root, void (*func)(const void *restrict, void *restrict)) {
+  register struct shard_node *node;
+           const void        *cursor = NULL;
+
+  do {
+    if (cursor == NULL) pthread_rwlock_rdlock(&(node = root->shards)->tree.lock);
+    else                node = shard_read_lock(root, cursor);
+
+    /* the elements below @cursor have moved in from the previous shard after it was visited */
+    if (cursor == NULL || (node->inf != NULL && !root->less(node->inf, cursor))) bplus_for_each(node->tree.tree, func);
+    else                                                                         shard_tail_each(node->tree.tree, cursor, func);
+
+    cursor = node->sup;
+    pthread_rwlock_unlock(&node->tree.lock);
+  } while (cursor != NULL);
+}
+
+extern void shard_range_each(struct shard_root *root, const void *inf, const void *sup, void (*func)(const void *restrict, void *restrict)) {
+  register struct shard_node *node;
+
+  for (;;) {
+    node = shard_read_lock(root, inf);
+    bplus_range_each(node->tree.tree, inf, sup, func);
+    inf = node->sup;
+    pthread_rwlock_unlock(&node->tree.lock);
+
+    if (inf == NULL || !root->less(inf, sup)) return;
+  }
+}
+
+extern size_t shard_rebalance(struct shard_root *root) {
+  register size_t            idx;
+  register size_t            writes;
+  register size_t            heat   = 0;
+  register size_t            total  = 0;
+  register size_t            moved  = 0;
+  register struct shard_node *hot   = root->shards;
+  register struct shard_node *cold;
+           const void        *bound;
+
+  pthread_mutex_lock(&root->lock);
+
+  for (idx = 0; idx < root->nmemb; ++idx) {
+    total += writes = __atomic_load_n(&root->shards[idx].writes, __ATOMIC_RELAXED);
+    if (heat < writes) heat = writes, hot = &root->shards[idx];
+  }
+
+  if (1 < root->nmemb && 2*total < root->nmemb*heat) {
+    cold = hot == root->shards                                                                                        ? hot+1
+         : hot == &root->shards[root->nmemb-1]                                                                        ? hot-1
+         : __atomic_load_n(&hot[1].writes, __ATOMIC_RELAXED) < __atomic_load_n(&hot[-1].writes, __ATOMIC_RELAXED) ? hot+1
+                                                                                                                      : hot-1;
+
+    pthread_rwlock_wrlock(&(hot < cold ? hot : cold)->tree.lock);
+    pthread_rwlock_wrlock(&(hot < cold ? cold : hot)->tree.lock);
+
+    /* case of no memory to collect the elements: the shards are left as they are */
+    if (0 < (moved = hot->tree.tree.size>>2) && !shard_move(hot, cold, moved, &bound)) moved = 0;
+
+    if (0 < moved) {
+      if (hot < cold) __atomic_store_n(&hot->sup, bound, __ATOMIC_RELEASE), __atomic_store_n(&cold->inf, bound, __ATOMIC_RELEASE);
+      else            __atomic_store_n(&cold->sup, bound, __ATOMIC_RELEASE), __atomic_store_n(&hot->inf, bound, __ATOMIC_RELEASE);
+    }
+
+    pthread_rwlock_unlock(&cold->tree.lock);
+    pthread_rwlock_unlock(&hot->tree.lock);
+  }
+
+  for (idx = 0; idx < root->nmemb; ++idx)
+    __atomic_store_n(&root->shards[idx].writes, 0, __ATOMIC_RELAXED);
+
+  pthread_mutex_unlock(&root->lock);
+
+  return moved;
+}
@@ -0,0 +1,417 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * skiplist.c - generic lock-free skip list definition
+ */
+#include <index/skiplist.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * skip_seed - the state of the random number generator of the calling thread
+ */
+static _Thread_local uint64_t skip_seed;
+
+/**
+ * skip_level - returns a random level, which is greater than n with probability 4^-n
+ */
+static inline size_t skip_level(void) {
+  if (skip_seed == 0)
+    skip_seed = 0x9E3779B97F4A7C15ULL * ((uintptr_t)&skip_seed | 1);
+
+  skip_seed ^= skip_seed << 13;
+  skip_seed ^= skip_seed >> 7;
+  skip_seed ^= skip_seed << 17;
+
+  return 1 + (size_t)__builtin_ctzll(skip_seed | 1ULL << (2*SKIP_MAXLEVEL-2))/2;
+}
+
+/**
+ * skip_alloc - allocates a node linked in @level levels
+ *
+ * @key:   the key of the node
+ * @value: the value of the node
+ * @level: the number of the levels of the node
+ */
+static inline struct skip_node *skip_alloc(const void *restrict key, void *restrict value, const size_t level) {
+  struct skip_node *node = malloc(sizeof(struct skip_node) + __SIZEOF_POINTER__*level);
+  node->key              = key;
+  node->value            = value;
+  node->level            = level;
+  node->ready            = 2;
+  return node;
+}
+
+/**
+ * skip_marked - checks if @link is marked as the link of an erased node
+ *
+ * @link: the link to check
+ */
+static inline bool skip_marked(const struct skip_node *link) { return ((uintptr_t)link & 1) != 0; }
+
+/**
+ * skip_ptr - returns the address of the node @link points to
+ *
+ * @link: the link to strip the mark of
+ */
+static inline struct skip_node *skip_ptr(const struct skip_node *link) { return (struct skip_node *)((uintptr_t)link & ~(uintptr_t)1); }
+
+/**
+ * skip_mark - returns @link with the mark set
+ *
+ * @link: the link to mark
+ */
+static inline struct skip_node *skip_mark(const struct skip_node *link) { return (struct skip_node *)((uintptr_t)link | 1); }
+
+/**
+ * skip_load - loads the @level-th link of @node
+ *
+ * @node:  node to load the link of
+ * @level: the level of the link
+ */
+static inline struct skip_node *skip_load(struct skip_node *restrict node, const size_t level) { return __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE); }
+
+/**
+ * skip_snip - unlinks @curr, whose @level-th link is @succ, from @pred
+ *
+ * @pred:  the previous node of @curr in @level
+ * @curr:  erased node to unlink
+ * @succ:  the marked @level-th link of @curr
+ * @level: the level to unlink @curr from
+ *
+ * Returns false if the link of @pred has changed, in which case the caller must search again.
+ */
+static inline bool skip_snip(struct skip_node *restrict pred, struct skip_node *curr, const struct skip_node *restrict succ, const size_t level) {
+  return __atomic_compare_exchange_n(&pred->next[level], &curr, skip_ptr(succ), false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/**
+ * skip_walk - finds the last node less than @key and the next node in each level, unlinking erased nodes on the way
+ *
+ * @list:  list to search
+ * @key:   the key to search for
+ * @preds: where to store the last node less than @key in each level
+ * @succs: where to store the next node of each of @preds
+ *
+ * Returns false if it loses a race to unlink an erased node, in which case the caller must walk again.
+ */
+static inline bool skip_walk(const struct skip_root *restrict list, const void *restrict key, struct skip_node **restrict preds, struct skip_node **restrict succs) {
+  register size_t           level;
+  register struct skip_node *pred = list->head;
+  register struct skip_node *curr = NULL;
+  register struct skip_node *succ;
+
+  for (level = SKIP_MAXLEVEL; 0 < level--;) {
+    for (curr = skip_ptr(skip_load(pred, level)); curr != NULL; curr = skip_ptr(succ)) {
+      succ = skip_load(curr, level);
+      if (skip_marked(succ)) { /* case of an erased node */
+        if (!skip_snip(pred, curr, succ, level)) return false;
+      } else if (list->less(curr->key, key)) {
+        pred = curr;
+      } else {
+        break;
+      }
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+
+  return true;
+}
+
+/**
+ * skip_search - finds the last node less than @key and the next node in each level
+ *
+ * @list:  list to search
+ * @key:   the key to search for
+ * @preds: where to store the last node less than @key in each level
+ * @succs: where to store the next node of each of @preds
+ *
+ * Returns true if the next node in the lowest level has @key.
+ */
+static inline bool skip_search(const struct skip_root *restrict list, const void *restrict key, struct skip_node **restrict preds, struct skip_node **restrict succs) {
+  while (!skip_walk(list, key, preds, succs));
+  return succs[0] != NULL && !list->less(key, succs[0]->key);
+}
+
+/**
+ * skip_sweep - unlinks the erased nodes with @key from every level
+ *
+ * @list: list to sweep
+ * @key:  the key of the erased nodes
+ *
+ * Returns false if it loses a race to unlink an erased node, in which case the caller must sweep again.
+ */
+static inline bool skip_sweep(const struct skip_root *restrict list, const void *restrict key) {
+  register size_t           level;
+  register struct skip_node *start = list->head;
+  register struct skip_node *pred;
+  register struct skip_node *curr;
+  register struct skip_node *succ;
+
+  for (level = SKIP_MAXLEVEL; 0 < level--;) {
+    /* the nodes with @key follow the last node less than @key in every level, in whatever order */
+    for (pred = start, curr = skip_ptr(skip_load(pred, level)); curr != NULL; curr = skip_ptr(succ)) {
+      succ = skip_load(curr, level);
+      if (skip_marked(succ)) {
+        if (!skip_snip(pred, curr, succ, level)) return false;
+      } else if (list->less(curr->key, key)) {
+        start = pred = curr;
+      } else if (!list->less(key, curr->key)) {
+        pred = curr;
+      } else {
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * skip_release - lets go of @node, retiring it if neither its inserter nor its eraser is still using it
+ *
+ * @list: list to which @node belongs
+ * @node: erased or fully linked node
+ *
+ * The inserter may link an upper level of @node after the eraser has unlinked it,
+ * so that whichever lets go of @node last unlinks it once more before retiring it.
+ */
+static inline void skip_release(struct skip_root *restrict list, struct skip_node *restrict node) {
+  if (__atomic_sub_fetch(&node->ready, 1, __ATOMIC_ACQ_REL) == 0) {
+    while (!skip_sweep(list, node->key));
+    epoch_retire(list->epoch, node);
+  }
+}
+
+/**
+ * skip_lookup - returns the node with @key in @list, or NULL if not found
+ *
+ * @list: list to search
+ * @key:  the key to search for
+ *
+ * Unlike skip_search, it never writes to @list.
+ */
+static inline struct skip_node *skip_lookup(const struct skip_root *restrict list, const void *restrict key) {
+  register size_t           level;
+  register struct skip_node *pred = list->head;
+  register struct skip_node *curr = NULL;
+
+  for (level = SKIP_MAXLEVEL; 0 < level--;)
+    for (curr = skip_ptr(skip_load(pred, level)); curr != NULL && list->less(curr->key, key); curr = skip_ptr(skip_load(curr, level)))
+      pred = curr;
+
+  /* an erased node with @key may still precede the one inserted after it */
+  for (; curr != NULL && !list->less(key, curr->key); curr = skip_ptr(skip_load(curr, 0)))
+    if (!skip_marked(skip_load(curr, 0)))
+      return curr;
+
+  return NULL;
+}
+
+/**
+ * skip_forward - returns the first node in @list after @node that is not erased
+ *
+ * @node: node to start from
+ */
+static inline struct skip_node *skip_forward(struct skip_node *node) {
+  for (node = skip_ptr(skip_load(node, 0)); node != NULL && skip_marked(skip_load(node, 0)); node = skip_ptr(skip_load(node, 0)));
+  return node;
+}
+
+/**
+ * skip_backward - returns the last node in @list less than @key that is not erased
+ *
+ * @list: list to search
+ * @key:  the key to search for
+ */
+static inline struct skip_node *skip_backward(const struct skip_root *restrict list, const void *restrict key) {
+  struct skip_node *preds[SKIP_MAXLEVEL];
+  struct skip_node *succs[SKIP_MAXLEVEL];
+
+  skip_search(list, key, preds, succs);
+
+  return preds[0] == list->head ? NULL : preds[0];
+}
+
+/**
+ * skip_put - inserts an entry into @list, or assigns @value to the existing entry with @key if @assign is set
+ *
+ * @list:   list to insert an entry into
+ * @key:    the key of the entry to insert
+ * @value:  the value of the entry to insert
+ * @assign: whether to assign @value if @key already exists
+ */
+static inline struct skip_node *skip_put(struct skip_root *restrict list, const void *restrict key, void *restrict value, const bool assign) {
+  register size_t           level;
+           struct skip_node *node = NULL;
+           struct skip_node *succ;
+           struct skip_node *preds[SKIP_MAXLEVEL];
+           struct skip_node *succs[SKIP_MAXLEVEL];
+
+  for (;;) {
+    if (skip_search(list, key, preds, succs)) {
+      free(node); /* case of an unpublished node */
+      if (assign) __atomic_store_n(&succs[0]->value, value, __ATOMIC_RELEASE);
+      return succs[0];
+    }
+
+    if (node == NULL)
+      node = skip_alloc(key, value, skip_level());
+
+    for (level = 0; level < node->level; ++level)
+      node->next[level] = succs[level];
+
+    /* the node is inserted once linked in the lowest level */
+    succ = succs[0];
+    if (__atomic_compare_exchange_n(&preds[0]->next[0], &succ, node, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      break;
+  }
+
+  __atomic_add_fetch(&list->size, 1, __ATOMIC_RELAXED);
+
+  for (level = 1; level < node->level; ++level) {
+    for (;;) {
+      succ = skip_load(node, level);
+      if (skip_marked(succ)) break; /* case of the node erased in the meantime */
+      if (succ != succs[level] && !__atomic_compare_exchange_n(&node->next[level], &succ, succs[level], false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) continue;
+      succ = succs[level];
+      if (__atomic_compare_exchange_n(&preds[level]->next[level], &succ, node, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) break;
+      skip_search(list, key, preds, succs);
+    }
+    if (skip_marked(succ)) break;
+  }
+
+  skip_release(list, node);
+
+  return node;
+}
+
+/**
+ * skip_mk_iter - makes an iterator of @node
+ *
+ * @list: list to which @node belongs
+ * @node: node to make an iterator of
+ */
+static inline struct skip_iter skip_mk_iter(const struct skip_root *restrict list, struct skip_node *restrict node) {
+  struct skip_iter iter = {
+    .key   = node == NULL ? NULL : node->key,
+    .value = node == NULL ? NULL : __atomic_load_n(&node->value, __ATOMIC_ACQUIRE),
+    .pivot = node,
+    .list  = list,
+  };
+  return iter;
+}
+
+/**
+ * skip_mk_reverse_iter - makes a reverse iterator of @node
+ *
+ * @list: list to which @node belongs
+ * @node: node to make a reverse iterator of
+ */
+static inline struct skip_reverse_iter skip_mk_reverse_iter(const struct skip_root *restrict list, struct skip_node *restrict node) {
+  struct skip_reverse_iter iter = {
+    .key   = node == NULL ? NULL : node->key,
+    .value = node == NULL ? NULL : __atomic_load_n(&node->value, __ATOMIC_ACQUIRE),
+    .pivot = node,
+    .list  = list,
+  };
+  return iter;
+}
+
+extern void skip_init(struct skip_root *restrict list, bool (*less)(const void *restrict, const void *restrict), struct epoch_root *restrict epoch) {
+  list->head  = skip_alloc(NULL, NULL, SKIP_MAXLEVEL);
+  list->less  = less;
+  list->size  = 0;
+  list->epoch = epoch;
+
+  for (register size_t level = 0; level < SKIP_MAXLEVEL; ++level)
+    list->head->next[level] = NULL;
+}
+
+extern void skip_destroy(struct skip_root *list) {
+  skip_clear(list);
+  free(list->head);
+  list->head = NULL;
+}
+
+extern bool skip_contains(const struct skip_root *list, const void *key) { return skip_lookup(list, key) != NULL; }
+
+extern struct skip_iter skip_find(const struct skip_root *list, const void *key) { return skip_mk_iter(list, skip_lookup(list, key)); }
+
+extern struct skip_iter skip_insert(struct skip_root *restrict list, const void *restrict key, void *restrict value) { return skip_mk_iter(list, skip_put(list, key, value, false)); }
+
+extern struct skip_iter skip_replace(struct skip_root *restrict list, const void *restrict key, void *restrict value) { return skip_mk_iter(list, skip_put(list, key, value, true)); }
+
+extern void *skip_erase(struct skip_root *restrict list, const void *restrict key) {
+  register size_t           level;
+  register struct skip_node *node;
+           struct skip_node *succ;
+           struct skip_node *preds[SKIP_MAXLEVEL];
+           struct skip_node *succs[SKIP_MAXLEVEL];
+           void             *value;
+
+  for (;;) {
+    if (!skip_search(list, key, preds, succs)) return NULL;
+
+    node = succs[0];
+
+    /* the upper levels are marked first, so that the node is never linked above an unmarked level */
+    for (level = node->level-1; 0 < level; --level)
+      for (succ = skip_load(node, level); !skip_marked(succ) && !__atomic_compare_exchange_n(&node->next[level], &succ, skip_mark(succ), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE););
+
+    /* the node is erased by whichever marks its lowest level */
+    for (succ = skip_load(node, 0); !skip_marked(succ);) {
+      if (__atomic_compare_exchange_n(&node->next[0], &succ, skip_mark(succ), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        value = __atomic_load_n(&node->value, __ATOMIC_ACQUIRE);
+        __atomic_sub_fetch(&list->size, 1, __ATOMIC_RELAXED);
+        while (!skip_sweep(list, key));
+        skip_release(list, node);
+        return value;
+      }
+    }
+  }
+}
+
+extern void skip_clear(struct skip_root *list) {
+  register struct skip_node *node = skip_ptr(list->head->next[0]);
+  register struct skip_node *next;
+
+  for (; node != NULL; node = next) {
+    next = skip_ptr(node->next[0]);
+    free(node);
+  }
+
+  for (register size_t level = 0; level < SKIP_MAXLEVEL; ++level)
+    list->head->next[level] = NULL;
+
+  list->size = 0;
+}
+
+extern struct skip_iter skip_iter_init(const struct skip_root *list) { return skip_mk_iter(list, skip_forward(list->head)); }
+
+extern void skip_iter_prev(struct skip_iter *iter) { *iter = skip_mk_iter(iter->list, skip_backward(iter->list, iter->key)); }
+
+extern void skip_iter_next(struct skip_iter *iter) { *iter = skip_mk_iter(iter->list, skip_forward(iter->pivot)); }
+
+extern struct skip_reverse_iter skip_reverse_iter_init(const struct skip_root *list) {
+  register size_t           level;
+  register struct skip_node *pred = list->head;
+  register struct skip_node *curr;
+
+  for (level = SKIP_MAXLEVEL; 0 < level--;)
+    for (curr = skip_ptr(skip_load(pred, level)); curr != NULL; curr = skip_ptr(skip_load(curr, level)))
+      if (!skip_marked(skip_load(curr, level)))
+        pred = curr;
+
+  /* case of the last node erased after it was passed */
+  if (pred != list->head && skip_marked(skip_load(pred, 0)))
+    return skip_mk_reverse_iter(list, skip_backward(list, pred->key));
+
+  return skip_mk_reverse_iter(list, pred == list->head ? NULL : pred);
+}
+
+extern void skip_reverse_iter_prev(struct skip_reverse_iter *iter) { *iter = skip_mk_reverse_iter(iter->list, skip_forward(iter->pivot)); }
+
+extern void skip_reverse_iter_next(struct skip_reverse_iter *iter) { *iter = skip_mk_reverse_iter(iter->list, skip_backward(iter->list, iter->key)); }
@@ -0,0 +1,522 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * wal.c - write-ahead logged B+-tree definition
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <index/wal.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The layout of a record, in which each key or value record is padded to a multiple of 8 bytes:
+ *
+ *    length | checksum | op | key | value
+ *
+ * where the length and checksum take 32 bits each, the op 64 bits, and an erasure has no value.
+ * The checksum covers the rest of the record, so that a record torn by a crash is told apart.
+ */
+
+/**
+ * struct wal_header - the header of a record
+ *
+ * @length:   the length of the record
+ * @checksum: the checksum of the rest of the record
+ * @op:       WAL_INSERT, WAL_ASSIGN or WAL_ERASE
+ */
+struct wal_header {
+  uint32_t length;
+  uint32_t checksum;
+  uint64_t op;
+} __attribute__((aligned(8)));
+
+/**
+ * struct wal_restore - the elements of an image collected to build the tree from
+ *
+ * @keys:   the keys
+ * @values: the values
+ * @nmemb:  the number of the elements collected
+ */
+struct wal_restore {
+  const void **keys;
+        void **values;
+        size_t nmemb;
+} __attribute__((aligned(__SIZEOF_POINTER__)));
+
+static _Thread_local struct wal_restore wal_restore;
+
+/**
+ * wal_collect - collects an element of an image into wal_restore
+ *
+ * @key:   the key of the element
+ * @value: the value of the element
+ */
+static void wal_collect(const void *restrict key, void *restrict value) {
+  wal_restore.keys[wal_restore.nmemb]   = key;
+  wal_restore.values[wal_restore.nmemb] = value;
+  ++wal_restore.nmemb;
+}
+
+/**
+ * wal_stride - returns the size of the slot of a record written by @codec
+ *
+ * @codec: the serializer, or NULL for a pointer
+ */
+static inline size_t wal_stride(const struct bplus_codec *restrict codec) { return codec == NULL ? sizeof(uint64_t) : (codec->size+7) & ~(size_t)7; }
+
+/**
+ * wal_checksum - returns the FNV-1a hash of @size bytes from @data
+ *
+ * @data: the bytes to hash
+ * @size: the number of bytes
+ */
+static inline uint32_t wal_checksum(const unsigned char *restrict data, const size_t size) {
+  register uint32_t hash = 2166136261U;
+
+  for (register size_t idx = 0; idx < size; ++idx)
+    hash = (hash ^ data[idx]) * 16777619U;
+
+  return hash;
+}
+
+/**
+ * wal_store - writes the record of @item into @slot
+ *
+ * @slot:  where to write the record
+ * @item:  the key or value to write the record of
+ * @codec: the serializer of @item, or NULL to write @item as a pointer
+ */
+static inline void wal_store(unsigned char *restrict slot, const void *restrict item, const struct bplus_codec *restrict codec) {
+  memset(slot, 0, wal_stride(codec));
+  if (codec == NULL) {
+    const uint64_t bits = (uintptr_t)item;
+    memcpy(slot, &bits, sizeof(uint64_t));
+  } else {
+    codec->encode(slot, item);
+  }
+}
+
+/**
+ * wal_load - returns the key or value presented by the record in @slot
+ *
+ * @slot:  the record to present
+ * @codec: the serializer of the record, or NULL for a pointer
+ */
+static inline void *wal_load(unsigned char *restrict slot, const struct bplus_codec *restrict codec) {
+  uint64_t bits;
+
+  if (codec != NULL) return slot;
+
+  memcpy(&bits, slot, sizeof(uint64_t));
+
+  return (void *)(uintptr_t)bits;
+}
+
+/**
+ * wal_append - appends a record to the log of @root, under the write lock of the tree
+ *
+ * @root:  tree to which the log belongs
+ * @op:    WAL_INSERT, WAL_ASSIGN or WAL_ERASE
+ * @key:   the key of the element
+ * @value: the value of the element, ignored for an erasure
+ *
+ * Returns the position in the log up to which the log must be synchronized for the record to be durable.
+ */
+static inline uint64_t wal_append(struct wal_root *restrict root, const uint64_t op, const void *restrict key, const void *restrict value) {
+  register const size_t        length = sizeof(struct wal_header) + wal_stride(root->keys) + (op == WAL_ERASE ? 0 : wal_stride(root->values));
+  register       unsigned char *record;
+  register       uint64_t      lsn;
+           struct wal_header   header = {.length = (uint32_t)length, .checksum = 0, .op = op};
+
+  pthread_mutex_lock(&root->log.lock);
+
+  if (root->log.capacity < root->log.length + length) {
+    do root->log.capacity = root->log.capacity == 0 ? 4096 : root->log.capacity<<1;
+    while (root->log.capacity < root->log.length + length);
+    root->log.pending = realloc(root->log.pending, root->log.capacity);
+  }
+
+  record = root->log.pending + root->log.length;
+  memcpy(record, &header, sizeof(struct wal_header));
+  wal_store(record + sizeof(struct wal_header), key, root->keys);
+  if (op != WAL_ERASE) wal_store(record + sizeof(struct wal_header) + wal_stride(root->keys), value, root->values);
+
+  header.checksum = wal_checksum(record + sizeof(uint32_t)*2, length - sizeof(uint32_t)*2);
+  memcpy(record, &header, sizeof(struct wal_header));
+
+  root->log.length   += length;
+  root->log.appended += length;
+  lsn                 = root->log.appended;
+
+  pthread_mutex_unlock(&root->log.lock);
+
+  return lsn;
+}
+
+/**
+ * wal_flush - waits for @log to be synchronized up to @lsn, leading the write if no other writer does
+ *
+ * @log: the log to synchronize
+ * @lsn: the position up to which to synchronize
+ *
+ * Returns false if the log cannot be synchronized.
+ */
+static bool wal_flush(struct wal_log *log, const uint64_t lsn) {
+  register unsigned char *buffer;
+  register size_t        length;
+  register size_t        capacity;
+  register uint64_t      target;
+  register uint64_t      offset;
+  register ssize_t       count;
+  register bool          ok;
+
+  pthread_mutex_lock(&log->lock);
+
+  while (log->durable < lsn && !log->failed) {
+    /* case of another leader writing: wait for it, as it may take our record along */
+    if (log->flushing) {
+      pthread_cond_wait(&log->cond, &log->lock);
+      continue;
+    }
+
+    /* become the leader, taking all records appended so far, and let the writers append to the spare buffer meanwhile */
+    log->flushing = true;
+    buffer        = log->pending;
+    length        = log->length;
+    capacity      = log->capacity;
+    target        = log->appended;
+    offset        = log->offset;
+    log->pending  = log->spare;
+    log->capacity = log->reserve;
+    log->length   = 0;
+    pthread_mutex_unlock(&log->lock);
+
+    ok = true;
+    for (register size_t done = 0; ok && done < length; done += (size_t)count)
+      ok = 0 <= (count = pwrite(log->fd, buffer + done, length - done, (off_t)(offset + done)));
+    ok = ok && fdatasync(log->fd) == 0;
+
+    pthread_mutex_lock(&log->lock);
+    log->spare    = buffer;
+    log->reserve  = capacity;
+    log->offset   = offset + length;
+    log->flushing = false;
+    ++log->syncs;
+    if (ok) log->durable = target;
+    else    log->failed  = true;
+    pthread_cond_broadcast(&log->cond);
+  }
+
+  ok = lsn <= log->durable;
+  pthread_mutex_unlock(&log->lock);
+
+  return ok;
+}
+
+/**
+ * wal_commit - makes the record ending at @lsn durable as the policy of @log requires
+ *
+ * @log: the log to which the record belongs
+ * @lsn: the position returned by wal_append
+ *
+ * Returns false if the log cannot be synchronized.
+ */
+static inline bool wal_commit(struct wal_log *log, const uint64_t lsn) {
+  register bool ok;
+  register bool due;
+
+  if (log->policy.interval == 0 && log->policy.bytes == 0) return wal_flush(log, lsn);
+
+  pthread_mutex_lock(&log->lock);
+  ok  = !log->failed;
+  due = log->policy.bytes != 0 && log->durable + log->policy.bytes <= lsn;
+  pthread_mutex_unlock(&log->lock);
+
+  return ok && due ? wal_flush(log, lsn) : ok;
+}
+
+/**
+ * wal_tick - synchronizes @arg every interval of its policy until stopped
+ *
+ * @arg: the log to synchronize
+ */
+static void *wal_tick(void *arg) {
+  struct wal_log  *log = arg;
+  struct timespec deadline;
+  uint64_t        lsn;
+
+  pthread_mutex_lock(&log->lock);
+
+  while (!log->stop) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec  += (time_t)(log->policy.interval/1000);
+    deadline.tv_nsec += (long)(log->policy.interval%1000)*1000000L;
+    if (1000000000L <= deadline.tv_nsec) {
+      ++deadline.tv_sec;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&log->cond, &log->lock, &deadline);
+
+    lsn = log->appended;
+    pthread_mutex_unlock(&log->lock);
+    wal_flush(log, lsn);
+    pthread_mutex_lock(&log->lock);
+  }
+
+  pthread_mutex_unlock(&log->lock);
+
+  return NULL;
+}
+
+/**
+ * wal_replay - applies the records in @size bytes from @data to the tree of @root
+ *
+ * @root: tree to apply the records to
+ * @data: the records
+ * @size: the number of bytes
+ *
+ * Returns the length of the intact records, which is less than @size if the log ends with a torn record.
+ */
+static inline size_t wal_replay(struct wal_root *restrict root, unsigned char *restrict data, const size_t size) {
+  register size_t            offset = 0;
+  register void              *key;
+           struct wal_header header;
+
+  while (sizeof(struct wal_header) <= size - offset) {
+    memcpy(&header, data + offset, sizeof(struct wal_header));
+
+    if (header.length < sizeof(struct wal_header) + wal_stride(root->keys) || size - offset < header.length ||
+        header.length != sizeof(struct wal_header) + wal_stride(root->keys) + (header.op == WAL_ERASE ? 0 : wal_stride(root->values)) ||
+        header.checksum != wal_checksum(data + offset + sizeof(uint32_t)*2, header.length - sizeof(uint32_t)*2)) break;
+
+    key = wal_load(data + offset + sizeof(struct wal_header), root->keys);
+
+    switch (header.op) {
+      case WAL_INSERT:
+        bplus_insert(&root->tree.tree, key, wal_load(data + offset + sizeof(struct wal_header) + wal_stride(root->keys), root->values));
+        break;
+      case WAL_ASSIGN:
+        bplus_insert_or_assign(&root->tree.tree, key, wal_load(data + offset + sizeof(struct wal_header) + wal_stride(root->keys), root->values));
+        break;
+      default:
+        bplus_erase(&root->tree.tree, key);
+        break;
+    }
+
+    offset += header.length;
+  }
+
+  return offset;
+}
+
+/**
+ * wal_restore_image - builds the tree of @root from its image, if any
+ *
+ * @root: tree to build
+ *
+ * Returns false if the elements of the image cannot be collected.
+ */
+static inline bool wal_restore_image(struct wal_root *restrict root) {
+  if ((root->base = bplus_open_mmap(root->image, root->tree.tree.less)) == NULL || bplus_image_empty(root->base)) return true;
+
+  wal_restore.keys   = malloc(__SIZEOF_POINTER__*bplus_image_size(root->base));
+  wal_restore.values = malloc(__SIZEOF_POINTER__*bplus_image_size(root->base));
+  wal_restore.nmemb  = 0;
+
+  if (wal_restore.keys == NULL || wal_restore.values == NULL) {
+    free(wal_restore.keys);
+    free(wal_restore.values);
+    return false;
+  }
+
+  bplus_image_for_each(root->base, wal_collect);
+  bplus_build(&root->tree.tree, wal_restore.keys, wal_restore.values, wal_restore.nmemb, 1);
+
+  free(wal_restore.keys);
+  free(wal_restore.values);
+
+  return true;
+}
+
+extern bool wal_open(struct wal_root *restrict root, const char *restrict image, const char *restrict log, const size_t order, bool (*less)(const void *restrict, const void *restrict),
+                     const struct bplus_codec *restrict keys, const struct bplus_codec *restrict values, const struct wal_policy policy) {
+  struct stat status;
+  size_t      length = 0;
+  ssize_t     count  = 0;
+
+  if ((root->log.fd = open(log, O_RDWR | O_CREAT, 0644)) < 0) return false;
+
+  if (fstat(root->log.fd, &status) != 0 || (root->image = strdup(image)) == NULL) {
+    close(root->log.fd);
+    return false;
+  }
+
+  if ((root->replayed = malloc((size_t)status.st_size + 1)) == NULL) {
+    free(root->image);
+    close(root->log.fd);
+    return false;
+  }
+
+  root->keys   = keys;
+  root->values = values;
+
+  bplus_rw_init(&root->tree, order, less);
+  if (!wal_restore_image(root)) count = -1;
+
+  /* replay the intact records over the image, and cut the torn one off */
+  while (0 <= count && length < (size_t)status.st_size && 0 < (count = pread(root->log.fd, root->replayed + length, (size_t)status.st_size - length, (off_t)length)))
+    length += (size_t)count;
+  if (0 <= count) length = wal_replay(root, root->replayed, length);
+  if (0 <= count && length < (size_t)status.st_size && ftruncate(root->log.fd, (off_t)length) != 0) count = -1;
+
+  if (count < 0) {
+    bplus_rw_destroy(&root->tree);
+    if (root->base != NULL) bplus_close_mmap(root->base);
+    free(root->replayed);
+    free(root->image);
+    close(root->log.fd);
+    return false;
+  }
+
+  root->log.offset   = length;
+  root->log.pending  = NULL;
+  root->log.length   = 0;
+  root->log.capacity = 0;
+  root->log.spare    = NULL;
+  root->log.reserve  = 0;
+  root->log.appended = 0;
+  root->log.durable  = 0;
+  root->log.syncs    = 0;
+  root->log.flushing = false;
+  root->log.failed   = false;
+  root->log.stop     = false;
+  root->log.policy   = policy;
+  pthread_mutex_init(&root->log.lock, NULL);
+  pthread_cond_init(&root->log.cond, NULL);
+
+  /* case of no group-commit thread: the commits would wait for a flush that never comes */
+  if (policy.interval != 0 && pthread_create(&root->log.flusher, NULL, wal_tick, &root->log) != 0) {
+    pthread_cond_destroy(&root->log.cond);
+    pthread_mutex_destroy(&root->log.lock);
+    bplus_rw_destroy(&root->tree);
+    if (root->base != NULL) bplus_close_mmap(root->base);
+    free(root->replayed);
+    free(root->image);
+    close(root->log.fd);
+    return false;
+  }
+
+  return true;
+}
+
+extern bool wal_close(struct wal_root *root) {
+  register bool ok;
+
+  if (root->log.policy.interval != 0) {
+    pthread_mutex_lock(&root->log.lock);
+    root->log.stop = true;
+    pthread_cond_broadcast(&root->log.cond);
+    pthread_mutex_unlock(&root->log.lock);
+    pthread_join(root->log.flusher, NULL);
+  }
+
+  ok = wal_sync(root);
+  ok = close(root->log.fd) == 0 && ok;
+
+  pthread_cond_destroy(&root->log.cond);
+  pthread_mutex_destroy(&root->log.lock);
+  free(root->log.pending);
+  free(root->log.spare);
+
+  bplus_rw_destroy(&root->tree);
+  if (root->base != NULL) bplus_close_mmap(root->base);
+  free(root->replayed);
+  free(root->image);
+
+  return ok;
+}
+
+extern bool wal_sync(struct wal_root *root) {
+  register uint64_t lsn;
+
+  pthread_mutex_lock(&root->log.lock);
+  lsn = root->log.appended;
+  pthread_mutex_unlock(&root->log.lock);
+
+  return wal_flush(&root->log, lsn);
+}
+
+extern bool wal_checkpoint(struct wal_root *root) {
+  register bool ok;
+
+  /* the read lock keeps the writers, and thus the appends, out until the log is truncated */
+  bplus_rw_read_lock(&root->tree);
+
+  ok = wal_sync(root) && bplus_save(root->tree.tree, root->image, root->keys, root->values);
+
+  if (ok) {
+    pthread_mutex_lock(&root->log.lock);
+    while (root->log.flushing)
+      pthread_cond_wait(&root->log.cond, &root->log.lock);
+    ok               = ftruncate(root->log.fd, 0) == 0 && fsync(root->log.fd) == 0;
+    root->log.offset = 0;
+    pthread_mutex_unlock(&root->log.lock);
+  }
+
+  bplus_rw_unlock(&root->tree);
+
+  return ok;
+}
+
+extern bool wal_insert(struct wal_root *root, const void *key, void *value) {
+  register uint64_t lsn;
+
+  bplus_rw_write_lock(&root->tree);
+  if (bplus_insert(&root->tree.tree, key, value) == NULL) {
+    bplus_rw_unlock(&root->tree);
+    return false;
+  }
+  lsn = wal_append(root, WAL_INSERT, key, value);
+  bplus_rw_unlock(&root->tree);
+
+  return wal_commit(&root->log, lsn);
+}
+
+extern bool wal_insert_or_assign(struct wal_root *root, const void *key, void *value) {
+  register uint64_t lsn;
+
+  bplus_rw_write_lock(&root->tree);
+  bplus_insert_or_assign(&root->tree.tree, key, value);
+  lsn = wal_append(root, WAL_ASSIGN, key, value);
+  bplus_rw_unlock(&root->tree);
+
+  return wal_commit(&root->log, lsn);
+}
+
+extern bool wal_erase(struct wal_root *restrict root, const void *restrict key, void **restrict value) {
+  register uint64_t lsn;
+  register size_t   size;
+  register void     *erased;
+
+  bplus_rw_write_lock(&root->tree);
+  size   = root->tree.tree.size;
+  erased = bplus_erase(&root->tree.tree, key);
+  if (root->tree.tree.size == size) {
+    bplus_rw_unlock(&root->tree);
+    return false;
+  }
+  lsn = wal_append(root, WAL_ERASE, key, NULL);
+  bplus_rw_unlock(&root->tree);
+
+  if (value != NULL) *value = erased;
+
+  return wal_commit(&root->log, lsn);
+}
@@ -14,14 +14,76 @@
 
 #include <ctest.h>
 #include <index/avltree.h>
+#include <index/serial.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#define NKEYS 256
+
 const uintptr_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
 
 bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
 
+struct memory {
+  unsigned char data[sizeof(uint64_t) + 2*(sizeof(uint64_t)+sizeof(uintptr_t))*NKEYS];
+  size_t        length;
+  size_t        offset;
+};
+
+bool sink(void *ctx, const void *restrict buf, const size_t size) {
+  struct memory *memory = ctx;
+
+  if (sizeof(memory->data) < memory->length + size) return false;
+  memcpy(memory->data + memory->length, buf, size);
+  memory->length += size;
+  return true;
+}
+
+bool source(void *ctx, void *restrict buf, const size_t size) {
+  struct memory *memory = ctx;
+
+  if (memory->length < memory->offset + size) return false;
+  memcpy(buf, memory->data + memory->offset, size);
+  memory->offset += size;
+  return true;
+}
+
+size_t encode(void *ctx, const void *item, void *restrict buf, const size_t capacity) {
+  (void)ctx;
+  if (sizeof(uintptr_t) <= capacity) memcpy(buf, &item, sizeof(uintptr_t));
+  return sizeof(uintptr_t);
+}
+
+bool decode(void *ctx, const void *restrict buf, const size_t length, void **restrict item) {
+  if (length != sizeof(uintptr_t)) return false;
+  memcpy(item, buf, sizeof(uintptr_t));
+  ++*(size_t *)ctx;
+  return true;
+}
+
+void release(void *ctx, void *item) {
+  (void)item;
+  --*(size_t *)ctx;
+}
+
+/**
+ * height - returns the height of subtree rooted with @node, or -1 if it is not an AVL tree
+ *
+ * @node: root node of subtree
+ */
+int height(const struct avl_node *node) {
+  if (node == NULL) return 0;
+
+  const int lhs = height(node->left);
+  const int rhs = height(node->right);
+
+  if (lhs < 0 || rhs < 0 || 1 < lhs - rhs || 1 < rhs - lhs || (node->left != NULL && node->left->parent != node) || (node->right != NULL && node->right->parent != node) ||
+      node->height != (size_t)(1 + (lhs < rhs ? rhs : lhs))) return -1;
+
+  return 1 + (lhs < rhs ? rhs : lhs);
+}
+
 CTEST(avltree_test, avl_find_test) {
   struct avl_root tree = avl_init(less);
 
@@ -102,4 +164,307 @@ CTEST(avltree_test, avl_erase_reverse_test) {
   ASSERT_TRUE(avl_empty(tree));
 }
 
+CTEST(avltree_test, avl_clone_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root clone = avl_init(less);
+  char            src[3];
+  char            dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    avl_insert(&tree, (void *)*it, (void *)*it);
+
+  avl_clone(&clone, tree);
+  avl_clear(&tree);
+
+  memset(dest, 0, sizeof(dest));
+  for (struct avl_iter iter = avl_iter_init(clone); !avl_iter_end(iter); avl_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), avl_size(clone));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_erase(&clone, (void *)*it));
+
+  ASSERT_TRUE(avl_empty(clone));
+}
+
+CTEST(avltree_test, avl_split_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root other = avl_init(less);
+  char            src[3];
+  char            dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    avl_insert(&tree, (void *)*it, (void *)*it);
+
+  avl_split(&tree, (void *)50, &other);
+  ASSERT_TRUE(0 <= height(tree.root));
+  ASSERT_TRUE(0 <= height(other.root));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct avl_iter iter = avl_iter_init(tree); !avl_iter_end(iter); avl_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("10112022253033404449", dest);
+  ASSERT_EQUAL_U(10, avl_size(tree));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct avl_iter iter = avl_iter_init(other); !avl_iter_end(iter); avl_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("50556066707780889099", dest);
+  ASSERT_EQUAL_U(10, avl_size(other));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_erase(*it < 50 ? &tree : &other, (void *)*it));
+
+  ASSERT_TRUE(avl_empty(tree));
+  ASSERT_TRUE(avl_empty(other));
+}
+
+CTEST(avltree_test, avl_join_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root other = avl_init(less);
+  char            src[3];
+  char            dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    avl_insert(*it < 33 ? &other : &tree, (void *)*it, (void *)*it);
+
+  avl_insert(&other, (void *)77, NULL);
+  ASSERT_FALSE(avl_join(&tree, &other));
+  avl_erase(&other, (void *)77);
+
+  ASSERT_TRUE(avl_join(&tree, &other));
+  ASSERT_TRUE(avl_empty(other));
+  ASSERT_TRUE(0 <= height(tree.root));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct avl_iter iter = avl_iter_init(tree); !avl_iter_end(iter); avl_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), avl_size(tree));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_erase(&tree, (void *)*it));
+
+  ASSERT_TRUE(avl_empty(tree));
+}
+
+CTEST(avltree_test, avl_split_join_balance_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root other = avl_init(less);
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    avl_insert(&tree, (void *)key, (void *)key);
+
+  /* the halves of each cut and their concatenation stay balanced, whichever of them is the taller */
+  for (uintptr_t key = 1; key <= NKEYS+1; key += 7) {
+    avl_split(&tree, (void *)key, &other);
+    ASSERT_EQUAL_U(key-1, avl_size(tree));
+    ASSERT_EQUAL_U(NKEYS+1-key, avl_size(other));
+    ASSERT_TRUE(0 <= height(tree.root));
+    ASSERT_TRUE(0 <= height(other.root));
+
+    ASSERT_TRUE(avl_join(&tree, &other));
+    ASSERT_EQUAL_U(NKEYS, avl_size(tree));
+    ASSERT_TRUE(0 <= height(tree.root));
+  }
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)avl_erase(&tree, (void *)key));
+
+  ASSERT_TRUE(avl_empty(tree));
+}
+
+CTEST(avltree_test, avl_union_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root other = avl_init(less);
+  uintptr_t       prev  = 0;
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2) avl_insert(&tree, (void *)key, (void *)key);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3) avl_insert(&other, (void *)key, NULL);
+
+  avl_union(&tree, &other);
+  ASSERT_TRUE(avl_empty(other));
+  ASSERT_EQUAL_U((1<<15) + (1<<16)/3 - (1<<16)/6, avl_size(tree));
+
+  for (struct avl_iter iter = avl_iter_init(tree); !avl_iter_end(iter); avl_iter_next(&iter)) {
+    ASSERT_TRUE(prev < (uintptr_t)iter.key);
+    ASSERT_TRUE((uintptr_t)iter.key % 2 == 0 || (uintptr_t)iter.key % 3 == 0);
+    ASSERT_TRUE((uintptr_t)iter.key % 2 == 0 ? iter.value == iter.key : iter.value == NULL);
+    prev = (uintptr_t)iter.key;
+  }
+
+  avl_clear(&tree);
+}
+
+CTEST(avltree_test, avl_intersection_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root other = avl_init(less);
+  size_t          size  = 0;
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2) avl_insert(&tree, (void *)key, (void *)key);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3) avl_insert(&other, (void *)key, NULL);
+
+  avl_intersection(&tree, &other);
+  ASSERT_TRUE(avl_empty(other));
+  ASSERT_EQUAL_U((1<<16)/6, avl_size(tree));
+
+  for (struct avl_iter iter = avl_iter_init(tree); !avl_iter_end(iter); avl_iter_next(&iter), ++size)
+    ASSERT_EQUAL_U(6*(size+1), (uintptr_t)iter.value);
+
+  avl_clear(&tree);
+}
+
+CTEST(avltree_test, avl_difference_test) {
+  struct avl_root tree  = avl_init(less);
+  struct avl_root other = avl_init(less);
+  size_t          size  = 0;
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2) avl_insert(&tree, (void *)key, (void *)key);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3) avl_insert(&other, (void *)key, NULL);
+
+  avl_difference(&tree, &other);
+  ASSERT_TRUE(avl_empty(other));
+  ASSERT_EQUAL_U((1<<15) - (1<<16)/6, avl_size(tree));
+
+  for (struct avl_iter iter = avl_iter_init(tree); !avl_iter_end(iter); avl_iter_next(&iter), ++size)
+    ASSERT_EQUAL_U(6*(size/2) + (size%2 == 0 ? 2 : 4), (uintptr_t)iter.value);
+
+  for (uintptr_t key = 6; key <= 1<<16; key += 6) ASSERT_NULL(avl_erase(&tree, (void *)key));
+  avl_clear(&tree);
+}
+
+CTEST(avltree_test, avl_cow_snapshot_test) {
+  struct avl_cow_root tree = avl_cow_init(less);
+  struct avl_cow_root snapshot;
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_TRUE(avl_cow_insert(&tree, (void *)*it, (void *)*it));
+
+  snapshot = avl_cow_snapshot(tree);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); it += 2)
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_cow_erase(&tree, (void *)*it));
+  for (uintptr_t key = 1; key < 10; ++key)
+    ASSERT_TRUE(avl_cow_insert(&tree, (void *)key, (void *)key));
+
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), avl_cow_size(snapshot));
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2 + 9, avl_cow_size(tree));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it) {
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_cow_find(snapshot, (void *)*it));
+    ASSERT_EQUAL((it - testcases)%2 == 1, avl_cow_contains(tree, (void *)*it));
+  }
+  for (uintptr_t key = 1; key < 10; ++key)
+    ASSERT_FALSE(avl_cow_contains(snapshot, (void *)key));
+
+  avl_cow_release(&tree);
+  ASSERT_TRUE(avl_cow_empty(tree));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_cow_find(snapshot, (void *)*it));
+
+  avl_cow_release(&snapshot);
+  ASSERT_TRUE(avl_cow_empty(snapshot));
+}
+
+CTEST(avltree_test, avl_cow_erase_test) {
+  struct avl_cow_root tree = avl_cow_init(less);
+  struct avl_cow_root snapshots[8];
+
+  for (uintptr_t key = 1; key <= 1<<12; ++key)
+    avl_cow_insert(&tree, (void *)key, (void *)key);
+
+  for (size_t idx = 0; idx < 8; ++idx) {
+    snapshots[idx] = avl_cow_snapshot(tree);
+    for (uintptr_t key = 1 + idx; key <= 1<<12; key += 8)
+      ASSERT_EQUAL_U(key, (uintptr_t)avl_cow_erase(&tree, (void *)key));
+    ASSERT_NULL(avl_cow_erase(&tree, (void *)(1 + idx)));
+  }
+  ASSERT_TRUE(avl_cow_empty(tree));
+
+  for (size_t idx = 0; idx < 8; ++idx) {
+    ASSERT_EQUAL_U((1<<12) - (1<<9)*idx, avl_cow_size(snapshots[idx]));
+    for (uintptr_t key = 1; key <= 1<<12; ++key)
+      ASSERT_EQUAL((key-1)%8 >= idx, avl_cow_contains(snapshots[idx], (void *)key));
+  }
+
+  for (size_t idx = 0; idx < 8; ++idx)
+    avl_cow_release(&snapshots[idx]);
+  avl_cow_release(&tree);
+}
+
+CTEST(avltree_test, avl_dump_test) {
+  struct avl_root      tree  = avl_init(less);
+  struct avl_root      other = avl_init(less);
+  char                 src[3];
+  char                 dest[41];
+  struct memory        memory = {.length = 0};
+  struct serial_stream stream = {sink, source, &memory};
+  size_t               live   = 0;
+  struct bplus_codec   codec  = {.record = encode, .decode = decode, .release = release, .ctx = &live};
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    avl_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(avl_dump(tree, &stream, &codec, &codec));
+  ASSERT_EQUAL_U(sizeof(uint64_t) + 2*(sizeof(uint64_t)+sizeof(uintptr_t))*sizeof(testcases)/sizeof(uintptr_t), memory.length);
+  avl_clear(&tree);
+
+  memory.offset = 0;
+  ASSERT_TRUE(avl_restore(&other, &stream, &codec, &codec));
+  ASSERT_TRUE(0 <= height(other.root));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct avl_iter iter = avl_iter_init(other); !avl_iter_end(iter); avl_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), avl_size(other));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)avl_erase(&other, (void *)*it));
+  ASSERT_TRUE(avl_empty(other));
+
+  /* the restored tree is balanced for any number of entries */
+  for (uintptr_t nmemb = 0; nmemb < NKEYS; ++nmemb) {
+    avl_insert(&tree, (void *)(nmemb+1), (void *)(nmemb+1));
+
+    memory.length = 0;
+    ASSERT_TRUE(avl_dump(tree, &stream, &codec, &codec));
+    memory.offset = 0;
+    ASSERT_TRUE(avl_restore(&other, &stream, &codec, &codec));
+    ASSERT_TRUE(0 <= height(other.root));
+    ASSERT_EQUAL_U(nmemb+1, avl_size(other));
+
+    for (uintptr_t key = 1; key <= nmemb+1; ++key)
+      ASSERT_EQUAL_U(key, (uintptr_t)avl_erase(&other, (void *)key));
+    ASSERT_TRUE(avl_empty(other));
+  }
+
+  /* a non-empty tree is left as it is */
+  memory.offset = 0;
+  ASSERT_FALSE(avl_restore(&tree, &stream, &codec, &codec));
+  ASSERT_EQUAL_U(NKEYS, avl_size(tree));
+
+  /* a truncated dump leaves the tree empty, and releases the keys and values read */
+  live           = 0;
+  memory.length -= sizeof(uintptr_t);
+  memory.offset  = 0;
+  ASSERT_FALSE(avl_restore(&other, &stream, &codec, &codec));
+  ASSERT_TRUE(avl_empty(other));
+  ASSERT_EQUAL_U(0, live);
+
+  avl_clear(&tree);
+}
+
 int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -0,0 +1,250 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * bplusdisk_test.c - disk-resident B+-tree unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/bplusdisk.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PATH   "bplusdisk_test.db"
+#define PAGE   256
+#define BUDGET (PAGE*16)
+#define NKEYS  20000
+
+      char     src[4];
+      char     dest[131];
+const uint64_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
+      uint64_t count;
+      uint64_t last;
+      bool     sorted;
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return *(const uint64_t *)lhs < *(const uint64_t *)rhs; }
+
+void concat(const void *restrict key, void *restrict value) {
+  (void)value;
+  sprintf(src, "%" PRIu64, *(const uint64_t *)key); strcat(dest, src);
+}
+
+void check(const void *restrict key, void *restrict value) {
+  sorted = sorted && (count == 0 || last < *(const uint64_t *)key) && *(const uint64_t *)value == *(const uint64_t *)key*3;
+  last   = *(const uint64_t *)key;
+  ++count;
+}
+
+/**
+ * shuffle - returns the @idx-th key of a permutation of [0, NKEYS)
+ *
+ * @idx: the index of the key
+ */
+uint64_t shuffle(const uint64_t idx) { return idx*7919 % NKEYS; }
+
+CTEST(bplusdisk_test, bplus_disk_find_test) {
+  struct bplus_disk_root tree;
+  uint64_t               value;
+
+  remove(PATH);
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+
+  for (const uint64_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uint64_t); ++it)
+    ASSERT_TRUE(bplus_disk_insert(&tree, it, it));
+
+  for (const uint64_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uint64_t); ++it) {
+    ASSERT_FALSE(bplus_disk_insert(&tree, it, it));
+    ASSERT_TRUE(bplus_disk_find(&tree, it, &value));
+    ASSERT_EQUAL_U(*it, value);
+  }
+
+  value = 12;
+  ASSERT_FALSE(bplus_disk_contains(&tree, &value));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_disk_for_each(&tree, concat);
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_disk_range_each(&tree, &testcases[4], &testcases[16], concat);
+  ASSERT_STR("2022253033404449", dest);
+
+  ASSERT_TRUE(bplus_disk_close(&tree));
+  remove(PATH);
+}
+
+CTEST(bplusdisk_test, bplus_disk_persist_test) {
+  struct bplus_disk_root tree;
+  uint64_t               key;
+  uint64_t               value;
+
+  remove(PATH);
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+
+  for (uint64_t idx = 0; idx < NKEYS; ++idx) {
+    key   = shuffle(idx);
+    value = key*3;
+    ASSERT_TRUE(bplus_disk_insert(&tree, &key, &value));
+  }
+  ASSERT_EQUAL_U(NKEYS, bplus_disk_size(&tree));
+
+  /* the tree does not fit into the buffer pool */
+  ASSERT_TRUE(BUDGET/PAGE < tree.meta.pages);
+  ASSERT_TRUE(0 < tree.pool.writes);
+
+  ASSERT_TRUE(bplus_disk_close(&tree));
+  ASSERT_FALSE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint32_t), sizeof(uint64_t), less));
+  /* the buffer pool cannot pin a split along the whole path */
+  ASSERT_FALSE(bplus_disk_open(&tree, PATH, PAGE, PAGE*4, sizeof(uint64_t), sizeof(uint64_t), less));
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+  ASSERT_EQUAL_U(NKEYS, bplus_disk_size(&tree));
+
+  for (key = 0; key < NKEYS; ++key) {
+    ASSERT_TRUE(bplus_disk_find(&tree, &key, &value));
+    ASSERT_EQUAL_U(key*3, value);
+  }
+
+  count  = 0;
+  sorted = true;
+  bplus_disk_for_each(&tree, check);
+  ASSERT_EQUAL_U(NKEYS, count);
+  ASSERT_TRUE(sorted);
+
+  count = 0;
+  key   = 1000;
+  value = 3000;
+  bplus_disk_range_each(&tree, &key, &value, check);
+  ASSERT_EQUAL_U(2000, count);
+  ASSERT_TRUE(sorted);
+
+  ASSERT_TRUE(bplus_disk_close(&tree));
+  remove(PATH);
+}
+
+CTEST(bplusdisk_test, bplus_disk_erase_test) {
+  struct bplus_disk_root tree;
+  uint64_t               key;
+  uint64_t               value;
+  uint64_t               pages;
+
+  remove(PATH);
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+
+  for (uint64_t idx = 0; idx < NKEYS; ++idx) {
+    key   = shuffle(idx);
+    value = key;
+    ASSERT_TRUE(bplus_disk_insert(&tree, &key, &value));
+  }
+
+  for (uint64_t idx = 0; idx < NKEYS; ++idx) {
+    key   = shuffle(idx);
+    value = key*3;
+    ASSERT_TRUE(bplus_disk_insert_or_assign(&tree, &key, &value));
+  }
+  ASSERT_EQUAL_U(NKEYS, bplus_disk_size(&tree));
+
+  for (key = 0; key < NKEYS; key += 2) {
+    ASSERT_TRUE(bplus_disk_erase(&tree, &key, &value));
+    ASSERT_EQUAL_U(key*3, value);
+    ASSERT_FALSE(bplus_disk_erase(&tree, &key, NULL));
+  }
+  ASSERT_EQUAL_U(NKEYS/2, bplus_disk_size(&tree));
+
+  for (key = 0; key < NKEYS; ++key)
+    ASSERT_TRUE(bplus_disk_contains(&tree, &key) == (key%2 == 1));
+
+  count  = 0;
+  sorted = true;
+  bplus_disk_for_each(&tree, check);
+  ASSERT_EQUAL_U(NKEYS/2, count);
+  ASSERT_TRUE(sorted);
+
+  for (key = 1; key < NKEYS; key += 2)
+    ASSERT_TRUE(bplus_disk_erase(&tree, &key, NULL));
+  ASSERT_TRUE(bplus_disk_empty(&tree));
+  ASSERT_EQUAL_U(0, tree.meta.root);
+
+  /* the freed pages are reused rather than growing the file */
+  pages = tree.meta.pages;
+  for (uint64_t idx = 0; idx < NKEYS; ++idx) {
+    key   = shuffle(idx);
+    value = key*3;
+    ASSERT_TRUE(bplus_disk_insert(&tree, &key, &value));
+  }
+  ASSERT_EQUAL_U(pages, tree.meta.pages);
+
+  ASSERT_TRUE(bplus_disk_close(&tree));
+  remove(PATH);
+}
+
+CTEST(bplusdisk_test, bplus_disk_readahead_test) {
+  struct bplus_disk_root tree;
+  uint64_t               key;
+  uint64_t               value;
+  size_t                 reads;
+
+  remove(PATH);
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+  for (uint64_t idx = 0; idx < NKEYS; ++idx) {
+    key   = shuffle(idx);
+    value = key*3;
+    ASSERT_TRUE(bplus_disk_insert(&tree, &key, &value));
+  }
+  ASSERT_TRUE(bplus_disk_close(&tree));
+
+  /* a cold scan takes most of its external nodes from the reader threads */
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+  ASSERT_TRUE(bplus_disk_readahead(&tree, 64, 2));
+  ASSERT_EQUAL_U(BUDGET/PAGE/2, tree.window);
+
+  count  = 0;
+  sorted = true;
+  bplus_disk_for_each(&tree, check);
+  ASSERT_EQUAL_U(NKEYS, count);
+  ASSERT_TRUE(sorted);
+  ASSERT_TRUE(tree.pool.reads < tree.pool.prefetches);
+
+  reads = tree.pool.reads + tree.pool.prefetches;
+  count = 0;
+  key   = 1000;
+  value = 3000;
+  bplus_disk_range_each(&tree, &key, &value, check);
+  ASSERT_EQUAL_U(2000, count);
+  ASSERT_TRUE(sorted);
+
+  /* the read-ahead stops at the upper bound */
+  ASSERT_TRUE(tree.pool.reads + tree.pool.prefetches - reads < 2000/4);
+
+  /* the writes wait for the pages still being read */
+  for (key = 0; key < NKEYS; key += 2)
+    ASSERT_TRUE(bplus_disk_erase(&tree, &key, NULL));
+
+  count = 0;
+  bplus_disk_for_each(&tree, check);
+  ASSERT_EQUAL_U(NKEYS/2, count);
+  ASSERT_TRUE(sorted);
+  ASSERT_TRUE(bplus_disk_close(&tree));
+
+  /* without reader threads, the kernel reads ahead */
+  ASSERT_TRUE(bplus_disk_open(&tree, PATH, PAGE, BUDGET, sizeof(uint64_t), sizeof(uint64_t), less));
+  ASSERT_TRUE(bplus_disk_readahead(&tree, 8, 0));
+  count = 0;
+  key   = 1001;
+  value = 1101;
+  bplus_disk_range_each(&tree, &key, &value, check);
+  ASSERT_EQUAL_U(50, count);
+  ASSERT_TRUE(sorted);
+  ASSERT_EQUAL_U(0, tree.pool.prefetches);
+  ASSERT_TRUE(bplus_disk_close(&tree));
+
+  remove(PATH);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
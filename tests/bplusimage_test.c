@@ -0,0 +1,381 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * bplusimage_test.c - memory-mapped B+-tree image unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/bplusimage.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PATH  "bplusimage_test.img"
+#define NAME  16
+#define NKEYS 4096
+#define EPOCH 1600000000000
+#define NPROC 4
+
+      char      src[4];
+      char      dest[131];
+      uintptr_t last;
+      size_t    count;
+      bool      sorted;
+const uintptr_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
+const char      *names[]    = {"kiwi", "apple", "mango", "cherry", "banana", "grape", "lemon", "peach", "fig", "plum"};
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+bool strless(const void *restrict lhs, const void *restrict rhs) { return strcmp(lhs, rhs) < 0; }
+
+void encode(void *restrict dst, const void *restrict src) { strncpy(dst, src, NAME); }
+
+void concat(const void *restrict key, void *restrict value) { (void)value; sprintf(src, "%" PRIuPTR, (uintptr_t)key); strcat(dest, src); }
+
+void strconcat(const void *restrict key, void *restrict value) { (void)value; strcat(dest, key); strcat(dest, ","); }
+
+void ascend(const void *restrict key, void *restrict value) {
+  sorted = sorted && last < (uintptr_t)key && (uintptr_t)value == ((uintptr_t)key-EPOCH)/1000/64;
+  last   = (uintptr_t)key;
+  ++count;
+}
+
+/**
+ * matches - checks if the image at PATH holds the same elements as @tree
+ *
+ * @tree: the tree to compare the image with
+ */
+bool matches(const struct bplus_root tree) {
+  struct bplus_image *image = bplus_open_mmap(PATH, less);
+  bool               match  = image != NULL && bplus_image_size(image) == bplus_size(tree);
+
+  for (uintptr_t key = 1; match && key <= 2*NKEYS; ++key)
+    match = bplus_image_find(image, (void *)key) == bplus_find(tree, (void *)key);
+
+  if (image != NULL) bplus_close_mmap(image);
+
+  return match;
+}
+
+CTEST(bplusimage_test, bplus_image_find_test) {
+  struct bplus_root  tree = bplus_init(3, less);
+  struct bplus_image *image;
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    bplus_insert(&tree, (void *)*it, (void *)(*it*2));
+
+  ASSERT_TRUE(bplus_save(tree, PATH, NULL, NULL));
+  bplus_clear(&tree);
+
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), bplus_image_size(image));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it*2, (uintptr_t)bplus_image_find(image, (void *)*it));
+
+  ASSERT_NULL(bplus_image_find(image, (void *)12));
+  ASSERT_FALSE(bplus_image_contains(image, (void *)100));
+  ASSERT_TRUE(bplus_image_contains(image, (void *)99));
+
+  bplus_close_mmap(image);
+  remove(PATH);
+}
+
+CTEST(bplusimage_test, bplus_image_range_each_test) {
+  struct bplus_root  tree = bplus_init(4, less);
+  struct bplus_image *image;
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    bplus_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(bplus_save(tree, PATH, NULL, NULL));
+  bplus_clear(&tree);
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_for_each(image, concat);
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, (void *)21, (void *)50, concat);
+  ASSERT_STR("22253033404449", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, (void *)90, (void *)1000, concat);
+  ASSERT_STR("9099", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, (void *)0, (void *)10, concat);
+  ASSERT_STR("", dest);
+
+  bplus_close_mmap(image);
+  remove(PATH);
+}
+
+CTEST(bplusimage_test, bplus_image_codec_test) {
+  struct bplus_root        tree  = bplus_init(3, strless);
+  const struct bplus_codec codec = {.size = NAME, .encode = encode};
+  struct bplus_image       *image;
+  char                     key[NAME] = "plum";
+
+  for (size_t idx = 0; idx < sizeof(names)/sizeof(char *); ++idx)
+    bplus_insert(&tree, names[idx], (void *)(idx+1));
+
+  ASSERT_TRUE(bplus_save(tree, PATH, &codec, NULL));
+  bplus_clear(&tree);
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, strless));
+
+  for (size_t idx = 0; idx < sizeof(names)/sizeof(char *); ++idx)
+    ASSERT_EQUAL_U(idx+1, (uintptr_t)bplus_image_find(image, names[idx]));
+  ASSERT_EQUAL_U(10, (uintptr_t)bplus_image_find(image, key));
+  ASSERT_NULL(bplus_image_find(image, "orange"));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, "banana", "lemon", strconcat);
+  ASSERT_STR("banana,cherry,fig,grape,kiwi,", dest);
+
+  bplus_close_mmap(image);
+  remove(PATH);
+}
+
+CTEST(bplusimage_test, bplus_image_small_test) {
+  struct bplus_root  tree = bplus_init(8, less);
+  struct bplus_image *image;
+
+  ASSERT_TRUE(bplus_save(tree, PATH, NULL, NULL));
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+  ASSERT_TRUE(bplus_image_empty(image));
+  ASSERT_NULL(bplus_image_find(image, (void *)40));
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, (void *)0, (void *)100, concat);
+  ASSERT_STR("", dest);
+  bplus_close_mmap(image);
+
+  for (const uintptr_t *it = testcases; it < testcases + 5; ++it)
+    bplus_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(bplus_save(tree, PATH, NULL, NULL));
+  bplus_clear(&tree);
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+
+  for (const uintptr_t *it = testcases; it < testcases + 5; ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)bplus_image_find(image, (void *)*it));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_for_each(image, concat);
+  ASSERT_STR("1120334077", dest);
+
+  bplus_close_mmap(image);
+  remove(PATH);
+
+  ASSERT_NULL(bplus_open_mmap(PATH, less));
+}
+
+CTEST(bplusimage_test, bplus_checkpoint_test) {
+  struct bplus_root  tree = bplus_init(8, less);
+  struct bplus_store store;
+  size_t             written;
+  uint64_t           length;
+
+  remove(PATH);
+  ASSERT_TRUE(bplus_store_init(&store, PATH, NULL, NULL));
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    bplus_insert(&tree, (void *)key, (void *)key);
+
+  /* the first checkpoint writes the whole tree */
+  ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  ASSERT_TRUE(matches(tree));
+  written = store.written;
+  length  = store.header.length;
+  ASSERT_TRUE(NKEYS/8 < written);
+
+  /* a later one writes the changed paths alone */
+  ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  ASSERT_EQUAL_U(0, store.written);
+  bplus_insert(&tree, (void *)(NKEYS+1), (void *)(NKEYS+1));
+  bplus_insert_or_assign(&tree, (void *)1, (void *)2);
+  ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  ASSERT_TRUE(matches(tree));
+  ASSERT_TRUE(store.written < 16);
+
+  bplus_olc_insert(&tree, (void *)(NKEYS+2), (void *)(NKEYS+2));
+  bplus_olc_erase(&tree, (void *)2);
+  ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  ASSERT_TRUE(matches(tree));
+  ASSERT_TRUE(store.written < 16);
+
+  /* merges and redistributions move the elements across the nodes */
+  for (uintptr_t key = 3; key <= NKEYS; key += 3)
+    bplus_erase(&tree, (void *)key);
+  ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  ASSERT_TRUE(matches(tree));
+
+  /* the slots left behind are reused, so that the image stops growing */
+  for (uintptr_t round = 0; round < 64; ++round) {
+    for (uintptr_t key = round*NKEYS/64+1; key <= (round+1)*NKEYS/64; ++key)
+      bplus_insert_or_assign(&tree, (void *)(key%3 == 0 ? key+NKEYS : key), (void *)(round+1));
+    ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  }
+  ASSERT_TRUE(matches(tree));
+  ASSERT_TRUE(store.header.length < 2*length);
+
+  for (uintptr_t key = 1; key <= 2*NKEYS; ++key)
+    bplus_erase(&tree, (void *)key);
+  ASSERT_TRUE(bplus_checkpoint(&store, &tree));
+  ASSERT_TRUE(matches(tree));
+
+  bplus_store_destroy(&store);
+  bplus_clear(&tree);
+  remove(PATH);
+}
+
+CTEST(bplusimage_test, bplus_save_compressed_test) {
+  struct bplus_root  tree = bplus_init(64, less);
+  struct bplus_image *image;
+  uint64_t           length;
+
+  /* timestamps a second apart, with values in runs */
+  for (uintptr_t key = 0; key < NKEYS; ++key)
+    bplus_insert(&tree, (void *)(EPOCH + key*1000), (void *)(key/64));
+
+  ASSERT_TRUE(bplus_save(tree, PATH, NULL, NULL));
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+  length = image->header->length;
+  bplus_close_mmap(image);
+
+  ASSERT_TRUE(bplus_save_compressed(tree, PATH, NULL, NULL, true));
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+  ASSERT_TRUE(image->header->length*4 < length);
+  ASSERT_EQUAL_U(NKEYS, bplus_image_size(image));
+
+  for (uintptr_t key = 0; key < NKEYS; ++key) {
+    ASSERT_EQUAL_U(key/64, (uintptr_t)bplus_image_find(image, (void *)(EPOCH + key*1000)));
+    ASSERT_FALSE(bplus_image_contains(image, (void *)(EPOCH + key*1000 + 1)));
+  }
+  ASSERT_FALSE(bplus_image_contains(image, (void *)0));
+
+  last   = 0;
+  count  = 0;
+  sorted = true;
+  bplus_image_for_each(image, ascend);
+  ASSERT_EQUAL_U(NKEYS, count);
+  ASSERT_TRUE(sorted);
+
+  last   = 0;
+  count  = 0;
+  sorted = true;
+  bplus_image_range_each(image, (void *)(EPOCH + 100*1000 - 1), (void *)(EPOCH + 2000*1000), ascend);
+  ASSERT_EQUAL_U(1900, count);
+  ASSERT_TRUE(sorted);
+  bplus_close_mmap(image);
+
+  bplus_clear(&tree);
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    bplus_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(bplus_save_compressed(tree, PATH, NULL, NULL, false));
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, (void *)21, (void *)50, concat);
+  ASSERT_STR("22253033404449", dest);
+  bplus_close_mmap(image);
+
+  bplus_clear(&tree);
+  ASSERT_TRUE(bplus_save_compressed(tree, PATH, NULL, NULL, true));
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, less));
+  ASSERT_TRUE(bplus_image_empty(image));
+  ASSERT_NULL(bplus_image_find(image, (void *)40));
+  bplus_close_mmap(image);
+
+  remove(PATH);
+}
+
+CTEST(bplusimage_test, bplus_save_compressed_codec_test) {
+  struct bplus_root        tree  = bplus_init(3, strless);
+  const struct bplus_codec codec = {.size = NAME, .encode = encode};
+  struct bplus_image       *image;
+
+  for (size_t idx = 0; idx < sizeof(names)/sizeof(char *); ++idx)
+    bplus_insert(&tree, names[idx], (void *)(idx+1));
+
+  /* the values written by an encoder are left uncompressed */
+  ASSERT_FALSE(bplus_save_compressed(tree, PATH, &codec, &codec, true));
+
+  ASSERT_TRUE(bplus_save_compressed(tree, PATH, &codec, NULL, true));
+  bplus_clear(&tree);
+  ASSERT_NOT_NULL(image = bplus_open_mmap(PATH, strless));
+
+  for (size_t idx = 0; idx < sizeof(names)/sizeof(char *); ++idx)
+    ASSERT_EQUAL_U(idx+1, (uintptr_t)bplus_image_find(image, names[idx]));
+  ASSERT_NULL(bplus_image_find(image, "orange"));
+  ASSERT_NULL(bplus_image_find(image, "aardvark"));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_range_each(image, "banana", "lemon", strconcat);
+  ASSERT_STR("banana,cherry,fig,grape,kiwi,", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_for_each(image, strconcat);
+  ASSERT_STR("apple,banana,cherry,fig,grape,kiwi,lemon,mango,peach,plum,", dest);
+
+  bplus_close_mmap(image);
+  remove(PATH);
+}
+
+CTEST(bplusimage_test, bplus_save_shared_test) {
+  struct bplus_root        tree  = bplus_init(8, strless);
+  const struct bplus_codec codec = {.size = NAME, .encode = encode};
+  struct bplus_image       *image;
+  pid_t                    workers[NPROC];
+  int                      status;
+  int                      fd;
+
+  for (size_t idx = 0; idx < sizeof(names)/sizeof(char *); ++idx)
+    bplus_insert(&tree, names[idx], (void *)(idx+1));
+
+  ASSERT_TRUE(0 <= (fd = bplus_save_shared(tree, &codec, NULL)));
+  bplus_clear(&tree);
+
+#ifdef __linux__
+  /* the sealed file can no longer be written, even through the descriptor it was written by */
+  ASSERT_TRUE(write(fd, "x", 1) < 0);
+#endif
+
+  /* each worker maps the file of the inherited descriptor on its own, and finds the keys written by the parent */
+  for (size_t idx = 0; idx < NPROC; ++idx)
+    if ((workers[idx] = fork()) == 0) {
+      bool match = (image = bplus_open_fd(fd, strless)) != NULL && bplus_image_size(image) == sizeof(names)/sizeof(char *);
+      for (size_t key = 0; match && key < sizeof(names)/sizeof(char *); ++key)
+        match = (uintptr_t)bplus_image_find(image, names[key]) == key+1;
+      match = match && bplus_image_find(image, "orange") == NULL;
+      _exit(match ? 0 : 1);
+    }
+
+  for (size_t idx = 0; idx < NPROC; ++idx) {
+    ASSERT_TRUE(0 < workers[idx]);
+    ASSERT_EQUAL(workers[idx], waitpid(workers[idx], &status, 0));
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  /* the mapping outlives the descriptor */
+  ASSERT_NOT_NULL(image = bplus_open_fd(fd, strless));
+  close(fd);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_image_for_each(image, strconcat);
+  ASSERT_STR("apple,banana,cherry,fig,grape,kiwi,lemon,mango,peach,plum,", dest);
+
+  bplus_close_mmap(image);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
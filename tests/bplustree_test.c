@@ -14,6 +14,7 @@
 
 #include <ctest.h>
 #include <index/bplustree.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -168,6 +169,42 @@ CTEST(bplustree_test, bplus_erase_even_test) {
   ASSERT_TRUE(bplus_empty(tree));
 }
 
+CTEST(bplustree_test, bplus_insert_batch_odd_test) {
+  struct bplus_root tree = bplus_init(3, less);
+
+  for (const uintptr_t *it = testcases; it < testcases + 39; ++it)
+    bplus_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2-1-39, bplus_insert_batch(&tree, (const void **)testcases, (void **)testcases, sizeof(testcases)/sizeof(uintptr_t)));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_for_each(tree, concat);
+  ASSERT_STR("1234567891011121314151617182022242528303340414243444546474849505152535455565758596061626364656667686970737577808182838488899099100", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2-1, bplus_size(tree));
+
+  for (const uintptr_t *it = testcases + sizeof(testcases)/sizeof(uintptr_t)/2; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    if (*it != 28 || bplus_contains(tree, (void *)*it))
+      ASSERT_EQUAL_U(*it, (uintptr_t)bplus_erase(&tree, (void *)*it));
+
+  ASSERT_TRUE(bplus_empty(tree));
+}
+
+CTEST(bplustree_test, bplus_insert_batch_even_test) {
+  struct bplus_root tree = bplus_init(4, less);
+
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2-1, bplus_insert_batch(&tree, (const void **)testcases, (void **)testcases, sizeof(testcases)/sizeof(uintptr_t)));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_rev_each(tree, concat);
+  ASSERT_STR("1009990898884838281807775737069686766656463626160595857565554535251504948474645444342414033302825242220181716151413121110987654321", dest);
+
+  for (const uintptr_t *it = testcases + sizeof(testcases)/sizeof(uintptr_t)/2; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    if (*it != 28 || bplus_contains(tree, (void *)*it))
+      ASSERT_EQUAL_U(*it, (uintptr_t)bplus_erase(&tree, (void *)*it));
+
+  ASSERT_TRUE(bplus_empty(tree));
+}
+
 CTEST(bplustree_test, bplus_range_each_test) {
   struct bplus_root tree = bplus_init(4, less);
 
@@ -194,4 +231,244 @@ CTEST(bplustree_test, bplus_range_each_test) {
   ASSERT_TRUE(bplus_empty(tree));
 }
 
+CTEST(bplustree_test, bplus_clone_test) {
+  struct bplus_root tree  = bplus_init(3, less);
+  struct bplus_root clone = bplus_init(3, less);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t)/2; ++it)
+    bplus_insert(&tree, (void *)*it, (void *)*it);
+
+  bplus_clone(&clone, tree);
+  bplus_clear(&tree);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_for_each(clone, concat);
+  ASSERT_STR("1234567891011121314151617182022242528303340414243444546474849505152535455565758596061626364656667686970737577808182838488899099100", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2-1, bplus_size(clone));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_range_each(clone, (void *)30, (void *)76, concat);
+  ASSERT_STR("3033404142434445464748495051525354555657585960616263646566676869707375", dest);
+
+  for (const uintptr_t *it = testcases + sizeof(testcases)/sizeof(uintptr_t)/2; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    bplus_erase(&clone, (void *)*it);
+
+  ASSERT_TRUE(bplus_empty(clone));
+  ASSERT_NULL(clone.head);
+}
+
+struct bplus_root shared;
+uintptr_t         sum;
+uintptr_t         sorted[1<<16];
+
+void add(const void *restrict key, void *restrict value) {
+  (void)key;
+  sum += (uintptr_t)value;
+}
+
+CTEST(bplustree_test, bplus_build_test) {
+  struct bplus_root tree  = bplus_init(3, less);
+  struct bplus_root large = bplus_init(5, less);
+
+  for (uintptr_t key = 1; key <= 1<<16; ++key)
+    sorted[key-1] = key;
+
+  bplus_build(&tree, (const void **)sorted, (void **)sorted, 100, 1);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_range_each(tree, (void *)30, (void *)76, concat);
+  ASSERT_STR("30313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475", dest);
+  ASSERT_EQUAL_U(100, bplus_size(tree));
+
+  for (uintptr_t key = 1; key <= 100; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)bplus_erase(&tree, (void *)key));
+  ASSERT_TRUE(bplus_empty(tree));
+  ASSERT_NULL(tree.head);
+
+  bplus_build(&large, (const void **)sorted, (void **)sorted, 1<<16, 4);
+  ASSERT_EQUAL_U(1<<16, bplus_size(large));
+
+  sum = 0;
+  bplus_rev_each(large, add);
+  ASSERT_EQUAL_U((uintptr_t)(1<<15)*((1<<16)+1), sum);
+
+  for (uintptr_t key = 1; key <= 1<<16; key += 3)
+    ASSERT_EQUAL_U(key, (uintptr_t)bplus_find(large, (void *)key));
+  for (uintptr_t key = 2; key <= 1<<16; key += 2)
+    ASSERT_EQUAL_U(key, (uintptr_t)bplus_erase(&large, (void *)key));
+  ASSERT_EQUAL_U(1<<15, bplus_size(large));
+
+  bplus_clear(&large);
+}
+
+struct summary {
+  size_t    count;
+  uintptr_t sum;
+  uintptr_t first;
+  uintptr_t last;
+  bool      sorted;
+};
+
+void summarize(void *restrict acc, const void *restrict key, void *restrict value) {
+  struct summary *summary = acc;
+  if (summary->count == 0) summary->first = (uintptr_t)key;
+  else                     summary->sorted &= summary->last < (uintptr_t)key;
+  summary->last  = (uintptr_t)key;
+  summary->sum  += (uintptr_t)value;
+  ++summary->count;
+}
+
+void merge(void *restrict acc, const void *restrict other) {
+  struct summary       *summary = acc;
+  const struct summary *partial = other;
+  if (partial->count == 0) return;
+  if (summary->count == 0) summary->first = partial->first;
+  else                     summary->sorted &= summary->last < partial->first;
+  summary->last    = partial->last;
+  summary->sum    += partial->sum;
+  summary->count  += partial->count;
+  summary->sorted &= partial->sorted;
+}
+
+CTEST(bplustree_test, bplus_reduce_test) {
+  struct bplus_root tree = bplus_init(4, less);
+  struct summary    summary;
+
+  for (uintptr_t key = 1; key <= 1<<16; ++key)
+    sorted[key-1] = key;
+
+  bplus_build(&tree, (const void **)sorted, (void **)sorted, 1<<16, 1);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3)
+    bplus_erase(&tree, (void *)key);
+
+  for (size_t threads = 1; threads <= 64; threads <<= 1) {
+    summary = (struct summary){0, 0, 0, 0, true};
+    bplus_reduce(tree, summarize, merge, &summary, sizeof(summary), threads);
+    ASSERT_EQUAL_U(bplus_size(tree), summary.count);
+    ASSERT_EQUAL_U(1, summary.first);
+    ASSERT_EQUAL_U(1<<16, summary.last);
+    ASSERT_EQUAL_U((uintptr_t)(1<<15)*((1<<16)+1)-(uintptr_t)3*21845*21846/2, summary.sum);
+    ASSERT_TRUE(summary.sorted);
+
+    summary = (struct summary){0, 0, 0, 0, true};
+    bplus_range_reduce(tree, (void *)1000, (void *)50000, summarize, merge, &summary, sizeof(summary), threads);
+    ASSERT_EQUAL_U(32667, summary.count);
+    ASSERT_EQUAL_U(1000, summary.first);
+    ASSERT_EQUAL_U(49999, summary.last);
+    ASSERT_TRUE(summary.sorted);
+
+    summary = (struct summary){0, 0, 0, 0, true};
+    bplus_range_reduce(tree, (void *)100, (void *)102, summarize, merge, &summary, sizeof(summary), threads);
+    ASSERT_EQUAL_U(2, summary.count);
+    ASSERT_EQUAL_U(100, summary.first);
+  }
+
+  bplus_clear(&tree);
+
+  summary = (struct summary){0, 0, 0, 0, true};
+  bplus_reduce(tree, summarize, merge, &summary, sizeof(summary), 8);
+  ASSERT_EQUAL_U(0, summary.count);
+}
+
+CTEST(bplustree_test, bplus_freeze_test) {
+  struct bplus_root   tree = bplus_init(3, less);
+  struct bplus_frozen frozen;
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t)/2; ++it)
+    bplus_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(bplus_freeze(&frozen, &tree));
+  ASSERT_TRUE(bplus_empty(tree));
+  ASSERT_NULL(tree.head);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2-1, bplus_frozen_size(&frozen));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t)/2; ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)bplus_frozen_find(&frozen, (void *)*it));
+  ASSERT_FALSE(bplus_frozen_contains(&frozen, (void *)0));
+  ASSERT_FALSE(bplus_frozen_contains(&frozen, (void *)19));
+  ASSERT_FALSE(bplus_frozen_contains(&frozen, (void *)101));
+
+  memset(dest, 0, sizeof(dest));
+  bplus_frozen_for_each(&frozen, concat);
+  ASSERT_STR("1234567891011121314151617182022242528303340414243444546474849505152535455565758596061626364656667686970737577808182838488899099100", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_frozen_range_each(&frozen, (void *)19, (void *)70, concat);
+  ASSERT_STR("20222425283033404142434445464748495051525354555657585960616263646566676869", dest);
+
+  memset(dest, 0, sizeof(dest));
+  bplus_frozen_range_each(&frozen, (void *)100, (void *)1000, concat);
+  ASSERT_STR("100", dest);
+
+  bplus_frozen_destroy(&frozen);
+  ASSERT_TRUE(bplus_frozen_empty(&frozen));
+
+  /* the last node of each level is left partially full for all but a few sizes */
+  for (size_t order = 3; order <= 6; ++order)
+    for (uintptr_t nmemb = 0; nmemb <= 300; ++nmemb) {
+      struct bplus_root large = bplus_init(order, less);
+
+      for (uintptr_t key = 1; key <= nmemb; ++key)
+        bplus_insert(&large, (void *)(key*2), (void *)key);
+
+      ASSERT_TRUE(bplus_freeze(&frozen, &large));
+      ASSERT_EQUAL_U(nmemb, bplus_frozen_size(&frozen));
+
+      for (uintptr_t key = 0; key <= 2*nmemb+1; ++key)
+        ASSERT_EQUAL_U(key % 2 == 0 ? key/2 : 0, (uintptr_t)bplus_frozen_find(&frozen, (void *)key));
+
+      sum = 0;
+      bplus_frozen_range_each(&frozen, (void *)(nmemb/2), (void *)(nmemb+nmemb/2+1), add);
+      for (uintptr_t key = 1; key <= nmemb; ++key)
+        if (nmemb/2 <= key*2 && key*2 < nmemb+nmemb/2+1)
+          sum -= key;
+      ASSERT_EQUAL_U(0, sum);
+
+      bplus_frozen_destroy(&frozen);
+    }
+}
+
+void *work(void *arg) {
+  const uintptr_t base   = (uintptr_t)arg;
+        uintptr_t misses = 0;
+
+  for (uintptr_t key = base; key < base + 4096; ++key)
+    if (!bplus_olc_insert(&shared, (void *)key, (void *)key))
+      ++misses;
+
+  for (uintptr_t key = base; key < base + 4096; ++key)
+    if (bplus_olc_find(&shared, (void *)key) != (void *)key)
+      ++misses;
+
+  for (uintptr_t key = base; key < base + 4096; key += 2)
+    if (bplus_olc_erase(&shared, (void *)key) != (void *)key || bplus_olc_contains(&shared, (void *)key))
+      ++misses;
+
+  return (void *)misses;
+}
+
+CTEST(bplustree_test, bplus_olc_test) {
+  const struct bplus_root tree = bplus_init(3, less);
+        pthread_t         threads[4];
+        void              *misses;
+
+  memcpy(&shared, &tree, sizeof(struct bplus_root));
+
+  for (uintptr_t idx = 0; idx < 4; ++idx)
+    pthread_create(&threads[idx], NULL, work, (void *)(1 + (idx << 12)));
+
+  for (size_t idx = 0; idx < 4; ++idx) {
+    pthread_join(threads[idx], &misses);
+    ASSERT_NULL(misses);
+  }
+
+  sum = 0;
+  bplus_for_each(shared, add);
+  ASSERT_EQUAL_U(2048*4, bplus_size(shared));
+  ASSERT_EQUAL_U(2048*4*(2048*4+1), sum);
+
+  bplus_clear(&shared);
+  ASSERT_TRUE(bplus_empty(shared));
+}
+
 int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -172,4 +172,70 @@ CTEST(btree_test, btree_erase_even_test) {
   ASSERT_TRUE(btree_empty(tree));
 }
 
+CTEST(btree_test, btree_clone_test) {
+  struct btree_root tree  = btree_init(3, less);
+  struct btree_root clone = btree_init(3, less);
+  char              src[4];
+  char              dest[131];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t)/2; ++it)
+    btree_insert(&tree, (void *)*it, (void *)*it);
+
+  btree_clone(&clone, tree);
+  btree_clear(&tree);
+
+  memset(dest, 0, sizeof(dest));
+  for (struct btree_iter iter = btree_iter_init(clone); !btree_iter_end(iter); btree_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1234567891011121314151617182022242528303340414243444546474849505152535455565758596061626364656667686970737577808182838488899099100", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)/2-1, btree_size(clone));
+
+  for (const uintptr_t *it = testcases + sizeof(testcases)/sizeof(uintptr_t)/2; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    btree_erase(&clone, (void *)*it);
+
+  ASSERT_TRUE(btree_empty(clone));
+}
+
+uintptr_t sorted[1<<16];
+
+CTEST(btree_test, btree_build_test) {
+  struct btree_root tree  = btree_init(3, less);
+  struct btree_root large = btree_init(5, less);
+  size_t            size  = 0;
+  char              src[4];
+  char              dest[193];
+
+  for (uintptr_t key = 1; key <= 1<<16; ++key)
+    sorted[key-1] = key;
+
+  btree_build(&tree, (const void **)sorted, (void **)sorted, 100, 1);
+
+  memset(dest, 0, sizeof(dest));
+  for (struct btree_reverse_iter iter = btree_reverse_iter_init(tree); !btree_reverse_iter_end(iter); btree_reverse_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("100999897969594939291908988878685848382818079787776757473727170696867666564636261605958575655545352515049484746454443424140393837363534333231302928272625242322212019181716151413121110987654321", dest);
+  ASSERT_EQUAL_U(100, btree_size(tree));
+
+  for (uintptr_t key = 100; 0 < key; --key)
+    ASSERT_EQUAL_U(key, (uintptr_t)btree_erase(&tree, (void *)key));
+  ASSERT_TRUE(btree_empty(tree));
+
+  btree_build(&large, (const void **)sorted, (void **)sorted, 1<<16, 4);
+  ASSERT_EQUAL_U(1<<16, btree_size(large));
+
+  for (struct btree_iter iter = btree_iter_init(large); !btree_iter_end(iter); btree_iter_next(&iter))
+    ASSERT_EQUAL_U(++size, (uintptr_t)iter.value);
+  ASSERT_EQUAL_U(1<<16, size);
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2)
+    ASSERT_EQUAL_U(key, (uintptr_t)btree_erase(&large, (void *)key));
+  ASSERT_EQUAL_U(1<<15, btree_size(large));
+
+  btree_clear(&large);
+}
+
 int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * epoch_test.c - epoch-based reclamation unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/avltree.h>
+#include <index/epoch.h>
+#include <index/rbtree.h>
+#include <stdint.h>
+
+#define NTHREADS 3
+#define NKEYS    4096
+#define NWRITES  (1 << 16)
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+struct epoch_root epoch;
+struct avl_root   avl;
+struct rb_root    rb;
+volatile bool     done;
+
+/**
+ * reader - looks up the odd keys, which are never erased, until the writer is done
+ *
+ * @arg: the seed of the keys to look up
+ */
+void *reader(void *arg) {
+  struct epoch_thread thread;
+  uintptr_t           seed   = (uintptr_t)arg;
+  uintptr_t           misses = 0;
+
+  epoch_register(&epoch, &thread);
+
+  while (!done) {
+    seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+
+    const uintptr_t key = (seed >> 33) % NKEYS | 1;
+
+    epoch_enter(&epoch, &thread);
+    if (avl_rcu_find(&avl, (void *)key) != (void *)key || !rb_rcu_contains(&rb, (void *)key))
+      ++misses;
+    epoch_exit(&thread);
+  }
+
+  epoch_unregister(&epoch, &thread);
+
+  return (void *)misses;
+}
+
+CTEST(epoch_test, rcu_test) {
+  pthread_t threads[NTHREADS];
+  void      *misses;
+  uintptr_t seed = 1;
+
+  epoch_init(&epoch);
+  avl  = avl_init(less);
+  rb   = rb_init(less);
+  done = false;
+
+  for (uintptr_t key = 1; key < NKEYS; key += 2) {
+    ASSERT_TRUE(avl_rcu_insert(&avl, (void *)key, (void *)key, &epoch));
+    ASSERT_TRUE(rb_rcu_insert(&rb, (void *)key, (void *)key, &epoch));
+  }
+
+  for (uintptr_t idx = 0; idx < NTHREADS; ++idx)
+    pthread_create(&threads[idx], NULL, reader, (void *)(idx+1));
+
+  for (size_t idx = 0; idx < NWRITES; ++idx) {
+    seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+
+    const uintptr_t key = (seed >> 33) % NKEYS & ~(uintptr_t)1;
+
+    if (seed >> 63) {
+      avl_rcu_insert(&avl, (void *)key, (void *)key, &epoch);
+      rb_rcu_insert(&rb, (void *)key, (void *)key, &epoch);
+    } else {
+      ASSERT_EQUAL_U((uintptr_t)avl_rcu_erase(&avl, (void *)key, &epoch), (uintptr_t)rb_rcu_erase(&rb, (void *)key, &epoch));
+    }
+  }
+
+  done = true;
+
+  for (size_t idx = 0; idx < NTHREADS; ++idx) {
+    pthread_join(threads[idx], &misses);
+    ASSERT_NULL(misses);
+  }
+
+  ASSERT_EQUAL_U(avl_size(avl), rb_size(rb));
+
+  for (uintptr_t key = 0; key < NKEYS; ++key)
+    ASSERT_EQUAL(avl_contains(avl, (void *)key), rb_contains(rb, (void *)key));
+
+  avl_clear(&avl);
+  rb_clear(&rb);
+  epoch_destroy(&epoch);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
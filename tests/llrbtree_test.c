@@ -14,14 +14,76 @@
 
 #include <ctest.h>
 #include <index/llrbtree.h>
+#include <index/serial.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#define NKEYS 256
+
 const uintptr_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
 
 bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
 
+struct memory {
+  unsigned char data[sizeof(uint64_t) + 2*(sizeof(uint64_t)+sizeof(uintptr_t))*NKEYS];
+  size_t        length;
+  size_t        offset;
+};
+
+bool sink(void *ctx, const void *restrict buf, const size_t size) {
+  struct memory *memory = ctx;
+
+  if (sizeof(memory->data) < memory->length + size) return false;
+  memcpy(memory->data + memory->length, buf, size);
+  memory->length += size;
+  return true;
+}
+
+bool source(void *ctx, void *restrict buf, const size_t size) {
+  struct memory *memory = ctx;
+
+  if (memory->length < memory->offset + size) return false;
+  memcpy(buf, memory->data + memory->offset, size);
+  memory->offset += size;
+  return true;
+}
+
+size_t encode(void *ctx, const void *item, void *restrict buf, const size_t capacity) {
+  (void)ctx;
+  if (sizeof(uintptr_t) <= capacity) memcpy(buf, &item, sizeof(uintptr_t));
+  return sizeof(uintptr_t);
+}
+
+bool decode(void *ctx, const void *restrict buf, const size_t length, void **restrict item) {
+  if (length != sizeof(uintptr_t)) return false;
+  memcpy(item, buf, sizeof(uintptr_t));
+  ++*(size_t *)ctx;
+  return true;
+}
+
+void release(void *ctx, void *item) {
+  (void)item;
+  --*(size_t *)ctx;
+}
+
+/**
+ * black_height - returns the black height of subtree rooted with @node, or -1 if it is not a left-leaning red-black tree
+ *
+ * @node: root node of subtree
+ */
+int black_height(const struct llrb_node *node) {
+  if (node == NULL) return 1;
+
+  const int lhs = black_height(node->left);
+  const int rhs = black_height(node->right);
+
+  if (lhs < 0 || lhs != rhs || (node->left != NULL && node->left->parent != node) || (node->right != NULL && node->right->parent != node) ||
+      (node->right != NULL && !node->right->black) || (!node->black && node->left != NULL && !node->left->black)) return -1;
+
+  return lhs + node->black;
+}
+
 CTEST(llrbtree_test, llrb_find_test) {
   struct llrb_root tree = llrb_init(less);
 
@@ -102,4 +164,95 @@ CTEST(llrbtree_test, llrb_erase_reverse_test) {
   ASSERT_TRUE(llrb_empty(tree));
 }
 
+CTEST(llrbtree_test, llrb_clone_test) {
+  struct llrb_root tree  = llrb_init(less);
+  struct llrb_root clone = llrb_init(less);
+  char             src[3];
+  char             dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    llrb_insert(&tree, (void *)*it, (void *)*it);
+
+  llrb_clone(&clone, tree);
+  llrb_clear(&tree);
+
+  memset(dest, 0, sizeof(dest));
+  for (struct llrb_iter iter = llrb_iter_init(clone); !llrb_iter_end(iter); llrb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), llrb_size(clone));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)llrb_erase(&clone, (void *)*it));
+
+  ASSERT_TRUE(llrb_empty(clone));
+}
+
+CTEST(llrbtree_test, llrb_dump_test) {
+  struct llrb_root     tree  = llrb_init(less);
+  struct llrb_root     other = llrb_init(less);
+  char                 src[3];
+  char                 dest[41];
+  struct memory        memory = {.length = 0};
+  struct serial_stream stream = {sink, source, &memory};
+  size_t               live   = 0;
+  struct bplus_codec   codec  = {.record = encode, .decode = decode, .release = release, .ctx = &live};
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    llrb_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(llrb_dump(tree, &stream, &codec, &codec));
+  ASSERT_EQUAL_U(sizeof(uint64_t) + 2*(sizeof(uint64_t)+sizeof(uintptr_t))*sizeof(testcases)/sizeof(uintptr_t), memory.length);
+  llrb_clear(&tree);
+
+  memory.offset = 0;
+  ASSERT_TRUE(llrb_restore(&other, &stream, &codec, &codec));
+  ASSERT_TRUE(0 < black_height(other.root) && (other.root == NULL || other.root->black));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct llrb_iter iter = llrb_iter_init(other); !llrb_iter_end(iter); llrb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), llrb_size(other));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)llrb_erase(&other, (void *)*it));
+  ASSERT_TRUE(llrb_empty(other));
+
+  /* the restored tree is balanced for any number of entries */
+  for (uintptr_t nmemb = 0; nmemb < NKEYS; ++nmemb) {
+    llrb_insert(&tree, (void *)(nmemb+1), (void *)(nmemb+1));
+
+    memory.length = 0;
+    ASSERT_TRUE(llrb_dump(tree, &stream, &codec, &codec));
+    memory.offset = 0;
+    ASSERT_TRUE(llrb_restore(&other, &stream, &codec, &codec));
+    ASSERT_TRUE(0 < black_height(other.root) && (other.root == NULL || other.root->black));
+    ASSERT_EQUAL_U(nmemb+1, llrb_size(other));
+
+    for (uintptr_t key = 1; key <= nmemb+1; ++key)
+      ASSERT_EQUAL_U(key, (uintptr_t)llrb_erase(&other, (void *)key));
+    ASSERT_TRUE(llrb_empty(other));
+  }
+
+  /* a non-empty tree is left as it is */
+  memory.offset = 0;
+  ASSERT_FALSE(llrb_restore(&tree, &stream, &codec, &codec));
+  ASSERT_EQUAL_U(NKEYS, llrb_size(tree));
+
+  /* a truncated dump leaves the tree empty, and releases the keys and values read */
+  live           = 0;
+  memory.length -= sizeof(uintptr_t);
+  memory.offset  = 0;
+  ASSERT_FALSE(llrb_restore(&other, &stream, &codec, &codec));
+  ASSERT_TRUE(llrb_empty(other));
+  ASSERT_EQUAL_U(0, live);
+
+  llrb_clear(&tree);
+}
+
 int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * lsm_test.c - log-structured merge index unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/lsm.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PATH      "."
+#define NKEYS     10000
+#define THRESHOLD 256
+#define FANOUT    4
+
+      char      src[4];
+      char      dest[131];
+      uintptr_t last;
+      size_t    count;
+      bool      sorted;
+const uintptr_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+uint64_t hash(const void *key) { return (uintptr_t)key; }
+
+void concat(const void *restrict key, void *restrict value) {
+  (void)value;
+  sprintf(src, "%" PRIuPTR, (uintptr_t)key);
+  strcat(dest, src);
+}
+
+void ascend(const void *restrict key, void *restrict value) {
+  sorted = sorted && last < (uintptr_t)key && (uintptr_t)value == (uintptr_t)key*3;
+  last   = (uintptr_t)key;
+  ++count;
+}
+
+/**
+ * shuffle - returns the @idx-th key of a permutation of [1, NKEYS]
+ *
+ * @idx: the index of the key
+ */
+uintptr_t shuffle(const uintptr_t idx) { return idx*7919 % NKEYS + 1; }
+
+CTEST(lsm_test, lsm_find_test) {
+  struct lsm_root tree;
+
+  ASSERT_TRUE(lsm_init(&tree, PATH, 16, THRESHOLD, FANOUT, less, hash));
+
+  for (uintptr_t idx = 0; idx < NKEYS; ++idx)
+    ASSERT_TRUE(lsm_insert(&tree, (void *)shuffle(idx), (void *)(shuffle(idx)*3)));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL(key*3, (uintptr_t)lsm_find(&tree, (void *)key));
+
+  ASSERT_TRUE(lsm_flush(&tree));
+  ASSERT_TRUE(0 < tree.compactions);
+  ASSERT_TRUE(tree.nruns < NKEYS/THRESHOLD);
+  ASSERT_EQUAL(0, bplus_size(tree.memtable));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_TRUE(lsm_contains(&tree, (void *)key));
+
+  /* the Bloom filters keep most of the lookups of missing keys off the runs */
+  for (uintptr_t key = NKEYS+1; key <= 2*NKEYS; ++key)
+    ASSERT_NULL(lsm_find(&tree, (void *)key));
+  ASSERT_TRUE(NKEYS*tree.nruns*9/10 < tree.skips);
+
+  lsm_destroy(&tree);
+}
+
+CTEST(lsm_test, lsm_compact_test) {
+  struct lsm_root tree;
+
+  ASSERT_TRUE(lsm_init(&tree, PATH, 16, THRESHOLD, FANOUT, less, hash));
+
+  /* 21 memtables of distinct keys, which is 111 in base FANOUT */
+  for (uintptr_t key = 1; key <= THRESHOLD*21; ++key)
+    ASSERT_TRUE(lsm_insert(&tree, (void *)key, (void *)(key*3)));
+  ASSERT_TRUE(lsm_flush(&tree));
+
+  /* each tier keeps fewer than FANOUT runs, and a run of each tier is FANOUT times as large as the next one */
+  ASSERT_EQUAL(3, tree.nruns);
+  ASSERT_EQUAL(THRESHOLD*FANOUT*FANOUT, tree.runs[0].nmemb);
+  ASSERT_EQUAL(THRESHOLD*FANOUT, tree.runs[1].nmemb);
+  ASSERT_EQUAL(THRESHOLD, tree.runs[2].nmemb);
+  ASSERT_EQUAL(6, tree.compactions);
+
+  sorted = true;
+  last   = 0;
+  count  = 0;
+  lsm_for_each(&tree, ascend);
+  ASSERT_TRUE(sorted);
+  ASSERT_EQUAL(THRESHOLD*21, count);
+
+  lsm_destroy(&tree);
+}
+
+CTEST(lsm_test, lsm_insert_test) {
+  struct lsm_root tree;
+
+  ASSERT_TRUE(lsm_init(&tree, PATH, 16, THRESHOLD, FANOUT, less, hash));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_TRUE(lsm_insert(&tree, (void *)key, (void *)key));
+  ASSERT_TRUE(lsm_flush(&tree));
+
+  /* the newer versions in the memtable and the younger runs shadow the older ones */
+  for (uintptr_t key = 1; key <= NKEYS; key += 2)
+    ASSERT_TRUE(lsm_insert(&tree, (void *)key, (void *)(key*3)));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL(key % 2 == 1 ? key*3 : key, (uintptr_t)lsm_find(&tree, (void *)key));
+
+  ASSERT_TRUE(lsm_flush(&tree));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL(key % 2 == 1 ? key*3 : key, (uintptr_t)lsm_find(&tree, (void *)key));
+
+  lsm_destroy(&tree);
+}
+
+CTEST(lsm_test, lsm_erase_test) {
+  struct lsm_root tree;
+
+  ASSERT_TRUE(lsm_init(&tree, PATH, 16, THRESHOLD, FANOUT, less, hash));
+
+  for (uintptr_t idx = 0; idx < NKEYS; ++idx)
+    ASSERT_TRUE(lsm_insert(&tree, (void *)shuffle(idx), (void *)(shuffle(idx)*3)));
+  ASSERT_TRUE(lsm_flush(&tree));
+
+  for (uintptr_t key = 2; key <= NKEYS; key += 2)
+    ASSERT_TRUE(lsm_erase(&tree, (void *)key));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL(key % 2 == 1, lsm_contains(&tree, (void *)key));
+
+  sorted = true;
+  last   = 0;
+  count  = 0;
+  lsm_for_each(&tree, ascend);
+  ASSERT_TRUE(sorted);
+  ASSERT_EQUAL(NKEYS/2, count);
+
+  /* the tombstones flushed to the runs keep shadowing the erased elements */
+  ASSERT_TRUE(lsm_flush(&tree));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL(key % 2 == 1, lsm_contains(&tree, (void *)key));
+
+  sorted = true;
+  last   = 0;
+  count  = 0;
+  lsm_for_each(&tree, ascend);
+  ASSERT_TRUE(sorted);
+  ASSERT_EQUAL(NKEYS/2, count);
+
+  lsm_destroy(&tree);
+}
+
+CTEST(lsm_test, lsm_range_each_test) {
+  struct lsm_root tree;
+
+  ASSERT_TRUE(lsm_init(&tree, PATH, 4, 4, FANOUT, less, hash));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_TRUE(lsm_insert(&tree, (void *)*it, (void *)(*it*3)));
+
+  memset(dest, 0, sizeof(dest));
+  lsm_range_each(&tree, (void *)20, (void *)60, concat);
+  ASSERT_STR("20222530334044495055", dest);
+
+  ASSERT_TRUE(lsm_erase(&tree, (void *)33));
+  ASSERT_TRUE(lsm_erase(&tree, (void *)99));
+
+  memset(dest, 0, sizeof(dest));
+  lsm_range_each(&tree, (void *)20, (void *)60, concat);
+  ASSERT_STR("202225304044495055", dest);
+
+  ASSERT_TRUE(lsm_flush(&tree));
+
+  memset(dest, 0, sizeof(dest));
+  lsm_for_each(&tree, concat);
+  ASSERT_STR("101120222530404449505560667077808890", dest);
+
+  sorted = true;
+  last   = 0;
+  count  = 0;
+  lsm_range_each(&tree, (void *)91, (void *)100, ascend);
+  ASSERT_EQUAL(0, count);
+
+  lsm_destroy(&tree);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
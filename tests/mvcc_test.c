@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * mvcc_test.c - multi-version B+-tree unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/mvcc.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NKEYS   1000
+#define NWRITES (1 << 17)
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+struct mvcc_root root;
+uintptr_t        sum;
+size_t           count;
+uintptr_t        seen[NKEYS+1];
+bool             done;
+
+void add(const void *restrict key, void *restrict value) {
+  (void)key;
+  sum += (uintptr_t)value, ++count;
+}
+
+void record(const void *restrict key, void *restrict value) { seen[(uintptr_t)key] = (uintptr_t)value; }
+
+CTEST(mvcc_test, mvcc_snapshot_test) {
+  struct mvcc_snapshot snapshot;
+
+  mvcc_init(&root, 4, less);
+
+  for (uintptr_t key = 1; key <= 100; ++key)
+    ASSERT_TRUE(mvcc_insert(&root, (void *)key, (void *)key));
+  ASSERT_FALSE(mvcc_insert(&root, (void *)50, (void *)50));
+
+  mvcc_snapshot(&root, &snapshot);
+
+  for (uintptr_t key = 2; key <= 100; key += 2)
+    ASSERT_EQUAL_U(key, (uintptr_t)mvcc_erase(&root, (void *)key));
+  for (uintptr_t key = 1; key <= 100; key += 2)
+    mvcc_replace(&root, (void *)key, (void *)(key*2));
+  for (uintptr_t key = 101; key <= 150; ++key)
+    ASSERT_TRUE(mvcc_insert(&root, (void *)key, (void *)key));
+
+  sum = count = 0;
+  mvcc_for_each(&root, &snapshot, add);
+  ASSERT_EQUAL_U(100, count);
+  ASSERT_EQUAL_U(5050, sum);
+
+  sum = count = 0;
+  mvcc_range_each(&root, &snapshot, (void *)30, (void *)76, add);
+  ASSERT_EQUAL_U(46, count);
+  ASSERT_EQUAL_U(2415, sum);
+
+  ASSERT_EQUAL_U(4, (uintptr_t)mvcc_snapshot_find(&root, &snapshot, (void *)4));
+  ASSERT_NULL(mvcc_find(&root, (void *)4));
+  ASSERT_EQUAL_U(6, (uintptr_t)mvcc_find(&root, (void *)3));
+  ASSERT_NULL(mvcc_snapshot_find(&root, &snapshot, (void *)120));
+  ASSERT_TRUE(mvcc_contains(&root, (void *)120));
+  ASSERT_EQUAL_U(100, mvcc_size(&root));
+
+  /* a tombstone is kept while the snapshot can see the element it erased */
+  ASSERT_EQUAL_U(0, mvcc_gc(&root));
+
+  mvcc_release(&root, &snapshot);
+  ASSERT_EQUAL_U(150, mvcc_gc(&root));
+  ASSERT_EQUAL_U(0, mvcc_gc(&root));
+  ASSERT_EQUAL_U(100, bplus_size(root.tree.tree));
+
+  mvcc_snapshot(&root, &snapshot);
+  sum = count = 0;
+  mvcc_for_each(&root, &snapshot, add);
+  ASSERT_EQUAL_U(100, count);
+  ASSERT_EQUAL_U(2500*2+6275, sum);
+  mvcc_release(&root, &snapshot);
+
+  mvcc_destroy(&root);
+}
+
+/**
+ * writer - assigns i to key i%NKEYS+1 for each i in order
+ *
+ * @arg: unused
+ */
+void *writer(void *arg) {
+  (void)arg;
+  for (uintptr_t idx = 1; idx <= NWRITES; ++idx)
+    mvcc_replace(&root, (void *)(idx%NKEYS+1), (void *)idx);
+
+  __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+
+  return NULL;
+}
+
+CTEST(mvcc_test, mvcc_concurrent_test) {
+  pthread_t            thread;
+  struct mvcc_snapshot snapshot;
+  uintptr_t            last;
+  uintptr_t            expected;
+  size_t               scans = 0;
+
+  mvcc_init(&root, 8, less);
+  done = false;
+
+  pthread_create(&thread, NULL, writer, NULL);
+
+  while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE) || scans == 0) {
+    memset(seen, 0, sizeof(seen));
+
+    mvcc_snapshot(&root, &snapshot);
+    mvcc_for_each(&root, &snapshot, record);
+    mvcc_release(&root, &snapshot);
+    mvcc_gc(&root);
+
+    /* the snapshot must show the state right after some write, the one of the greatest value seen */
+    for (last = 0, expected = 1; expected <= NKEYS; ++expected)
+      if (last < seen[expected]) last = seen[expected];
+    for (uintptr_t key = 1; key <= NKEYS; ++key) {
+      expected = last < key-1 ? 0 : last - (last-key+1)%NKEYS; /* the greatest value up to last assigned to key */
+      ASSERT_EQUAL_U(expected, seen[key]);
+    }
+
+    ++scans;
+  }
+
+  pthread_join(thread, NULL);
+
+  ASSERT_EQUAL_U(NKEYS, mvcc_size(&root));
+  mvcc_gc(&root);
+  ASSERT_EQUAL_U(NKEYS, bplus_size(root.tree.tree));
+
+  mvcc_destroy(&root);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * pool_test.c - buffer pool unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/pool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PATH   "pool_test.db"
+#define PAGE   512
+#define FRAMES 4
+#define NPAGES 64
+
+CTEST(pool_test, pool_evict_test) {
+  struct pool pool;
+  uint64_t    *data;
+
+  remove(PATH);
+  ASSERT_TRUE(pool_open(&pool, PATH, PAGE, PAGE*FRAMES));
+
+  for (uint64_t page = 0; page < NPAGES; ++page) {
+    ASSERT_NOT_NULL(data = pool_create(&pool, page));
+    data[0] = page*page;
+    pool_unpin(&pool, data, true);
+  }
+
+  /* all but the resident pages have been written back on eviction */
+  ASSERT_EQUAL_U(NPAGES-FRAMES, pool.writes);
+
+  for (uint64_t page = 0; page < NPAGES; ++page) {
+    ASSERT_NOT_NULL(data = pool_fetch(&pool, page));
+    ASSERT_EQUAL_U(page*page, data[0]);
+    pool_unpin(&pool, data, false);
+  }
+
+  ASSERT_TRUE(pool_close(&pool));
+  ASSERT_TRUE(pool_open(&pool, PATH, PAGE, PAGE*FRAMES));
+
+  for (uint64_t page = NPAGES; 0 < page; --page) {
+    ASSERT_NOT_NULL(data = pool_fetch(&pool, page-1));
+    ASSERT_EQUAL_U((page-1)*(page-1), data[0]);
+    pool_unpin(&pool, data, false);
+  }
+  ASSERT_EQUAL_U(NPAGES, pool.reads);
+
+  /* a page past the end of the file reads as zeros */
+  ASSERT_NOT_NULL(data = pool_fetch(&pool, NPAGES*2));
+  ASSERT_EQUAL_U(0, data[0]);
+  pool_unpin(&pool, data, false);
+
+  ASSERT_TRUE(pool_close(&pool));
+  remove(PATH);
+}
+
+CTEST(pool_test, pool_pin_test) {
+  struct pool pool;
+  void        *pinned[FRAMES];
+  uint64_t    *data;
+
+  remove(PATH);
+  ASSERT_FALSE(pool_open(&pool, PATH, PAGE, PAGE));
+  ASSERT_FALSE(pool_open(&pool, PATH, PAGE+1, PAGE*FRAMES));
+  ASSERT_TRUE(pool_open(&pool, PATH, PAGE, PAGE*FRAMES));
+
+  for (uint64_t page = 0; page < FRAMES; ++page)
+    ASSERT_NOT_NULL(pinned[page] = pool_create(&pool, page));
+
+  /* no frame can be evicted while every page is pinned */
+  ASSERT_NULL(pool_fetch(&pool, FRAMES));
+
+  /* a resident page can be pinned more than once */
+  ASSERT_TRUE(pool_fetch(&pool, 0) == pinned[0]);
+  pool_unpin(&pool, pinned[0], false);
+
+  pool_unpin(&pool, pinned[1], true);
+  ASSERT_NOT_NULL(data = pool_fetch(&pool, FRAMES));
+  ASSERT_TRUE((void *)data == pinned[1]);
+  pool_unpin(&pool, data, false);
+
+  for (uint64_t page = 0; page < FRAMES; ++page)
+    if (page != 1) pool_unpin(&pool, pinned[page], false);
+
+  ASSERT_TRUE(pool_close(&pool));
+  remove(PATH);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -14,14 +14,76 @@
 
 #include <ctest.h>
 #include <index/rbtree.h>
+#include <index/serial.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#define NKEYS 256
+
 const uintptr_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
 
 bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
 
+struct memory {
+  unsigned char data[sizeof(uint64_t) + 2*(sizeof(uint64_t)+sizeof(uintptr_t))*NKEYS];
+  size_t        length;
+  size_t        offset;
+};
+
+bool sink(void *ctx, const void *restrict buf, const size_t size) {
+  struct memory *memory = ctx;
+
+  if (sizeof(memory->data) < memory->length + size) return false;
+  memcpy(memory->data + memory->length, buf, size);
+  memory->length += size;
+  return true;
+}
+
+bool source(void *ctx, void *restrict buf, const size_t size) {
+  struct memory *memory = ctx;
+
+  if (memory->length < memory->offset + size) return false;
+  memcpy(buf, memory->data + memory->offset, size);
+  memory->offset += size;
+  return true;
+}
+
+size_t encode(void *ctx, const void *item, void *restrict buf, const size_t capacity) {
+  (void)ctx;
+  if (sizeof(uintptr_t) <= capacity) memcpy(buf, &item, sizeof(uintptr_t));
+  return sizeof(uintptr_t);
+}
+
+bool decode(void *ctx, const void *restrict buf, const size_t length, void **restrict item) {
+  if (length != sizeof(uintptr_t)) return false;
+  memcpy(item, buf, sizeof(uintptr_t));
+  ++*(size_t *)ctx;
+  return true;
+}
+
+void release(void *ctx, void *item) {
+  (void)item;
+  --*(size_t *)ctx;
+}
+
+/**
+ * black_height - returns the black height of subtree rooted with @node, or -1 if it is not a red-black tree
+ *
+ * @node: root node of subtree
+ */
+int black_height(const struct rb_node *node) {
+  if (node == NULL) return 1;
+
+  const int lhs = black_height(node->left);
+  const int rhs = black_height(node->right);
+
+  if (lhs < 0 || lhs != rhs || (node->left != NULL && node->left->parent != node) || (node->right != NULL && node->right->parent != node) ||
+      (!node->black && ((node->left != NULL && !node->left->black) || (node->right != NULL && !node->right->black)))) return -1;
+
+  return lhs + node->black;
+}
+
 CTEST(rbtree_test, rb_find_test) {
   struct rb_root tree = rb_init(less);
 
@@ -102,4 +164,297 @@ CTEST(rbtree_test, rb_erase_reverse_test) {
   ASSERT_TRUE(rb_empty(tree));
 }
 
+CTEST(rbtree_test, rb_clone_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root clone = rb_init(less);
+  char           src[3];
+  char           dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    rb_insert(&tree, (void *)*it, (void *)*it);
+
+  rb_clone(&clone, tree);
+  rb_clear(&tree);
+
+  memset(dest, 0, sizeof(dest));
+  for (struct rb_iter iter = rb_iter_init(clone); !rb_iter_end(iter); rb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), rb_size(clone));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)rb_erase(&clone, (void *)*it));
+
+  ASSERT_TRUE(rb_empty(clone));
+}
+
+CTEST(rbtree_test, rb_split_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+  char           src[3];
+  char           dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    rb_insert(&tree, (void *)*it, (void *)*it);
+
+  rb_split(&tree, (void *)50, &other);
+  ASSERT_TRUE(0 <= black_height(tree.root) && (tree.root == NULL || tree.root->black));
+  ASSERT_TRUE(0 <= black_height(other.root) && (other.root == NULL || other.root->black));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct rb_iter iter = rb_iter_init(tree); !rb_iter_end(iter); rb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("10112022253033404449", dest);
+  ASSERT_EQUAL_U(10, rb_size(tree));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct rb_iter iter = rb_iter_init(other); !rb_iter_end(iter); rb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("50556066707780889099", dest);
+  ASSERT_EQUAL_U(10, rb_size(other));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)rb_erase(*it < 50 ? &tree : &other, (void *)*it));
+
+  ASSERT_TRUE(rb_empty(tree));
+  ASSERT_TRUE(rb_empty(other));
+}
+
+CTEST(rbtree_test, rb_split_found_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+
+  /* the children of the node split at are red, and must not stay red as roots */
+  rb_insert(&tree, (void *)2, (void *)2);
+  rb_insert(&tree, (void *)1, (void *)1);
+  rb_insert(&tree, (void *)3, (void *)3);
+
+  rb_split(&tree, (void *)2, &other);
+  ASSERT_TRUE(0 < black_height(tree.root) && tree.root->black);
+  ASSERT_TRUE(0 < black_height(other.root) && other.root->black);
+
+  rb_insert(&tree, (void *)0, (void *)0);
+  rb_insert(&other, (void *)4, (void *)4);
+  ASSERT_TRUE(0 < black_height(tree.root) && tree.root->black);
+  ASSERT_TRUE(0 < black_height(other.root) && other.root->black);
+
+  for (uintptr_t key = 0; key < 2; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)rb_erase(&tree, (void *)key));
+  for (uintptr_t key = 2; key < 5; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)rb_erase(&other, (void *)key));
+  ASSERT_TRUE(rb_empty(tree));
+  ASSERT_TRUE(rb_empty(other));
+
+  /* split at each existing key in turn, then grow and shrink both halves */
+  for (const uintptr_t *at = testcases; at < testcases + sizeof(testcases)/sizeof(uintptr_t); ++at) {
+    for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+      rb_insert(&tree, (void *)*it, (void *)*it);
+
+    rb_split(&tree, (void *)*at, &other);
+
+    for (uintptr_t key = 1; key < 10; ++key)
+      rb_insert(&tree, (void *)key, (void *)key);
+    for (uintptr_t key = 101; key < 110; ++key)
+      rb_insert(&other, (void *)key, (void *)key);
+    ASSERT_TRUE(0 < black_height(tree.root) && tree.root->black);
+    ASSERT_TRUE(0 < black_height(other.root) && other.root->black);
+
+    for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+      ASSERT_EQUAL_U(*it, (uintptr_t)rb_erase(*it < *at ? &tree : &other, (void *)*it));
+    for (uintptr_t key = 1; key < 10; ++key)
+      ASSERT_EQUAL_U(key, (uintptr_t)rb_erase(&tree, (void *)key));
+    for (uintptr_t key = 101; key < 110; ++key)
+      ASSERT_EQUAL_U(key, (uintptr_t)rb_erase(&other, (void *)key));
+    ASSERT_TRUE(rb_empty(tree));
+    ASSERT_TRUE(rb_empty(other));
+  }
+}
+
+CTEST(rbtree_test, rb_join_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+  char           src[3];
+  char           dest[41];
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    rb_insert(*it < 33 ? &other : &tree, (void *)*it, (void *)*it);
+
+  rb_insert(&other, (void *)77, NULL);
+  ASSERT_FALSE(rb_join(&tree, &other));
+  rb_erase(&other, (void *)77);
+
+  ASSERT_TRUE(rb_join(&tree, &other));
+  ASSERT_TRUE(rb_empty(other));
+  ASSERT_TRUE(0 <= black_height(tree.root) && (tree.root == NULL || tree.root->black));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct rb_iter iter = rb_iter_init(tree); !rb_iter_end(iter); rb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), rb_size(tree));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)rb_erase(&tree, (void *)*it));
+
+  ASSERT_TRUE(rb_empty(tree));
+}
+
+CTEST(rbtree_test, rb_split_join_balance_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    rb_insert(&tree, (void *)key, (void *)key);
+
+  /* the halves of each cut and their concatenation stay balanced, whichever of them is the taller */
+  for (uintptr_t key = 1; key <= NKEYS+1; key += 7) {
+    rb_split(&tree, (void *)key, &other);
+    ASSERT_EQUAL_U(key-1, rb_size(tree));
+    ASSERT_EQUAL_U(NKEYS+1-key, rb_size(other));
+    ASSERT_TRUE(0 <= black_height(tree.root) && (tree.root == NULL || tree.root->black));
+    ASSERT_TRUE(0 <= black_height(other.root) && (other.root == NULL || other.root->black));
+
+    ASSERT_TRUE(rb_join(&tree, &other));
+    ASSERT_EQUAL_U(NKEYS, rb_size(tree));
+    ASSERT_TRUE(0 <= black_height(tree.root) && (tree.root == NULL || tree.root->black));
+  }
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)rb_erase(&tree, (void *)key));
+
+  ASSERT_TRUE(rb_empty(tree));
+}
+
+CTEST(rbtree_test, rb_union_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+  uintptr_t       prev  = 0;
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2) rb_insert(&tree, (void *)key, (void *)key);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3) rb_insert(&other, (void *)key, NULL);
+
+  rb_union(&tree, &other);
+  ASSERT_TRUE(rb_empty(other));
+  ASSERT_EQUAL_U((1<<15) + (1<<16)/3 - (1<<16)/6, rb_size(tree));
+
+  for (struct rb_iter iter = rb_iter_init(tree); !rb_iter_end(iter); rb_iter_next(&iter)) {
+    ASSERT_TRUE(prev < (uintptr_t)iter.key);
+    ASSERT_TRUE((uintptr_t)iter.key % 2 == 0 || (uintptr_t)iter.key % 3 == 0);
+    ASSERT_TRUE((uintptr_t)iter.key % 2 == 0 ? iter.value == iter.key : iter.value == NULL);
+    prev = (uintptr_t)iter.key;
+  }
+
+  rb_clear(&tree);
+}
+
+CTEST(rbtree_test, rb_intersection_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+  size_t          size  = 0;
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2) rb_insert(&tree, (void *)key, (void *)key);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3) rb_insert(&other, (void *)key, NULL);
+
+  rb_intersection(&tree, &other);
+  ASSERT_TRUE(rb_empty(other));
+  ASSERT_EQUAL_U((1<<16)/6, rb_size(tree));
+
+  for (struct rb_iter iter = rb_iter_init(tree); !rb_iter_end(iter); rb_iter_next(&iter), ++size)
+    ASSERT_EQUAL_U(6*(size+1), (uintptr_t)iter.value);
+
+  rb_clear(&tree);
+}
+
+CTEST(rbtree_test, rb_difference_test) {
+  struct rb_root tree  = rb_init(less);
+  struct rb_root other = rb_init(less);
+  size_t          size  = 0;
+
+  for (uintptr_t key = 2; key <= 1<<16; key += 2) rb_insert(&tree, (void *)key, (void *)key);
+  for (uintptr_t key = 3; key <= 1<<16; key += 3) rb_insert(&other, (void *)key, NULL);
+
+  rb_difference(&tree, &other);
+  ASSERT_TRUE(rb_empty(other));
+  ASSERT_EQUAL_U((1<<15) - (1<<16)/6, rb_size(tree));
+
+  for (struct rb_iter iter = rb_iter_init(tree); !rb_iter_end(iter); rb_iter_next(&iter), ++size)
+    ASSERT_EQUAL_U(6*(size/2) + (size%2 == 0 ? 2 : 4), (uintptr_t)iter.value);
+
+  for (uintptr_t key = 6; key <= 1<<16; key += 6) ASSERT_NULL(rb_erase(&tree, (void *)key));
+  rb_clear(&tree);
+}
+
+CTEST(rbtree_test, rb_dump_test) {
+  struct rb_root       tree  = rb_init(less);
+  struct rb_root       other = rb_init(less);
+  char                 src[3];
+  char                 dest[41];
+  struct memory        memory = {.length = 0};
+  struct serial_stream stream = {sink, source, &memory};
+  size_t               live   = 0;
+  struct bplus_codec   codec  = {.record = encode, .decode = decode, .release = release, .ctx = &live};
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    rb_insert(&tree, (void *)*it, (void *)*it);
+
+  ASSERT_TRUE(rb_dump(tree, &stream, &codec, &codec));
+  ASSERT_EQUAL_U(sizeof(uint64_t) + 2*(sizeof(uint64_t)+sizeof(uintptr_t))*sizeof(testcases)/sizeof(uintptr_t), memory.length);
+  rb_clear(&tree);
+
+  memory.offset = 0;
+  ASSERT_TRUE(rb_restore(&other, &stream, &codec, &codec));
+  ASSERT_TRUE(0 < black_height(other.root) && (other.root == NULL || other.root->black));
+
+  memset(dest, 0, sizeof(dest));
+  for (struct rb_iter iter = rb_iter_init(other); !rb_iter_end(iter); rb_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), rb_size(other));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)rb_erase(&other, (void *)*it));
+  ASSERT_TRUE(rb_empty(other));
+
+  /* the restored tree is balanced for any number of entries */
+  for (uintptr_t nmemb = 0; nmemb < NKEYS; ++nmemb) {
+    rb_insert(&tree, (void *)(nmemb+1), (void *)(nmemb+1));
+
+    memory.length = 0;
+    ASSERT_TRUE(rb_dump(tree, &stream, &codec, &codec));
+    memory.offset = 0;
+    ASSERT_TRUE(rb_restore(&other, &stream, &codec, &codec));
+    ASSERT_TRUE(0 < black_height(other.root) && (other.root == NULL || other.root->black));
+    ASSERT_EQUAL_U(nmemb+1, rb_size(other));
+
+    for (uintptr_t key = 1; key <= nmemb+1; ++key)
+      ASSERT_EQUAL_U(key, (uintptr_t)rb_erase(&other, (void *)key));
+    ASSERT_TRUE(rb_empty(other));
+  }
+
+  /* a non-empty tree is left as it is */
+  memory.offset = 0;
+  ASSERT_FALSE(rb_restore(&tree, &stream, &codec, &codec));
+  ASSERT_EQUAL_U(NKEYS, rb_size(tree));
+
+  /* a truncated dump leaves the tree empty, and releases the keys and values read */
+  live           = 0;
+  memory.length -= sizeof(uintptr_t);
+  memory.offset  = 0;
+  ASSERT_FALSE(rb_restore(&other, &stream, &codec, &codec));
+  ASSERT_TRUE(rb_empty(other));
+  ASSERT_EQUAL_U(0, live);
+
+  rb_clear(&tree);
+}
+
 int main(int argc, const char **argv) { return ctest_main(argc, argv); }
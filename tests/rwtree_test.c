@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * rwtree_test.c - reader/writer-locked tree unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/rwtree.h>
+#include <stdint.h>
+
+#define NTHREADS 4
+#define NKEYS    4096
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+uintptr_t sum;
+
+void add(const void *restrict key, void *restrict value) {
+  (void)key;
+  sum += (uintptr_t)value;
+}
+
+/**
+ * struct worker - a thread working on one of the trees
+ *
+ * @tree:   the tree to work on
+ * @kind:   the kind of @tree
+ * @base:   the first key to insert
+ * @misses: the number of the keys inserted by the other workers but not found
+ */
+struct worker {
+  void      *tree;
+  int       kind;
+  uintptr_t base;
+  size_t    misses;
+};
+
+bool insert(const struct worker *restrict worker, const uintptr_t key) {
+  switch (worker->kind) {
+    case 0:  return avl_rw_insert(worker->tree, (void *)key, (void *)key);
+    case 1:  return rb_rw_insert(worker->tree, (void *)key, (void *)key);
+    case 2:  return llrb_rw_insert(worker->tree, (void *)key, (void *)key);
+    case 3:  return btree_rw_insert(worker->tree, (void *)key, (void *)key);
+    default: return bplus_rw_insert(worker->tree, (void *)key, (void *)key);
+  }
+}
+
+void *find(const struct worker *restrict worker, const uintptr_t key) {
+  switch (worker->kind) {
+    case 0:  return avl_rw_find(worker->tree, (void *)key);
+    case 1:  return rb_rw_find(worker->tree, (void *)key);
+    case 2:  return llrb_rw_find(worker->tree, (void *)key);
+    case 3:  return btree_rw_find(worker->tree, (void *)key);
+    default: return bplus_rw_find(worker->tree, (void *)key);
+  }
+}
+
+void *work(void *arg) {
+  struct worker *worker = arg;
+
+  for (uintptr_t key = worker->base; key < worker->base + NKEYS; ++key)
+    if (!insert(worker, key))
+      ++worker->misses;
+
+  for (uintptr_t key = worker->base; key < worker->base + NKEYS; ++key)
+    if (find(worker, key) != (void *)key)
+      ++worker->misses;
+
+  return NULL;
+}
+
+void run(void *tree, const int kind) {
+  pthread_t     threads[NTHREADS];
+  struct worker workers[NTHREADS];
+
+  for (int idx = 0; idx < NTHREADS; ++idx) {
+    workers[idx] = (struct worker){ .tree = tree, .kind = kind, .base = 1 + idx*NKEYS, .misses = 0 };
+    pthread_create(&threads[idx], NULL, work, &workers[idx]);
+  }
+
+  for (int idx = 0; idx < NTHREADS; ++idx) {
+    pthread_join(threads[idx], NULL);
+    ASSERT_EQUAL_U(0, workers[idx].misses);
+  }
+}
+
+CTEST(rwtree_test, avl_rw_test) {
+  struct avl_rw_root tree;
+
+  avl_rw_init(&tree, less);
+  run(&tree, 0);
+
+  ASSERT_EQUAL_U(NTHREADS*NKEYS, avl_rw_size(&tree));
+  ASSERT_FALSE(avl_rw_insert(&tree, (void *)1, NULL));
+  ASSERT_TRUE(avl_rw_contains(&tree, (void *)NKEYS));
+  ASSERT_FALSE(avl_rw_contains(&tree, (void *)(NTHREADS*NKEYS+1)));
+
+  sum = 0;
+  avl_rw_for_each(&tree, add);
+  ASSERT_EQUAL_U((uintptr_t)NTHREADS*NKEYS*(NTHREADS*NKEYS+1)/2, sum);
+
+  ASSERT_EQUAL_U(1, (uintptr_t)avl_rw_erase(&tree, (void *)1));
+  ASSERT_NULL(avl_rw_find(&tree, (void *)1));
+  avl_rw_destroy(&tree);
+}
+
+CTEST(rwtree_test, rb_rw_test) {
+  struct rb_rw_root tree;
+
+  rb_rw_init(&tree, less);
+  run(&tree, 1);
+
+  ASSERT_EQUAL_U(NTHREADS*NKEYS, rb_rw_size(&tree));
+  ASSERT_FALSE(rb_rw_insert(&tree, (void *)1, NULL));
+  ASSERT_TRUE(rb_rw_contains(&tree, (void *)NKEYS));
+  ASSERT_FALSE(rb_rw_contains(&tree, (void *)(NTHREADS*NKEYS+1)));
+
+  sum = 0;
+  rb_rw_for_each(&tree, add);
+  ASSERT_EQUAL_U((uintptr_t)NTHREADS*NKEYS*(NTHREADS*NKEYS+1)/2, sum);
+
+  ASSERT_EQUAL_U(1, (uintptr_t)rb_rw_erase(&tree, (void *)1));
+  ASSERT_NULL(rb_rw_find(&tree, (void *)1));
+  rb_rw_destroy(&tree);
+}
+
+CTEST(rwtree_test, llrb_rw_test) {
+  struct llrb_rw_root tree;
+
+  llrb_rw_init(&tree, less);
+  run(&tree, 2);
+
+  ASSERT_EQUAL_U(NTHREADS*NKEYS, llrb_rw_size(&tree));
+  ASSERT_FALSE(llrb_rw_insert(&tree, (void *)1, NULL));
+  ASSERT_TRUE(llrb_rw_contains(&tree, (void *)NKEYS));
+  ASSERT_FALSE(llrb_rw_contains(&tree, (void *)(NTHREADS*NKEYS+1)));
+
+  sum = 0;
+  llrb_rw_for_each(&tree, add);
+  ASSERT_EQUAL_U((uintptr_t)NTHREADS*NKEYS*(NTHREADS*NKEYS+1)/2, sum);
+
+  ASSERT_EQUAL_U(1, (uintptr_t)llrb_rw_erase(&tree, (void *)1));
+  ASSERT_NULL(llrb_rw_find(&tree, (void *)1));
+  llrb_rw_destroy(&tree);
+}
+
+CTEST(rwtree_test, btree_rw_test) {
+  struct btree_rw_root tree;
+
+  btree_rw_init(&tree, 4, less);
+  run(&tree, 3);
+
+  ASSERT_EQUAL_U(NTHREADS*NKEYS, btree_rw_size(&tree));
+  ASSERT_FALSE(btree_rw_insert(&tree, (void *)1, NULL));
+  ASSERT_TRUE(btree_rw_contains(&tree, (void *)NKEYS));
+  ASSERT_FALSE(btree_rw_contains(&tree, (void *)(NTHREADS*NKEYS+1)));
+
+  sum = 0;
+  btree_rw_for_each(&tree, add);
+  ASSERT_EQUAL_U((uintptr_t)NTHREADS*NKEYS*(NTHREADS*NKEYS+1)/2, sum);
+
+  ASSERT_EQUAL_U(1, (uintptr_t)btree_rw_erase(&tree, (void *)1));
+  ASSERT_NULL(btree_rw_find(&tree, (void *)1));
+  btree_rw_destroy(&tree);
+}
+
+CTEST(rwtree_test, bplus_rw_test) {
+  struct bplus_rw_root tree;
+
+  bplus_rw_init(&tree, 4, less);
+  run(&tree, 4);
+
+  ASSERT_EQUAL_U(NTHREADS*NKEYS, bplus_rw_size(&tree));
+  ASSERT_FALSE(bplus_rw_insert(&tree, (void *)1, NULL));
+  ASSERT_TRUE(bplus_rw_contains(&tree, (void *)NKEYS));
+  ASSERT_FALSE(bplus_rw_contains(&tree, (void *)(NTHREADS*NKEYS+1)));
+
+  sum = 0;
+  bplus_rw_for_each(&tree, add);
+  ASSERT_EQUAL_U((uintptr_t)NTHREADS*NKEYS*(NTHREADS*NKEYS+1)/2, sum);
+
+  ASSERT_EQUAL_U(1, (uintptr_t)bplus_rw_erase(&tree, (void *)1));
+  ASSERT_NULL(bplus_rw_find(&tree, (void *)1));
+  bplus_rw_destroy(&tree);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * shard_test.c - range-partitioned sharded index unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/shard.h>
+#include <sched.h>
+#include <stdint.h>
+
+#define NTHREADS 4
+#define NKEYS    4096
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+const void *bounds[] = {(void *)1024, (void *)2048, (void *)3072};
+
+uintptr_t sum;
+uintptr_t prev;
+size_t    unordered;
+
+void add(const void *restrict key, void *restrict value) {
+  if ((uintptr_t)key <= prev) ++unordered;
+  prev  = (uintptr_t)key;
+  sum  += (uintptr_t)value;
+}
+
+CTEST(shard_test, shard_range_each_test) {
+  struct shard_root root;
+  shard_init(&root, 4, bounds, 5, less);
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_TRUE(shard_insert(&root, (void *)key, (void *)key));
+  ASSERT_FALSE(shard_insert(&root, (void *)NKEYS, NULL));
+  ASSERT_EQUAL_U(NKEYS, shard_size(&root));
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)shard_find(&root, (void *)key));
+
+  sum = prev = unordered = 0;
+  shard_range_each(&root, (void *)1000, (void *)3100, add);
+  ASSERT_EQUAL_U((1000+3099)*2100/2, sum);
+  ASSERT_EQUAL_U(0, unordered);
+
+  for (uintptr_t key = 1; key <= NKEYS; key += 2)
+    ASSERT_EQUAL_U(key, (uintptr_t)shard_erase(&root, (void *)key));
+  ASSERT_NULL(shard_erase(&root, (void *)1));
+
+  sum = prev = unordered = 0;
+  shard_for_each(&root, add);
+  ASSERT_EQUAL_U(NKEYS/2*(NKEYS/2+1), sum);
+  ASSERT_EQUAL_U(0, unordered);
+
+  shard_destroy(&root);
+}
+
+CTEST(shard_test, shard_rebalance_test) {
+  struct shard_root root;
+  shard_init(&root, 4, bounds, 5, less);
+
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    shard_insert(&root, (void *)key, (void *)key);
+  ASSERT_EQUAL_U(0, shard_rebalance(&root));
+
+  for (uintptr_t key = 1; key < 1024; ++key)
+    shard_replace(&root, (void *)key, (void *)key);
+  ASSERT_EQUAL_U(1023>>2, shard_rebalance(&root));
+  ASSERT_EQUAL_U(1024-(1023>>2), (uintptr_t)root.shards[0].sup);
+  ASSERT_EQUAL_U(1024-(1023>>2), (uintptr_t)root.shards[1].inf);
+  ASSERT_EQUAL_U(0, shard_rebalance(&root));
+
+  for (uintptr_t key = 3072; key <= NKEYS; ++key)
+    shard_replace(&root, (void *)key, (void *)key);
+  ASSERT_EQUAL_U(1025>>2, shard_rebalance(&root));
+  ASSERT_EQUAL_U(3072+(1025>>2), (uintptr_t)root.shards[2].sup);
+
+  ASSERT_EQUAL_U(NKEYS, shard_size(&root));
+  for (uintptr_t key = 1; key <= NKEYS; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)shard_find(&root, (void *)key));
+
+  sum = prev = unordered = 0;
+  shard_for_each(&root, add);
+  ASSERT_EQUAL_U(NKEYS*(NKEYS+1)/2, sum);
+  ASSERT_EQUAL_U(0, unordered);
+
+  shard_destroy(&root);
+}
+
+struct shard_root shared;
+bool              done;
+
+void *sweep(void *arg) {
+  const uintptr_t base = (uintptr_t)arg;
+
+  /* all writers sweep the key space together, so that one shard after another grows hot */
+  for (uintptr_t key = base; key <= NTHREADS*NKEYS; key += NTHREADS)
+    shard_insert(&shared, (void *)key, (void *)key);
+
+  return NULL;
+}
+
+void *balance(void *arg) {
+  size_t *moved = arg;
+
+  while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+    *moved += shard_rebalance(&shared);
+    sched_yield();
+  }
+
+  return NULL;
+}
+
+CTEST(shard_test, shard_concurrent_test) {
+  pthread_t   writers[NTHREADS];
+  pthread_t   rebalancer;
+  size_t      moved = 0;
+  const void *quarters[] = {(void *)NKEYS, (void *)(2*NKEYS), (void *)(3*NKEYS)};
+
+  shard_init(&shared, 4, quarters, 5, less);
+
+  pthread_create(&rebalancer, NULL, balance, &moved);
+  for (uintptr_t idx = 0; idx < NTHREADS; ++idx)
+    pthread_create(&writers[idx], NULL, sweep, (void *)(idx+1));
+  for (size_t idx = 0; idx < NTHREADS; ++idx)
+    pthread_join(writers[idx], NULL);
+  __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+  pthread_join(rebalancer, NULL);
+
+  ASSERT_EQUAL_U(NTHREADS*NKEYS, shard_size(&shared));
+  for (uintptr_t key = 1; key <= NTHREADS*NKEYS; ++key)
+    ASSERT_TRUE(shard_contains(&shared, (void *)key));
+
+  sum = prev = unordered = 0;
+  shard_for_each(&shared, add);
+  ASSERT_EQUAL_U(NTHREADS*NKEYS*(NTHREADS*NKEYS+1)/2, sum);
+  ASSERT_EQUAL_U(0, unordered);
+
+  shard_destroy(&shared);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
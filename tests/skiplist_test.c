@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * skiplist_test.c - generic lock-free skip list unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/skiplist.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NTHREADS 4
+#define NKEYS    4096
+#define NWRITES  (1 << 16)
+
+const uintptr_t testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+struct epoch_root epoch;
+struct skip_root  list;
+
+CTEST(skiplist_test, skip_find_test) {
+  struct epoch_thread thread;
+
+  epoch_init(&epoch);
+  epoch_register(&epoch, &thread);
+  skip_init(&list, less, &epoch);
+  epoch_enter(&epoch, &thread);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    skip_insert(&list, (void *)*it, (void *)*it);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)skip_find(&list, (void *)*it).value);
+
+  ASSERT_TRUE(skip_iter_end(skip_find(&list, (void *)12)));
+  ASSERT_FALSE(skip_contains(&list, (void *)100));
+
+  epoch_exit(&thread);
+  skip_destroy(&list);
+  epoch_unregister(&epoch, &thread);
+  epoch_destroy(&epoch);
+}
+
+CTEST(skiplist_test, skip_insert_test) {
+  struct epoch_thread thread;
+  char                src[3];
+  char                dest[41];
+
+  epoch_init(&epoch);
+  epoch_register(&epoch, &thread);
+  skip_init(&list, less, &epoch);
+  epoch_enter(&epoch, &thread);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)skip_insert(&list, (void *)*it, NULL).key);
+
+  ASSERT_NULL(skip_insert(&list, (void *)40, (void *)40).value);
+
+  memset(dest, 0, sizeof(dest));
+  for (struct skip_iter iter = skip_iter_init(&list); !skip_iter_end(iter); skip_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("1011202225303340444950556066707780889099", dest);
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), skip_size(&list));
+
+  epoch_exit(&thread);
+  skip_clear(&list);
+  ASSERT_TRUE(skip_empty(&list));
+
+  skip_destroy(&list);
+  epoch_unregister(&epoch, &thread);
+  epoch_destroy(&epoch);
+}
+
+CTEST(skiplist_test, skip_replace_test) {
+  struct epoch_thread thread;
+
+  epoch_init(&epoch);
+  epoch_register(&epoch, &thread);
+  skip_init(&list, less, &epoch);
+  epoch_enter(&epoch, &thread);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_NULL(skip_replace(&list, (void *)*it, NULL).value);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)skip_replace(&list, (void *)*it, (void *)*it).value);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)skip_find(&list, (void *)*it).value);
+
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), skip_size(&list));
+
+  epoch_exit(&thread);
+  skip_destroy(&list);
+  epoch_unregister(&epoch, &thread);
+  epoch_destroy(&epoch);
+}
+
+CTEST(skiplist_test, skip_erase_test) {
+  struct epoch_thread thread;
+
+  epoch_init(&epoch);
+  epoch_register(&epoch, &thread);
+  skip_init(&list, less, &epoch);
+  epoch_enter(&epoch, &thread);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    skip_insert(&list, (void *)*it, (void *)*it);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it) {
+    ASSERT_EQUAL_U(*it, (uintptr_t)skip_erase(&list, (void *)*it));
+    ASSERT_NULL(skip_erase(&list, (void *)*it));
+  }
+
+  ASSERT_TRUE(skip_empty(&list));
+  ASSERT_TRUE(skip_iter_end(skip_iter_init(&list)));
+  ASSERT_TRUE(skip_reverse_iter_end(skip_reverse_iter_init(&list)));
+
+  epoch_exit(&thread);
+  skip_destroy(&list);
+  epoch_unregister(&epoch, &thread);
+  epoch_destroy(&epoch);
+}
+
+CTEST(skiplist_test, skip_reverse_iter_test) {
+  struct epoch_thread      thread;
+  struct skip_reverse_iter iter;
+  char                     src[3];
+  char                     dest[41];
+
+  epoch_init(&epoch);
+  epoch_register(&epoch, &thread);
+  skip_init(&list, less, &epoch);
+  epoch_enter(&epoch, &thread);
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    skip_insert(&list, (void *)*it, (void *)*it);
+
+  memset(dest, 0, sizeof(dest));
+  for (iter = skip_reverse_iter_init(&list); !skip_reverse_iter_end(iter); skip_reverse_iter_next(&iter)) {
+    sprintf(src, "%" PRIuPTR, (uintptr_t)iter.key);
+    strcat(dest, src);
+  }
+  ASSERT_STR("9990888077706660555049444033302522201110", dest);
+
+  iter = skip_reverse_iter_init(&list);
+  skip_reverse_iter_next(&iter);
+  ASSERT_EQUAL_U(90, (uintptr_t)iter.key);
+  skip_reverse_iter_prev(&iter);
+  ASSERT_EQUAL_U(99, (uintptr_t)iter.key);
+
+  struct skip_iter forward = skip_find(&list, (void *)44);
+  skip_iter_prev(&forward);
+  ASSERT_EQUAL_U(40, (uintptr_t)forward.value);
+  skip_iter_next(&forward);
+  skip_iter_next(&forward);
+  ASSERT_EQUAL_U(49, (uintptr_t)forward.value);
+
+  epoch_exit(&thread);
+  skip_destroy(&list);
+  epoch_unregister(&epoch, &thread);
+  epoch_destroy(&epoch);
+}
+
+/**
+ * writer - inserts and erases random keys, of which the ones congruent to @arg modulo NTHREADS are its own
+ *
+ * @arg: the index of the thread
+ *
+ * Returns the number of the own keys whose presence differs from what the thread has done to them.
+ */
+void *writer(void *arg) {
+  struct epoch_thread thread;
+  bool                present[NKEYS/NTHREADS] = {false};
+  uintptr_t           seed                    = (uintptr_t)arg + 1;
+  uintptr_t           errors                  = 0;
+
+  epoch_register(&epoch, &thread);
+
+  for (size_t idx = 0; idx < NWRITES; ++idx) {
+    seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+
+    const uintptr_t shared = (seed >> 33) % NKEYS;
+    const uintptr_t own    = ((seed >> 20) % (NKEYS/NTHREADS))*NTHREADS + (uintptr_t)arg;
+
+    epoch_enter(&epoch, &thread);
+
+    /* the shared keys above NKEYS are inserted and erased by all threads at once */
+    if (seed >> 63) skip_insert(&list, (void *)(NKEYS + shared), (void *)shared);
+    else            skip_erase(&list, (void *)(NKEYS + shared));
+
+    if (present[own/NTHREADS]) errors += skip_erase(&list, (void *)own) != (void *)own;
+    else                       errors += !skip_iter_end(skip_find(&list, (void *)own)) || skip_insert(&list, (void *)own, (void *)own).value != (void *)own;
+    present[own/NTHREADS] = !present[own/NTHREADS];
+
+    epoch_exit(&thread);
+  }
+
+  epoch_enter(&epoch, &thread);
+  for (uintptr_t key = 0; key < NKEYS/NTHREADS; ++key)
+    errors += present[key] != skip_contains(&list, (void *)(key*NTHREADS + (uintptr_t)arg));
+  epoch_exit(&thread);
+
+  epoch_unregister(&epoch, &thread);
+
+  return (void *)errors;
+}
+
+CTEST(skiplist_test, skip_concurrent_test) {
+  pthread_t           threads[NTHREADS];
+  struct epoch_thread thread;
+  void                *errors;
+  size_t              count = 0;
+
+  epoch_init(&epoch);
+  skip_init(&list, less, &epoch);
+
+  for (uintptr_t idx = 0; idx < NTHREADS; ++idx)
+    pthread_create(&threads[idx], NULL, writer, (void *)idx);
+
+  for (size_t idx = 0; idx < NTHREADS; ++idx) {
+    pthread_join(threads[idx], &errors);
+    ASSERT_NULL(errors);
+  }
+
+  epoch_register(&epoch, &thread);
+  epoch_enter(&epoch, &thread);
+
+  for (struct skip_iter iter = skip_iter_init(&list), prev = iter; !skip_iter_end(iter); prev = iter, skip_iter_next(&iter), ++count)
+    if (prev.pivot != iter.pivot)
+      ASSERT_TRUE(less(prev.key, iter.key));
+  ASSERT_EQUAL_U(count, skip_size(&list));
+
+  epoch_exit(&thread);
+  epoch_unregister(&epoch, &thread);
+
+  skip_destroy(&list);
+  epoch_destroy(&epoch);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+/*
+ * Copyright (C) 2020-2022 9rum
+ *
+ * wal_test.c - write-ahead logged B+-tree unit test
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#define CTEST_MAIN
+#define CTEST_SEGFAULT
+#define CTEST_COLOR_OK
+
+#include <ctest.h>
+#include <index/wal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define IMAGE    "wal_test.img"
+#define LOG      "wal_test.log"
+#define NAME     16
+#define NTHREADS 4
+#define NWRITES  1024
+
+const uintptr_t         testcases[] = {40, 11, 77, 33, 20, 90, 99, 70, 88, 80, 66, 10, 22, 30, 44, 55, 50, 60, 25, 49};
+const struct wal_policy every       = {.interval = 0, .bytes = 0};
+      struct wal_root   root;
+
+bool less(const void *restrict lhs, const void *restrict rhs) { return (uintptr_t)lhs < (uintptr_t)rhs; }
+
+bool strless(const void *restrict lhs, const void *restrict rhs) { return strcmp(lhs, rhs) < 0; }
+
+void encode(void *restrict dst, const void *restrict src) { strncpy(dst, src, NAME); }
+
+/**
+ * length - returns the length of the file at @path
+ *
+ * @path: the path of the file
+ */
+size_t length(const char *restrict path) {
+  struct stat status;
+  return stat(path, &status) == 0 ? (size_t)status.st_size : 0;
+}
+
+CTEST(wal_test, wal_replay_test) {
+  void *value;
+
+  remove(IMAGE);
+  remove(LOG);
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_TRUE(wal_insert(&root, (void *)*it, (void *)*it));
+  ASSERT_FALSE(wal_insert(&root, (void *)40, (void *)41));
+  ASSERT_TRUE(wal_insert_or_assign(&root, (void *)40, (void *)41));
+  ASSERT_TRUE(wal_erase(&root, (void *)11, &value));
+  ASSERT_EQUAL_U(11, (uintptr_t)value);
+  ASSERT_FALSE(wal_erase(&root, (void *)11, NULL));
+
+  /* closing without a checkpoint leaves everything to the log */
+  ASSERT_TRUE(wal_close(&root));
+  ASSERT_EQUAL_U(0, length(IMAGE));
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)-1, wal_size(&root));
+  ASSERT_EQUAL_U(41, (uintptr_t)wal_find(&root, (void *)40));
+  ASSERT_FALSE(wal_contains(&root, (void *)11));
+  for (const uintptr_t *it = testcases+2; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_EQUAL_U(*it, (uintptr_t)wal_find(&root, (void *)*it));
+
+  ASSERT_TRUE(wal_checkpoint(&root));
+  ASSERT_EQUAL_U(0, length(LOG));
+  ASSERT_TRUE(wal_erase(&root, (void *)99, NULL));
+  ASSERT_TRUE(wal_insert(&root, (void *)11, (void *)12));
+  ASSERT_TRUE(wal_close(&root));
+
+  /* the image holds the state of the checkpoint, and the log the writes after it */
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)-1, wal_size(&root));
+  ASSERT_EQUAL_U(12, (uintptr_t)wal_find(&root, (void *)11));
+  ASSERT_EQUAL_U(41, (uintptr_t)wal_find(&root, (void *)40));
+  ASSERT_FALSE(wal_contains(&root, (void *)99));
+  ASSERT_TRUE(wal_close(&root));
+
+  remove(IMAGE);
+  remove(LOG);
+}
+
+CTEST(wal_test, wal_torn_test) {
+  FILE   *file;
+  size_t intact;
+
+  remove(IMAGE);
+  remove(LOG);
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+  for (const uintptr_t *it = testcases; it < testcases + sizeof(testcases)/sizeof(uintptr_t); ++it)
+    ASSERT_TRUE(wal_insert(&root, (void *)*it, (void *)*it));
+  ASSERT_TRUE(wal_close(&root));
+
+  /* a crash in the middle of a write leaves a torn record behind */
+  intact = length(LOG);
+  ASSERT_NOT_NULL(file = fopen(LOG, "ab"));
+  fwrite("\x20\0\0\0torn", 1, 8, file);
+  fclose(file);
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t), wal_size(&root));
+  ASSERT_EQUAL_U(intact, length(LOG));
+  ASSERT_TRUE(wal_insert(&root, (void *)100, (void *)100));
+  ASSERT_TRUE(wal_close(&root));
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+  ASSERT_EQUAL_U(sizeof(testcases)/sizeof(uintptr_t)+1, wal_size(&root));
+  ASSERT_TRUE(wal_close(&root));
+
+  remove(IMAGE);
+  remove(LOG);
+}
+
+CTEST(wal_test, wal_policy_test) {
+  const struct wal_policy interval = {.interval = 5, .bytes = 0};
+  const struct wal_policy bytes    = {.interval = 0, .bytes = 256};
+
+  remove(IMAGE);
+  remove(LOG);
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, bytes));
+  for (uintptr_t key = 1; key <= NWRITES; ++key)
+    ASSERT_TRUE(wal_insert(&root, (void *)key, (void *)key));
+
+  /* the log is synchronized once per 256 bytes rather than once per write */
+  ASSERT_TRUE(root.log.syncs < NWRITES/4);
+  ASSERT_TRUE(wal_close(&root));
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, interval));
+  ASSERT_EQUAL_U(NWRITES, wal_size(&root));
+  for (uintptr_t key = 1; key <= NWRITES; key += 2)
+    ASSERT_TRUE(wal_erase(&root, (void *)key, NULL));
+  ASSERT_TRUE(wal_sync(&root));
+  ASSERT_TRUE(wal_close(&root));
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 4, less, NULL, NULL, every));
+  ASSERT_EQUAL_U(NWRITES/2, wal_size(&root));
+  ASSERT_FALSE(wal_contains(&root, (void *)1));
+  ASSERT_TRUE(wal_contains(&root, (void *)2));
+  ASSERT_TRUE(wal_close(&root));
+
+  remove(IMAGE);
+  remove(LOG);
+}
+
+CTEST(wal_test, wal_codec_test) {
+  const struct bplus_codec codec   = {.size = NAME, .encode = encode};
+  const char               *names[] = {"kiwi", "apple", "mango", "cherry", "banana", "grape", "lemon", "peach", "fig", "plum"};
+
+  remove(IMAGE);
+  remove(LOG);
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 3, strless, &codec, NULL, every));
+  for (size_t idx = 0; idx < sizeof(names)/sizeof(char *)/2; ++idx)
+    ASSERT_TRUE(wal_insert(&root, names[idx], (void *)(idx+1)));
+  ASSERT_TRUE(wal_checkpoint(&root));
+  for (size_t idx = sizeof(names)/sizeof(char *)/2; idx < sizeof(names)/sizeof(char *); ++idx)
+    ASSERT_TRUE(wal_insert(&root, names[idx], (void *)(idx+1)));
+  ASSERT_TRUE(wal_erase(&root, "kiwi", NULL));
+  ASSERT_TRUE(wal_close(&root));
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 3, strless, &codec, NULL, every));
+  ASSERT_EQUAL_U(sizeof(names)/sizeof(char *)-1, wal_size(&root));
+  ASSERT_FALSE(wal_contains(&root, "kiwi"));
+  for (size_t idx = 1; idx < sizeof(names)/sizeof(char *); ++idx)
+    ASSERT_EQUAL_U(idx+1, (uintptr_t)wal_find(&root, names[idx]));
+
+  /* the restored keys remain valid across a checkpoint */
+  ASSERT_TRUE(wal_checkpoint(&root));
+  ASSERT_EQUAL_U(3, (uintptr_t)wal_find(&root, "mango"));
+  ASSERT_TRUE(wal_close(&root));
+
+  remove(IMAGE);
+  remove(LOG);
+}
+
+/**
+ * writer - inserts the keys congruent to @arg modulo NTHREADS
+ *
+ * @arg: the index of the thread
+ *
+ * Returns the number of the failed insertions.
+ */
+void *writer(void *arg) {
+  uintptr_t errors = 0;
+
+  for (uintptr_t key = (uintptr_t)arg + 1; key <= NWRITES; key += NTHREADS)
+    errors += !wal_insert(&root, (void *)key, (void *)key);
+
+  return (void *)errors;
+}
+
+CTEST(wal_test, wal_concurrent_test) {
+  pthread_t threads[NTHREADS];
+  void      *errors;
+
+  remove(IMAGE);
+  remove(LOG);
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 8, less, NULL, NULL, every));
+
+  for (uintptr_t idx = 0; idx < NTHREADS; ++idx)
+    pthread_create(&threads[idx], NULL, writer, (void *)idx);
+
+  for (size_t idx = 0; idx < NTHREADS; ++idx) {
+    pthread_join(threads[idx], &errors);
+    ASSERT_NULL(errors);
+  }
+
+  ASSERT_TRUE(root.log.syncs <= NWRITES);
+  ASSERT_TRUE(wal_close(&root));
+
+  ASSERT_TRUE(wal_open(&root, IMAGE, LOG, 8, less, NULL, NULL, every));
+  ASSERT_EQUAL_U(NWRITES, wal_size(&root));
+  for (uintptr_t key = 1; key <= NWRITES; ++key)
+    ASSERT_EQUAL_U(key, (uintptr_t)wal_find(&root, (void *)key));
+  ASSERT_TRUE(wal_close(&root));
+
+  remove(IMAGE);
+  remove(LOG);
+}
+
+int main(int argc, const char **argv) { return ctest_main(argc, argv); }